@@ -11,6 +11,10 @@
 #include "TH1.h"
 #include "TFile.h"
 #include "MJVetoEvent.hh"
+#include "auto-veto/VetoGeometry.hh"
+#include "auto-veto/VetoCoincidence.hh"
+#include "auto-veto/VetoOutput.hh"
+#include "auto-veto/VetoWindowIndex.hh"
 
 using namespace std;
 
@@ -57,11 +61,8 @@ void GenerateVetoList(TChain *vetoTree)
 	ofstream MuonList("./output/MuonList_test.txt");
 
 	TTreeReader reader(vetoTree);
-	TTreeReaderValue<MJVetoEvent> events(reader,"events");
-	TTreeReaderValue<Long64_t> start(reader,"start");
-	TTreeReaderValue<Long64_t> stop(reader,"stop");
-	TTreeReaderValue<double> xTime(reader,"xTime");
-	TTreeReaderArray<int> CoinType(reader,"CoinType");	//[32]
+	VetoOutReader vetoIn(reader,vetoTree);  // either output layout
+	CoinBitsReader coinBits(reader,vetoTree);
 
 	bool newRun=false;
 	int prevRun=0;
@@ -69,28 +70,29 @@ void GenerateVetoList(TChain *vetoTree)
 
 	while(reader.Next())
 	{
-		MJVetoEvent veto = *events;
-		int run = veto.GetRun();
+		int run = vetoIn.GetRun();
+		Long64_t start = vetoIn.GetStart();
 		if (run != prevRun) newRun=true;
 		else newRun = false;
 
 		int type = 0;
-		if (CoinType[0]) type=1;
-		if (CoinType[1]) type=2;	// overrides type 1 if both are true
-		if ((*start-prevStop) > 10 && newRun) type = 3;
+		uint8_t coin = coinBits.Get();
+		if (coin & kCoinMuon) type=1;
+		if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
+		if ((start-prevStop) > 10 && newRun) type = 3;
 
 		char muonList[200];
 		if (type > 0) {
 			if (type==1 || type==2)
-				sprintf(muonList,"%i %lli %.8f %i %i\n",run,*start,*xTime,type,veto.GetBadScaler());
+				sprintf(muonList,"%i %lli %.8f %i %i\n",run,start,vetoIn.GetXTime(),type,vetoIn.GetBadScaler());
 			else if (type==3)
-				sprintf(muonList,"%i %lli 0.0 3 0\n",run,*start);
+				sprintf(muonList,"%i %lli 0.0 3 0\n",run,start);
 			cout << muonList;
 			MuonList << muonList;
 		}
 
 		// end of entry, save the run and stop time
-		prevStop = *stop;
+		prevStop = vetoIn.GetStop();
 		prevRun = run;
 	}
 	MuonList.close();
@@ -102,29 +104,27 @@ void GenerateDisplayList(TChain *vetoTree)
 	ofstream DisplayList("./output/MuonDisplay_test.txt");
 
 	TTreeReader reader(vetoTree);
-	TTreeReaderValue<MJVetoEvent> events(reader,"events");
-	TTreeReaderValue<Long64_t> start(reader,"start");
-	TTreeReaderValue<double> xTime(reader,"xTime");
-	TTreeReaderArray<int> CoinType(reader,"CoinType");	//[32]
+	VetoOutReader vetoIn(reader,vetoTree);  // either output layout
+	CoinBitsReader coinBits(reader,vetoTree);
 
 	while(reader.Next())
 	{
 		long i = reader.GetCurrentEntry();
-		MJVetoEvent veto = *events;
 
 		int type = 0;
-		if (CoinType[0]) type=1;
-		if (CoinType[1]) type=2;	// overrides type 1 if both are true
+		uint8_t coin = coinBits.Get();
+		if (coin & kCoinMuon) type=1;
+		if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
 
 		char display[200];
 		if (type>0) // all events passing TimeCut & EnergyCut
 		{
-			sprintf(display,"%i  %li  %lli  %.3f  ",events->GetRun(),i,*start,*xTime);
+			sprintf(display,"%i  %li  %lli  %.3f  ",vetoIn.GetRun(),i,vetoIn.GetStart(),vetoIn.GetXTime());
 			DisplayList << display;
 			for (int j=0; j<32; j++)
 			{
-				if (events->GetQDC(j) >= events->GetSWThresh(j))
-					DisplayList << events->GetQDC(j) << " ";
+				if (vetoIn.GetQDC(j) >= vetoIn.GetSWThresh(j))
+					DisplayList << vetoIn.GetQDC(j) << " ";
 				else
 					DisplayList << 0 << " ";
 			}
@@ -135,6 +135,7 @@ void GenerateDisplayList(TChain *vetoTree)
 
 void CalculateDeadTime(string MuonList, int dsNumber)
 {
+	// The windows are merged (VetoWindowIndex.hh), so overlapping ones aren't counted twice.
 	ifstream InputList(MuonList.c_str());
 	if(!InputList.good()) {
     	cout << "Couldn't open " << MuonList << endl;
@@ -158,6 +159,7 @@ void CalculateDeadTime(string MuonList, int dsNumber)
 		badScalerWindow = 8;
 	}
 
+	VetoWindowSet windows;
 	while(true)
 	{
 		InputList >> run >> utc >> hitTime >> type >> badScaler;
@@ -168,19 +170,29 @@ void CalculateDeadTime(string MuonList, int dsNumber)
 			if (badScaler) {
 				deadTime += 2*badScalerWindow;
 				deadBadScalerTime += 2*badScalerWindow;
+				windows.Add(run, hitTime-badScalerWindow, hitTime+badScalerWindow);
+			}
+			else {
+				deadTime += timeBefore + timeAfter;
+				windows.Add(run, hitTime-timeBefore, hitTime+timeAfter);
 			}
-			else deadTime += timeBefore + timeAfter;
 		}
 		if (type == 3) {
 			if (badScaler) {
 				deadTime += badScalerWindow;
 				deadBadScalerTime += badScalerWindow;
+				windows.Add(run, hitTime, hitTime+badScalerWindow);
+			}
+			else {
+				deadTime += timeAfter;
+				windows.Add(run, hitTime, hitTime+timeAfter);
 			}
-			else deadTime += timeAfter;
 		}
 		if (badScaler) numBadScalers++;
 	}
-	printf("Dead time due to veto: %.2f seconds.\n",deadTime);
+	windows.Build();
+	printf("Dead time due to veto: %.2f seconds (%.2f before merging %lu overlapping windows).\n",
+		windows.DeadTime(),deadTime,windows.GetNAdded()-windows.Size());
 	if (numBadScalers > 0) printf("Bad scalers: %i, %.2f of %.2f sec (%.2f%%)\n", numBadScalers,deadBadScalerTime,deadTime,((double)deadBadScalerTime/deadTime)*100);
 }
 
@@ -189,66 +201,11 @@ void CalculateDeadTime(string MuonList, int dsNumber)
 int PanelMap(int qdcChan, int runNum)
 {
 	// For Dave and Bradley.
-	// Using the 32-panel configuration as "standard", map the QDC index to a physical panel location for all of the run ranges.
-	// The figure "Veto Panels, View From The Top" in Veto System Change Log is the map I use for ALL configurations.
-	// key: "qdc channel"  value: "panel location"
-
-	map<int,int> panels;
-
-	// 32-panel config (default) - began 7/10/15
-	if (runNum < 45000000 && runNum >= 3057) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,25}, {25,26}, {26,27}, {27,28},
-		 {28,29}, {29,30}, {30,31}, {31,32}};
-		panels = tempMap;
-	}
-	// 1st prototype config (24 panels)
-	else if (runNum >= 45000509 && runNum <= 45004116) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,21}, {13,22}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,13}, {21,14}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	// 2nd prototype config (24 panels)
-	else if (runNum >= 45004117 && runNum <= 45008659) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	// 1st module 1 (P3JDY) config, 6/24/15 - 7/7/15
-	else if (runNum > 0 && runNum <=3056){
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	else {
+	// Map the QDC index to a physical panel location (see auto-veto/VetoGeometry.hh).
+	VetoGeometry geo(runNum);
+	if (!geo.IsKnown()) {
 		cout << "Panel map not known for this run number!\n";
 		return -1;
 	}
-	int panel = -1;
-	auto search = panels.find(qdcChan);
-	if(search != panels.end()) panel=search->second;
-	return panel;
+	return geo.GetLocation(qdcChan);
 }
@@ -0,0 +1,88 @@
+// DS4MuonList.hh
+// The DS4 muon list, made by GenerateDS4MuonList (skim-veto.cc) from the DS3 veto data,
+// kept in a data file (ds4Muons.txt) instead of being compiled in:
+//   ds4muons 1                       <- format version, the first line that isn't a comment
+//   # run  type  runTStart  time_s  uncert_s
+//   60000804 1 1472176844 14090.6928 1.41421356
+// skim-veto -ds4cat saves it as a muon catalog (VetoMuonCatalog.hh), which is what
+// skim-coins reads.  If there's no catalog, skim-coins reads this file instead.
+// C. Wiseman, A. Lopez
+
+#ifndef DS4MUONLIST_HH_GUARD
+#define DS4MUONLIST_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include "VetoMuonList.hh"
+
+const char *const kDS4MuonFile = "./ds4Muons.txt";
+const int kDS4MuonFileVersion = 1;
+
+// The muons of these runs (all of them if runs is empty), in run and time order,
+// like VetoMuonCatalog::Load.  False (see err) if the file can't be read, or has
+// a line that isn't [run] [type] [runTStart] [time] [uncert].
+inline bool LoadDS4MuonList(std::string fileName, VetoMuonList &mu, std::string &err,
+  const std::vector<int> &runs = std::vector<int>())
+{
+  std::ifstream in(fileName.c_str());
+  if (!in) { err = fileName + ": can't open"; return false; }
+  std::set<int> keep(runs.begin(), runs.end());
+  VetoMuonList all;
+  std::string line;
+  int lineNum = 0, version = 0;
+  while (getline(in, line)) {
+    lineNum++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    std::istringstream ss(line);
+    std::string first, extra;
+    if (!(ss >> first)) continue;
+    std::string where = fileName + ":" + std::to_string(lineNum) + ": ";
+    if (version == 0) {
+      if (first != "ds4muons" || !(ss >> version) || version != kDS4MuonFileVersion || (ss >> extra)) {
+        err = where + "expected \"ds4muons " + std::to_string(kDS4MuonFileVersion) + "\"";
+        return false;
+      }
+      continue;
+    }
+    int run = 0, type = 0;
+    double runTStart = 0, time = 0, unc = 0;
+    ss.clear();
+    ss.str(line);
+    if (!(ss >> run >> type >> runTStart >> time >> unc) || (ss >> extra)) {
+      err = where + "expected [run] [type] [runTStart] [time] [uncert]";
+      return false;
+    }
+    if (keep.empty() || keep.count(run)) all.Add(run, type, runTStart, time, unc);
+  }
+  if (version == 0) { err = fileName + ": empty"; return false; }
+
+  std::vector<size_t> order(all.Size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&all](size_t a, size_t b) {
+    return all.runs[a] != all.runs[b] ? all.runs[a] < all.runs[b] : all.times[a] < all.times[b];
+  });
+  for (auto i : order) mu.Add(all.runs[i], all.types[i], all.runTStarts[i], all.times[i], all.uncert[i]);
+  return true;
+}
+
+inline bool WriteDS4MuonList(std::string fileName, const VetoMuonList &mu)
+{
+  std::ofstream out(fileName.c_str());
+  if (!out) return false;
+  out << "ds4muons " << kDS4MuonFileVersion << "\n"
+      << "# The DS4 muon list, made by GenerateDS4MuonList (skim-veto.cc) from the DS3 veto data.\n"
+      << "# Read by LoadDS4MuonList (DS4MuonList.hh).  Type 1: muon, 2: vertical muon, 3: start of a run.\n"
+      << "# run  type  runTStart  time_s  uncert_s\n";
+  for (size_t i = 0; i < mu.Size(); i++)
+    out << mu.runs[i] << " " << mu.types[i] << " " << (long)mu.runTStarts[i] << " "
+        << std::setprecision(9) << mu.times[i] << " " << mu.uncert[i] << "\n";
+  return (bool)out;
+}
+
+#endif
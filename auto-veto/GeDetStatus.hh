@@ -0,0 +1,212 @@
+// GeDetStatus.hh
+// Ge detector status (bad, veto-only, enriched/natural) for skim-coins, read
+// from a data file (detStatus.txt) instead of being compiled in:
+//   detstatus 1                      <- format version, the first line that isn't a comment
+//   # ds  detID    status    [runs]
+//   0     28474    bad
+//   1     28480    vetoOnly
+// Status is one of bad, vetoOnly, enr, nat.  A detector can have several lines,
+// and their bits are or'ed.  The run range (first-last, both inclusive, or
+// first- / -last) is optional: without one, the line holds for the whole dataset.
+//
+// GeDetStatusTable::ForRun resolves the lines that hold for one run into a
+// GeDetStatusView, a perfect hash on detID: a lookup is one multiply, one slot,
+// and no allocation.  (If no table up to 2^20 slots is collision free, it's a
+// binary search instead.)  A detID with no lines has status 0 (good).
+// C. Wiseman, A. Lopez
+
+#ifndef GEDETSTATUS_HH_GUARD
+#define GEDETSTATUS_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include "VetoProducts.hh"
+
+const int kGeDetStatusVersion = 1;
+
+enum GeDetStatusBit {
+  kDetBad = 0x1,       // totally "bad" (not biased, etc): its hits are skipped
+  kDetVetoOnly = 0x2,  // use for veto only: its hits under 10 keV are skipped
+  kDetEnr = 0x4,       // enriched
+  kDetNat = 0x8        // natural
+};
+
+// The status of every listed detector, for one run.
+class GeDetStatusView
+{
+  public:
+    uint8_t Get(int detID) const
+    {
+      if (!fSlots.empty()) {
+        const Slot &s = fSlots[Hash(detID)];
+        return s.detID == detID ? s.status : 0;
+      }
+      auto it = std::lower_bound(fSorted.begin(), fSorted.end(), detID,
+        [](const Slot &s, int val) { return s.detID < val; });
+      return it != fSorted.end() && it->detID == detID ? it->status : 0;
+    }
+    bool IsBad(int detID) const { return Get(detID) & kDetBad; }
+    bool IsVetoOnly(int detID) const { return Get(detID) & kDetVetoOnly; }
+    size_t Size() const { return fN; }
+
+    // detIDs and their (or'ed) status.  Detectors with status 0 can be left out.
+    void Build(const std::vector<std::pair<int,uint8_t> > &dets)
+    {
+      fSlots.clear();
+      fSorted.clear();
+      fN = 0;
+      std::vector<std::pair<int,uint8_t> > merged(dets);
+      std::sort(merged.begin(), merged.end());
+      size_t n = 0;
+      for (size_t i = 0; i < merged.size(); i++) {
+        if (n > 0 && merged[n-1].first == merged[i].first) merged[n-1].second |= merged[i].second;
+        else merged[n++] = merged[i];
+      }
+      merged.resize(n);
+      if (n == 0) return;
+      fN = n;
+      // The smallest power-of-2 table, twice the size or more, with no collisions.
+      for (fBits = 1; fBits <= kMaxBits && (1u << fBits) < 2*n; fBits++);
+      for (; fBits <= kMaxBits; fBits++) {
+        fSlots.assign(1u << fBits, Slot{INT_MIN, 0});
+        bool ok = true;
+        for (auto &d : merged) {
+          Slot &s = fSlots[Hash(d.first)];
+          if (s.detID != INT_MIN) { ok = false; break; }
+          s = Slot{d.first, d.second};
+        }
+        if (ok) return;
+      }
+      // none: the merged list is already sorted by detID
+      fSlots.clear();
+      for (auto &d : merged) fSorted.push_back(Slot{d.first, d.second});
+    }
+
+  private:
+    struct Slot { int detID; uint8_t status; };
+    static const unsigned kMaxBits = 20;
+    std::vector<Slot> fSlots;
+    std::vector<Slot> fSorted;  // used if there's no perfect hash
+    unsigned fBits = 0;
+    size_t fN = 0;
+
+    size_t Hash(int detID) const { return ((uint32_t)detID * 2654435761u) >> (32 - fBits); }
+};
+
+// Every line of the status file for one dataset.
+class GeDetStatusTable
+{
+  public:
+    // False (see GetError) if the file can't be read, or has a line it doesn't understand.
+    bool Load(std::string fileName, int dsNumber)
+    {
+      fEntries.clear();
+      fError = "";
+      std::ifstream in(fileName.c_str());
+      if (!in) return Fail(fileName + ": can't open");
+      std::string line;
+      int lineNum = 0, version = 0;
+      while (getline(in, line)) {
+        lineNum++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream ss(line);
+        std::string first, extra;
+        if (!(ss >> first)) continue;
+        std::string where = fileName + ":" + std::to_string(lineNum) + ": ";
+        if (version == 0) {
+          std::string ver;
+          if (first != "detstatus" || !(ss >> ver) || !ParseInt(ver, version) || version != kGeDetStatusVersion || (ss >> extra))
+            return Fail(where + "expected \"detstatus " + std::to_string(kGeDetStatusVersion) + "\"");
+          continue;
+        }
+        Entry e;
+        int ds = 0;
+        std::string detID, status, runs;
+        if (!ParseInt(first, ds)) return Fail(where + "bad dataset number " + first);
+        if (!(ss >> detID >> status)) return Fail(where + "expected [ds] [detID] [status] (runs)");
+        if (!ParseInt(detID, e.detID) || e.detID == INT_MIN) return Fail(where + "bad detID " + detID);
+        e.status = StatusBit(status);
+        if (e.status == 0) return Fail(where + "unknown status " + status);
+        if ((ss >> runs) && !ParseRuns(runs, e.runLo, e.runHi)) return Fail(where + "bad run range " + runs);
+        if (ss >> extra) return Fail(where + "unexpected " + extra + " after the run range");
+        if (ds == dsNumber) fEntries.push_back(e);
+      }
+      if (version == 0) return Fail(fileName + ": empty");
+      return true;
+    }
+
+    // The status of every detector in one run.
+    GeDetStatusView ForRun(int run) const
+    {
+      std::vector<std::pair<int,uint8_t> > dets;
+      for (auto &e : fEntries)
+        if (run >= e.runLo && run <= e.runHi) dets.push_back(std::make_pair(e.detID, e.status));
+      GeDetStatusView view;
+      view.Build(dets);
+      return view;
+    }
+
+    size_t Size() const { return fEntries.size(); }
+    std::string GetError() const { return fError; }
+
+    // Changes when this dataset's lines do.
+    uint64_t GetKey() const
+    {
+      VetoKey key;
+      key.Add(kGeDetStatusVersion);
+      for (auto &e : fEntries) key.Add(e.detID).Add(e.status).Add(e.runLo).Add(e.runHi);
+      return key.Get();
+    }
+
+  private:
+    struct Entry {
+      int detID = 0;
+      uint8_t status = 0;
+      int runLo = INT_MIN, runHi = INT_MAX;
+    };
+    std::vector<Entry> fEntries;  // this dataset's lines
+    std::string fError;
+
+    bool Fail(std::string err) { fError = err; fEntries.clear(); return false; }
+
+    static uint8_t StatusBit(const std::string &s)
+    {
+      if (s == "bad") return kDetBad;
+      if (s == "vetoOnly") return kDetVetoOnly;
+      if (s == "enr") return kDetEnr;
+      if (s == "nat") return kDetNat;
+      return 0;
+    }
+
+    // The whole string must be an integer ("12abc" is rejected).
+    static bool ParseInt(const std::string &s, int &val)
+    {
+      size_t end = 0;
+      try { val = std::stoi(s, &end); }
+      catch (...) { return false; }
+      return end == s.size();
+    }
+
+    // "first-last", "first-", "-last", or one run.
+    static bool ParseRuns(const std::string &s, int &lo, int &hi)
+    {
+      size_t dash = s.find('-');
+      if (dash == std::string::npos) {
+        if (!ParseInt(s, lo)) return false;
+        hi = lo;
+        return true;
+      }
+      if (dash == 0 && dash+1 == s.size()) return false;  // "-"
+      if (dash > 0 && !ParseInt(s.substr(0, dash), lo)) return false;
+      if (dash+1 < s.size() && !ParseInt(s.substr(dash+1), hi)) return false;
+      return lo <= hi;
+    }
+};
+
+#endif
@@ -0,0 +1,135 @@
+// GeSelection.hh
+// High-energy pre-selection of gatified events, for skim-coins.
+// A cheap first pass reads only trapENFCal, trapECal and EventDC1Bits, and lists
+// the events with a hit over the energy threshold that aren't pulsers.  The full
+// read (every vector branch) is then done only for those entries.
+// The lists are saved in a cache directory, one file per gatified file and cut:
+//   [gatified file name].[key].gesel
+// The key is a hash of kGeSelectionVersion, the cuts, and the file's identity
+// (VetoFileKey: size, mtime, and a checksum of its first and last MB), so
+// different thresholds don't overwrite each other, and a changed file is rescanned.
+// C. Wiseman, A. Lopez
+
+#ifndef GESELECTION_HH_GUARD
+#define GESELECTION_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "TChain.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+#include "VetoProducts.hh"
+
+const int kGeSelectionVersion = 1;
+
+struct GeSelectCuts {
+  double eThresh = 2630;              // keV.  keep events with a hit over this in trapENFCal or trapECal
+  unsigned int pulserMask = 0x1 << 1; // EventDC1Bits of pulser events (Pinghan's)
+};
+
+struct GeSelection {
+  uint64_t key = 0;
+  long entries = 0;                   // events in the file
+  std::vector<Long64_t> selected;     // entries passing the cuts, in order
+};
+
+inline uint64_t GeSelectionKey(const std::string &gatFile, const GeSelectCuts &cuts)
+{
+  uint64_t fileKey = VetoFileKey(gatFile);
+  if (fileKey == 0) return 0;
+  return VetoKey().Add(kGeSelectionVersion).Add(fileKey).Add(cuts.eThresh).Add(cuts.pulserMask).Get();
+}
+
+inline std::string GeSelectionFile(const std::string &cacheDir, const std::string &gatFile, uint64_t key)
+{
+  size_t slash = gatFile.find_last_of('/');
+  std::string base = (slash == std::string::npos) ? gatFile : gatFile.substr(slash+1);
+  char hex[20];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+  return cacheDir + "/" + base + "." + hex + ".gesel";
+}
+
+// The first pass.  Only the three branches are read.
+inline bool ScanGeSelection(const std::string &gatFile, const std::string &treeName, const GeSelectCuts &cuts, GeSelection &sel)
+{
+  TChain chain(treeName.c_str());
+  if (!chain.Add(gatFile.c_str())) return false;
+  TTreeReader reader(&chain);
+  TTreeReaderValue< std::vector<double> > trapENFCalIn(reader, "trapENFCal");
+  TTreeReaderValue< std::vector<double> > trapECalIn(reader, "trapECal");
+  TTreeReaderValue<unsigned int> eventDC1BitsIn(reader, "EventDC1Bits");
+  sel.selected.clear();
+  sel.entries = 0;
+  while (reader.Next()) {
+    sel.entries++;
+    if (*eventDC1BitsIn & cuts.pulserMask) continue;
+    const std::vector<double> &enf = *trapENFCalIn, &ecal = *trapECalIn;
+    for (size_t i = 0; i < enf.size(); i++)
+      if (enf[i] >= cuts.eThresh || (i < ecal.size() && ecal[i] >= cuts.eThresh)) {
+        sel.selected.push_back(reader.GetCurrentEntry());
+        break;
+      }
+  }
+  return true;
+}
+
+inline bool LoadGeSelection(const std::string &fileName, uint64_t key, GeSelection &sel)
+{
+  if (key == 0) return false;
+  FILE *f = fopen(fileName.c_str(), "rb");
+  if (!f) return false;
+  char magic[8];
+  uint64_t fileKey = 0, n = 0;
+  int64_t entries = 0;
+  bool ok = fread(magic, 8, 1, f) == 1 && memcmp(magic, "GESEL001", 8) == 0
+    && fread(&fileKey, sizeof(fileKey), 1, f) == 1 && fileKey == key
+    && fread(&entries, sizeof(entries), 1, f) == 1
+    && fread(&n, sizeof(n), 1, f) == 1;
+  if (ok) {
+    sel.selected.resize(n);
+    ok = n == 0 || fread(sel.selected.data(), sizeof(Long64_t), n, f) == n;
+  }
+  fclose(f);
+  if (!ok) { sel.selected.clear(); return false; }
+  sel.key = key;
+  sel.entries = entries;
+  return true;
+}
+
+// Written to a temporary file, then renamed, so a reader never sees part of a list.
+inline bool SaveGeSelection(const std::string &fileName, const GeSelection &sel)
+{
+  if (sel.key == 0) return false;
+  std::string tmp = fileName + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  uint64_t n = sel.selected.size();
+  int64_t entries = sel.entries;
+  bool ok = fwrite("GESEL001", 8, 1, f) == 1 && fwrite(&sel.key, sizeof(sel.key), 1, f) == 1
+    && fwrite(&entries, sizeof(entries), 1, f) == 1 && fwrite(&n, sizeof(n), 1, f) == 1
+    && (n == 0 || fwrite(sel.selected.data(), sizeof(Long64_t), n, f) == n);
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp.c_str(), fileName.c_str()) == 0;
+  if (!ok) remove(tmp.c_str());
+  return ok;
+}
+
+// The selection for one gatified file: from the cache if it's there, else scanned (and saved).
+// reused: true if it came from the cache.
+inline bool GetGeSelection(const std::string &gatFile, const std::string &treeName, const GeSelectCuts &cuts,
+  const std::string &cacheDir, GeSelection &sel, bool &reused)
+{
+  reused = false;
+  uint64_t key = GeSelectionKey(gatFile, cuts);
+  std::string cacheFile = GeSelectionFile(cacheDir, gatFile, key);
+  if (LoadGeSelection(cacheFile, key, sel)) { reused = true; return true; }
+  if (!ScanGeSelection(gatFile, treeName, cuts, sel)) return false;
+  sel.key = key;
+  if (key != 0) SaveGeSelection(cacheFile, sel);
+  return true;
+}
+
+#endif
@@ -0,0 +1,253 @@
+// GeTimeIndex.hh
+// Sorted (ORCA packet index, Ge timestamp) table for one run's built data.
+// The bad-scaler interpolation only needs the packet index and timestamp of the
+// first digitizer hit in each built entry, but it needs them all over the run.
+// The table is built with one pass over the built chain, saved next to the
+// veto output (veto_run%i.geidx), and every lookup after that is a binary search.
+// The pass only reads the event branch without its waveforms.  The saved table is
+// keyed on the built files themselves (BuiltChainKey), so it's rebuilt if they change.
+//
+// The veto/Ge clock sync only needs the packets around one veto entry near the
+// start of the run, so it doesn't use the table: ScanGeSync reads the first
+// ~200 built entries (more if the packet after the sync event hasn't turned up yet).
+// C. Wiseman, A. Lopez
+
+#ifndef GETIMEINDEX_HH_GUARD
+#define GETIMEINDEX_HH_GUARD
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TBranch.h"
+#include "MGTEvent.hh"
+#include "MGVDigitizerData.hh"
+#include "VetoProducts.hh"
+
+// Key of the built files behind a chain: VetoFileKey of each one, in order.
+// Used for the Ge index and for the veto products (VetoProducts.hh).
+// 0 if any of them can't be read (e.g. a remote path), so nothing is reused.
+inline uint64_t BuiltChainKey(TChain *chain)
+{
+  VetoKey key;
+  TObjArray *files = chain->GetListOfFiles();
+  int n = files ? files->GetEntries() : 0;
+  if (n == 0) return 0;
+  for (int i = 0; i < n; i++) {
+    uint64_t fileKey = VetoFileKey(((TChainElement*)files->At(i))->GetTitle());
+    if (fileKey == 0) return 0;
+    key.Add(fileKey);
+  }
+  return key.Get();
+}
+
+// Saves the status of every branch of a chain, and puts them back when it goes out
+// of scope, so a pass that only reads some branches leaves the caller's as they were.
+class BranchStatusGuard
+{
+  public:
+    BranchStatusGuard(TChain *chain) : fChain(chain)
+    {
+      if (fChain->LoadTree(0) >= 0) Save(fChain->GetListOfBranches());
+    }
+    ~BranchStatusGuard()
+    {
+      // parents first, so a parent doesn't undo its sub-branches
+      for (auto &s : fStatus) fChain->SetBranchStatus(s.first.c_str(), s.second);
+    }
+
+  private:
+    TChain *fChain;
+    std::vector<std::pair<std::string,bool> > fStatus;
+
+    void Save(TObjArray *branches)
+    {
+      if (!branches) return;
+      for (int i = 0; i < branches->GetEntries(); i++) {
+        TBranch *br = (TBranch*)branches->At(i);
+        fStatus.push_back(std::make_pair(std::string(br->GetName()), fChain->GetBranchStatus(br->GetName())));
+        Save(br->GetListOfBranches());
+      }
+    }
+};
+
+// Ge times around the veto sync event (packet scalerIndex), from a bounded scan of
+// the start of the built chain:
+//   first:  the first Ge timestamp in the run
+//   before: the last packet read with an index below the sync packet
+//   after:  the packet with the closest index above the sync packet
+// The scan reads 200 entries, and one more for each entry until a packet after the
+// sync packet is found.  (Packets can be out of order after a buffer flush.)
+// Times are in seconds, and 0 if not found.  Returns the number of entries read.
+inline long ScanGeSync(TChain *builtChain, long scalerIndex, double &first, double &before, double &after)
+{
+  first = before = after = 0;
+  long bEntries = builtChain->GetEntries();
+  long minPacketDiff = LONG_MAX;
+  long maxEntry = 200;
+  bool foundPacketAfter = false;
+  long bItr = 0;
+  MGTEvent *evt=0;
+  {
+    BranchStatusGuard status(builtChain);
+    builtChain->SetBranchStatus("*",0);
+    builtChain->SetBranchStatus("event",1);
+    builtChain->SetBranchStatus("*Waveforms*",0);  // fWaveforms, fAuxWaveforms
+    builtChain->SetBranchAddress("event",&evt);
+    for (; bItr < bEntries && bItr <= maxEntry; bItr++)
+    {
+      builtChain->GetEntry(bItr);
+      if (evt->GetNDigitizerData() > 0)
+      {
+        MGVDigitizerData *dig = evt->GetDigitizerData(0);
+        long bIndex = dig->GetIndex();
+        double bTime = ((double)dig->GetTimeStamp())*1.e-8;
+        if (first == 0) first = bTime;
+        if (bIndex < scalerIndex) before = bTime;
+        long packetDiff = labs(bIndex - scalerIndex);
+        if (bIndex > scalerIndex && packetDiff < minPacketDiff) {
+          after = bTime;
+          minPacketDiff = packetDiff;
+          foundPacketAfter = true;
+        }
+      }
+      if (!foundPacketAfter) maxEntry++;
+    }
+    builtChain->ResetBranchAddresses();
+  }
+  delete evt;
+  return bItr;
+}
+
+class GeTimeIndex
+{
+  public:
+
+    GeTimeIndex() : fBuiltEntries(0), fKey(0), fFirstTime(0) {}
+
+    long GetBuiltEntries() const { return fBuiltEntries; }
+    size_t GetSize() const { return fIndex.size(); }
+    double GetFirstTime() const { return fFirstTime; }  // first Ge timestamp in the built file (seconds)
+
+    // Key of the built files the table was made from (see BuiltChainKey).  0 for synthetic runs.
+    uint64_t GetKey() const { return fKey; }
+
+    // One pass over the built chain.  Only the "event" branch is read, without the
+    // waveforms: the table needs the packet index and timestamp of the digitizer data.
+    void Build(TChain *builtChain)
+    {
+      fBuiltEntries = builtChain->GetEntries();
+      fKey = BuiltChainKey(builtChain);
+      fFirstTime = 0;
+      std::vector<uint64_t> index;
+      std::vector<double> time;
+      index.reserve(fBuiltEntries);
+      time.reserve(fBuiltEntries);
+
+      MGTEvent *evt=0;
+      {
+        BranchStatusGuard status(builtChain);
+        builtChain->SetBranchStatus("*",0);
+        builtChain->SetBranchStatus("event",1);
+        builtChain->SetBranchStatus("*Waveforms*",0);  // fWaveforms, fAuxWaveforms
+        builtChain->SetBranchAddress("event",&evt);
+        for (long i = 0; i < fBuiltEntries; i++)
+        {
+          builtChain->GetEntry(i);
+          if (evt->GetNDigitizerData() < 1) continue;
+          MGVDigitizerData *dig = evt->GetDigitizerData(0);
+          index.push_back(dig->GetIndex());
+          time.push_back(((double)dig->GetTimeStamp())*1.e-8);
+          if (fFirstTime == 0) fFirstTime = time.back();
+        }
+        builtChain->ResetBranchAddresses();
+      }
+      delete evt;
+
+      // Packets can be out of order after a buffer flush, so sort by index.
+      std::vector<size_t> order(index.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return index[a] < index[b]; });
+      fIndex.resize(index.size());
+      fTime.resize(index.size());
+      for (size_t i = 0; i < order.size(); i++) {
+        fIndex[i] = index[order[i]];
+        fTime[i] = time[order[i]];
+      }
+    }
+
+    // Ge timestamps (seconds) of the closest packets before and after this one.
+    // A side with no packet is left at 0.  Returns true if both were found.
+    bool Around(long packet, double &tBefore, double &tAfter) const
+    {
+      tBefore = 0;
+      tAfter = 0;
+      if (packet < 0) packet = 0;
+      std::vector<uint64_t>::const_iterator lo = std::lower_bound(fIndex.begin(), fIndex.end(), (uint64_t)packet);
+      std::vector<uint64_t>::const_iterator hi = std::upper_bound(lo, fIndex.end(), (uint64_t)packet);
+      bool before = (lo != fIndex.begin()), after = (hi != fIndex.end());
+      if (before) tBefore = fTime[(lo - fIndex.begin()) - 1];
+      if (after) tAfter = fTime[hi - fIndex.begin()];
+      return before && after;
+    }
+
+    // Binary sidecar file.  Load() rejects a file made from other built files
+    // (a different key) or a different number of built entries.
+    bool Save(std::string fileName) const
+    {
+      std::ofstream out(fileName.c_str(), std::ios::binary);
+      if (!out) return false;
+      uint64_t n = fIndex.size();
+      out.write(Magic(), 8);
+      out.write((const char*)&fBuiltEntries, sizeof(fBuiltEntries));
+      out.write((const char*)&fKey, sizeof(fKey));
+      out.write((const char*)&fFirstTime, sizeof(fFirstTime));
+      out.write((const char*)&n, sizeof(n));
+      out.write((const char*)fIndex.data(), n*sizeof(uint64_t));
+      out.write((const char*)fTime.data(), n*sizeof(double));
+      return out.good();
+    }
+
+    bool Load(std::string fileName, long builtEntries, uint64_t key)
+    {
+      std::ifstream in(fileName.c_str(), std::ios::binary);
+      if (!in) return false;
+      char magic[8];
+      long entries = 0;
+      uint64_t fileKey = 0;
+      double first = 0;
+      uint64_t n = 0;
+      in.read(magic, sizeof(magic));
+      in.read((char*)&entries, sizeof(entries));
+      in.read((char*)&fileKey, sizeof(fileKey));
+      in.read((char*)&first, sizeof(first));
+      in.read((char*)&n, sizeof(n));
+      if (!in || memcmp(magic, Magic(), 8) != 0 || entries != builtEntries || fileKey != key) return false;
+      fIndex.resize(n);
+      fTime.resize(n);
+      in.read((char*)fIndex.data(), n*sizeof(uint64_t));
+      in.read((char*)fTime.data(), n*sizeof(double));
+      if (!in) { fIndex.clear(); fTime.clear(); return false; }
+      fBuiltEntries = entries;
+      fKey = fileKey;
+      fFirstTime = first;
+      return true;
+    }
+
+  private:
+    static const char *Magic() { return "GETIDX02"; }  // 8 bytes, file format version
+    long fBuiltEntries;
+    uint64_t fKey;
+    double fFirstTime;
+    std::vector<uint64_t> fIndex;  // sorted packet index
+    std::vector<double> fTime;     // Ge timestamp (seconds) of each packet
+};
+
+#endif
@@ -0,0 +1,222 @@
+// SkimOutput.hh
+// Layout of skim-coins' skimTree.
+//
+// The hit-level quantities are flat arrays sized by the nHit leaf ("channel[nHit]/I"),
+// rather than std::vector branches.  They live in one structure-of-arrays buffer,
+// SkimEvent::hits, which is allocated once and reused for every event: a hit is
+// written by index, and the buffer only grows (and the branches are re-pointed)
+// when an event has more hits than any before it.
+//
+// Detector names are dictionary encoded: each hit has a detIdx into the file's
+// "detTable" tree (detIdx, detName).  The yes/no hit quantities are bits of one
+// hitFlags byte (SkimHitFlag):
+//   skimTree->Draw("trapENFCal", "hitFlags & 1")   // enriched detectors
+// C. Wiseman, A. Lopez
+
+#ifndef SKIMOUTPUT_HH_GUARD
+#define SKIMOUTPUT_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include "TFile.h"
+#include "TTree.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+
+enum SkimHitFlag {
+  kHitEnr = 0x1,          // enriched detector (name starts with 'P')
+  kHitNat = 0x2,          // natural detector (name starts with 'B')
+  kHitGood = 0x4,         // not a use-for-veto-only detector
+  kHitLowGain = 0x8,      // odd channel
+  kHitMuVeto = 0x10,      // in a muon veto window
+  kHitMuVetoWide = 0x20   // in a DS4-size muon veto window
+};
+
+// Enriched/natural bits of a detector, from its name.
+inline UChar_t SkimDetFlags(const std::string &detName)
+{
+  if (detName.empty()) return 0;
+  return detName[0] == 'P' ? kHitEnr : (detName[0] == 'B' ? kHitNat : 0);
+}
+
+// The hit columns.  Entries [0, nHit) belong to the current event.
+class SkimHits
+{
+  public:
+    Int_t nHit = 0;
+    std::vector<Int_t> iHit, channel, pos, det, cryo, detID, dateMT, muType;
+    std::vector<UShort_t> detIdx;
+    std::vector<UChar_t> hitFlags;
+    std::vector<Double_t> tloc_s, time_s, timeMT, trapENFCal, trapECal, dtmu_s, muTUnc;
+
+    SkimHits() { Grow(kInitHits); }
+
+    size_t Capacity() const { return fCapacity; }
+
+    // Make room for n hits.  Only reallocates (and re-points t's branches) if n is a new maximum.
+    void Reserve(size_t n, TTree *t)
+    {
+      if (n <= fCapacity) return;
+      Grow(std::max(n, 2*fCapacity));
+      if (t) SetAddresses(t, false);
+    }
+
+    // Start a hit and return its index.  Call Reserve first.
+    size_t Add() { hitFlags[nHit] = 0; return nHit++; }
+
+    void Book(TTree *t) { t->Branch("nHit", &nHit, "nHit/I"); SetAddresses(t, true); }
+
+  private:
+    static const size_t kInitHits = 64;
+    size_t fCapacity = 0;
+
+    void Grow(size_t n)
+    {
+      fCapacity = n;
+      for (auto v : {&iHit, &channel, &pos, &det, &cryo, &detID, &dateMT, &muType}) v->resize(n);
+      for (auto v : {&tloc_s, &time_s, &timeMT, &trapENFCal, &trapECal, &dtmu_s, &muTUnc}) v->resize(n);
+      detIdx.resize(n);
+      hitFlags.resize(n);
+    }
+
+    // Book the columns (with the tree's names and types), or re-point them after a Grow.
+    void SetAddresses(TTree *t, bool book)
+    {
+      Column(t, book, "iHit", iHit, "I");
+      Column(t, book, "channel", channel, "I");
+      Column(t, book, "P", pos, "I");
+      Column(t, book, "D", det, "I");
+      Column(t, book, "C", cryo, "I");
+      Column(t, book, "detID", detID, "I");
+      Column(t, book, "detIdx", detIdx, "s");
+      Column(t, book, "hitFlags", hitFlags, "b");
+      Column(t, book, "tloc_s", tloc_s, "D");
+      Column(t, book, "time_s", time_s, "D");
+      Column(t, book, "timeMT", timeMT, "D");
+      Column(t, book, "dateMT", dateMT, "I");
+      Column(t, book, "trapENFCal", trapENFCal, "D");
+      Column(t, book, "trapECal", trapECal, "D");
+      Column(t, book, "dtmu_s", dtmu_s, "D");
+      Column(t, book, "muType", muType, "I");
+      Column(t, book, "muTUnc", muTUnc, "D");
+    }
+
+    template <class T> void Column(TTree *t, bool book, const char *name, std::vector<T> &v, const char *type)
+    {
+      if (book) t->Branch(name, v.data(), (std::string(name) + "[nHit]/" + type).c_str());
+      else t->SetBranchAddress(name, v.data());
+    }
+};
+
+// One event's skimTree entry.
+class SkimEvent
+{
+  public:
+    Int_t run = 0, iEvent = 0;
+    Double_t runTime_s = 0, startTime = 0, startTime0 = 0, stopTime = 0;
+    Int_t mH = 0, mL = 0;
+    UInt_t eventDC1Bits = 0;
+    SkimHits hits;
+
+    void ClearHits() { hits.nHit = 0; mH = 0; mL = 0; }
+
+    void Book(TTree *t)
+    {
+      // run level variables and indices
+      t->Branch("run", &run, "run/I");
+      t->Branch("iEvent", &iEvent, "iEvent/I");
+
+      // time variables
+      t->Branch("startTime", &startTime, "startTime/D");
+      t->Branch("startTime0", &startTime0, "startTime0/D");
+      t->Branch("runTime_s", &runTime_s, "runTime_s/D");
+      t->Branch("stopTime", &stopTime, "stopTime/D");
+
+      // analysis cut variables
+      t->Branch("mH", &mH, "mH/I");
+      t->Branch("mL", &mL, "mL/I");
+
+      // data cleaning variables
+      t->Branch("EventDC1Bits", &eventDC1Bits, "eventDC1Bits/i");
+
+      // hit variables: IDs, times, energies, and veto
+      hits.Book(t);
+    }
+};
+
+// The detector dictionary: detIdx -> detName.  Shared by all the shards of a
+// job, so an index means the same detector in every shard, and the shards can
+// still be merged without rewriting their baskets.  Thread safe.
+class SkimDetTable
+{
+  public:
+    // The index of a detector, added if it's new.
+    UShort_t Index(const std::string &name)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      auto it = fIndex.find(name);
+      if (it != fIndex.end()) return it->second;
+      UShort_t idx = fNames.size();
+      fNames.push_back(name);
+      fIndex[name] = idx;
+      return idx;
+    }
+
+    // Take in a table written earlier (a shard from an earlier job).
+    // False, and no change, if it gives an index a different detector than this one does.
+    bool Merge(const std::vector<std::string> &names)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      for (size_t i = 0; i < names.size(); i++) {
+        if (i < fNames.size() && fNames[i] != names[i]) return false;
+        if (i >= fNames.size() && fIndex.count(names[i])) return false;
+      }
+      for (size_t i = fNames.size(); i < names.size(); i++) {
+        fIndex[names[i]] = i;
+        fNames.push_back(names[i]);
+      }
+      return true;
+    }
+
+    std::vector<std::string> Names() const
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      return fNames;
+    }
+
+    // Write the "detTable" tree to the current directory.
+    static void Write(const std::vector<std::string> &names)
+    {
+      TTree t("detTable", "detTable");
+      Int_t idx = 0;
+      std::string name;
+      t.Branch("detIdx", &idx, "detIdx/I");
+      t.Branch("detName", &name);
+      for (idx = 0; idx < (Int_t)names.size(); idx++) {
+        name = names[idx];
+        t.Fill();
+      }
+      t.Write("", TObject::kOverwrite);
+    }
+
+    static bool Read(TFile *f, std::vector<std::string> &names)
+    {
+      names.clear();
+      TTree *t = (TTree*)f->Get("detTable");
+      if (!t) return false;
+      TTreeReader reader(t);
+      TTreeReaderValue<std::string> nameIn(reader, "detName");
+      while (reader.Next()) names.push_back(*nameIn);
+      return true;
+    }
+
+  private:
+    mutable std::mutex fMutex;
+    std::vector<std::string> fNames;
+    std::unordered_map<std::string, UShort_t> fIndex;
+};
+
+#endif
@@ -0,0 +1,47 @@
+// VetoBranches.hh
+// Pruned reading of the built VetoTree.  Decoding an entry (MJVetoEvent::WriteEvent)
+// needs vetoBits and vetoEvent, plus the run object, which is the same for every
+// entry in a file.  PruneVetoTree turns every other branch off (mVeto, ...), and
+// gives the tree a TTreeCache holding only the per-entry branches, set up front
+// (no learning phase).  The run branch stays on but out of the cache, so a
+// TTreeReader only reads it when it's asked for (VetoRunCache: once per file).
+// C. Wiseman, A. Lopez
+
+#ifndef VETOBRANCHES_HH_GUARD
+#define VETOBRANCHES_HH_GUARD
+
+#include "TChain.h"
+#include "TBranch.h"
+
+const long kVetoTreeCacheBytes = 8*1024*1024;
+
+// Uncompressed sizes of the first file's VetoTree: all branches, and the ones read every entry.
+struct VetoTreeBytes {
+  long long total = 0, perEntry = 0;
+};
+
+inline VetoTreeBytes PruneVetoTree(TTree *vetoTree, bool readMult=false)
+{
+  VetoTreeBytes bytes;
+  const char *perEntry[] = {"vetoBits", "vetoEvent", "mVeto"};
+  int nPerEntry = readMult ? 3 : 2;
+
+  vetoTree->LoadTree(0);
+  if (TTree *t = vetoTree->GetTree()) {
+    bytes.total = t->GetTotBytes();
+    for (int i = 0; i < nPerEntry; i++)
+      if (TBranch *br = t->GetBranch(perEntry[i])) bytes.perEntry += br->GetTotBytes("*");
+  }
+
+  // Setting a split branch's status also sets its sub-branches.
+  vetoTree->SetBranchStatus("*",0);
+  vetoTree->SetBranchStatus("run",1);
+  for (int i = 0; i < nPerEntry; i++) vetoTree->SetBranchStatus(perEntry[i],1);
+
+  vetoTree->SetCacheSize(kVetoTreeCacheBytes);
+  for (int i = 0; i < nPerEntry; i++) vetoTree->AddBranchToCache(perEntry[i],kTRUE);
+  vetoTree->StopCacheLearningPhase();
+  return bytes;
+}
+
+#endif
@@ -0,0 +1,167 @@
+// VetoCoincidence.hh
+// Plane-based muon coincidence classes.
+// An event's hit pattern is a 12-bit plane mask (bit p = plane p, see VetoGeometry.hh),
+// so every possible pattern fits in a 4096-entry table.  The table is generated at
+// compile time from the rule functions below, and classifying an event is one lookup.
+// To add a coincidence class, give it a bit and a rule in CoinClass().
+// C. Wiseman, A. Lopez
+
+#ifndef VETOCOINCIDENCE_HH_GUARD
+#define VETOCOINCIDENCE_HH_GUARD
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TTree.h"
+#include "TBranch.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+#include "TTreeReaderArray.h"
+
+// Coincidence bits (same indexes as the old CoinType vector):
+// 0: muon candidate -- passes the LED cut and the energy cut (2+ panels over QDC 500)
+// 1: vertical     -- both bottom planes and both top planes
+// 2: side+bottom  -- both bottom planes and both planes of a side
+// 3: top+sides    -- both top planes and both planes of a side
+// 4: side         -- both planes of a side, without a complete top or bottom pair
+// Bits 1-4 depend only on the plane mask.  Bit 0 depends on the cuts, so it is set by the caller.
+const int nCoinBits = 5;
+const uint8_t kCoinMuon = 1u << 0;
+const uint8_t kCoinVertical = 1u << 1;
+const uint8_t kCoinSideBottom = 1u << 2;
+const uint8_t kCoinTopSide = 1u << 3;
+const uint8_t kCoinSide = 1u << 4;
+
+// Hit types printed by auto-veto.  Types 1-3 match coincidence bits 1-3.
+enum { kHit2Panels=0, kHitVertical=1, kHitSideBottom=2, kHitTopSide=3, kHitCompound=4 };
+
+namespace VetoCoin {
+
+constexpr bool Both(int mask, int p1, int p2) {
+  return ((mask >> p1) & 1) && ((mask >> p2) & 1);
+}
+constexpr bool Bottom(int mask) { return Both(mask,0,1); }
+constexpr bool Top(int mask) { return Both(mask,2,3); }
+constexpr bool AnySide(int mask) {
+  return Both(mask,4,5) || Both(mask,6,7) || Both(mask,8,9) || Both(mask,10,11);
+}
+
+// The rules.  Returns coincidence bits 1-4 for a plane mask.
+constexpr uint8_t CoinClass(int mask) {
+  return (uint8_t)(
+      ((Bottom(mask) && Top(mask)) ? kCoinVertical : 0)
+    | ((Bottom(mask) && AnySide(mask)) ? kCoinSideBottom : 0)
+    | ((Top(mask) && AnySide(mask)) ? kCoinTopSide : 0)
+    | ((AnySide(mask) && !Bottom(mask) && !Top(mask)) ? kCoinSide : 0));
+}
+
+// Hit type: the last of types 1-3 that matched, or compound if two or more did.
+constexpr int HitType(int mask) {
+  return ((CoinClass(mask) & kCoinVertical) ? 1 : 0)
+       + ((CoinClass(mask) & kCoinSideBottom) ? 1 : 0)
+       + ((CoinClass(mask) & kCoinTopSide) ? 1 : 0) > 1 ? kHitCompound
+    : (CoinClass(mask) & kCoinTopSide) ? kHitTopSide
+    : (CoinClass(mask) & kCoinSideBottom) ? kHitSideBottom
+    : (CoinClass(mask) & kCoinVertical) ? kHitVertical
+    : kHit2Panels;
+}
+
+// Table entry: coincidence bits in the low byte, hit type in the next byte.
+constexpr uint16_t Entry(int mask) { return (uint16_t)(CoinClass(mask) | (HitType(mask) << 8)); }
+
+// Compile-time 0..N-1 index list, built by doubling so the template depth stays small (C++11).
+template <int... I> struct Seq {};
+template <class A, class B> struct Concat;
+template <int... I, int... J> struct Concat<Seq<I...>, Seq<J...> > { typedef Seq<I..., (int)sizeof...(I)+J...> type; };
+template <int N> struct MakeSeq {
+  typedef typename Concat<typename MakeSeq<N/2>::type, typename MakeSeq<N-N/2>::type>::type type;
+};
+template <> struct MakeSeq<0> { typedef Seq<> type; };
+template <> struct MakeSeq<1> { typedef Seq<0> type; };
+
+template <class S> struct Table;
+template <int... I> struct Table<Seq<I...> > {
+  static constexpr uint16_t entry[sizeof...(I)] = { Entry(I)... };
+};
+template <int... I> constexpr uint16_t Table<Seq<I...> >::entry[sizeof...(I)];
+
+typedef Table<MakeSeq<4096>::type> CoinTable;
+
+static_assert(CoinTable::entry[0xF] == (kCoinVertical | (kHitVertical << 8)), "vertical muon table entry");
+static_assert(CoinTable::entry[0x33] == (kCoinSideBottom | (kHitSideBottom << 8)), "side+bottom table entry");
+static_assert(CoinTable::entry[0xFFF] == (kCoinVertical | kCoinSideBottom | kCoinTopSide | (kHitCompound << 8)), "compound table entry");
+
+} // namespace VetoCoin
+
+// Coincidence bits 1-4 of a 12-bit plane mask.
+inline uint8_t GetCoinClass(uint16_t planeMask) { return VetoCoin::CoinTable::entry[planeMask & 0xFFF] & 0xFF; }
+
+// Hit type (kHit2Panels ... kHitCompound) of a 12-bit plane mask.
+inline int GetHitType(uint16_t planeMask) { return VetoCoin::CoinTable::entry[planeMask & 0xFFF] >> 8; }
+
+// Reads the coincidence bits of the current entry of a vetoTree (or a chain of
+// them), loaded with TTreeReader or with GetEntry.  Files written before the
+// "CoinBits" branch existed store CoinType instead: a vector<int>(32) from
+// auto-veto, or an int[32] from vetoScan.  The layout is looked up for each file
+// of a chain, so a chain can mix them.
+class CoinBitsReader
+{
+  public:
+    explicit CoinBitsReader(TTree *tree) : fTree(tree) {}
+    CoinBitsReader(TTreeReader &, TTree *tree) : fTree(tree) {}
+    ~CoinBitsReader() { delete fTypeVec; }
+
+    uint8_t Get()
+    {
+      TTree *t = fTree->GetTree();
+      if (!t) return 0;
+      if (t != fCur || fTree->GetTreeNumber() != fCurNum) Attach(t);
+      Long64_t entry = t->GetReadEntry();
+      if (!fBranch || entry < 0) return 0;
+      fBranch->GetEntry(entry, 1);  // even if the caller switched the branch off
+      if (fLayout == kBits) return fBits;
+      uint8_t bits = 0;
+      for (int i = 0; i < nCoinBits; i++) {
+        int type = (fLayout == kArray) ? fTypeArr[i] : (i < (int)fTypeVec->size() ? (*fTypeVec)[i] : 0);
+        if (type) bits |= (1u << i);
+      }
+      return bits;
+    }
+
+  private:
+    enum Layout { kBits, kVector, kArray };
+    TTree *fTree;
+    TTree *fCur = 0;       // file tree the branch belongs to
+    int fCurNum = -1;
+    TBranch *fBranch = 0;  // 0: neither layout (every entry reads 0)
+    Layout fLayout = kBits;
+    uint8_t fBits = 0;
+    std::vector<int> *fTypeVec = 0;
+    int fTypeArr[32] = {0};
+
+    void Attach(TTree *t)
+    {
+      fCur = t;
+      fCurNum = fTree->GetTreeNumber();
+      fBranch = t->GetBranch("CoinBits");
+      if (fBranch) {
+        fLayout = kBits;
+        fBranch->SetAddress(&fBits);
+        return;
+      }
+      fBranch = t->GetBranch("CoinType");
+      if (!fBranch) fBranch = t->GetBranch("CoinType[32]");
+      if (!fBranch) return;
+      if (std::string(fBranch->GetClassName()).find("vector") == 0) {
+        fLayout = kVector;
+        if (!fTypeVec) fTypeVec = new std::vector<int>;
+        fBranch->SetAddress(&fTypeVec);
+      }
+      else {
+        fLayout = kArray;
+        fBranch->SetAddress(fTypeArr);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,116 @@
+// VetoErrors.hh
+// Event-level veto error checks, packed into a 32-bit mask (bit i = error i).
+// Works on the compact VetoRecord, so checking an entry copies nothing and allocates nothing.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOERRORS_HH_GUARD
+#define VETOERRORS_HH_GUARD
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include "VetoRunCache.hh"
+
+/*
+Recoverable:
+Actionable:
+  LED Off -> Output string Dave can grep for, send veto experts an email
+  No QDC events -> Need to have people check if a panel went down
+  High error rate (desynchs, bad scalers, etc) -> Need to try and restart data taking
+Diagnostic:
+
+// Event-level error checks ('s' denotes setting skip=true)
+// s 1. Missing channels (< 32 veto datas in event)
+// s 2. Extra Channels (> 32 veto datas in event)
+// s 3. Scaler only (no QDC data)
+//   4. Bad Timestamp: FFFF FFFF FFFF FFFF
+// s 5. QDCIndex - ScalerIndex != 1 or 2
+// s 6. Duplicate channels (channel shows up multiple times)
+//   7. HW Count Mismatch (SEC - QEC != 1 or 2)
+//   8. MJTRun run number doesn't match input file
+// s 9. MJTVetoData cast failed (missing QDC data)
+//   10. Scaler EventCount doesn't match ROOT entry
+//   11. Scaler EventCount doesn't match QDC1 EventCount
+//   12. QDC1 EventCount doesn't match QDC2 EventCount
+// s 13. Indexes of QDC1 and Scaler differ by more than 2
+// s 14. Indexes of QDC2 and Scaler differ by more than 2
+//   15. Indexes of either QDC1 or QDC2 PRECEDE the scaler index
+//   16. Indexes of either QDC1 or QDC2 EQUAL the scaler index
+//   17. Unknown Card is present.
+// s 18. Scaler & SBC Timestamp Desynch.
+// s 19. Scaler Event Count reset.
+// s 20. Scaler Event Count increment by > +1.
+// s 21. QDC1 Event Count reset.
+// s 22. QDC1 Event Count increment by > +1.
+// s 23. QDC2 Event Count reset.
+// s 24. QDC2 Event Count increment > +1.
+// s 25. Buffer flush error.
+
+// Run-level error checks (not checked by CheckErrors)
+// 26. LED frequency very low/high, corrupted, or LED's off.
+// 27. QDC threshold not found
+// 28. No events above QDC threshold
+// 29. Avg Panel LEDQDC deviates from expected mean by > 3 sigma.
+// 30. nonLED Panel Hit Rate deviates from expected mean by 3 > sigma.
+*/
+
+const int nErrs = 31;
+
+inline uint32_t ErrorBit(int i) { return (uint32_t)1 << i; }
+
+// Errors 0-17 are checked automatically when we call MJVetoEvent::WriteEvent
+const uint32_t kHardwareErrors = (1u << 18) - 1;
+
+// An entry is skipped (not analyzable) if any of these are set.
+const uint32_t kSkipErrors = (1u<<1)|(1u<<2)|(1u<<3)|(1u<<5)|(1u<<6)|(1u<<9)|(1u<<13)|(1u<<14)
+  |(1u<<18)|(1u<<19)|(1u<<20)|(1u<<21)|(1u<<22)|(1u<<23)|(1u<<24)|(1u<<25);
+
+// Errors printed during the error-check loop, and counted as "serious" in the summary.
+const uint32_t kSeriousErrors = (1u<<1)|(1u<<4)|(1u<<13)|(1u<<14)
+  |(1u<<18)|(1u<<19)|(1u<<20)|(1u<<21)|(1u<<22)|(1u<<23)|(1u<<24)|(1u<<25)|(1u<<26);
+
+// Returns the event-level error mask.  The entry should be skipped if (mask & kSkipErrors).
+inline uint32_t CheckErrors(const VetoRecord &veto, const VetoRecord &prev)
+{
+  uint32_t err = veto.hwErrors & kHardwareErrors;
+
+  bool foundBothQDC = !veto.GetError(1) && !prev.GetError(1);
+  bool later = veto.entry > 1;
+  long dEntry = veto.entry - prev.entry;
+
+  if (foundBothQDC && later && veto.timeSec > 0 && veto.timeSBC > 0
+      && fabs((veto.timeSec - prev.timeSec)-(veto.timeSBC - prev.timeSBC)) > 1
+      && !veto.badScaler && !prev.badScaler)
+    err |= ErrorBit(18);
+
+  if (!veto.GetError(1) && veto.sec == 0 && later)
+    err |= ErrorBit(19);
+
+  if (foundBothQDC && later && abs(veto.sec - prev.sec) > dEntry && veto.sec != 0)
+    err |= ErrorBit(20);
+
+  if (!veto.GetError(1) && veto.qec == 0 && later)
+    err |= ErrorBit(21);
+
+  if (foundBothQDC && later && abs(veto.qec - prev.qec) > dEntry && veto.qec != 0)
+    err |= ErrorBit(22);
+
+  if (!veto.GetError(1) && veto.qec2 == 0 && later)
+    err |= ErrorBit(23);
+
+  if (foundBothQDC && later && abs(veto.qec2 - prev.qec2) > dEntry && veto.qec2 != 0)
+    err |= ErrorBit(24);
+
+  if (labs(veto.scalerIndex - prev.scalerIndex) == 1)
+    err |= ErrorBit(25);
+
+  return err;
+}
+
+// Add one to the count of every error set in the mask.
+inline void CountErrors(uint32_t err, int *ErrorCount)
+{
+  for (; err; err &= err-1) ErrorCount[__builtin_ctz(err)]++;
+}
+
+#endif
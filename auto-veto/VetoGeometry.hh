@@ -0,0 +1,230 @@
+// VetoGeometry.hh
+// Run-indexed veto configuration: panel -> plane, panel -> physical location,
+// QDC card numbers, and the reference panel statistics used by the run-level checks.
+// Each quantity is a table of run intervals.  SetRun() searches the tables only
+// when the run changes, and every per-panel lookup after that is a flat array read.
+// To add a new configuration, add a row to the table -- nothing else changes.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOGEOMETRY_HH_GUARD
+#define VETOGEOMETRY_HH_GUARD
+
+#include <climits>
+#include <cstdint>
+
+namespace VetoGeo {
+
+const int nPanels = 32;
+const int nPlanes = 12;
+
+// Geometric planes (zero-indexed):
+// 0: Lower Bottom   1: Upper Bottom
+// 2: Top Inner      3: Top Outer
+// 4: North Inner    5: North Outer
+// 6: South Inner    7: South Outer
+// 8: West Inner     9: West Outer
+// 10: East Inner    11: East Outer
+// -1: panel not installed
+const int kPlanes32[nPanels] =
+  {0, 0, 0, 0, 0, 0,
+   1, 1, 1, 1, 1, 1,
+   8, 8, 9, 5,
+   5, 3, 3, 4,
+   2, 2, 9, 4,
+   6, 7, 6, 7,
+   10,11,10,11};
+
+const int kPlanesProto1[nPanels] =
+  {0, 0, 0, 0, 0, 0,
+   1, 1, 1, 1, 1, 1,
+   2, 2, 9, 5,
+   5, 3, 3, 4,
+   8, 8, 9, 4,
+   -1,-1,-1,-1,
+   -1,-1,-1,-1};
+
+const int kPlanes24[nPanels] =
+  {0, 0, 0, 0, 0, 0,
+   1, 1, 1, 1, 1, 1,
+   8, 8, 9, 5,
+   5, 3, 3, 4,
+   2, 2, 9, 4,
+   -1,-1,-1,-1,
+   -1,-1,-1,-1};
+
+// Physical panel locations (for Dave and Bradley).
+// Using the 32-panel configuration as "standard", map the QDC index to a physical panel location.
+// The figure "Veto Panels, View From The Top" in Veto System Change Log is the map used for ALL configurations.
+const int kLocation32[nPanels] =
+  {1, 2, 3, 4, 5, 6,
+   7, 8, 9, 10,11,12,
+   13,14,15,16,
+   17,18,19,20,
+   21,22,23,24,
+   25,26,27,28,
+   29,30,31,32};
+
+const int kLocationProto1[nPanels] =
+  {1, 2, 3, 4, 5, 6,
+   7, 8, 9, 10,11,12,
+   21,22,15,16,
+   17,18,19,20,
+   13,14,23,24,
+   -1,-1,-1,-1,
+   -1,-1,-1,-1};
+
+const int kLocation24[nPanels] =
+  {1, 2, 3, 4, 5, 6,
+   7, 8, 9, 10,11,12,
+   13,14,15,16,
+   17,18,19,20,
+   21,22,23,24,
+   -1,-1,-1,-1,
+   -1,-1,-1,-1};
+
+// Reference panel statistics, implemented for DS3 and onward.
+// Each panel's mean (non-LED) hit rate:
+const double kHitRateMean[nPanels] = {0.007338, 0.007482, 0.007730, 0.009183, 0.005995, 0.005272, 0.005786, 0.013200, 0.007360, 0.008041, 0.006708, 0.004830, 0.006750, 0.010310, 0.011600, 0.020450, 0.006718, 0.028900, 0.008145, 0.025110, 0.002854, 0.003381, 0.006357, 0.002808, 0.0006327, 0.0010950, 0.0003902, 0.003375, 0.0022120, 0.005735, 0.0007639, 0.005983};
+
+const double kHitRateSigma[nPanels] = {0.001709, 0.001793, 0.001888, 0.002020, 0.001848, 0.00145 , 0.001414, 0.002276, 0.001566, 0.001775, 0.001587, 0.001344, 0.001948, 0.001995, 0.002273, 0.002962, 0.001635, 0.003787, 0.002711, 0.003167, 0.001129, 0.001145, 0.001727, 0.001200, 0.0004681, 0.0006459, 0.0003892, 0.001133, 0.0009158, 0.001850, 0.0005355, 0.001726};
+
+// Each panel's mean LED qdc value, before run 19091:
+const double kQDCMean1[nPanels] = {925, 629.8, 1268, 993.4, 2151, 849.8, 720.2, 2997, 1585, 1185, 1495, 1207, 709.9, 1007, 1702, 2592, 643.2, 1040, 1115, 1307, 1917, 2027, 1214, 1069, 3783, 638.7, 1595, 1138, 1079, 1699, 2476, 3843};
+
+const double kQDCSigma1[nPanels] = {220, 108.9, 175.6, 136.8, 309.9, 131.9, 115.1, 396.4, 228.5, 182.1, 230.5, 170.5, 93.33, 119.2, 207.9, 319.6, 155.6, 142,  217.2, 173.4, 272.5, 264.5, 145,  215.5, 269.2, 164.6, 263.8, 186.3, 204.9, 253.8, 282.3, 209.7};
+
+// From run 19091 on:
+const double kQDCMean2[nPanels] = {3772, 520.1, 1491, 1110, 2306, 970.3, 2380, 3445, 1676, 1433, 1617, 1292, 857.2, 1124, 2104, 2576, 701.3, 1160, 1312, 1409, 2131, 2279, 1383, 1199, 1048, 743.7, 1688, 1220, 1343, 1760, 2212, 1828};
+
+const double kQDCSigma2[nPanels] = {297, 92.38, 199.9, 150.1, 321.5, 149.5, 299.3, 387.1, 239.2, 212.6, 244.3, 178.9, 113,  129.6, 245.3, 312.3, 162.3, 154.5, 255.4, 184.5, 292.5, 288.8, 161, 228.7, 210, 176,  270.8, 194.4, 230.4, 261.8, 316, 230.8};
+
+// Run intervals are inclusive: lo <= run <= hi.
+struct PanelConfig {
+  int lo, hi;
+  const char *name;
+  const int *plane;
+  const int *location;
+};
+const PanelConfig kPanelConfigs[] = {
+  {1,        3056,     "P3JDY (6/24/15 - 7/7/15)", kPlanes24,     kLocation24},
+  {3057,     44999999, "32-panel (began 7/10/15)", kPlanes32,     kLocation32},
+  {45000509, 45004116, "1st prototype (24 panels)", kPlanesProto1, kLocationProto1},
+  {45004117, 45008659, "2nd prototype (24 panels)", kPlanes24,     kLocation24}
+};
+
+struct CardConfig {
+  int lo, hi;
+  int card1, card2;
+};
+const CardConfig kCardConfigs[] = {
+  {INT_MIN,  45000000, 13, 18},
+  {45000001, INT_MAX,  11, 18}
+};
+
+struct ReferenceConfig {
+  int lo, hi;
+  const double *hitRateMean, *hitRateSigma, *qdcMean, *qdcSigma;
+};
+const ReferenceConfig kReferenceConfigs[] = {
+  {INT_MIN, 19090,   kHitRateMean, kHitRateSigma, kQDCMean1, kQDCSigma1},
+  {19091,   4499999, kHitRateMean, kHitRateSigma, kQDCMean2, kQDCSigma2}
+};
+
+// The LED QDC reference that error 29 checks against, with the run ranges auto-veto
+// has always used: the sigma from before run 19091 was never reached (so it's 0,
+// and any deviation is an error), and run 19091 fits neither period (mean and sigma 0).
+// A missing column (0) reads as 0.
+struct QDCCheckConfig {
+  int lo, hi;
+  const double *qdcMean, *qdcSigma;
+};
+const QDCCheckConfig kQDCCheckConfigs[] = {
+  {INT_MIN, 19090,   kQDCMean1, 0},
+  {19092,   4499999, kQDCMean2, kQDCSigma2}
+};
+
+template <class T, int N>
+inline const T *FindRun(const T (&table)[N], int run) {
+  for (int i = 0; i < N; i++)
+    if (run >= table[i].lo && run <= table[i].hi) return &table[i];
+  return 0;
+}
+
+} // namespace VetoGeo
+
+class VetoGeometry
+{
+  public:
+
+    VetoGeometry(int run=0) : fRun(0), fPanels(0), fCards(0), fRef(0), fCheck(0) { SetRun(run); }
+
+    // Resolve the tables for this run.  Returns false if no panel map covers it,
+    // in which case every panel reads as not installed (plane and location -1).
+    bool SetRun(int run)
+    {
+      if (run == fRun && fCards) return fPanels != 0;
+      fRun = run;
+      fPanels = VetoGeo::FindRun(VetoGeo::kPanelConfigs, run);
+      fCards = VetoGeo::FindRun(VetoGeo::kCardConfigs, run);
+      fRef = VetoGeo::FindRun(VetoGeo::kReferenceConfigs, run);
+      fCheck = VetoGeo::FindRun(VetoGeo::kQDCCheckConfigs, run);
+      fInstalled = 0;
+      for (int i = 0; i < VetoGeo::nPanels; i++) {
+        fPlane[i] = fPanels ? fPanels->plane[i] : -1;
+        fLocation[i] = fPanels ? fPanels->location[i] : -1;
+        fPlaneBit[i] = fPlane[i] >= 0 ? (uint16_t)(1 << fPlane[i]) : 0;
+        if (fPlane[i] >= 0) fInstalled |= (1u << i);
+      }
+      return fPanels != 0;
+    }
+
+    int GetRun() const { return fRun; }
+    bool IsKnown() const { return fPanels != 0; }
+    const char *GetConfigName() const { return fPanels ? fPanels->name : "unknown"; }
+
+    // zero-indexed plane, or -1 if the panel is not installed
+    int GetPlane(int panel) const { return fPlane[panel]; }
+
+    // physical panel location (one-indexed), or -1 if the panel is not installed
+    int GetLocation(int panel) const { return fLocation[panel]; }
+
+    bool IsInstalled(int panel) const { return fPlane[panel] >= 0; }
+
+    // bit i set if panel i is installed
+    uint32_t GetInstalledMask() const { return fInstalled; }
+
+    // 12-bit mask of the planes hit, from a mask of the panels hit (bit i = panel i).
+    // Panels that aren't installed don't contribute.
+    uint16_t GetPlaneMask(uint32_t panelMask) const {
+      uint16_t planes = 0;
+      for (uint32_t m = panelMask & fInstalled; m; m &= m-1) planes |= fPlaneBit[__builtin_ctz(m)];
+      return planes;
+    }
+
+    int GetCard1() const { return fCards->card1; }
+    int GetCard2() const { return fCards->card2; }
+
+    // Reference statistics return 0 outside the reference range.
+    bool HasReference() const { return fRef != 0; }
+    double GetHitRateMean(int panel) const { return fRef ? fRef->hitRateMean[panel] : 0; }
+    double GetHitRateSigma(int panel) const { return fRef ? fRef->hitRateSigma[panel] : 0; }
+    double GetQDCMean(int panel) const { return fRef ? fRef->qdcMean[panel] : 0; }
+    double GetQDCSigma(int panel) const { return fRef ? fRef->qdcSigma[panel] : 0; }
+
+    // The error 29 reference (kQDCCheckConfigs).
+    double GetCheckQDCMean(int panel) const { return fCheck && fCheck->qdcMean ? fCheck->qdcMean[panel] : 0; }
+    double GetCheckQDCSigma(int panel) const { return fCheck && fCheck->qdcSigma ? fCheck->qdcSigma[panel] : 0; }
+
+  private:
+    int fRun;
+    const VetoGeo::PanelConfig *fPanels;
+    const VetoGeo::CardConfig *fCards;
+    const VetoGeo::ReferenceConfig *fRef;
+    const VetoGeo::QDCCheckConfig *fCheck;
+    int fPlane[VetoGeo::nPanels];
+    int fLocation[VetoGeo::nPanels];
+    uint16_t fPlaneBit[VetoGeo::nPanels];
+    uint32_t fInstalled;
+};
+
+#endif
@@ -0,0 +1,167 @@
+// VetoLEDTimer.hh
+// LED period, RMS and jitter, estimated while the entries stream by.
+//
+// Replaces the 100,000-bin (1 ms) LEDDeltaT histograms, with the same numbers:
+// the period is the mean delta-t of the bins within +/- 0.1 s (100 bins) of the
+// max bin, from bin centers, like TH1::GetMean after SetRange(max-100,max+100).
+// Only the bins that were filled are stored (a few hundred for a run, instead of
+// 800 kB), and the max bin is kept up to date on every Fill, so the period can be
+// read at any time.
+//
+// Track() runs a simple phase-locked loop on the LED times: it predicts the next
+// pulse, and pulses that land within the window nudge the period and add to the
+// jitter.  ExpectedNext() gives the time cut a prediction for the current entry
+// without waiting for a finished first pass.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOLEDTIMER_HH_GUARD
+#define VETOLEDTIMER_HH_GUARD
+
+#include <map>
+#include <cmath>
+
+class LEDTimer
+{
+  public:
+
+    // window: half-width of the range averaged around the peak, and the PLL lock window (sec).
+    // binWidth, maxDT: bins of the old histogram.
+    LEDTimer(double window=0.1, double binWidth=0.001, double maxDT=100, double gain=0.1) :
+      fWindow(window), fGain(gain)
+    {
+      fNBins = (long)(maxDT/binWidth + 0.5);
+      if (fNBins < 1) fNBins = 1;
+      fMaxDT = maxDT;
+      fBinWidth = maxDT/fNBins;
+      fHalfRange = (long)(window/fBinWidth + 0.5);
+      Clear();
+    }
+
+    void Clear()
+    {
+      fN.clear();
+      fEntries = 0;
+      fMaxBin = -1;
+      fMaxN = 0;
+      ResetTracker();
+    }
+
+    // ======== Delta-t histogram ========
+
+    // Time since the previous entry, for an LED-like entry.
+    // Like TH1::Fill, values outside [0,maxDT) count as entries but aren't binned.
+    void Fill(double dt)
+    {
+      fEntries++;
+      if (dt < 0) return;
+      long b = (long)(fNBins*dt/fMaxDT);
+      if (b >= fNBins) return;
+      long n = ++fN[b];
+      // the first max bin on a tie, like TH1::GetMaximumBin
+      if (n > fMaxN || (n == fMaxN && b < fMaxBin)) { fMaxBin = b; fMaxN = n; }
+    }
+
+    long GetEntries() const { return fEntries; }
+
+    // Mean and RMS of delta-t (bin centers) within +/- window of the max bin.  0 if nothing was binned.
+    double GetPeriod() const
+    {
+      double n=0, s=0, s2=0;
+      PeakSums(n,s,s2);
+      return n > 0 ? s/n : 0;
+    }
+
+    double GetRMS() const
+    {
+      double n=0, s=0, s2=0;
+      PeakSums(n,s,s2);
+      if (n <= 0) return 0;
+      double var = s2/n - (s/n)*(s/n);
+      return var > 0 ? sqrt(var) : 0;
+    }
+
+    // ======== Phase-locked LED tracker ========
+
+    // Start tracking over, e.g. before a second pass: forget the last pulse and
+    // the locks, so the prediction starts again from the histogram period.
+    void ResetTracker()
+    {
+      fHaveLast = false;
+      fLast = 0;
+      fTrackPeriod = 0;
+      fLocks = 0;
+      fResSum = 0;
+      fResSum2 = 0;
+    }
+
+    // Time of an entry tagged as an LED.  If it lands within the window of a
+    // predicted pulse (possibly a few periods on, for missed pulses), the
+    // residual adjusts the tracked period and is added to the jitter.
+    // Either way it becomes the phase reference for the next prediction.
+    void Track(double t)
+    {
+      double p = GetTrackedPeriod();
+      if (fHaveLast && p > 0) {
+        long k = lround((t - fLast)/p);
+        if (k >= 1) {
+          double res = (t - fLast) - k*p;
+          if (fabs(res) < fWindow) {
+            fTrackPeriod = p + fGain*res/k;
+            fLocks++;
+            fResSum += res;
+            fResSum2 += res*res;
+          }
+        }
+      }
+      fLast = t;
+      fHaveLast = true;
+    }
+
+    // Locked once a few pulses have landed where they were predicted.
+    bool IsLocked() const { return fLocks >= 3; }
+    long GetLocks() const { return fLocks; }
+
+    // Tracked period once locked, otherwise the histogram period so far.
+    double GetTrackedPeriod() const { return fLocks > 0 ? fTrackPeriod : GetPeriod(); }
+
+    // RMS of the tracked pulses' residuals (sec).
+    double GetJitter() const
+    {
+      if (fLocks == 0) return 0;
+      double m = fResSum/fLocks;
+      double var = fResSum2/fLocks - m*m;
+      return var > 0 ? sqrt(var) : 0;
+    }
+
+    // Expected time of the next LED pulse.  Before any Track(), the reference is t=0.
+    double GetLastLED() const { return fLast; }
+    double ExpectedNext() const { return fLast + GetTrackedPeriod(); }
+
+  private:
+
+    void PeakSums(double &n, double &s, double &s2) const
+    {
+      if (fMaxBin < 0) return;
+      std::map<long,long>::const_iterator it = fN.lower_bound(fMaxBin - fHalfRange);
+      std::map<long,long>::const_iterator end = fN.upper_bound(fMaxBin + fHalfRange);
+      for (; it != end; ++it) {
+        double x = (it->first + 0.5)*fBinWidth;
+        n += it->second;
+        s += it->second*x;
+        s2 += it->second*x*x;
+      }
+    }
+
+    double fWindow, fGain, fBinWidth, fMaxDT;
+    long fNBins, fHalfRange;
+    std::map<long,long> fN;   // bin -> count, filled bins only
+    long fEntries;
+    long fMaxBin, fMaxN;
+
+    bool fHaveLast;
+    double fLast, fTrackPeriod;
+    long fLocks;
+    double fResSum, fResSum2;
+};
+
+#endif
@@ -0,0 +1,242 @@
+// VetoLive.hh
+// Veto data quality monitor for auto-veto's follow mode (-t), fed with the new
+// entries of a run that is still being written.  All of the scan state is kept
+// between polls, so each entry is only looked at once:
+//   - Error checks run on every new entry right away (they don't need thresholds).
+//   - Good entries fill the low-QDC histograms until kThreshEntries are in.  Then
+//     the thresholds are found (FindThreshold), and the LED timing and muon tagging
+//     catch up on the entries so far, and keep up from there.
+// After each poll, Flags() compares the last fWindow seconds (veto clock) with
+// the alarm levels below, and WriteStatus() replaces a small JSON status file.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOLIVE_HH_GUARD
+#define VETOLIVE_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include "TH1.h"
+#include "VetoRunCache.hh"
+#include "VetoErrors.hh"
+#include "VetoLEDTimer.hh"
+#include "VetoThreshold.hh"
+
+// Flags (bit i: flag i), in the order of kLiveFlagNames
+enum VetoLiveFlag { kLEDOff, kQDCMissing, kFlushStorm, kHighErrorRate, kNLiveFlags };
+static const char *const kLiveFlagNames[kNLiveFlags] = {"LEDOff", "QDCCardMissing", "BufferFlushStorm", "HighErrorRate"};
+
+class VetoLiveMonitor
+{
+  public:
+
+    static const long kThreshEntries = 2000;  // good entries before the thresholds are found
+    static const int kThreshVal = 35;          // same as MeasurePanelThresholds
+    static const int kLEDSimpleThreshold = 10;
+
+    // Alarm levels, over the last fWindow seconds
+    double fLEDTimeout = 20;       // no LED for max(this, 3 LED periods)
+    double fMissingQDCFrac = 0.5;  // fraction of entries with errors 1, 3 or 9
+    int fFlushBursts = 3;          // separate buffer flushes (runs of error 25)
+    double fSeriousFrac = 0.1;     // fraction of entries with serious errors
+
+    VetoLiveMonitor(VetoRunCache &cache, int overQDC=500, int minPanels=2, int LEDMultipThreshold=5, double window=60) :
+      fCache(cache), fOverQDC(overQDC), fMinPanels(minPanels),
+      fLEDMultipThreshold(LEDMultipThreshold), fWindow(window)
+    {
+      for (int q = 0; q < 32; q++) {
+        fHist[q] = new TH1D(TString::Format("hLiveQDC%d",q),"",500,0,500);
+        fHist[q]->SetDirectory(0);
+        fThresh[q] = 1;
+      }
+      for (int e = 0; e < 32; e++) fErrorCount[e] = 0;
+    }
+
+    ~VetoLiveMonitor() { for (int q = 0; q < 32; q++) delete fHist[q]; }
+
+    // Look at the entries the cache got since the last call.
+    void Update()
+    {
+      long n = fCache.GetEntries();
+      VetoRecord veto;
+      for (; fChecked < n; fChecked++) {
+        fCache.Read(fChecked, veto);
+        Check(veto);
+      }
+      if (!fHaveThresh && fGood >= kThreshEntries) FindThresholds();
+      if (!fHaveThresh) return;
+      for (; fTagged < n; fTagged++) {
+        fCache.Read(fTagged, veto);
+        Tag(veto);
+      }
+    }
+
+    // Bit i set: flag i (VetoLiveFlag) is raised as of the latest entry.
+    uint32_t Flags() const
+    {
+      uint32_t flags = 0;
+      double span = fNow - fFirstTime;
+      double LEDTimeout = fLEDTimeout;
+      if (fLED.GetEntries() > 0 && 3*fLED.GetPeriod() > LEDTimeout) LEDTimeout = 3*fLED.GetPeriod();
+      if (fHaveThresh && span > LEDTimeout && fNow - (fLastLED > 0 ? fLastLED : fFirstTime) > LEDTimeout)
+        flags |= 1u << kLEDOff;
+      long nWin = fWinAll.size();
+      if (nWin >= 10 && fWinMissingQDC.size() > fMissingQDCFrac*nWin) flags |= 1u << kQDCMissing;
+      if ((int)fWinFlush.size() >= fFlushBursts) flags |= 1u << kFlushStorm;
+      if (nWin >= 10 && fWinSerious.size() > fSeriousFrac*nWin) flags |= 1u << kHighErrorRate;
+      return flags;
+    }
+
+    long GetChecked() const { return fChecked; }
+    long GetTagged() const { return fTagged; }
+    long GetMuons() const { return fMuons; }
+    bool HaveThresholds() const { return fHaveThresh; }
+    double GetLatestTime() const { return fNow; }
+    double GetLEDFreq() const { return fLED.GetPeriod() > 0 ? 1/fLED.GetPeriod() : 0; }
+
+    // Replace the status file (written to a temporary file, then renamed).
+    // pollSec: time of the last poll, from seeing the new entries to this call.
+    bool WriteStatus(const std::string &fileName, double pollSec, bool finished=false) const
+    {
+      std::string tmp = fileName + ".tmp";
+      FILE *f = fopen(tmp.c_str(), "w");
+      if (!f) return false;
+      long nWin = fWinAll.size();
+      fprintf(f, "{\"run\": %i, \"updated\": %li, \"finished\": %s, \"entries\": %li, \"checked\": %li, \"tagged\": %li,\n",
+        fCache.GetRunNumber(), (long)time(0), finished ? "true" : "false", fCache.GetEntries(), fChecked, fTagged);
+      fprintf(f, " \"pollSec\": %.3f, \"vetoTime\": %.3f, \"skipped\": %li, \"thresholds\": %s, \"highestMultip\": %i,\n",
+        pollSec, fNow, fSkipped, fHaveThresh ? "true" : "false", fHighestMultip);
+      fprintf(f, " \"LEDfreq\": %.4f, \"LEDjitter\": %.4f, \"lastLED\": %.3f, \"muons\": %li, \"lastMuon\": %.3f,\n",
+        GetLEDFreq(), fLED.GetJitter(), fLastLED, fMuons, fLastMuon);
+      fprintf(f, " \"window\": {\"sec\": %.0f, \"entries\": %li, \"LED\": %lu, \"muons\": %lu, \"serious\": %lu, \"missingQDC\": %lu, \"flushBursts\": %lu},\n",
+        fWindow, nWin, fWinLED.size(), fWinMuon.size(), fWinSerious.size(), fWinMissingQDC.size(), fWinFlush.size());
+      fprintf(f, " \"errors\": {");
+      bool first = true;
+      for (int e = 1; e < nErrs; e++) {
+        if (fErrorCount[e] == 0) continue;
+        fprintf(f, "%s\"%i\": %li", first ? "" : ", ", e, fErrorCount[e]);
+        first = false;
+      }
+      fprintf(f, "},\n \"flags\": [");
+      uint32_t flags = Flags();
+      first = true;
+      for (int i = 0; i < kNLiveFlags; i++) {
+        if (!((flags >> i) & 1)) continue;
+        fprintf(f, "%s\"%s\"", first ? "" : ", ", kLiveFlagNames[i]);
+        first = false;
+      }
+      fprintf(f, "]}\n");
+      bool ok = (fclose(f) == 0);
+      return ok && rename(tmp.c_str(), fileName.c_str()) == 0;
+    }
+
+  private:
+
+    VetoRunCache &fCache;
+    int fOverQDC, fMinPanels, fLEDMultipThreshold;
+    double fWindow;
+
+    long fChecked = 0, fTagged = 0, fGood = 0, fSkipped = 0, fMuons = 0;
+    long fErrorCount[32];
+    VetoRecord fPrevCheck, fPrevTag;
+    bool fInFlush = false;
+
+    TH1D *fHist[32];
+    int fThresh[32];
+    bool fHaveThresh = false;
+
+    LEDTimer fLED;
+    int fHighestMultip = 0;
+    double fFirstTime = 0, fNow = 0, fLastLED = 0, fLastMuon = 0;
+
+    // times of the entries in the window (veto clock)
+    std::deque<double> fWinAll, fWinSerious, fWinMissingQDC, fWinFlush, fWinLED, fWinMuon;
+
+    // Scaler time, or the last good one for a bad scaler.
+    double EntryTime(const VetoRecord &veto)
+    {
+      if (!veto.GetBadScaler() && veto.GetTimeSec() > 0) fNow = veto.GetTimeSec();
+      if (fFirstTime == 0) fFirstTime = fNow;
+      return fNow;
+    }
+
+    void Push(std::deque<double> &win, double t)
+    {
+      win.push_back(t);
+      Trim(win);
+    }
+
+    void Trim(std::deque<double> &win)
+    {
+      while (!win.empty() && win.front() < fNow - fWindow) win.pop_front();
+    }
+
+    // Error checks and threshold histograms
+    void Check(const VetoRecord &veto)
+    {
+      double t = EntryTime(veto);
+      uint32_t err = CheckErrors(veto,fPrevCheck);
+      for (uint32_t m = err; m; m &= m-1) fErrorCount[__builtin_ctz(m)]++;
+      Push(fWinAll, t);
+      if (err & kSeriousErrors) Push(fWinSerious, t);
+      if (err & (ErrorBit(1)|ErrorBit(3)|ErrorBit(9))) Push(fWinMissingQDC, t);
+      bool flush = err & ErrorBit(25);
+      if (flush && !fInFlush) Push(fWinFlush, t);
+      fInFlush = flush;
+      std::deque<double> *wins[] = {&fWinSerious, &fWinMissingQDC, &fWinFlush, &fWinLED, &fWinMuon};
+      for (auto w : wins) Trim(*w);
+
+      if (err & kSkipErrors) fSkipped++;
+      else if (!fHaveThresh) {
+        for (int q = 0; q < 32; q++) fHist[q]->Fill(veto.GetQDC(q));
+        fGood++;
+      }
+      fPrevCheck = veto;
+    }
+
+    void FindThresholds()
+    {
+      for (int q = 0; q < 32; q++) fThresh[q] = FindThreshold(fHist[q],kThreshVal,q,fCache.GetRunNumber());
+      fCache.SetSWThresh(fThresh);
+      fCache.SetOverQDC(fOverQDC);
+      // The highest multiplicity so far, so the LED cut is set before tagging starts.
+      VetoRecord veto;
+      for (long i = 0; i < fChecked; i++) {
+        fCache.Read(i, veto);
+        if (veto.GetMultip() > fHighestMultip) fHighestMultip = veto.GetMultip();
+      }
+      fHaveThresh = true;
+    }
+
+    // LED timing and muon tagging (the cuts of ProcessVetoData's muon loop, without the LED-off exception)
+    void Tag(const VetoRecord &veto)
+    {
+      if (CheckErrors(veto,fPrevTag) & kSkipErrors) { fPrevTag = veto; return; }
+      double t = veto.GetBadScaler() ? 0 : veto.GetTimeSec();
+      int multip = veto.GetMultip();
+      if (multip > fHighestMultip) fHighestMultip = multip;
+      if (multip > kLEDSimpleThreshold) {
+        fLED.Fill(veto.GetTimeSec()-fPrevTag.GetTimeSec());
+        if (t > 0) {
+          fLED.Track(t);
+          fLastLED = t;
+          Push(fWinLED, t);
+        }
+      }
+      bool LEDCut = multip < fHighestMultip - fLEDMultipThreshold;
+      bool EnergyCut = veto.GetOverQDCCount() >= fMinPanels;
+      if (LEDCut && EnergyCut) {
+        fMuons++;
+        if (t > 0) {
+          fLastMuon = t;
+          Push(fWinMuon, t);
+        }
+      }
+      fPrevTag = veto;
+    }
+};
+
+#endif
@@ -0,0 +1,43 @@
+// VetoLog.hh
+// Console output for run processing.  Normally this is just stdout.
+// In batch mode each worker thread sets a per-run buffer, so the logs of
+// runs processed at the same time don't interleave.  The buffer is
+// printed in one piece when its run is finished.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOLOG_HH_GUARD
+#define VETOLOG_HH_GUARD
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+
+// This thread's log buffer, or 0 to write straight to stdout.
+inline std::ostringstream *&VetoLogBuffer()
+{
+  static thread_local std::ostringstream *buf = 0;
+  return buf;
+}
+
+// Use like cout:  vlog() << "text" << endl;
+inline std::ostream &vlog()
+{
+  std::ostringstream *buf = VetoLogBuffer();
+  if (buf) return *buf;
+  return std::cout;
+}
+
+// Use like printf.
+inline void vlogf(const char *fmt, ...)
+{
+  char line[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  vlog() << line;
+}
+
+#endif
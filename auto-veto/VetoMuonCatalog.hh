@@ -0,0 +1,173 @@
+// VetoMuonCatalog.hh
+// A muon list saved as a flat binary file, so skim jobs don't rebuild it from
+// the veto_run*.root files (or a compiled-in list, for DS4) every time.
+//   VetoMuonCatHeader
+//   VetoMuonCatRun[nRuns]       sorted by run: where each run's muons start
+//   VetoMuonCatRecord[nMuons]   sorted by run, then time
+// skim-veto -cat writes one (with a temporary file and a rename, so a reader
+// never sees half a file).  Readers map it read-only, so any number of skim
+// jobs on a node share the same pages, and opening one costs next to nothing.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOMUONCATALOG_HH_GUARD
+#define VETOMUONCATALOG_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "VetoMuonList.hh"
+
+struct VetoMuonCatHeader {
+  char magic[8];              // "VMUCAT01", file format version
+  uint64_t nRuns, nMuons;
+};
+
+struct VetoMuonCatRun {
+  int32_t run;
+  uint32_t nMuons;
+  uint64_t first;             // index of the run's first record
+};
+
+// One VetoMuonList entry.
+struct VetoMuonCatRecord {
+  int32_t run, type;
+  double runTStart, xTime, uncert;
+  uint8_t badScaler, pad[7];
+};
+static_assert(sizeof(VetoMuonCatHeader) == 24 && sizeof(VetoMuonCatRun) == 16 && sizeof(VetoMuonCatRecord) == 40,
+  "muon catalog structs must have no hidden padding");
+
+inline const char *VetoMuonCatMagic() { return "VMUCAT01"; }
+
+inline bool WriteMuonCatalog(std::string fileName, const VetoMuonList &mu)
+{
+  std::vector<VetoMuonCatRecord> recs(mu.Size());
+  for (size_t i = 0; i < mu.Size(); i++) {
+    VetoMuonCatRecord &r = recs[i];
+    memset(&r, 0, sizeof(r));
+    r.run = mu.runs[i];
+    r.type = mu.types[i];
+    r.runTStart = mu.runTStarts[i];
+    r.xTime = mu.times[i];
+    r.uncert = mu.uncert[i];
+    r.badScaler = i < mu.badScalers.size() && mu.badScalers[i];
+  }
+  std::stable_sort(recs.begin(), recs.end(), [](const VetoMuonCatRecord &a, const VetoMuonCatRecord &b) {
+    return a.run != b.run ? a.run < b.run : a.xTime < b.xTime;
+  });
+  std::vector<VetoMuonCatRun> runs;
+  for (size_t i = 0; i < recs.size(); i++) {
+    if (runs.empty() || runs.back().run != recs[i].run) runs.push_back(VetoMuonCatRun{recs[i].run, 0, i});
+    runs.back().nMuons++;
+  }
+  VetoMuonCatHeader hdr;
+  memcpy(hdr.magic, VetoMuonCatMagic(), 8);
+  hdr.nRuns = runs.size();
+  hdr.nMuons = recs.size();
+
+  std::string tmp = fileName + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  if (ok && !runs.empty()) ok = fwrite(runs.data(), sizeof(VetoMuonCatRun), runs.size(), f) == runs.size();
+  if (ok && !recs.empty()) ok = fwrite(recs.data(), sizeof(VetoMuonCatRecord), recs.size(), f) == recs.size();
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp.c_str(), fileName.c_str()) == 0;
+  if (!ok) remove(tmp.c_str());
+  return ok;
+}
+
+// Read-only view of a catalog file.
+class VetoMuonCatalog
+{
+  public:
+    VetoMuonCatalog() {}
+    ~VetoMuonCatalog() { Close(); }
+    VetoMuonCatalog(const VetoMuonCatalog&) = delete;
+    VetoMuonCatalog &operator=(const VetoMuonCatalog&) = delete;
+
+    bool Open(std::string fileName)
+    {
+      Close();
+      int fd = open(fileName.c_str(), O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(VetoMuonCatHeader)) { close(fd); return false; }
+      void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);  // the mapping keeps the file
+      if (map == MAP_FAILED) return false;
+      fMap = map;
+      fMapSize = st.st_size;
+      const VetoMuonCatHeader *hdr = (const VetoMuonCatHeader*)fMap;
+      size_t expect = sizeof(VetoMuonCatHeader) + hdr->nRuns*sizeof(VetoMuonCatRun) + hdr->nMuons*sizeof(VetoMuonCatRecord);
+      if (memcmp(hdr->magic, VetoMuonCatMagic(), 8) != 0 || expect != fMapSize) { Close(); return false; }
+      fRuns = (const VetoMuonCatRun*)(hdr+1);
+      fRecs = (const VetoMuonCatRecord*)(fRuns + hdr->nRuns);
+      fNRuns = hdr->nRuns;
+      fNMuons = hdr->nMuons;
+      return true;
+    }
+
+    void Close()
+    {
+      if (fMap) munmap(fMap, fMapSize);
+      fMap = 0;
+      fMapSize = fNRuns = fNMuons = 0;
+      fRuns = 0;
+      fRecs = 0;
+    }
+
+    bool IsOpen() const { return fMap != 0; }
+    size_t GetNRuns() const { return fNRuns; }
+    size_t GetNMuons() const { return fNMuons; }
+    const VetoMuonCatRun &GetRun(size_t i) const { return fRuns[i]; }
+    const VetoMuonCatRecord &GetRecord(size_t i) const { return fRecs[i]; }
+
+    // The records of one run: [first, first+n).  False if the run has no muons.
+    bool FindRun(int run, size_t &first, size_t &n) const
+    {
+      const VetoMuonCatRun *it = std::lower_bound(fRuns, fRuns + fNRuns, run,
+        [](const VetoMuonCatRun &r, int val) { return r.run < val; });
+      if (it == fRuns + fNRuns || it->run != run) return false;
+      first = it->first;
+      n = it->nMuons;
+      return true;
+    }
+
+    // Copy the muons of these runs (all of them if runs is empty) into a muon list.
+    void Load(VetoMuonList &mu, const std::vector<int> &runs = std::vector<int>()) const
+    {
+      if (runs.empty()) {
+        for (size_t i = 0; i < fNMuons; i++) Add(mu, fRecs[i]);
+        return;
+      }
+      std::vector<int> sorted(runs);
+      std::sort(sorted.begin(), sorted.end());
+      sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+      for (auto run : sorted) {
+        size_t first = 0, n = 0;
+        if (!FindRun(run, first, n)) continue;
+        for (size_t i = first; i < first + n; i++) Add(mu, fRecs[i]);
+      }
+    }
+
+  private:
+    void *fMap = 0;
+    size_t fMapSize = 0, fNRuns = 0, fNMuons = 0;
+    const VetoMuonCatRun *fRuns = 0;
+    const VetoMuonCatRecord *fRecs = 0;
+
+    static void Add(VetoMuonList &mu, const VetoMuonCatRecord &r)
+    {
+      mu.Add(r.run, r.type, r.runTStart, r.xTime, r.uncert, r.badScaler);
+    }
+};
+
+#endif
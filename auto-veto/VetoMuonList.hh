@@ -0,0 +1,103 @@
+// VetoMuonList.hh
+// The muon list skim-coins builds from auto-veto output, and the search for
+// the most recent muon before each Ge hit.  Shared by skim-coins, skim-veto and veto-bench.
+// Saved lists: VetoMuonCatalog.hh.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOMUONLIST_HH_GUARD
+#define VETOMUONLIST_HH_GUARD
+
+#include <vector>
+#include "TChain.h"
+#include "TTreeReader.h"
+#include "VetoCoincidence.hh"
+#include "VetoOutput.hh"
+
+// One entry per muon candidate, in run and time order.
+// Type 1: muon, 2: vertical muon, 3: start of a run after a gap (> 10 sec) in veto data.
+struct VetoMuonList {
+  std::vector<int> runs, types;
+  std::vector<double> runTStarts, times, uncert;
+  std::vector<bool> badScalers;  // can be empty (a list from vectors filled directly)
+
+  size_t Size() const { return times.size(); }
+
+  void Add(int run, int type, double runTStart, double time, double unc, bool badScaler=false)
+  {
+    runs.push_back(run);
+    types.push_back(type);
+    runTStarts.push_back(runTStart);
+    times.push_back(time);
+    uncert.push_back(unc);
+    badScalers.push_back(badScaler);
+  }
+};
+
+// Muons from auto-veto output (either layout).
+inline void LoadMuonList(TChain *vetoChain, VetoMuonList &mu)
+{
+  TTreeReader vetoReader(vetoChain);
+  VetoOutReader vetoIn(vetoReader,vetoChain);  // either output layout
+  CoinBitsReader coinBits(vetoReader,vetoChain);
+  bool newRun=false;
+  int prevRun=0;
+  Long64_t prevStop=0;
+  while(vetoReader.Next())
+  {
+    int run = vetoIn.GetRun();
+    Long64_t vetoStart = vetoIn.GetStart();
+    if (run != prevRun) newRun=true;
+    else newRun = false;
+    int type = 0;
+    uint8_t coin = coinBits.Get();
+    if (coin & kCoinMuon) type=1;
+    if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
+    if ((vetoStart-prevStop) > 10 && newRun) type = 3;
+    if (type > 0) {
+      // type 3 uses the time of the first veto entry in the run
+      bool badScaler = vetoIn.GetBadScaler();
+      double unc = badScaler ? 8.0 : vetoIn.GetTimeUncert();  // uncertainty for corrupted scalers
+      mu.Add(run, type, vetoStart, vetoIn.GetXTime(), unc, badScaler);
+    }
+    prevStop = vetoIn.GetStop();  // end of entry, save the run and stop time
+    prevRun = run;
+  }
+}
+
+// Move iMu forward to the most recent muon before a Ge hit at hitT_s (seconds) in run.
+// Hits must be searched in time order, so each call only steps past the muons since the last hit.
+inline size_t FindRecentMuon(const VetoMuonList &mu, size_t iMu, int run, double hitT_s)
+{
+  size_t nMu = mu.Size();
+  while(1)
+  {
+    if(iMu+1 >= nMu) break;
+    double tmuUnc = 1.e-8; // normally 10ns uncertainty
+    if (mu.uncert[iMu+1] > tmuUnc) tmuUnc = mu.uncert[iMu+1];
+    if (mu.runs[iMu+1] > run) break;
+    else if (mu.runs[iMu+1]==run && (mu.times[iMu+1]-tmuUnc) > hitT_s) break;
+    iMu++;
+  }
+  return iMu;
+}
+
+// Time since muon iMu.
+// NOTE: If there has been a clock reset since the last muon hit, this will be incorrect.
+inline double MuonDeltaT(const VetoMuonList &mu, size_t iMu, double hitT_s, double startTime, int dsNumber)
+{
+  if (dsNumber==0)
+    return (startTime - mu.runTStarts[iMu]) + (hitT_s - mu.times[iMu]);
+  return hitT_s - mu.times[iMu];
+}
+
+// Is a hit dtmu seconds after muon iMu inside its veto window?
+// The window is closed, like the VetoWindowSet intervals (VetoWindowIndex.hh).
+inline bool IsMuonVetoed(const VetoMuonList &mu, size_t iMu, double dtmu, int dsNumber)
+{
+  // DS-4 requires a larger window due to synchronization issues.
+  if (dsNumber==4)
+    return (dtmu >= -3.*(mu.uncert[iMu]) && dtmu <= (4. + mu.uncert[iMu]));
+  return (dtmu >= -1.*(mu.uncert[iMu]) && dtmu <= (1. + mu.uncert[iMu]));
+}
+
+#endif
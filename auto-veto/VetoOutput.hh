@@ -0,0 +1,501 @@
+// VetoOutput.hh
+// Layouts of the veto_run%i.root files written by auto-veto, and a reader for both.
+//
+// v1: "vetoEvent" is a whole MJVetoEvent object (split level 1), and the run-level
+//     quantities (start, stop, LEDfreq, scalerOffset, ...) are repeated on every entry.
+// v2: every per-entry quantity is its own primitive branch (QDC is a UShort_t[32]),
+//     and the run-level quantities are stored once, in a one-entry "runInfo" tree.
+//     Compression (algorithm and level) and basket size can be chosen.
+// v1 is the default; v2 is written with auto-veto -f 2 (and always for synthetic runs).
+//
+// VetoOutReader gives the same getters for either layout, so the skim and analysis
+// codes don't need to know which one a file has.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOOUTPUT_HH_GUARD
+#define VETOOUTPUT_HH_GUARD
+
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdint>
+#include "TFile.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+#include "TTreeReaderArray.h"
+#include "MJVetoEvent.hh"
+
+// Output options.  Compression is ROOT's "100*algorithm + level" setting.
+class VetoOutConfig
+{
+  public:
+    int schema;       // 1 or 2
+    int compAlg;      // 0: ROOT default, 1: ZLIB, 2: LZMA, 4: LZ4, 5: ZSTD
+    int compLevel;    // 1-9 (0 = uncompressed)
+    int basketSize;   // bytes per basket, 0 = ROOT default
+
+    VetoOutConfig() : schema(1), compAlg(0), compLevel(0), basketSize(0) {}
+
+    bool UseDefaultCompression() const { return compAlg == 0 && compLevel == 0; }
+    int GetCompression() const { return 100*compAlg + compLevel; }
+
+    // From "alg" or "alg:level", e.g. "lz4:4", "zstd", "zlib:1", "none".  Returns false if unknown.
+    bool SetCompression(std::string opt)
+    {
+      std::string alg = opt, level = "";
+      size_t colon = opt.find(':');
+      if (colon != std::string::npos) { alg = opt.substr(0,colon); level = opt.substr(colon+1); }
+      if (alg == "none") { compAlg = 1; compLevel = 0; return true; }
+      if (alg == "zlib") compAlg = 1;
+      else if (alg == "lzma") compAlg = 2;
+      else if (alg == "lz4") compAlg = 4;
+      else if (alg == "zstd") compAlg = 5;
+      else return false;
+      if (level.empty()) { compLevel = (compAlg == 4 ? 4 : 5); return true; }
+      if (level.size() != 1 || level[0] < '0' || level[0] > '9') return false;
+      compLevel = level[0] - '0';
+      return true;
+    }
+};
+
+// v2 per-entry columns, for vetoTree and skipTree.
+class VetoEventColumns
+{
+  public:
+    Int_t run;
+    Long64_t entry;
+    UShort_t qdc[32];
+    Int_t multip, totE;
+    Double_t timeSec, timeSBC;
+    Long64_t scalerIndex, qdc1Index, qdc2Index;
+    Int_t sec, qec, qec2;
+    Bool_t badScaler;
+    UInt_t hitMask;
+
+    VetoEventColumns() { Clear(); }
+
+    void Clear() {
+      run=0; entry=0; multip=0; totE=0; timeSec=0; timeSBC=0;
+      scalerIndex=0; qdc1Index=0; qdc2Index=0; sec=0; qec=0; qec2=0;
+      badScaler=false; hitMask=0;
+      for (int q = 0; q < 32; q++) qdc[q] = 0;
+    }
+
+    void Book(TTree *t)
+    {
+      t->Branch("run",&run,"run/I");
+      t->Branch("entry",&entry,"entry/L");
+      t->Branch("qdc",qdc,"qdc[32]/s");
+      t->Branch("multip",&multip,"multip/I");
+      t->Branch("totE",&totE,"totE/I");
+      t->Branch("timeSec",&timeSec,"timeSec/D");
+      t->Branch("timeSBC",&timeSBC,"timeSBC/D");
+      t->Branch("scalerIndex",&scalerIndex,"scalerIndex/L");
+      t->Branch("qdc1Index",&qdc1Index,"qdc1Index/L");
+      t->Branch("qdc2Index",&qdc2Index,"qdc2Index/L");
+      t->Branch("sec",&sec,"sec/I");
+      t->Branch("qec",&qec,"qec/I");
+      t->Branch("qec2",&qec2,"qec2/I");
+      t->Branch("badScaler",&badScaler,"badScaler/O");
+      t->Branch("hitMask",&hitMask,"hitMask/i");
+    }
+
+    // From a decoded entry (VetoRecord, or anything with the same getters).
+    template <class R> void Set(int runNum, const R &rec)
+    {
+      run = runNum;
+      entry = rec.GetEntry();
+      for (int q = 0; q < 32; q++) qdc[q] = (UShort_t)rec.GetQDC(q);
+      multip = rec.GetMultip();
+      totE = rec.GetTotE();
+      timeSec = rec.GetTimeSec();
+      timeSBC = rec.GetTimeSBC();
+      scalerIndex = rec.GetScalerIndex();
+      qdc1Index = rec.GetQDC1Index();
+      qdc2Index = rec.GetQDC2Index();
+      sec = rec.GetSEC();
+      qec = rec.GetQEC();
+      qec2 = rec.GetQEC2();
+      badScaler = rec.GetBadScaler();
+      hitMask = rec.GetHitMask();
+    }
+};
+
+// One v2 output entry of auto-veto's muon scan: the event columns,
+// plus the quantities worked out for it in loop 3.
+class VetoOutEntry
+{
+  public:
+    VetoEventColumns ev;
+    Double_t xTime, timeUncert, jumpCorrection, deltaScaler, deltaSBC, timePrevLED;
+    UShort_t PlaneMask;
+    UChar_t CoinBits;
+    UInt_t ErrorBits;
+    Long64_t start, stop;  // skipTree only, as in v1
+
+    VetoOutEntry() { Clear(); }
+
+    void Clear() {
+      ev.Clear();
+      xTime=0; timeUncert=0; jumpCorrection=0; deltaScaler=0; deltaSBC=0; timePrevLED=0;
+      PlaneMask=0; CoinBits=0; ErrorBits=0; start=0; stop=0;
+    }
+
+    void BookVeto(TTree *t)
+    {
+      ev.Book(t);
+      // time variables
+      t->Branch("xTime",&xTime,"xTime/D");
+      t->Branch("timeUncert",&timeUncert,"timeUncert/D");
+      t->Branch("jumpCorrection",&jumpCorrection,"jumpCorrection/D");
+      t->Branch("deltaScaler",&deltaScaler,"deltaScaler/D");
+      t->Branch("deltaSBC",&deltaSBC,"deltaSBC/D");
+      t->Branch("timePrevLED",&timePrevLED,"timePrevLED/D");
+      // muon ID and error variables
+      t->Branch("PlaneMask",&PlaneMask,"PlaneMask/s");
+      t->Branch("CoinBits",&CoinBits,"CoinBits/b");
+      t->Branch("ErrorBits",&ErrorBits,"ErrorBits/i");
+    }
+
+    // Error "garbage event" tree
+    void BookSkip(TTree *t)
+    {
+      ev.Book(t);
+      t->Branch("ErrorBits",&ErrorBits,"ErrorBits/i");
+      t->Branch("start",&start,"start/L");
+      t->Branch("stop",&stop,"stop/L");
+    }
+};
+
+// One v1 output entry: the whole MJVetoEvent, and the quantities the v1 trees
+// repeat on every entry.  Like VetoOutEntry, it's copied into VetoTreeWriter's
+// ring, and the trees' branch addresses point at the writer's own copy.
+class VetoOutEntryV1
+{
+  public:
+    Int_t run = 0;
+    MJVetoEvent event;
+    // time variables
+    Double_t xTime = 0, timeUncert = 0, syncUncert = 0, jumpCorrection = 0;
+    Double_t deltaScaler = 0, deltaSBC = 0, timePrevLED = 0;
+    Long64_t start = 0, stop = 0;
+    Double_t unixDuration = 0, scalerDuration = 0, scalerOffset = 0, sbcOffset = 0, sbcUnc = 0;
+    Int_t entryAfterFlush = 0;
+    Bool_t applyOffset = false;
+    // LED variables
+    Double_t LEDfreq = 0;
+    Int_t multipThreshold = 0, highestMultip = 0, LEDMultipThreshold = 0, LEDSimpleThreshold = 0;
+    Bool_t useSimpleThreshold = false;
+    // muon ID and error variables
+    UShort_t PlaneMask = 0;
+    UChar_t CoinBits = 0;
+    UInt_t ErrorBits = 0;
+    std::vector<int> Errors;  // unpacked copy of ErrorBits, kept for existing readers
+
+    void BookVeto(TTree *t)
+    {
+      // event info
+      t->Branch("run",&run);
+      t->Branch("vetoEvent","MJVetoEvent",&event,32000,1);
+      // time variables
+      t->Branch("xTime",&xTime);
+      t->Branch("timeUncert",&timeUncert);
+      t->Branch("syncUncert",&syncUncert);
+      t->Branch("jumpCorrection",&jumpCorrection);
+      t->Branch("deltaScaler",&deltaScaler);
+      t->Branch("deltaSBC",&deltaSBC);
+      t->Branch("timePrevLED",&timePrevLED);
+      t->Branch("start",&start,"start/L");
+      t->Branch("stop",&stop,"stop/L");
+      t->Branch("unixDuration",&unixDuration);
+      t->Branch("scalerDuration",&scalerDuration);
+      t->Branch("scalerOffset",&scalerOffset);
+      t->Branch("sbcOffset",&sbcOffset);
+      t->Branch("sbcUnc",&sbcUnc);
+      t->Branch("entryAfterFlush",&entryAfterFlush);
+      t->Branch("applyOffset",&applyOffset);
+      // LED variables
+      t->Branch("LEDfreq",&LEDfreq);
+      t->Branch("multipThreshold",&multipThreshold);
+      t->Branch("highestMultip",&highestMultip);
+      t->Branch("LEDMultipThreshold",&LEDMultipThreshold);
+      t->Branch("LEDSimpleThreshold",&LEDSimpleThreshold);
+      t->Branch("useSimpleThreshold",&useSimpleThreshold);
+      // muon ID variables
+      t->Branch("PlaneMask",&PlaneMask,"PlaneMask/s");
+      t->Branch("CoinBits",&CoinBits,"CoinBits/b");
+      // error variables
+      t->Branch("ErrorBits",&ErrorBits,"ErrorBits/i");
+      t->Branch("Errors",&Errors);
+    }
+
+    // Error "garbage event" tree
+    void BookSkip(TTree *t)
+    {
+      t->Branch("run",&run);
+      t->Branch("vetoEvent","MJVetoEvent",&event,32000,1);
+      t->Branch("ErrorBits",&ErrorBits,"ErrorBits/i");
+      t->Branch("Errors",&Errors);
+      t->Branch("start",&start,"start/L");
+      t->Branch("stop",&stop,"stop/L");
+    }
+};
+
+// v2 run-level quantities, one entry per run in the "runInfo" tree.
+class VetoRunInfo
+{
+  public:
+    Int_t run, schema;
+    Long64_t start, stop;
+    Double_t unixDuration, scalerDuration;
+    Double_t scalerOffset, syncUncert, sbcOffset, sbcUnc;
+    Int_t entryAfterFlush;
+    Bool_t applyOffset;
+    Double_t LEDfreq;
+    Int_t multipThreshold, highestMultip, LEDMultipThreshold, LEDSimpleThreshold;
+    Bool_t useSimpleThreshold;
+    Int_t swThresh[32];
+
+    VetoRunInfo() { Clear(); }
+
+    void Clear() {
+      run=0; schema=2; start=0; stop=0; unixDuration=0; scalerDuration=0;
+      scalerOffset=0; syncUncert=0; sbcOffset=0; sbcUnc=0;
+      entryAfterFlush=0; applyOffset=false; LEDfreq=0;
+      multipThreshold=0; highestMultip=0; LEDMultipThreshold=0; LEDSimpleThreshold=0;
+      useSimpleThreshold=false;
+      for (int q = 0; q < 32; q++) swThresh[q] = 0;
+    }
+
+    void Book(TTree *t)
+    {
+      t->Branch("run",&run,"run/I");
+      t->Branch("schema",&schema,"schema/I");
+      t->Branch("start",&start,"start/L");
+      t->Branch("stop",&stop,"stop/L");
+      t->Branch("unixDuration",&unixDuration,"unixDuration/D");
+      t->Branch("scalerDuration",&scalerDuration,"scalerDuration/D");
+      t->Branch("scalerOffset",&scalerOffset,"scalerOffset/D");
+      t->Branch("syncUncert",&syncUncert,"syncUncert/D");
+      t->Branch("sbcOffset",&sbcOffset,"sbcOffset/D");
+      t->Branch("sbcUnc",&sbcUnc,"sbcUnc/D");
+      t->Branch("entryAfterFlush",&entryAfterFlush,"entryAfterFlush/I");
+      t->Branch("applyOffset",&applyOffset,"applyOffset/O");
+      t->Branch("LEDfreq",&LEDfreq,"LEDfreq/D");
+      t->Branch("multipThreshold",&multipThreshold,"multipThreshold/I");
+      t->Branch("highestMultip",&highestMultip,"highestMultip/I");
+      t->Branch("LEDMultipThreshold",&LEDMultipThreshold,"LEDMultipThreshold/I");
+      t->Branch("LEDSimpleThreshold",&LEDSimpleThreshold,"LEDSimpleThreshold/I");
+      t->Branch("useSimpleThreshold",&useSimpleThreshold,"useSimpleThreshold/O");
+      t->Branch("swThresh",swThresh,"swThresh[32]/I");
+    }
+
+    void SetAddresses(TTree *t)
+    {
+      t->SetBranchAddress("run",&run);
+      t->SetBranchAddress("schema",&schema);
+      t->SetBranchAddress("start",&start);
+      t->SetBranchAddress("stop",&stop);
+      t->SetBranchAddress("unixDuration",&unixDuration);
+      t->SetBranchAddress("scalerDuration",&scalerDuration);
+      t->SetBranchAddress("scalerOffset",&scalerOffset);
+      t->SetBranchAddress("syncUncert",&syncUncert);
+      t->SetBranchAddress("sbcOffset",&sbcOffset);
+      t->SetBranchAddress("sbcUnc",&sbcUnc);
+      t->SetBranchAddress("entryAfterFlush",&entryAfterFlush);
+      t->SetBranchAddress("applyOffset",&applyOffset);
+      t->SetBranchAddress("LEDfreq",&LEDfreq);
+      t->SetBranchAddress("multipThreshold",&multipThreshold);
+      t->SetBranchAddress("highestMultip",&highestMultip);
+      t->SetBranchAddress("LEDMultipThreshold",&LEDMultipThreshold);
+      t->SetBranchAddress("LEDSimpleThreshold",&LEDSimpleThreshold);
+      t->SetBranchAddress("useSimpleThreshold",&useSimpleThreshold);
+      t->SetBranchAddress("swThresh",swThresh);
+    }
+};
+
+// Reads a vetoTree (or a chain of them) of either layout.
+// Use it next to the caller's own TTreeReaderValues, like CoinBitsReader:
+//   TTreeReader reader(chain);
+//   VetoOutReader vo(reader, chain);
+//   while (reader.Next()) { ... vo.GetXTime() ... }
+// The layout is worked out again for each file of the chain, since a directory can
+// hold both (v1 is the default, v2 is opt-in), so the branches are read straight from
+// the current file's tree rather than through TTreeReaderValues.  (The caller
+// shouldn't read the same branches with its own.)  Each branch is only read once an
+// entry, when one of its getters is first called.  Like CoinBitsReader, it leaves its
+// addresses on the current file's tree, so the reader should outlive the reads.
+// Files older than v1 called the event branch "events"; that's read too.
+class VetoOutReader
+{
+  public:
+    VetoOutReader(TTreeReader &reader, TTree *tree) : fReader(reader), fTree(tree)
+    {
+      fEvt.Value() = &fEvtObj;  // read into our own object, so no file's branch owns it
+      LoadRunInfo(tree);
+    }
+
+    VetoOutReader(const VetoOutReader&) = delete;
+    VetoOutReader &operator=(const VetoOutReader&) = delete;
+
+    // Layout of the current entry's file
+    int GetSchema() { Sync(); return fSchema; }
+
+    // Per-entry quantities
+    int GetRun() { Sync(); return fRunV.Has() ? fRunV.Get(fLocal) : (Evt() ? Evt()->GetRun() : 0); }
+    long GetEntry() { Sync(); return fSchema==2 ? (long)fEntry.Get(fLocal) : (Evt() ? Evt()->GetEntry() : 0); }
+    int GetQDC(int q) { Sync(); return fSchema==2 ? fQDC.Get(fLocal).q[q] : (Evt() ? Evt()->GetQDC(q) : 0); }
+    int GetMultip() { Sync(); return fSchema==2 ? fMultip.Get(fLocal) : (Evt() ? Evt()->GetMultip() : 0); }
+    bool GetBadScaler() { Sync(); return fSchema==2 ? fBadScaler.Get(fLocal) : (Evt() ? Evt()->GetBadScaler() : false); }
+    double GetXTime() { Sync(); return fXTime.Get(fLocal); }
+    double GetTimeUncert() { Sync(); return fTimeUncert.Get(fLocal); }
+
+    // Run-level quantities
+    int GetSWThresh(int q) { Sync(); return fSchema==2 ? Info().swThresh[q] : (Evt() ? Evt()->GetSWThresh(q) : 0); }
+    Long64_t GetStart() { Sync(); return fSchema==2 ? Info().start : fStart.Get(fLocal); }
+    Long64_t GetStop() { Sync(); return fSchema==2 ? Info().stop : fStop.Get(fLocal); }
+    double GetUnixDuration() { Sync(); return fSchema==2 ? Info().unixDuration : fDuration.Get(fLocal); }
+    double GetScalerOffset() { Sync(); return fSchema==2 ? Info().scalerOffset : fScalerOffset.Get(fLocal); }
+    double GetSyncUncert() { Sync(); return fSchema==2 ? Info().syncUncert : fSyncUncert.Get(fLocal); }
+
+    // v2 only: the whole runInfo entry for the current run.
+    const VetoRunInfo &Info()
+    {
+      int run = GetRun();
+      if (run != fInfoRun) {
+        fInfoRun = run;
+        std::map<int,VetoRunInfo>::iterator it = fInfo.find(run);
+        if (it != fInfo.end()) fInfoCur = it->second;
+        else { fInfoCur.Clear(); fInfoCur.run = run; }
+      }
+      return fInfoCur;
+    }
+
+  private:
+
+    // One branch of the current file's tree, read (at most once an entry) on first use.
+    // A branch the file doesn't have reads as 0.
+    template <class T> class Column
+    {
+      public:
+        void Attach(TTree *t, const char *name)
+        {
+          fBranch = t->GetBranch(name);
+          fRead = -1;
+          if (fBranch) fBranch->SetAddress(&fVal);
+        }
+        bool Has() const { return fBranch != 0; }
+        const T &Get(Long64_t entry)
+        {
+          static const T kNone = T();
+          if (!fBranch) return kNone;
+          if (entry != fRead) {
+            fBranch->GetEntry(entry, 1);  // even if the caller switched the branch off
+            fRead = entry;
+          }
+          return fVal;
+        }
+        T &Value() { return fVal; }
+
+      private:
+        TBranch *fBranch = 0;
+        T fVal = T();
+        Long64_t fRead = -1;
+    };
+    struct QDCArray { UShort_t q[32]; };
+
+    TTreeReader &fReader;
+    TTree *fTree;
+    TTree *fCurTree = 0;    // file tree the columns belong to
+    int fCurNum = -1;
+    Long64_t fSynced = -1;  // reader entry of the last Sync
+    Long64_t fLocal = -1;   // and its entry in fCurTree
+    int fSchema = 1;
+
+    std::map<int,VetoRunInfo> fInfo;
+    VetoRunInfo fInfoCur;
+    int fInfoRun = -1;
+
+    MJVetoEvent fEvtObj;
+    Column<MJVetoEvent*> fEvt;
+    Column<Int_t> fRunV;
+    Column<Long64_t> fStart, fStop;
+    Column<Double_t> fDuration, fScalerOffset, fSyncUncert;
+    Column<QDCArray> fQDC;
+    Column<Int_t> fMultip;
+    Column<Long64_t> fEntry;
+    Column<Bool_t> fBadScaler;
+    Column<Double_t> fXTime, fTimeUncert;
+
+    // Point the columns at the tree of the reader's current entry.
+    void Sync()
+    {
+      Long64_t entry = fReader.GetCurrentEntry();
+      if (entry == fSynced && fCurTree) return;
+      fLocal = fTree->LoadTree(entry);
+      fSynced = entry;
+      TTree *t = fTree->GetTree();
+      if (t && (t != fCurTree || fTree->GetTreeNumber() != fCurNum)) Attach(t);
+    }
+
+    void Attach(TTree *t)
+    {
+      fCurTree = t;
+      fCurNum = fTree->GetTreeNumber();
+      fInfoRun = -1;
+      fSchema = t->GetBranch("qdc") ? 2 : 1;
+      fRunV.Attach(t,"run");
+      fXTime.Attach(t,"xTime");
+      fTimeUncert.Attach(t,"timeUncert");
+      // v2
+      fQDC.Attach(t,"qdc");
+      fMultip.Attach(t,"multip");
+      fEntry.Attach(t,"entry");
+      fBadScaler.Attach(t,"badScaler");
+      // v1
+      fEvt.Attach(t, t->GetBranch("vetoEvent") ? "vetoEvent" : "events");
+      fStart.Attach(t,"start");
+      fStop.Attach(t,"stop");
+      fDuration.Attach(t,"unixDuration");
+      fScalerOffset.Attach(t,"scalerOffset");
+      fSyncUncert.Attach(t, t->GetBranch("syncUncert") ? "syncUncert" : "scalerUnc");  // older name
+    }
+
+    // The v1 event of the current entry, or 0 if the file has no event branch.
+    MJVetoEvent *Evt() { return fEvt.Has() ? fEvt.Get(fLocal) : 0; }
+
+    // runInfo has one entry per file (v2 files only), so read them all up front.
+    void LoadRunInfo(TTree *tree)
+    {
+      TChain *chain = dynamic_cast<TChain*>(tree);
+      if (!chain) {
+        if (tree->GetCurrentFile()) LoadRunInfo(tree->GetCurrentFile()->GetName());
+        return;
+      }
+      TObjArray *files = chain->GetListOfFiles();
+      for (int i = 0; i < files->GetEntries(); i++)
+        LoadRunInfo(((TChainElement*)files->At(i))->GetTitle());
+    }
+
+    void LoadRunInfo(const char *fileName)
+    {
+      TFile *f = TFile::Open(fileName);
+      if (!f || f->IsZombie()) { delete f; return; }
+      TTree *t = (TTree*)f->Get("runInfo");
+      if (t) {
+        VetoRunInfo info;
+        info.SetAddresses(t);
+        for (long i = 0; i < t->GetEntries(); i++) {
+          t->GetEntry(i);
+          fInfo[info.run] = info;
+        }
+      }
+      f->Close();
+      delete f;
+    }
+};
+
+#endif
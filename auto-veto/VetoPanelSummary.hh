@@ -0,0 +1,135 @@
+// VetoPanelSummary.hh
+// One-pass summary of the 32 panel QDC values of a veto event:
+// hit mask, multiplicity, number of panels over a QDC value, and QDC sums.
+// Uses AVX2 (4 x 8 panels) when the CPU has it, and a scalar loop otherwise.
+// The choice is made once, at the first call.  Set VETO_SCALAR=1 in the
+// environment to force the scalar version (for checks and benchmarks).
+// Used by auto-veto (through VetoRunCache), veto-bench, and vetoScan-dev's muFinder.
+// vetoCheck and vetoPerformance don't need it: their per-event panel loops only
+// fill QDC histograms, and they take multiplicity and total QDC from MJVetoEvent.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOPANELSUMMARY_HH_GUARD
+#define VETOPANELSUMMARY_HH_GUARD
+
+#include <cstdint>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VETO_HAVE_AVX2_KERNEL
+#endif
+
+struct PanelSummary
+{
+  uint32_t hitMask;  // bit q set if qdc[q] > thresh[q]
+  int multip;        // number of panels over threshold
+  int overN;         // number of panels with qdc > N
+  int totQDC;        // sum of all 32 QDC values
+  int hitQDC;        // sum of QDC over threshold (same as MJVetoEvent::GetTotE)
+};
+
+namespace VetoSIMD {
+
+typedef void (*SummaryFn)(const int *qdc, const int *thresh, int overN, PanelSummary &s);
+
+inline void SummarizeScalar(const int *qdc, const int *thresh, int overN, PanelSummary &s)
+{
+  uint32_t hit = 0;
+  int over = 0, tot = 0, hitSum = 0;
+  for (int q = 0; q < 32; q++) {
+    tot += qdc[q];
+    if (qdc[q] > overN) over++;
+    if (qdc[q] > thresh[q]) {
+      hit |= (1u << q);
+      hitSum += qdc[q];
+    }
+  }
+  s.hitMask = hit;
+  s.multip = __builtin_popcount(hit);
+  s.overN = over;
+  s.totQDC = tot;
+  s.hitQDC = hitSum;
+}
+
+#ifdef VETO_HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+inline int HorizontalSum(__m256i v)
+{
+  __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v,1));
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4E));
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xB1));
+  return _mm_cvtsi128_si32(x);
+}
+
+__attribute__((target("avx2")))
+inline void SummarizeAVX2(const int *qdc, const int *thresh, int overN, PanelSummary &s)
+{
+  const __m256i n = _mm256_set1_epi32(overN);
+  __m256i tot = _mm256_setzero_si256(), hitSum = _mm256_setzero_si256();
+  uint32_t hit = 0, over = 0;
+  for (int b = 0; b < 4; b++) {
+    __m256i q = _mm256_loadu_si256((const __m256i*)(qdc + 8*b));
+    __m256i t = _mm256_loadu_si256((const __m256i*)(thresh + 8*b));
+    __m256i isHit = _mm256_cmpgt_epi32(q,t);
+    __m256i isOver = _mm256_cmpgt_epi32(q,n);
+    hit |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(isHit)) << (8*b);
+    over |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(isOver)) << (8*b);
+    tot = _mm256_add_epi32(tot,q);
+    hitSum = _mm256_add_epi32(hitSum,_mm256_and_si256(isHit,q));
+  }
+  s.hitMask = hit;
+  s.multip = __builtin_popcount(hit);
+  s.overN = __builtin_popcount(over);
+  s.totQDC = HorizontalSum(tot);
+  s.hitQDC = HorizontalSum(hitSum);
+}
+#endif
+
+inline bool UseAVX2()
+{
+#ifdef VETO_HAVE_AVX2_KERNEL
+  const char *env = getenv("VETO_SCALAR");
+  if (env && atoi(env) != 0) return false;
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+inline SummaryFn SelectSummary()
+{
+#ifdef VETO_HAVE_AVX2_KERNEL
+  if (UseAVX2()) return SummarizeAVX2;
+#endif
+  return SummarizeScalar;
+}
+
+} // namespace VetoSIMD
+
+// Summarize one event.  qdc and thresh are 32 panels each.
+inline void SummarizePanels(const int *qdc, const int *thresh, int overN, PanelSummary &s)
+{
+  static const VetoSIMD::SummaryFn fn = VetoSIMD::SelectSummary();
+  fn(qdc,thresh,overN,s);
+}
+
+// Name of the kernel in use, for log output.
+inline const char *PanelSummaryKernel()
+{
+  return VetoSIMD::SelectSummary() == VetoSIMD::SummarizeScalar ? "scalar" : "avx2";
+}
+
+// Same, for an MJVetoEvent-like object (anything with GetQDC and GetSWThresh).
+template <class Event>
+inline void SummarizePanels(Event &veto, int overN, PanelSummary &s)
+{
+  int qdc[32], thresh[32];
+  for (int q = 0; q < 32; q++) {
+    qdc[q] = veto.GetQDC(q);
+    thresh[q] = veto.GetSWThresh(q);
+  }
+  SummarizePanels(qdc,thresh,overN,s);
+}
+
+#endif
@@ -0,0 +1,267 @@
+// VetoProducts.hh
+// Per-run intermediate products of auto-veto, saved next to the veto output
+// (veto_run%i.products), so rerunning a run with different muon cuts only
+// redoes the muon scan.
+//
+// Each stage is saved with a key: a hash of the build (kVetoProductsBuild), the
+// input files (VetoFileKey of every file in the chain), and the stage's own
+// parameters and inputs.  A stage is only reused if its key matches.
+// Changing the software thresholds reruns the scan and everything after it;
+// changing the muon cuts (--muon-qdc, --muon-panels, --led-multip) reruns nothing.
+//
+//   kThreshStage   software thresholds (MeasurePanelThresholds)
+//   kScanStage     loop 1: highest multiplicity, LED timing, buffer flush, bad scalers
+//   kSyncStage     veto/Ge clock offsets
+//   kInterpStage   interpolated times for bad scalers
+//   kErrorStage    loop 2 error counts
+//
+// The build ID comes from the Makefile: the git commit, plus a checksum of the
+// uncommitted changes in this directory.  So any change to the code, committed or
+// not, makes new products.  Without it (a build outside git), it's the compile
+// time, and every rebuild does.
+//
+// The auto-veto daemon (-D) also keeps the products of its recent runs in memory
+// (VetoProductsCache), so a resubmitted run doesn't read them back from disk.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOPRODUCTS_HH_GUARD
+#define VETOPRODUCTS_HH_GUARD
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+
+#ifndef VETO_BUILD_ID
+#define VETO_BUILD_ID __DATE__ " " __TIME__
+#endif
+const char *const kVetoProductsBuild = VETO_BUILD_ID;
+
+enum VetoStage { kThreshStage, kScanStage, kSyncStage, kInterpStage, kErrorStage, kNStages };
+
+// 64-bit FNV-1a hash of whatever is added to it.
+class VetoKey
+{
+  public:
+    VetoKey() : fHash(14695981039346656037ULL) {}
+
+    VetoKey &Add(const void *data, size_t n)
+    {
+      const unsigned char *p = (const unsigned char*)data;
+      for (size_t i = 0; i < n; i++) { fHash ^= p[i]; fHash *= 1099511628211ULL; }
+      return *this;
+    }
+    template<class T> VetoKey &Add(const T &val) { return Add(&val, sizeof(T)); }
+
+    uint64_t Get() const { return fHash ? fHash : 1; }  // 0 means "no key"
+
+  private:
+    uint64_t fHash;
+};
+
+// Identity of an input file: size, mtime, and a checksum of its first and last MB.
+// Only those 2 MB are read, so it's cheap for a multi-GB built file, but a rewrite
+// of the middle of a file that keeps its size and mtime isn't seen.  (Built files
+// are written once; a rebuilt one has a new mtime.)
+// Returns 0 if the file can't be read (e.g. a remote path), so nothing is reused.
+inline uint64_t VetoFileKey(const std::string &fileName)
+{
+  struct stat st;
+  if (stat(fileName.c_str(), &st) != 0) return 0;
+  std::ifstream in(fileName.c_str(), std::ios::binary);
+  if (!in) return 0;
+  VetoKey key;
+  key.Add((int64_t)st.st_size).Add((int64_t)st.st_mtime);
+  const long chunk = 1 << 20;
+  std::vector<char> buf(chunk);
+  in.read(buf.data(), chunk);
+  key.Add(buf.data(), in.gcount());
+  if (st.st_size > 2*chunk) {
+    in.clear();
+    in.seekg(st.st_size - chunk);
+    in.read(buf.data(), chunk);
+    key.Add(buf.data(), in.gcount());
+  }
+  return key.Get();
+}
+
+struct VetoProducts
+{
+  uint64_t input = 0;               // key of the current input files, set by the caller.  0: don't reuse
+  uint64_t key[kNStages] = {0};     // key each stage was computed with.  0: not computed
+  int nReused = 0;                  // stages reused this time (not saved)
+
+  // kThreshStage
+  int swThresh[32] = {0};
+
+  // kScanStage
+  int highestMultip = 0, simpleLEDCount = 0, entryAfterFlush = 0;
+  long LEDEntries = 0, syncEntry = -1;   // syncEntry -1: no sync event found
+  double LEDPeriod = 0, firstGoodScaler = 0, lastGoodScaler = 0;
+  double LEDQDCTotal[32] = {0};
+  int nonLEDHitCount[32] = {0};
+  std::vector<int> badEntries;
+  std::vector<long> packetList;
+
+  // kSyncStage
+  double scalerOffset = 0, syncUncert = 0, sbcOffset = 0, sbcUnc = 0;
+  bool applyOffset = false;
+
+  // kInterpStage
+  std::vector<double> interpTimes, interpUnc;
+
+  // kErrorStage (indexed by error number, see VetoErrors.hh)
+  int errorCount[32] = {0};
+
+  // Key for a stage computed from this input with the given parameters.
+  uint64_t StageKey(VetoStage stage, VetoKey params) const
+  {
+    if (input == 0) return 0;
+    return VetoKey().Add(kVetoProductsBuild, strlen(kVetoProductsBuild)).Add(input).Add((int)stage).Add(params.Get()).Get();
+  }
+
+  bool Has(VetoStage stage, uint64_t k) const { return k != 0 && key[stage] == k; }
+
+  // Written to a temporary file, then renamed, so a reader never sees part of one.
+  bool Save(std::string fileName) const
+  {
+    std::string tmp = fileName + ".tmp";
+    std::ofstream out(tmp.c_str(), std::ios::binary);
+    if (!out) return false;
+    out.write(Magic(), 8);
+    Write(out, key, sizeof(key));
+    Write(out, swThresh, sizeof(swThresh));
+    Write(out, &highestMultip, sizeof(highestMultip));
+    Write(out, &simpleLEDCount, sizeof(simpleLEDCount));
+    Write(out, &entryAfterFlush, sizeof(entryAfterFlush));
+    Write(out, &LEDEntries, sizeof(LEDEntries));
+    Write(out, &syncEntry, sizeof(syncEntry));
+    Write(out, &LEDPeriod, sizeof(LEDPeriod));
+    Write(out, &firstGoodScaler, sizeof(firstGoodScaler));
+    Write(out, &lastGoodScaler, sizeof(lastGoodScaler));
+    Write(out, LEDQDCTotal, sizeof(LEDQDCTotal));
+    Write(out, nonLEDHitCount, sizeof(nonLEDHitCount));
+    WriteVec(out, badEntries);
+    WriteVec(out, packetList);
+    Write(out, &scalerOffset, sizeof(scalerOffset));
+    Write(out, &syncUncert, sizeof(syncUncert));
+    Write(out, &sbcOffset, sizeof(sbcOffset));
+    Write(out, &sbcUnc, sizeof(sbcUnc));
+    Write(out, &applyOffset, sizeof(applyOffset));
+    WriteVec(out, interpTimes);
+    WriteVec(out, interpUnc);
+    Write(out, errorCount, sizeof(errorCount));
+    out.close();
+    bool ok = !out.fail() && rename(tmp.c_str(), fileName.c_str()) == 0;
+    if (!ok) remove(tmp.c_str());
+    return ok;
+  }
+
+  // On any failure the products are left empty (nothing is reused).
+  bool Load(std::string fileName)
+  {
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    if (!in) return false;
+    char magic[8];
+    in.read(magic, sizeof(magic));
+    if (!in || memcmp(magic, Magic(), 8) != 0) return false;
+    Read(in, key, sizeof(key));
+    Read(in, swThresh, sizeof(swThresh));
+    Read(in, &highestMultip, sizeof(highestMultip));
+    Read(in, &simpleLEDCount, sizeof(simpleLEDCount));
+    Read(in, &entryAfterFlush, sizeof(entryAfterFlush));
+    Read(in, &LEDEntries, sizeof(LEDEntries));
+    Read(in, &syncEntry, sizeof(syncEntry));
+    Read(in, &LEDPeriod, sizeof(LEDPeriod));
+    Read(in, &firstGoodScaler, sizeof(firstGoodScaler));
+    Read(in, &lastGoodScaler, sizeof(lastGoodScaler));
+    Read(in, LEDQDCTotal, sizeof(LEDQDCTotal));
+    Read(in, nonLEDHitCount, sizeof(nonLEDHitCount));
+    ReadVec(in, badEntries);
+    ReadVec(in, packetList);
+    Read(in, &scalerOffset, sizeof(scalerOffset));
+    Read(in, &syncUncert, sizeof(syncUncert));
+    Read(in, &sbcOffset, sizeof(sbcOffset));
+    Read(in, &sbcUnc, sizeof(sbcUnc));
+    Read(in, &applyOffset, sizeof(applyOffset));
+    ReadVec(in, interpTimes);
+    ReadVec(in, interpUnc);
+    Read(in, errorCount, sizeof(errorCount));
+    if (!in) {
+      uint64_t in0 = input;
+      *this = VetoProducts();
+      input = in0;
+      return false;
+    }
+    return true;
+  }
+
+  private:
+    static const char *Magic() { return "VETOPRD1"; }  // 8 bytes, file format version
+    static void Write(std::ofstream &out, const void *p, size_t n) { out.write((const char*)p, n); }
+    static void Read(std::ifstream &in, void *p, size_t n) { in.read((char*)p, n); }
+    template<class T> static void WriteVec(std::ofstream &out, const std::vector<T> &v)
+    {
+      uint64_t n = v.size();
+      Write(out, &n, sizeof(n));
+      Write(out, v.data(), n*sizeof(T));
+    }
+    template<class T> static void ReadVec(std::ifstream &in, std::vector<T> &v)
+    {
+      uint64_t n = 0;
+      Read(in, &n, sizeof(n));
+      if (!in || n > (1ULL << 32)) { in.setstate(std::ios::failbit); return; }
+      v.resize(n);
+      Read(in, v.data(), n*sizeof(T));
+    }
+};
+
+// Products kept in memory between jobs, by products file name.
+// Shared by the daemon's workers.  Only the newest kMaxRuns files are kept.
+class VetoProductsCache
+{
+  public:
+    static const size_t kMaxRuns = 500;
+
+    // Copy the cached products for this file into prod, keeping prod's input key.
+    bool Get(const std::string &fileName, VetoProducts &prod)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      auto it = fProducts.find(fileName);
+      if (it == fProducts.end()) return false;
+      uint64_t in0 = prod.input;
+      prod = it->second.second;
+      prod.input = in0;
+      prod.nReused = 0;
+      return true;
+    }
+
+    void Put(const std::string &fileName, const VetoProducts &prod)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fProducts[fileName] = std::make_pair(fCount++, prod);
+      if (fProducts.size() <= kMaxRuns) return;
+      auto oldest = fProducts.begin();
+      for (auto it = fProducts.begin(); it != fProducts.end(); ++it)
+        if (it->second.first < oldest->second.first) oldest = it;
+      fProducts.erase(oldest);
+    }
+
+    size_t Size()
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      return fProducts.size();
+    }
+
+  private:
+    std::mutex fMutex;
+    long fCount = 0;
+    std::map<std::string, std::pair<long, VetoProducts> > fProducts;  // file: (last use, products)
+};
+
+#endif
@@ -0,0 +1,194 @@
+// VetoProfile.hh
+// Phase-level timers and counters for auto-veto, skim-coins and vetoScan.
+//
+// A VetoProfiler collects the phases of one run (or one job).  While it's
+// installed as this thread's profiler (VetoProfilerCurrent), each VETO_SCOPE
+// records the wall time, CPU time, entries processed and ROOT file bytes
+// read/written between its start and Stop() (or the end of the block).
+// Scopes with the same name add up, and nested scopes are timed separately,
+// so a phase's time includes any phases inside it.
+// With no profiler installed, a scope is a null pointer check.
+//
+// Bytes read/written come from ROOT's global TFile counters, so they're exact
+// for a single run, but include the other workers' I/O in batch mode.
+// Peak RSS is for the whole process.
+//
+// VetoProfileReport gathers the finished profilers and writes them as JSON:
+//   {"program": "auto-veto", "jobs": [ {"label": "run", "id": 12345, "phases": [...], "counters": {...}}, ... ]}
+// C. Wiseman, A. Lopez
+
+#ifndef VETOPROFILE_HH_GUARD
+#define VETOPROFILE_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include <sys/resource.h>
+#include "TFile.h"
+
+struct VetoPhase {
+  std::string name;
+  double wall = 0, cpu = 0;           // sec
+  long entries = 0;
+  long long bytesIn = 0, bytesOut = 0;
+  int calls = 0;
+};
+
+class VetoProfiler
+{
+  public:
+
+    VetoProfiler(std::string label="run", long id=0) : fLabel(label), fID(id) {}
+
+    // Phases keep the order they were first started in.
+    VetoPhase &Phase(const std::string &name)
+    {
+      for (auto &p : fPhases) if (p.name == name) return p;
+      fPhases.push_back(VetoPhase());
+      fPhases.back().name = name;
+      return fPhases.back();
+    }
+
+    void SetCounter(const std::string &name, double val) { fCounters[name] = val; }
+    void AddCounter(const std::string &name, double val) { fCounters[name] += val; }
+
+    // Record the peak RSS so far (kB), e.g. when the job is done.
+    void SetPeakRSS()
+    {
+      struct rusage ru;
+      if (getrusage(RUSAGE_SELF, &ru) == 0) SetCounter("peakRSSkB", (double)ru.ru_maxrss);
+    }
+
+    const std::vector<VetoPhase> &GetPhases() const { return fPhases; }
+
+    std::string ToJSON() const
+    {
+      std::string s;
+      char buf[512];
+      snprintf(buf, sizeof(buf), "{\"label\": \"%s\", \"id\": %li, \"phases\": [", fLabel.c_str(), fID);
+      s += buf;
+      for (size_t i = 0; i < fPhases.size(); i++) {
+        const VetoPhase &p = fPhases[i];
+        snprintf(buf, sizeof(buf),
+          "%s\n    {\"name\": \"%s\", \"calls\": %i, \"wall\": %.6f, \"cpu\": %.6f, \"entries\": %li, "
+          "\"entriesPerSec\": %.1f, \"bytesIn\": %lli, \"bytesOut\": %lli}",
+          i ? "," : "", p.name.c_str(), p.calls, p.wall, p.cpu, p.entries,
+          p.wall > 0 ? p.entries/p.wall : 0., p.bytesIn, p.bytesOut);
+        s += buf;
+      }
+      s += "],\n   \"counters\": {";
+      bool first = true;
+      for (auto &c : fCounters) {
+        snprintf(buf, sizeof(buf), "%s\"%s\": %.6g", first ? "" : ", ", c.first.c_str(), c.second);
+        s += buf;
+        first = false;
+      }
+      s += "}}";
+      return s;
+    }
+
+  private:
+    std::string fLabel;
+    long fID;
+    std::vector<VetoPhase> fPhases;
+    std::map<std::string,double> fCounters;
+};
+
+// This thread's profiler, or 0 when profiling is off.
+inline VetoProfiler *&VetoProfilerCurrent()
+{
+  static thread_local VetoProfiler *prof = 0;
+  return prof;
+}
+
+// Times a phase from construction to Stop() or the end of the block.
+class VetoScope
+{
+  public:
+
+    explicit VetoScope(const char *name) : fProf(VetoProfilerCurrent()), fName(name), fEntries(0)
+    {
+      if (!fProf) return;
+      fWall0 = std::chrono::steady_clock::now();
+      fCPU0 = ThreadCPU();
+      fIn0 = TFile::GetFileBytesRead();
+      fOut0 = TFile::GetFileBytesWritten();
+    }
+
+    ~VetoScope() { Stop(); }
+
+    void AddEntries(long n) { fEntries += n; }
+
+    // End the phase early, optionally adding the entries it processed.
+    void Stop(long entries=0)
+    {
+      if (!fProf) return;
+      VetoPhase &p = fProf->Phase(fName);
+      p.calls++;
+      p.wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - fWall0).count();
+      p.cpu += ThreadCPU() - fCPU0;
+      p.entries += fEntries + entries;
+      p.bytesIn += TFile::GetFileBytesRead() - fIn0;
+      p.bytesOut += TFile::GetFileBytesWritten() - fOut0;
+      fProf = 0;
+    }
+
+  private:
+
+    static double ThreadCPU()
+    {
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+      return ts.tv_sec + 1e-9*ts.tv_nsec;
+    }
+
+    VetoProfiler *fProf;
+    const char *fName;
+    long fEntries;
+    std::chrono::steady_clock::time_point fWall0;
+    double fCPU0 = 0;
+    long long fIn0 = 0, fOut0 = 0;
+};
+
+// Use like:  VETO_SCOPE(pLoop, "loop1");  ...  pLoop.Stop(nEntries);
+#define VETO_SCOPE(var, name) VetoScope var(name)
+
+// Finished profilers from every thread, written out once at the end.
+class VetoProfileReport
+{
+  public:
+
+    static VetoProfileReport &Get()
+    {
+      static VetoProfileReport report;
+      return report;
+    }
+
+    void Add(const VetoProfiler &prof)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fJobs.push_back(prof.ToJSON());
+    }
+
+    bool Write(const std::string &fileName, const std::string &program)
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      std::ofstream out(fileName.c_str());
+      if (!out) return false;
+      out << "{\"program\": \"" << program << "\", \"jobs\": [";
+      for (size_t i = 0; i < fJobs.size(); i++) out << (i ? ",\n  " : "\n  ") << fJobs[i];
+      out << "\n]}\n";
+      return (bool)out;
+    }
+
+  private:
+    std::mutex fMutex;
+    std::vector<std::string> fJobs;
+};
+
+#endif
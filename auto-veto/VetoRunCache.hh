@@ -0,0 +1,551 @@
+// VetoRunCache.hh
+// Decodes each VetoTree entry of a run exactly once (MJVetoEvent::WriteEvent)
+// into compact structure-of-arrays columns, so the multi-pass scans in auto-veto
+// iterate memory instead of re-reading and re-decoding the tree.
+// If the run is larger than the memory cap, the cache falls back to
+// reading VetoTree on every pass (the old behavior).
+// A .vsyn synthetic run from veto-gen (VetoSynth.hh) is read straight into the columns.
+// VetoTree is read pruned (VetoBranches.hh): only vetoBits and vetoEvent every entry,
+// and the run object once per file.
+// In follow mode (auto-veto -t) the run is still being written, and each
+// Append call only decodes the entries that landed since the last one.
+// For the v1 output (a full MJVetoEvent per entry), KeepEvents makes the cache
+// keep the decoded events too, so writing them doesn't read the tree again.
+// If the thresholds aren't known yet, KeepEventsGuessed has Load guess them
+// from the first entries it decodes.
+// C. Wiseman, A. Lopez
+
+#ifndef VETORUNCACHE_HH_GUARD
+#define VETORUNCACHE_HH_GUARD
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "TChain.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+#include "MJVetoEvent.hh"
+#include "MGTEvent.hh"
+#include "VetoBranches.hh"
+#include "VetoPanelSummary.hh"
+#include "VetoLog.hh"
+#include "VetoSynth.hh"
+
+// One decoded veto entry.
+// The getters mirror MJVetoEvent so the scan loops read the same either way.
+// Hardware errors 0-17 (checked by WriteEvent) are packed into hwErrors.
+class VetoRecord
+{
+  public:
+    long entry;
+    int qdc[32];
+    double timeSec, timeSBC;
+    long scalerIndex, qdc1Index, qdc2Index;
+    int sec, qec, qec2;
+    uint32_t hwErrors;
+    bool badScaler;
+    PanelSummary panels;       // with respect to the cache's current SW thresholds and over-QDC value
+    const int *swThresh;
+
+    VetoRecord() { Clear(); }
+
+    void Clear() {
+      entry=0; timeSec=0; timeSBC=0;
+      scalerIndex=0; qdc1Index=0; qdc2Index=0;
+      sec=0; qec=0; qec2=0;
+      hwErrors=0; badScaler=false;
+      panels = PanelSummary(); swThresh=0;
+      for (int q = 0; q < 32; q++) qdc[q] = 0;
+    }
+
+    int GetEntry() const { return (int)entry; }
+    int GetQDC(int q) const { return qdc[q]; }
+    int GetSWThresh(int q) const { return swThresh ? swThresh[q] : 0; }
+    int GetMultip() const { return panels.multip; }
+    int GetTotE() const { return panels.hitQDC; }
+    uint32_t GetHitMask() const { return panels.hitMask; }
+    int GetOverQDCCount() const { return panels.overN; }
+    double GetTimeSec() const { return timeSec; }
+    double GetTimeSBC() const { return timeSBC; }
+    long GetScalerIndex() const { return scalerIndex; }
+    long GetQDC1Index() const { return qdc1Index; }
+    long GetQDC2Index() const { return qdc2Index; }
+    int GetSEC() const { return sec; }
+    int GetQEC() const { return qec; }
+    int GetQEC2() const { return qec2; }
+    bool GetBadScaler() const { return badScaler; }
+    bool GetError(int i) const { return (hwErrors >> i) & 1; }
+};
+
+class VetoRunCache
+{
+  public:
+
+    VetoRunCache(TChain *vetoChain) :
+      fChain(vetoChain), fReader(vetoChain),
+      fBits(fReader,"vetoBits"), fEvt(fReader,"vetoEvent"), fRun(fReader,"run"),
+      fTimeStart(fReader,"fStartTime"), fTimeStop(fReader,"fStopTime"),
+      fCached(false), fAtEnd(false), fPos(0), fLastDecoded(-1), fOverQDC(500), fSynth(false), fBuiltEntries(0)
+    {
+      for (int q = 0; q < 32; q++) fSWThresh[q] = 1;
+      fTreeBytes = PruneVetoTree(fChain);
+      fEntries = fChain->GetEntries();
+      fReader.SetEntry(0);
+      fRunNum = fRun->GetRunNumber();
+      fStart = (*fTimeStart);
+      fStop = (*fTimeStop);
+    }
+
+    // Synthetic run (a .vsyn file from veto-gen), fully cached on construction.
+    // There's no VetoTree behind it, so Load() does nothing and FillEvent() can't be used.
+    // GetEntries() is 0 if the file couldn't be read.
+    // With follow, the file may still be growing: no entries are read until AppendSynth().
+    explicit VetoRunCache(const std::string &synthFile, bool follow=false) :
+      fChain(0), fReader(),
+      fBits(fReader,"vetoBits"), fEvt(fReader,"vetoEvent"), fRun(fReader,"run"),
+      fTimeStart(fReader,"fStartTime"), fTimeStop(fReader,"fStopTime"),
+      fCached(false), fAtEnd(true), fEntries(0), fPos(0), fLastDecoded(-1), fRunNum(0), fStart(0), fStop(0),
+      fOverQDC(500), fSynth(true), fSynthFile(synthFile), fBuiltEntries(0)
+    {
+      for (int q = 0; q < 32; q++) fSWThresh[q] = 1;
+      VetoSynthFile in;
+      if (!in.Open(synthFile)) return;
+      const VetoSynthHeader &hdr = in.GetHeader();
+      fRunNum = hdr.run;
+      fStart = hdr.start;
+      fStop = hdr.stop;
+      SetSynthGeIndex(synthFile, hdr.builtEntries);
+      fCached = true;
+      if (follow) return;
+
+      AppendSynth(hdr.entries);
+      if (fEntries < hdr.entries) vlogf("Warning: %s ends after %li of %lli entries.\n",synthFile.c_str(),fEntries,(long long)hdr.entries);
+    }
+
+    long GetEntries() const { return fEntries; }
+    int GetRunNumber() const { return fRunNum; }
+    long GetStartTime() const { return fStart; }
+    long GetStopTime() const { return fStop; }
+    bool IsCached() const { return fCached; }
+    TChain *GetChain() const { return fChain; }  // 0 for a .vsyn run
+
+    // Synthetic runs come with their Ge packet/timestamp index (GeTimeIndex format),
+    // veto_run%i.geidx next to the run file.  Built files from veto-gen (VetoSynthTree.hh)
+    // are read like any other, so for the older ones without a Ge stream it's set from outside.
+    void SetSynthGeIndex(const std::string &runFile, long builtEntries)
+    {
+      size_t slash = runFile.find_last_of('/');
+      std::string dir = (slash == std::string::npos) ? "." : runFile.substr(0, slash);
+      fGeIndexFile = dir + "/veto_run" + std::to_string(fRunNum) + ".geidx";
+      fBuiltEntries = builtEntries;
+    }
+    bool HasSynthGeIndex() const { return !fGeIndexFile.empty(); }
+
+    // Built files from veto-gen with a Ge stream (an MGTree, as in the built data)
+    // are their own built chain, instead of the one GATDataSet finds for the run.
+    void SetSynthBuilt() { fSynthBuilt = true; }
+    bool IsSynthBuilt() const { return fSynthBuilt; }
+
+    // A .vsyn run: the columns are all there is (no VetoTree, no MJVetoEvent).
+    bool IsSynthetic() const { return fSynth; }
+    std::string GetGeIndexFile() const { return fGeIndexFile; }
+    long GetBuiltEntries() const { return fBuiltEntries; }
+    VetoTreeBytes GetTreeBytes() const { return fTreeBytes; }
+
+    // ======== Follow mode ========
+
+    // Built data: empty the columns, and decode with run-based card numbers from now on.
+    void StartFollow(int card1, int card2)
+    {
+      fVeto = MJVetoEvent(card1,card2);
+      Resize(0);
+      fEntries = 0;
+      fCached = true;
+      fAtEnd = true;
+    }
+
+    // Built data: decode the entries of a freshly opened chain on the growing file
+    // that came after the ones we have.  The cache reads from this chain from now on,
+    // so the old one can be deleted.  Returns the number of new entries.
+    long Append(TChain *vetoChain)
+    {
+      long n = vetoChain->GetEntries();
+      if (n <= fEntries) return 0;
+      if (vetoChain != fChain) PruneVetoTree(vetoChain);
+      fChain = vetoChain;
+      ResetReader();
+      Resize(n);
+      for (long i = fEntries; i < n; i++) {
+        fReader.SetEntry(i);
+        Decode(i);
+        Store(i);
+      }
+      fAtEnd = true;
+      long nNew = n - fEntries;
+      fEntries = n;
+      return nNew;
+    }
+
+    // Synthetic run: read the complete rows written since the last call (at most maxEntries in all).
+    long AppendSynth(long maxEntries=-1)
+    {
+      std::ifstream in(fSynthFile.c_str(), std::ios::binary);
+      if (!in) return 0;
+      in.seekg(0, std::ios::end);
+      long n = ((long)in.tellg() - (long)sizeof(VetoSynthHeader)) / (long)sizeof(VetoSynthRow);
+      if (maxEntries >= 0 && n > maxEntries) n = maxEntries;
+      if (n <= fEntries) return 0;
+      in.seekg(sizeof(VetoSynthHeader) + fEntries*sizeof(VetoSynthRow));
+      Resize(n);
+      std::vector<VetoSynthRow> rows(4096);
+      long i = fEntries;
+      while (i < n) {
+        long nRead = std::min((long)rows.size(), n - i);
+        if (!in.read((char*)rows.data(), nRead*sizeof(VetoSynthRow))) break;
+        for (long r = 0; r < nRead; r++, i++) StoreSynth(i, rows[r]);
+      }
+      if (i < n) Resize(i);
+      long nNew = i - fEntries;
+      fEntries = i;
+      return nNew;
+    }
+
+    static double BytesPerEntry() {
+      return 32*sizeof(uint16_t) + 2*sizeof(double) + 4*sizeof(long) + 3*sizeof(int)
+        + sizeof(uint32_t) + sizeof(char);
+    }
+
+    // Call before Load: also keep every decoded MJVetoEvent, for FillEvent.
+    // They're decoded with thresh, which should be the SW thresholds the output
+    // will be written with (or a close guess).  They count against Load's memory cap.
+    void KeepEvents(const int *thresh)
+    {
+      fKeepEvents = true;
+      for (int q = 0; q < 32; q++) fEventThresh[q] = thresh[q];
+    }
+
+    // Call before Load, instead of KeepEvents, when the thresholds aren't known yet.
+    // Load guesses them from the first kGuessEntries entries it decodes (each panel's
+    // most common low QDC plus threshVal, as FindThreshold does), and keeps the events
+    // it decodes after that.  FillEvent reads the first ones again.
+    void KeepEventsGuessed(int threshVal)
+    {
+      fKeepEvents = true;
+      fGuessThresh = threshVal;
+      for (int q = 0; q < 32; q++) fEventThresh[q] = 9999;
+    }
+
+    // FillEvent calls that had to read and decode the entry again.
+    long GetRedecoded() const { return fRedecoded; }
+
+    // Thresholds used to compute multiplicity and total QDC of each record.
+    void SetSWThresh(const int *thresh) {
+      for (int q = 0; q < 32; q++) fSWThresh[q] = thresh[q];
+    }
+
+    // Panels with QDC above this value are counted in GetOverQDCCount() (default 500).
+    void SetOverQDC(int qdc) { fOverQDC = qdc; }
+
+    // Start a new pass over the run.
+    void Rewind() {
+      fPos = 0;
+      if (!fCached) ResetReader();
+    }
+
+    // Get the next entry of the current pass.  Returns false at the end of the run.
+    bool Next(VetoRecord &rec)
+    {
+      if (fCached) {
+        if (fPos >= fEntries) return false;
+        Get(fPos++, rec);
+        return true;
+      }
+      if (fAtEnd || !fReader.Next()) { fAtEnd = true; return false; }
+      Decode(fReader.GetCurrentEntry());
+      Copy(rec);
+      return true;
+    }
+
+    // Random access.  In streaming mode this moves the reader,
+    // so call Rewind() before starting the next pass.
+    bool Read(long i, VetoRecord &rec)
+    {
+      if (i < 0 || i >= fEntries) return false;
+      if (fCached) { Get(i, rec); return true; }
+      Seek(i);
+      Copy(rec);
+      return true;
+    }
+
+    // Full MJVetoEvent for entry i (with the current SW thresholds),
+    // for writing to the output tree.  A kept event (KeepEvents) is used if the
+    // current thresholds give it the same panel hits as the ones it was decoded
+    // with: MJVetoEvent only uses them to compare each QDC with its panel's
+    // threshold.  In streaming mode this reuses the decode from Next().
+    // Otherwise the single entry is re-read.
+    void FillEvent(long i, MJVetoEvent &out)
+    {
+      if (fCached && i >= fEventsFrom && i - fEventsFrom < (long)fEvents.size() && SameHits(i)) {
+        out = fEvents[i - fEventsFrom];
+        out.SetSWThresh(fSWThresh);
+        return;
+      }
+      if (fLastDecoded != i) {
+        Seek(i);
+        fRedecoded++;
+      }
+      out = fVeto;
+    }
+
+    // Decode the run with run-based QDC card numbers.
+    // maxMB is the memory cap for the columns.  Use 0 to always read the tree.
+    void Load(int card1, int card2, double maxMB=512)
+    {
+      if (fSynth) return;
+      fVeto = MJVetoEvent(card1,card2);
+      double needMB = BytesPerEntry() * fEntries / (1024.*1024.);
+      if (needMB > maxMB) {
+        vlogf("Run needs %.1f MB to cache (cap %.0f MB).  Reading VetoTree on every pass.\n",needMB,maxMB);
+        fCached = false;
+        ResetReader();
+        return;
+      }
+      double eventMB = sizeof(MJVetoEvent) * (double)fEntries / (1024.*1024.);
+      if (fKeepEvents && needMB + eventMB > maxMB) {
+        vlogf("Run needs %.1f MB to keep its decoded events (cap %.0f MB).  Re-reading them for the output.\n",
+          needMB + eventMB, maxMB);
+        fKeepEvents = false;
+      }
+      Resize(fEntries);
+
+      // The kept events are decoded with their own thresholds.  The columns don't depend on them.
+      // With guessed thresholds, the events before the guess aren't kept.
+      int thresh[32];
+      std::memcpy(thresh, fSWThresh, sizeof(thresh));
+      fEventsFrom = 0;
+      if (fKeepEvents) {
+        if (fGuessThresh >= 0) fEventsFrom = std::min(fEntries, (long)kGuessEntries);
+        else SetSWThresh(fEventThresh);
+        fEvents.clear();
+        fEvents.reserve(fEntries - fEventsFrom);
+      }
+      ResetReader();
+      while (fReader.Next())
+      {
+        long i = fReader.GetCurrentEntry();
+        if (fKeepEvents && fEventsFrom > 0 && i == fEventsFrom) {
+          GuessThresh(fEventsFrom);
+          SetSWThresh(fEventThresh);
+        }
+        Decode(i);
+        Store(i);
+        if (fKeepEvents && i >= fEventsFrom) fEvents.push_back(fVeto);
+      }
+      SetSWThresh(thresh);
+      fAtEnd = true;
+      fCached = true;
+    }
+
+  private:
+    TChain *fChain;
+    TTreeReader fReader;
+    TTreeReaderValue<uint32_t> fBits;
+    TTreeReaderValue<MGTBasicEvent> fEvt;
+    TTreeReaderValue<MJTRun> fRun;
+    MJTRun *fRunInfo = 0;   // fRun, as of the last time it was read
+    int fRunTree = -1;      // file of the chain it was read from
+    VetoTreeBytes fTreeBytes;
+    TTreeReaderValue<long> fTimeStart;
+    TTreeReaderValue<long> fTimeStop;
+    MJVetoEvent fVeto;
+
+    bool fCached, fAtEnd;
+    long fEntries, fPos, fLastDecoded;
+    int fRunNum;
+    long fStart, fStop;
+    int fSWThresh[32];
+    int fOverQDC;
+    bool fSynth;
+    std::string fSynthFile, fGeIndexFile;
+    long fBuiltEntries;
+    bool fSynthBuilt = false;
+    bool fKeepEvents = false;
+    int fGuessThresh = -1;              // KeepEventsGuessed's threshVal
+    int fEventThresh[32];               // SW thresholds of the kept events
+    std::vector<MJVetoEvent> fEvents;   // kept events, one per entry from fEventsFrom
+    long fEventsFrom = 0;
+    static const long kGuessEntries = 2000;
+    long fRedecoded = 0;
+
+    // columns
+    std::vector<uint16_t> fQDC;   // 32 per entry (12-bit QDC)
+    std::vector<double> fTimeSec, fTimeSBC;
+    std::vector<long> fScalerIndex, fQDC1Index, fQDC2Index;
+    std::vector<int> fSEC, fQEC, fQEC2;
+    std::vector<uint32_t> fHWErrors;
+    std::vector<char> fBadScaler;
+
+    void Resize(long n) {
+      fQDC.resize(32*n);
+      fTimeSec.resize(n);
+      fTimeSBC.resize(n);
+      fScalerIndex.resize(n);
+      fQDC1Index.resize(n);
+      fQDC2Index.resize(n);
+      fSEC.resize(n);
+      fQEC.resize(n);
+      fQEC2.resize(n);
+      fHWErrors.resize(n);
+      fBadScaler.resize(n);
+    }
+
+    void ResetReader() {
+      fReader.SetTree(fChain);
+      fAtEnd = false;
+      fLastDecoded = -1;
+      fRunInfo = 0;
+    }
+
+    // The run object is the same for every entry in a file, so it's only read
+    // for the first entry decoded from each file.
+    MJTRun *RunInfo() {
+      int tree = fChain->GetTreeNumber();
+      if (!fRunInfo || tree != fRunTree) {
+        fRunInfo = &*fRun;
+        fRunTree = tree;
+      }
+      return fRunInfo;
+    }
+
+    void Seek(long i) {
+      if (fAtEnd) ResetReader();
+      fReader.SetEntry(i);
+      Decode(i);
+    }
+
+    void Decode(long i) {
+      fVeto.Clear();
+      fVeto.SetSWThresh(fSWThresh);
+      fVeto.WriteEvent(i,RunInfo(),&*fEvt,*fBits,fRunNum,true);
+      fLastDecoded = i;
+    }
+
+    // the decoded MJVetoEvent into row i of the columns
+    void Store(long i)
+    {
+      for (int q = 0; q < 32; q++) fQDC[32*i+q] = (uint16_t)fVeto.GetQDC(q);
+      fTimeSec[i] = fVeto.GetTimeSec();
+      fTimeSBC[i] = fVeto.GetTimeSBC();
+      fScalerIndex[i] = fVeto.GetScalerIndex();
+      fQDC1Index[i] = fVeto.GetQDC1Index();
+      fQDC2Index[i] = fVeto.GetQDC2Index();
+      fSEC[i] = fVeto.GetSEC();
+      fQEC[i] = fVeto.GetQEC();
+      fQEC2[i] = fVeto.GetQEC2();
+      fHWErrors[i] = PackErrors();
+      fBadScaler[i] = fVeto.GetBadScaler();
+    }
+
+    void StoreSynth(long i, const VetoSynthRow &row)
+    {
+      for (int q = 0; q < 32; q++) fQDC[32*i+q] = row.qdc[q];
+      fTimeSec[i] = row.timeSec;
+      fTimeSBC[i] = row.timeSBC;
+      fScalerIndex[i] = row.scalerIndex;
+      fQDC1Index[i] = row.qdc1Index;
+      fQDC2Index[i] = row.qdc2Index;
+      fSEC[i] = row.sec;
+      fQEC[i] = row.qec;
+      fQEC2[i] = row.qec2;
+      fHWErrors[i] = row.hwErrors;
+      fBadScaler[i] = row.badScaler;
+    }
+
+    uint32_t PackErrors() {
+      uint32_t bits = 0;
+      for (int e = 0; e < 18; e++) if (fVeto.GetError(e)) bits |= (1u << e);
+      return bits;
+    }
+
+    // streaming mode: copy the decoded MJVetoEvent into a record
+    void Copy(VetoRecord &rec)
+    {
+      rec.entry = fLastDecoded;
+      for (int q = 0; q < 32; q++) rec.qdc[q] = fVeto.GetQDC(q);
+      rec.timeSec = fVeto.GetTimeSec();
+      rec.timeSBC = fVeto.GetTimeSBC();
+      rec.scalerIndex = fVeto.GetScalerIndex();
+      rec.qdc1Index = fVeto.GetQDC1Index();
+      rec.qdc2Index = fVeto.GetQDC2Index();
+      rec.sec = fVeto.GetSEC();
+      rec.qec = fVeto.GetQEC();
+      rec.qec2 = fVeto.GetQEC2();
+      rec.hwErrors = PackErrors();
+      rec.badScaler = fVeto.GetBadScaler();
+      SetMultip(rec);
+    }
+
+    // cached mode: gather one row of the columns into a record
+    void Get(long i, VetoRecord &rec)
+    {
+      rec.entry = i;
+      const uint16_t *q32 = &fQDC[32*i];
+      for (int q = 0; q < 32; q++) rec.qdc[q] = q32[q];
+      rec.timeSec = fTimeSec[i];
+      rec.timeSBC = fTimeSBC[i];
+      rec.scalerIndex = fScalerIndex[i];
+      rec.qdc1Index = fQDC1Index[i];
+      rec.qdc2Index = fQDC2Index[i];
+      rec.sec = fSEC[i];
+      rec.qec = fQEC[i];
+      rec.qec2 = fQEC2[i];
+      rec.hwErrors = fHWErrors[i];
+      rec.badScaler = fBadScaler[i];
+      SetMultip(rec);
+    }
+
+    // KeepEventsGuessed: the thresholds of the kept events, from the pedestals of
+    // entries [0,n) of the columns.  Like FindThreshold: the first QDC seen more than
+    // once, the most common QDC from 10 below it to 50 above, plus fGuessThresh.
+    void GuessThresh(long n)
+    {
+      std::vector<long> count(500);
+      for (int q = 0; q < 32; q++) {
+        fEventThresh[q] = 9999;
+        if (fRunNum > 45000000 && q > 23) continue;
+        std::fill(count.begin(), count.end(), 0);
+        for (long i = 0; i < n; i++)
+          if (fQDC[32*i+q] < 500) count[fQDC[32*i+q]]++;
+        int first = 0;
+        while (first < 500 && count[first] <= 1) first++;
+        if (first == 500) continue;
+        int mode = std::max(first-10, 0);
+        for (int k = mode; k < std::min(first+51, 500); k++) if (count[k] > count[mode]) mode = k;
+        fEventThresh[q] = mode + fGuessThresh;
+      }
+    }
+
+    // The kept event i has the hits it would have with the current thresholds
+    bool SameHits(long i) const
+    {
+      if (std::memcmp(fEventThresh, fSWThresh, sizeof(fSWThresh)) == 0) return true;
+      int qdc[32];
+      for (int q = 0; q < 32; q++) qdc[q] = fQDC[32*i+q];
+      PanelSummary kept, now;
+      SummarizePanels(qdc, fEventThresh, fOverQDC, kept);
+      SummarizePanels(qdc, fSWThresh, fOverQDC, now);
+      return kept.hitMask == now.hitMask;
+    }
+
+    // Multiplicity and total QDC count panels over the SW threshold (same as MJVetoEvent).
+    void SetMultip(VetoRecord &rec)
+    {
+      rec.swThresh = fSWThresh;
+      SummarizePanels(rec.qdc,fSWThresh,fOverQDC,rec.panels);
+    }
+};
+
+#endif
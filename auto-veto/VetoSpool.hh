@@ -0,0 +1,205 @@
+// VetoSpool.hh
+// The job queue between the auto-veto daemon (auto-veto -D) and veto-submit.
+// It's a spool directory with one small text file per job:
+//   queue/[id].job     submitted and waiting.  Written as a .tmp file, then renamed in.
+//   running/[id].job   claimed by a daemon worker (renamed out of queue/, so only one worker gets it)
+//   done/[id].done     finished: the job, with its status and timing
+//   done/[id].log      the job's console output
+//   daemon.pid         the running daemon
+//   stop               makes the daemon exit once its running jobs are done
+// Job ids start with the submit time in ms, so sorting them gives the queue order.
+// Nothing here needs ROOT, so the client stays small.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOSPOOL_HH_GUARD
+#define VETOSPOOL_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+
+struct VetoSpoolJob
+{
+  std::string id;
+  int run = 0;
+  std::string path;       // run file.  empty: the daemon looks the run up (GATDataSet)
+  bool synth = false;     // path is a synthetic run from veto-gen (built or .vsyn file)
+  std::string outputDir;  // empty: the daemon's output directory
+  double submitted = 0, started = 0, finished = 0;  // unix time
+  int status = -1;        // ProcessRun's return value.  -1: not finished
+  bool warmPath = false;  // the run path came from the daemon's lookup cache
+
+  double WaitSec() const { return started - submitted; }
+  double ProcSec() const { return finished - started; }
+  double LatencySec() const { return finished - submitted; }
+};
+
+class VetoSpool
+{
+  public:
+    explicit VetoSpool(std::string dir) : fDir(dir) {
+      while (fDir.size() > 1 && fDir.back() == '/') fDir.pop_back();
+    }
+
+    std::string GetDir() const { return fDir; }
+
+    // Make the spool directories if they aren't there.
+    bool Init() const
+    {
+      const char *sub[] = {"", "/queue", "/running", "/done"};
+      for (auto s : sub) {
+        std::string d = fDir + s;
+        if (mkdir(d.c_str(), 0775) != 0 && errno != EEXIST) return false;
+      }
+      return true;
+    }
+
+    static double Now()
+    {
+      struct timeval tv;
+      gettimeofday(&tv, 0);
+      return tv.tv_sec + tv.tv_usec*1e-6;
+    }
+
+    // Queue a job.  Sets its id and submit time.
+    bool Submit(VetoSpoolJob &job) const
+    {
+      static int count = 0;
+      job.submitted = Now();
+      char id[64];
+      snprintf(id, sizeof(id), "%013lld-%d-%d", (long long)(job.submitted*1000), (int)getpid(), count++);
+      job.id = id;
+      std::string tmp = fDir + "/queue/" + job.id + ".tmp";
+      if (!Write(tmp, job)) return false;
+      return rename(tmp.c_str(), JobFile("queue", job.id).c_str()) == 0;
+    }
+
+    // Take the oldest queued job.  False if the queue is empty.
+    bool Claim(VetoSpoolJob &job) const
+    {
+      for (auto &id : List("queue", ".job")) {
+        std::string running = JobFile("running", id);
+        if (rename(JobFile("queue", id).c_str(), running.c_str()) != 0) continue;  // another worker got it
+        if (Read(running, job)) return true;
+        remove(running.c_str());  // unreadable, drop it
+      }
+      return false;
+    }
+
+    // Record a finished job and its output.
+    bool Finish(const VetoSpoolJob &job, const std::string &log) const
+    {
+      std::ofstream out((fDir + "/done/" + job.id + ".log").c_str());
+      out << log;
+      std::string tmp = fDir + "/done/" + job.id + ".tmp";
+      bool ok = Write(tmp, job) && rename(tmp.c_str(), (fDir + "/done/" + job.id + ".done").c_str()) == 0;
+      remove(JobFile("running", job.id).c_str());
+      return ok;
+    }
+
+    // Is job id finished?  Fills job from its done file.
+    bool Done(const std::string &id, VetoSpoolJob &job) const { return Read(fDir + "/done/" + id + ".done", job); }
+
+    std::string LogFile(const std::string &id) const { return fDir + "/done/" + id + ".log"; }
+
+    // Put jobs left running by a daemon that died back in the queue.
+    int Requeue() const
+    {
+      int n = 0;
+      for (auto &id : List("running", ".job"))
+        if (rename(JobFile("running", id).c_str(), JobFile("queue", id).c_str()) == 0) n++;
+      return n;
+    }
+
+    int Queued() const { return (int)List("queue", ".job").size(); }
+
+    bool StopRequested() const { return access((fDir + "/stop").c_str(), F_OK) == 0; }
+    void ClearStop() const { remove((fDir + "/stop").c_str()); }
+
+    // The daemon's pid file.  DaemonRunning() is false if there's none, or its process is gone.
+    bool WritePid() const
+    {
+      std::ofstream out((fDir + "/daemon.pid").c_str());
+      out << getpid() << std::endl;
+      return out.good();
+    }
+    void RemovePid() const { remove((fDir + "/daemon.pid").c_str()); }
+    bool DaemonRunning() const
+    {
+      std::ifstream in((fDir + "/daemon.pid").c_str());
+      int pid = 0;
+      if (!(in >> pid) || pid <= 0) return false;
+      return kill(pid, 0) == 0 || errno == EPERM;
+    }
+
+  private:
+    std::string fDir;
+
+    std::string JobFile(const char *sub, const std::string &id) const { return fDir + "/" + sub + "/" + id + ".job"; }
+
+    // Sorted ids of the files in a spool subdirectory with this extension.
+    std::vector<std::string> List(const char *sub, const std::string &ext) const
+    {
+      std::vector<std::string> ids;
+      DIR *d = opendir((fDir + "/" + sub).c_str());
+      if (!d) return ids;
+      while (dirent *ent = readdir(d)) {
+        std::string name = ent->d_name;
+        if (name.size() <= ext.size() || name.compare(name.size()-ext.size(), ext.size(), ext) != 0) continue;
+        ids.push_back(name.substr(0, name.size()-ext.size()));
+      }
+      closedir(d);
+      std::sort(ids.begin(), ids.end());
+      return ids;
+    }
+
+    // One "key value" per line.  Paths can't contain newlines.
+    static bool Write(const std::string &fileName, const VetoSpoolJob &job)
+    {
+      FILE *f = fopen(fileName.c_str(), "w");
+      if (!f) return false;
+      fprintf(f, "id %s\nrun %i\nsynth %i\nsubmitted %.3f\n", job.id.c_str(), job.run, (int)job.synth, job.submitted);
+      if (!job.path.empty()) fprintf(f, "path %s\n", job.path.c_str());
+      if (!job.outputDir.empty()) fprintf(f, "output %s\n", job.outputDir.c_str());
+      if (job.status >= 0)
+        fprintf(f, "started %.3f\nfinished %.3f\nstatus %i\nwarmPath %i\n", job.started, job.finished, job.status, (int)job.warmPath);
+      return fclose(f) == 0;
+    }
+
+    static bool Read(const std::string &fileName, VetoSpoolJob &job)
+    {
+      std::ifstream in(fileName.c_str());
+      if (!in) return false;
+      job = VetoSpoolJob();
+      std::string line;
+      while (getline(in, line)) {
+        size_t sp = line.find(' ');
+        if (sp == std::string::npos) continue;
+        std::string key = line.substr(0, sp), val = line.substr(sp+1);
+        if (key == "id") job.id = val;
+        else if (key == "run") job.run = atoi(val.c_str());
+        else if (key == "synth") job.synth = atoi(val.c_str()) != 0;
+        else if (key == "path") job.path = val;
+        else if (key == "output") job.outputDir = val;
+        else if (key == "submitted") job.submitted = atof(val.c_str());
+        else if (key == "started") job.started = atof(val.c_str());
+        else if (key == "finished") job.finished = atof(val.c_str());
+        else if (key == "status") job.status = atoi(val.c_str());
+        else if (key == "warmPath") job.warmPath = atoi(val.c_str()) != 0;
+      }
+      return !job.id.empty();
+    }
+};
+
+#endif
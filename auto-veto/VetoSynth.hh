@@ -0,0 +1,470 @@
+// VetoSynth.hh
+// Synthetic veto runs for load and scaling tests (see veto-gen.cc).
+//
+// The entries of a run are generated in time order: LED pulses (with jitter),
+// muons hitting a chosen pattern of planes, and single-panel background hits,
+// all on top of per-panel pedestals.  Faults can be injected: bad scalers,
+// buffer flushes (error 25), scaler jumps (error 18), SEC/QEC resets
+// (errors 19, 21, 23) and missing QDC cards (error 1).  Ge events are numbered
+// in the same ORCA packet sequence, so the veto-Ge sync and the bad-scaler
+// interpolation have something to match against.
+//
+// Entries are generated as decoded records (the columns VetoRunCache holds), and
+// Generate() hands them to a writer:
+//   OR_run%i.root     : a built file, VetoTree with MGTBasicEvent/MJTVetoData, and the
+//                       Ge stream as an MGTree of MGTEvents (VetoSynthTree.hh)
+//   synth_run%i.vsyn  : VetoSynthHeader, then one VetoSynthRow per entry (VetoSynthRecordWriter)
+//   veto_run%i.geidx  : the Ge packet/timestamp index, in GeTimeIndex's sidecar format
+// The built file goes through the same MJVetoEvent decode as real runs.  The .vsyn
+// file needs neither ROOT nor MGDO, and is what veto-bench and veto-replay -x read.
+// auto-veto -g takes either one.  A built file is its own built chain, and a .vsyn
+// file has the .geidx in place of the built Ge data.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOSYNTH_HH_GUARD
+#define VETOSYNTH_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "VetoGeometry.hh"
+
+struct VetoSynthHeader {
+  char magic[8];               // "VETOSYN1", file format version
+  int32_t run, pad;
+  int64_t start, stop;         // unix times, like the fStartTime/fStopTime branches
+  int64_t entries;             // veto entries (rows)
+  int64_t builtEntries;        // Ge events in the matching .geidx
+};
+
+// One veto entry, as MJVetoEvent::WriteEvent would decode it.
+struct VetoSynthRow {
+  double timeSec, timeSBC;
+  int64_t scalerIndex, qdc1Index, qdc2Index;
+  int32_t sec, qec, qec2;
+  uint32_t hwErrors;           // errors 0-17, bit i = error i
+  uint16_t qdc[32];
+  uint8_t badScaler, pad[7];
+};
+static_assert(sizeof(VetoSynthRow) == 128, "VetoSynthRow must have no hidden padding");
+
+// A muon hits one installed panel in each plane of a pattern.
+struct VetoSynthPattern {
+  uint16_t planes;   // bit p: plane p (plane numbering is in VetoGeometry.hh)
+  double weight;
+};
+
+// What the last VetoSynth::Generate() wrote.
+struct VetoSynthCounts {
+  long entries = 0, LED = 0, muon = 0, bg = 0, ge = 0;
+  long badScaler = 0, missingCard = 0, flushed = 0;
+};
+
+struct VetoSynthConfig {
+  int run = 20000;
+  double duration = 3600;       // sec
+  long startUnix = 1500000000;
+  double LEDfreq = 0.2;         // Hz
+  double LEDjitter = 0.002;     // sec (rms)
+  double muRate = 0.01;         // Hz
+  double bgRate = 0;            // Hz per panel.  0: the run's reference hit rates (VetoGeometry)
+  double geRate = 5;            // Hz of built (Ge) events
+  double geOffset = 0;          // Ge clock minus scaler clock (sec)
+  double pedestal[32] = {0};    // QDC.  0: random between 80 and 160
+  double pedWidth = 3;
+  std::vector<VetoSynthPattern> patterns;  // empty: DefaultPatterns()
+
+  // injected faults
+  double badScalerFrac = 0;     // fraction of entries with a bad scaler
+  double missingCardFrac = 0;   // fraction of entries missing one QDC card
+  int nFlush = 0, flushLen = 20;
+  int nJump = 0;
+  double jumpSize = 20;         // sec
+  int nReset = 0;
+  unsigned long seed = 1;
+
+  // Vertical, side+bottom and top+sides muons, for each side.
+  static std::vector<VetoSynthPattern> DefaultPatterns()
+  {
+    std::vector<VetoSynthPattern> pat;
+    pat.push_back({(uint16_t)0x000f, 5});   // bottom + top
+    for (int side = 4; side < 12; side += 2) {
+      pat.push_back({(uint16_t)(0x0003 | (3 << side)), 1});  // bottom + one side
+      pat.push_back({(uint16_t)(0x000c | (3 << side)), 1});  // top + one side
+    }
+    return pat;
+  }
+
+  // "0+1+2+3:5,0+1+4+5:1" -> plane lists with weights.  Returns false if it can't be parsed.
+  bool SetPatterns(const std::string &arg)
+  {
+    std::vector<VetoSynthPattern> pat;
+    size_t pos = 0;
+    while (pos < arg.size()) {
+      size_t end = arg.find(',', pos);
+      if (end == std::string::npos) end = arg.size();
+      std::string item = arg.substr(pos, end-pos);
+      pos = end+1;
+      size_t colon = item.find(':');
+      double w = (colon == std::string::npos) ? 1 : atof(item.substr(colon+1).c_str());
+      std::string planes = item.substr(0, colon);
+      uint16_t mask = 0;
+      size_t p = 0;
+      while (p < planes.size()) {
+        size_t plus = planes.find('+', p);
+        if (plus == std::string::npos) plus = planes.size();
+        int plane = atoi(planes.substr(p, plus-p).c_str());
+        if (plane < 0 || plane >= VetoGeo::nPlanes) return false;
+        mask |= (uint16_t)(1 << plane);
+        p = plus+1;
+      }
+      if (mask == 0 || w <= 0) return false;
+      pat.push_back({mask, w});
+    }
+    if (pat.empty()) return false;
+    patterns = pat;
+    return true;
+  }
+};
+
+inline bool IsVetoSynthRecordFile(const std::string &path)
+{
+  return path.size() > 5 && path.compare(path.size()-5, 5, ".vsyn") == 0;
+}
+
+// Writes .vsyn files, for VetoSynth::Generate.
+class VetoSynthRecordWriter
+{
+  public:
+    static std::string FileName(const std::string &dir, int run)
+    {
+      return dir + "/synth_run" + std::to_string(run) + ".vsyn";
+    }
+
+    bool Open(const std::string &dir, const VetoSynthHeader &hdr)
+    {
+      fFileName = FileName(dir, hdr.run);
+      fOut.open(fFileName.c_str(), std::ios::binary);
+      fOut.write((const char*)&hdr, sizeof(hdr));  // entries are filled in by Close()
+      return fOut.good();
+    }
+
+    bool Write(const std::vector<VetoSynthRow> &rows)
+    {
+      fOut.write((const char*)rows.data(), rows.size()*sizeof(VetoSynthRow));
+      return fOut.good();
+    }
+
+    // The .geidx is the Ge stream of a .vsyn run.
+    bool WriteGe(const std::vector<uint64_t> &index, const std::vector<double> &time) { return true; }
+
+    bool Close(const VetoSynthHeader &hdr)
+    {
+      fOut.seekp(0);
+      fOut.write((const char*)&hdr, sizeof(hdr));
+      if (!fOut.good()) return false;
+      fOut.close();
+      return true;
+    }
+
+    std::string GetFileName() const { return fFileName; }
+
+  private:
+    std::ofstream fOut;
+    std::string fFileName;
+};
+
+// Buffered reader for .vsyn files.
+class VetoSynthFile
+{
+  public:
+
+    bool Open(const std::string &fileName)
+    {
+      fIn.open(fileName.c_str(), std::ios::binary);
+      if (!fIn) return false;
+      fIn.read((char*)&fHeader, sizeof(fHeader));
+      if (!fIn || memcmp(fHeader.magic, "VETOSYN1", 8) != 0) return false;
+      fRead = 0;
+      fPos = fBuf.size();
+      return true;
+    }
+
+    const VetoSynthHeader &GetHeader() const { return fHeader; }
+
+    bool Next(VetoSynthRow &row)
+    {
+      if (fPos >= fBuf.size()) {
+        long n = std::min((long)4096, (long)(fHeader.entries - fRead));
+        if (n <= 0) return false;
+        fBuf.resize(n);
+        fIn.read((char*)fBuf.data(), n*sizeof(VetoSynthRow));
+        if (!fIn) return false;
+        fRead += n;
+        fPos = 0;
+      }
+      row = fBuf[fPos++];
+      return true;
+    }
+
+  private:
+    std::ifstream fIn;
+    VetoSynthHeader fHeader;
+    std::vector<VetoSynthRow> fBuf;
+    size_t fPos = 0;
+    long fRead = 0;
+};
+
+class VetoSynth
+{
+  public:
+
+    explicit VetoSynth(const VetoSynthConfig &cfg) : fCfg(cfg), fGeo(cfg.run), fRand(cfg.seed)
+    {
+      if (fCfg.patterns.empty()) fCfg.patterns = VetoSynthConfig::DefaultPatterns();
+      std::uniform_real_distribution<double> ped(80,160);
+      for (int q = 0; q < 32; q++) {
+        fPed[q] = fCfg.pedestal[q] > 0 ? fCfg.pedestal[q] : ped(fRand);
+        fBgRate[q] = 0;
+        if (!fGeo.IsInstalled(q)) continue;
+        fBgRate[q] = fCfg.bgRate > 0 ? fCfg.bgRate : fGeo.GetHitRateMean(q);
+        if (fBgRate[q] <= 0) fBgRate[q] = 0.05;
+      }
+    }
+
+    bool IsKnownRun() const { return fGeo.IsKnown(); }
+    const VetoSynthCounts &GetCounts() const { return fN; }
+
+    std::string GetGeIndexFile(const std::string &dir) const { return Name(dir,"veto_run%i.geidx"); }
+
+    // Write the run's entries to outDir with out (VetoSynthRecordWriter, or VetoSynthTree
+    // for a built file), and its .geidx.  out has Open(dir, header), Write(rows),
+    // WriteGe(packet indexes, times) and Close(header).
+    template <class Out> bool Generate(const std::string &outDir, Out &out)
+    {
+      fN = VetoSynthCounts();
+
+      VetoSynthHeader hdr;
+      memset(&hdr, 0, sizeof(hdr));
+      memcpy(hdr.magic, "VETOSYN1", 8);
+      hdr.run = fCfg.run;
+      hdr.start = fCfg.startUnix;
+      hdr.stop = fCfg.startUnix + (long)fCfg.duration;
+      if (!out.Open(outDir, hdr)) return false;
+
+      // fault schedules (sorted times within the run)
+      const double t0 = 10;   // scaler time of the run start
+      const double tEnd = t0 + fCfg.duration;
+      std::vector<double> flushT = Schedule(fCfg.nFlush, t0, tEnd);
+      std::vector<double> jumpT = Schedule(fCfg.nJump, t0, tEnd);
+      std::vector<double> resetT = Schedule(fCfg.nReset, t0, tEnd);
+      size_t iFlush = 0, iJump = 0, iReset = 0;
+
+      std::exponential_distribution<double> dMu(fCfg.muRate > 0 ? fCfg.muRate : 1);
+      double bgTot = 0;
+      for (int q = 0; q < 32; q++) bgTot += fBgRate[q];
+      std::exponential_distribution<double> dBg(bgTot > 0 ? bgTot : 1);
+      std::exponential_distribution<double> dGe(fCfg.geRate > 0 ? fCfg.geRate : 1);
+      std::normal_distribution<double> gaus(0,1);
+      std::uniform_real_distribution<double> flat(0,1);
+      std::discrete_distribution<int> bgPanel(fBgRate, fBgRate+32);
+      std::vector<double> patW;
+      for (auto &p : fCfg.patterns) patW.push_back(p.weight);
+      std::discrete_distribution<int> pattern(patW.begin(), patW.end());
+
+      const double never = 1e300;
+      double LEDperiod = fCfg.LEDfreq > 0 ? 1./fCfg.LEDfreq : never;
+      long kLED = 1;
+      double tLED = fCfg.LEDfreq > 0 ? t0 + LEDperiod*flat(fRand) : never;
+      double tMu = fCfg.muRate > 0 ? t0 + dMu(fRand) : never;
+      double tBg = bgTot > 0 ? t0 + dBg(fRand) : never;
+      double tGe = fCfg.geRate > 0 ? t0 + dGe(fRand) : never;
+      double tLEDBase = tLED;
+
+      std::vector<uint64_t> geIndex;
+      std::vector<double> geTime, geHeld;   // Ge events held back during a buffer flush
+      std::vector<VetoSynthRow> buf;
+      buf.reserve(4096);
+
+      int64_t pkt = 1;
+      int32_t sec = 1, qec = 1, qec2 = 1;
+      double jumpOffset = 0, sbcFrozen = 0;
+      int flushLeft = 0;
+      double tPrev = t0;
+
+      while (true)
+      {
+        // next thing to happen: 0 LED, 1 muon, 2 background, 3 Ge
+        double next[4] = {tLED, tMu, tBg, tGe};
+        int kind = (int)(std::min_element(next, next+4) - next);
+        double t = next[kind];
+        if (t >= tEnd) break;
+        if (t < tPrev) t = tPrev;  // LED jitter can't reorder the stream
+        tPrev = t;
+
+        // Ge event: its own packet, or held until the flush is read out
+        if (kind == 3) {
+          if (flushLeft > 0) geHeld.push_back(t + fCfg.geOffset);
+          else { geIndex.push_back(pkt++); geTime.push_back(t + fCfg.geOffset); }
+          fN.ge++;
+          tGe += dGe(fRand);
+          continue;
+        }
+
+        // faults that start at this time
+        while (iFlush < flushT.size() && flushT[iFlush] <= t) { flushLeft = fCfg.flushLen; sbcFrozen = t; iFlush++; }
+        while (iJump < jumpT.size() && jumpT[iJump] <= t) { jumpOffset += fCfg.jumpSize; iJump++; }
+        int resetCounter = -1;
+        while (iReset < resetT.size() && resetT[iReset] <= t) { resetCounter = (int)(3*flat(fRand)); iReset++; }
+
+        VetoSynthRow row;
+        memset(&row, 0, sizeof(row));
+        for (int q = 0; q < 32; q++) row.qdc[q] = Clamp(fPed[q] + fCfg.pedWidth*gaus(fRand));
+
+        if (kind == 0) {
+          for (int q = 0; q < 32; q++) {
+            if (!fGeo.IsInstalled(q)) continue;
+            double mean = fGeo.HasReference() ? fGeo.GetQDCMean(q) : fPed[q] + 1400;
+            double sig = fGeo.HasReference() ? fGeo.GetQDCSigma(q) : 80;
+            row.qdc[q] = Clamp(mean + sig*gaus(fRand));
+          }
+          fN.LED++;
+          kLED++;
+          tLED = tLEDBase + (kLED-1)*LEDperiod + fCfg.LEDjitter*gaus(fRand);
+        }
+        else if (kind == 1) {
+          uint16_t planes = fCfg.patterns[pattern(fRand)].planes;
+          for (int p = 0; p < VetoGeo::nPlanes; p++) {
+            if (!((planes >> p) & 1)) continue;
+            int q = PanelInPlane(p, flat(fRand));
+            if (q >= 0) row.qdc[q] = Clamp(fPed[q] + 600 + 800*(-log(1-flat(fRand))));
+          }
+          fN.muon++;
+          tMu += dMu(fRand);
+        }
+        else {
+          int q = bgPanel(fRand);
+          row.qdc[q] = Clamp(fPed[q] + 40 + 150*(-log(1-flat(fRand))));
+          fN.bg++;
+          tBg += dBg(fRand);
+        }
+
+        // hardware counters and packet numbers
+        row.sec = sec++;
+        row.qec = qec++;
+        row.qec2 = qec2++;
+        if (resetCounter == 0) { row.sec = 0; sec = 1; }
+        if (resetCounter == 1) { row.qec = 0; qec = 1; }
+        if (resetCounter == 2) { row.qec2 = 0; qec2 = 1; }
+        row.scalerIndex = pkt;
+        row.qdc1Index = pkt+1;
+        row.qdc2Index = pkt+2;
+        pkt += (flushLeft > 0) ? 1 : 3;   // flushed scaler packets arrive back to back
+
+        // clocks
+        row.timeSec = t + jumpOffset;
+        row.timeSBC = (flushLeft > 0) ? sbcFrozen : t + 1e-4*gaus(fRand);
+        if (flushLeft > 0) {
+          fN.flushed++;
+          if (--flushLeft == 0) {
+            pkt += 2;
+            for (auto tg : geHeld) { geIndex.push_back(pkt++); geTime.push_back(tg); }
+            geHeld.clear();
+          }
+        }
+        if (fCfg.badScalerFrac > 0 && flat(fRand) < fCfg.badScalerFrac) {
+          row.badScaler = 1;
+          row.timeSec = 0;
+          row.hwErrors |= 1u << 4;
+          fN.badScaler++;
+        }
+        if (fCfg.missingCardFrac > 0 && flat(fRand) < fCfg.missingCardFrac) {
+          int card = flat(fRand) < 0.5 ? 0 : 1;
+          for (int q = 16*card; q < 16*card+16; q++) row.qdc[q] = 0;
+          if (card == 0) row.qdc1Index = 0;
+          else row.qdc2Index = 0;
+          row.hwErrors |= 1u << 1;
+          fN.missingCard++;
+        }
+
+        buf.push_back(row);
+        fN.entries++;
+        if (buf.size() == buf.capacity()) {
+          if (!out.Write(buf)) return false;
+          buf.clear();
+        }
+      }
+      for (auto tg : geHeld) { geIndex.push_back(pkt++); geTime.push_back(tg); }
+      if (!out.Write(buf)) return false;
+      if (!out.WriteGe(geIndex, geTime)) return false;
+
+      hdr.entries = fN.entries;
+      hdr.builtEntries = fN.ge;
+      if (!out.Close(hdr)) return false;
+      return WriteGeIndex(GetGeIndexFile(outDir), geIndex, geTime);
+    }
+
+  private:
+
+    std::string Name(const std::string &dir, const char *fmt) const
+    {
+      char name[200];
+      snprintf(name, sizeof(name), fmt, fCfg.run);
+      return dir + "/" + name;
+    }
+
+    std::vector<double> Schedule(int n, double t0, double t1)
+    {
+      std::uniform_real_distribution<double> flat(t0, t1);
+      std::vector<double> t(n > 0 ? n : 0);
+      for (auto &x : t) x = flat(fRand);
+      std::sort(t.begin(), t.end());
+      return t;
+    }
+
+    // An installed panel in plane p, picked by u in [0,1).  -1 if the plane is empty.
+    int PanelInPlane(int p, double u) const
+    {
+      int panels[32], n = 0;
+      for (int q = 0; q < 32; q++) if (fGeo.GetPlane(q) == p) panels[n++] = q;
+      return n ? panels[(int)(u*n)] : -1;
+    }
+
+    static uint16_t Clamp(double qdc) { return (uint16_t)(qdc < 0 ? 0 : qdc > 4095 ? 4095 : qdc); }
+
+    // Same layout as GeTimeIndex::Save().  Packets are already in index order.
+    static bool WriteGeIndex(const std::string &fileName, const std::vector<uint64_t> &index,
+      const std::vector<double> &time)
+    {
+      std::ofstream out(fileName.c_str(), std::ios::binary);
+      if (!out) return false;
+      long builtEntries = index.size();
+      uint64_t key = 0;  // no built files behind it
+      double first = time.empty() ? 0 : *std::min_element(time.begin(), time.end());
+      uint64_t n = index.size();
+      out.write("GETIDX02", 8);
+      out.write((const char*)&builtEntries, sizeof(builtEntries));
+      out.write((const char*)&key, sizeof(key));
+      out.write((const char*)&first, sizeof(first));
+      out.write((const char*)&n, sizeof(n));
+      out.write((const char*)index.data(), n*sizeof(uint64_t));
+      out.write((const char*)time.data(), n*sizeof(double));
+      return out.good();
+    }
+
+    VetoSynthConfig fCfg;
+    VetoGeometry fGeo;
+    std::mt19937_64 fRand;
+    double fPed[32];
+    double fBgRate[32];
+    VetoSynthCounts fN;
+};
+
+#endif
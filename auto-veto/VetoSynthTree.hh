@@ -0,0 +1,253 @@
+// VetoSynthTree.hh
+// Writes a synthetic run from veto-gen (VetoSynth.hh) as a built file, OR_run%i.root,
+// with the same "VetoTree" branches as the built data:
+//   run        MJTRun: run number, fStartTime, fStopTime
+//   vetoEvent  MGTBasicEvent: one MJTVetoData per QDC channel read out (none for a missing card)
+//   vetoBits   0
+//   mVeto      number of MJTVetoData in the entry
+// so auto-veto, vetoCheck and the vetoScan-dev codes decode it with MJVetoEvent::WriteEvent,
+// just like a production run.  The Ge stream is in the same file, like the built data:
+//   MGTree     event: MGTEvent, one digitizer data per Ge event (packet index and timestamp)
+// so auto-veto -g reads it as the run's built chain (GeTimeIndex::Build, ScanGeSync).
+// The number of Ge events is also stored as the "synthBuiltEntries" parameter,
+// for the matching .geidx.
+//
+// Each MJTVetoData carries its card, channel, amplitude and packet index, and the
+// entry's scaler (SEC, scaler packet index, scaler and SBC clocks) and QDC event count.
+// Check() decodes the first entries of the file again and compares them with the
+// records they were made from, and reads the Ge stream back through GeTimeIndex, so a
+// decode that doesn't give back what the generator meant fails at generation time,
+// not in a benchmark.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOSYNTHTREE_HH_GUARD
+#define VETOSYNTHTREE_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include "TFile.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TClonesArray.h"
+#include "TParameter.h"
+#include "MJTRun.hh"
+#include "MGTBasicEvent.hh"
+#include "MJTVetoData.hh"
+#include "MGTEvent.hh"
+#include "MGVDigitizerData.hh"
+#include "VetoGeometry.hh"
+#include "VetoRunCache.hh"
+#include "VetoSynth.hh"
+#include "GeTimeIndex.hh"
+
+class VetoSynthTree
+{
+  public:
+    static std::string FileName(const std::string &dir, int run)
+    {
+      return dir + "/OR_run" + std::to_string(run) + ".root";
+    }
+
+    // Records kept for Check().
+    static const size_t kCheckRows = 4096;
+
+    // For VetoSynth::Generate.
+    bool Open(const std::string &dir, const VetoSynthHeader &hdr)
+    {
+      fFileName = FileName(dir, hdr.run);
+      fFile = TFile::Open(fFileName.c_str(), "RECREATE");
+      if (!fFile || fFile->IsZombie()) return false;
+      VetoGeometry geo(hdr.run);
+      fCard1 = geo.GetCard1();
+      fCard2 = geo.GetCard2();
+      fRun = new MJTRun();
+      fRun->SetRunNumber(hdr.run);
+      fRun->SetStartTime(hdr.start);
+      fRun->SetStopTime(hdr.stop);
+      fEvent = new MGTBasicEvent();
+      fTree = new TTree("VetoTree", "VetoTree");
+      fTree->Branch("run", "MJTRun", &fRun, 32000, 99);
+      fTree->Branch("vetoEvent", "MGTBasicEvent", &fEvent, 32000, 99);
+      fTree->Branch("vetoBits", &fBits, "vetoBits/i");
+      fTree->Branch("mVeto", &fMVeto, "mVeto/i");
+      fGeEvent = new MGTEvent();
+      fGeEvent->InitializeArrays("MJTGretina4DigitizerData", 1);
+      fGeTree = new TTree("MGTree", "MGTree");
+      fGeTree->Branch("event", "MGTEvent", &fGeEvent, 32000, 99);
+      fRows.clear();
+      fGeIndex.clear();
+      fGeTime.clear();
+      fNGe = 0;
+      return true;
+    }
+
+    bool Write(const std::vector<VetoSynthRow> &rows)
+    {
+      for (auto &row : rows) {
+        Fill(row);
+        if (fTree->Fill() < 0) return false;
+        if (fRows.size() < kCheckRows) fRows.push_back(row);
+      }
+      return true;
+    }
+
+    // The Ge events, in packet order.  Timestamps are on the 100 MHz Ge clock.
+    bool WriteGe(const std::vector<uint64_t> &index, const std::vector<double> &time)
+    {
+      MGVDigitizerData *dig = fGeEvent->GetDigitizerData(0);
+      for (size_t i = 0; i < index.size(); i++) {
+        dig->SetIndex(index[i]);
+        dig->SetTimeStamp((ULong64_t)std::llround(std::max(time[i], 0.)*1e8));
+        if (fGeTree->Fill() < 0) return false;
+        if (fGeIndex.size() < kCheckRows) {
+          fGeIndex.push_back(index[i]);
+          fGeTime.push_back(time[i]);
+        }
+      }
+      fNGe += index.size();
+      return true;
+    }
+
+    bool Close(const VetoSynthHeader &hdr)
+    {
+      fFile->cd();
+      fTree->Write("", TObject::kOverwrite);
+      fGeTree->Write("", TObject::kOverwrite);
+      TParameter<Long64_t> built("synthBuiltEntries", hdr.builtEntries);
+      built.Write("", TObject::kOverwrite);
+      fFile->Close();
+      delete fFile;
+      fFile = 0;
+      fTree = 0;
+      fGeTree = 0;
+      delete fRun;
+      delete fEvent;
+      delete fGeEvent;
+      fRun = 0;
+      fEvent = 0;
+      fGeEvent = 0;
+      return true;
+    }
+
+    std::string GetFileName() const { return fFileName; }
+
+    // Decode the first entries of the written file with MJVetoEvent (through VetoRunCache),
+    // and compare them with the records.  The hardware error bits aren't compared:
+    // WriteEvent works them out from the data.  Then build the Ge index from the
+    // Ge stream, and do the sync scan, and compare them with the Ge events.
+    // Returns the first entry that differs (and what differs, in err), or -1 if they all agree.
+    long Check(std::string &err) const
+    {
+      TChain chain("VetoTree");
+      if (!chain.Add(fFileName.c_str()) || chain.GetEntries() < (long)fRows.size()) {
+        err = "can't read " + fFileName;
+        return 0;
+      }
+      VetoRunCache cache(&chain);
+      cache.Load(fCard1, fCard2, 0);
+      cache.Rewind();
+      VetoRecord rec;
+      for (size_t i = 0; i < fRows.size(); i++) {
+        if (!cache.Next(rec)) { err = "decode ended early"; return i; }
+        const VetoSynthRow &row = fRows[i];
+        for (int q = 0; q < 32; q++)
+          if (rec.qdc[q] != row.qdc[q]) { err = "QDC " + std::to_string(q); return i; }
+        if (std::fabs(rec.timeSec - row.timeSec) > 1e-7) { err = "scaler time"; return i; }
+        if (std::fabs(rec.timeSBC - row.timeSBC) > 1e-6) { err = "SBC time"; return i; }
+        if (rec.scalerIndex != row.scalerIndex || rec.qdc1Index != row.qdc1Index || rec.qdc2Index != row.qdc2Index)
+          { err = "packet index"; return i; }
+        if (rec.sec != row.sec || rec.qec != row.qec || rec.qec2 != row.qec2) { err = "SEC/QEC"; return i; }
+        if (rec.badScaler != (bool)row.badScaler) { err = "bad scaler flag"; return i; }
+      }
+
+      // The Ge stream, through the built-chain code auto-veto uses on a production run.
+      // Returns the Ge entry that differs.
+      TChain geChain("MGTree");
+      if (!geChain.Add(fFileName.c_str()) || geChain.GetEntries() != fNGe) {
+        err = "Ge stream: can't read " + fFileName;
+        return 0;
+      }
+      GeTimeIndex index;
+      index.Build(&geChain);
+      if ((long)index.GetSize() != fNGe) { err = "Ge index size"; return 0; }
+      for (size_t i = 0; i < fGeIndex.size(); i++) {
+        double before = 0, after = 0;
+        index.Around(fGeIndex[i] + 1, before, after);  // before: the packet itself
+        if (std::fabs(before - fGeTime[i]) > 1e-7) { err = "Ge packet time"; return i; }
+      }
+      if (!fRows.empty() && fNGe > 0) {
+        long sync = fRows[fRows.size()/2].scalerIndex;
+        double first = 0, before = 0, after = 0, iBefore = 0, iAfter = 0;
+        ScanGeSync(&geChain, sync, first, before, after);
+        index.Around(sync, iBefore, iAfter);
+        if (first != index.GetFirstTime() || before != iBefore || after != iAfter) {
+          err = "Ge sync scan around packet " + std::to_string(sync);
+          return 0;
+        }
+      }
+      return -1;
+    }
+
+    // Is there a Ge stream (MGTree) in the file?  veto-gen's older built files only had the .geidx.
+    static bool HasGeStream(const std::string &fileName)
+    {
+      TFile f(fileName.c_str());
+      return !f.IsZombie() && f.Get("MGTree") != 0;
+    }
+
+    // The Ge event count written by Close(), or -1 if the file doesn't have one.
+    static long BuiltEntries(const std::string &fileName)
+    {
+      TFile f(fileName.c_str());
+      if (f.IsZombie()) return -1;
+      TParameter<Long64_t> *built = (TParameter<Long64_t>*)f.Get("synthBuiltEntries");
+      return built ? built->GetVal() : -1;
+    }
+
+  private:
+    std::string fFileName;
+    TFile *fFile = 0;
+    TTree *fTree = 0;
+    MJTRun *fRun = 0;
+    MGTBasicEvent *fEvent = 0;
+    UInt_t fBits = 0, fMVeto = 0;
+    int fCard1 = 0, fCard2 = 0;
+    std::vector<VetoSynthRow> fRows;
+    TTree *fGeTree = 0;
+    MGTEvent *fGeEvent = 0;
+    std::vector<uint64_t> fGeIndex;   // the first Ge events, kept for Check()
+    std::vector<double> fGeTime;
+    long fNGe = 0;
+
+    // One record into the MGTBasicEvent.
+    void Fill(const VetoSynthRow &row)
+    {
+      TClonesArray *data = fEvent->GetDetectorData();
+      data->Clear("C");
+      const bool missing[2] = {row.qdc1Index == 0, row.qdc2Index == 0};
+      const long sbcSec = (long)row.timeSBC;
+      const long sbcUsec = std::lround((row.timeSBC - sbcSec)*1e6);
+      int n = 0;
+      for (int q = 0; q < 32; q++) {
+        int card = q/16;
+        if (missing[card]) continue;
+        MJTVetoData *d = (MJTVetoData*)data->ConstructedAt(n++);
+        d->SetCard(card == 0 ? fCard1 : fCard2);
+        d->SetChannel(q % 16);
+        d->SetAmplitude(row.qdc[q]);
+        d->SetIsUnderThreshold(row.qdc[q] == 0);
+        d->SetIsOverflow(row.qdc[q] >= 4095);
+        d->SetIndex(card == 0 ? row.qdc1Index : row.qdc2Index);
+        d->SetEventCount(card == 0 ? row.qec : row.qec2);
+        d->SetScalerCount(row.sec);
+        d->SetScalerIndex(row.scalerIndex);
+        d->SetTimeStamp((ULong64_t)std::llround(row.timeSec*1e8));  // 100 MHz scaler clock
+        d->SetSBCTSsec(sbcSec);
+        d->SetSBCTSusec(sbcUsec);
+      }
+      fMVeto = n;
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+// VetoThreshold.hh
+// QDC software threshold for one panel, from its low-QDC histogram.
+// Shared by auto-veto and veto-bench.
+//
+// SampleThresholds is the fast start (auto-veto --sample-thresh): it fills the
+// histograms from a sample spread over the run, and stops filling each panel once its pedestal has
+// converged.  Panels that never converge (e.g. a dead panel, which gets 9999)
+// keep going until every entry has been used, so they get the full-scan answer.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOTHRESHOLD_HH_GUARD
+#define VETOTHRESHOLD_HH_GUARD
+
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "TH1.h"
+#include "VetoRunCache.hh"
+#include "VetoErrors.hh"
+
+inline int FindThreshold(TH1D *qdcHist, int threshVal, int panel, int runNum)
+{
+  // Returns 9999 if a panels is deactivated or the threshold is not found.
+  // This (intentionally) causes that panel to not contribute to multiplicity or total QDC.
+  // This is the run-level error 27/28, and is checked between loop 1 and loop 2.
+
+  if (runNum > 45000000 && panel > 23)
+    return 9999;
+
+  int firstNonzeroBin = qdcHist->FindFirstBinAbove(1,1);
+  qdcHist->GetXaxis()->SetRange(firstNonzeroBin-10,firstNonzeroBin+50);
+  //qdcHist->GetXaxis()->SetRangeUser(0,500); //alternate method of finding pedestal
+  int bin = qdcHist->GetMaximumBin();
+  if (firstNonzeroBin == -1) return 9999;
+  double xval = qdcHist->GetXaxis()->GetBinCenter(bin);
+  return xval+threshVal;
+}
+
+struct VetoThreshSample
+{
+  int thresh[32];
+  long used[32];         // good entries in each panel's histogram
+  bool converged[32];    // false: the panel used the whole run
+  long read = 0;         // entries read
+  long skipped = 0;      // entries with skip errors (of those read)
+  int nFullScan = 0;     // panels that didn't converge
+};
+
+// Convergence: after kMinSamples good entries, the threshold is found again every
+// kCheckEvery.  A panel is done when its last kStableChecks thresholds agree to
+// within kTolerance QDC, and the pedestal peak bin is above both of its neighbors
+// by kPeakSigma (counting statistics), so the mode isn't just a fluctuation.
+const long kThreshMinSamples = 2000;
+const long kThreshCheckEvery = 1000;
+const int kThreshStableChecks = 3;
+const int kThreshTolerance = 1;
+const double kThreshPeakSigma = 2;
+
+// hLowQDC: 32 empty histograms, filled here.  The skip-error check of each
+// sampled entry uses the entry before it, as in the full scan.
+// Cached runs are sampled with a large stride (modulo the run length) so the sample
+// covers the whole run.  Streamed runs are read in order, from the start.
+inline VetoThreshSample SampleThresholds(VetoRunCache &cache, TH1D **hLowQDC, int threshVal)
+{
+  VetoThreshSample res;
+  long n = cache.GetEntries();
+  int runNum = cache.GetRunNumber();
+  int def[32];
+  for (int q = 0; q < 32; q++) def[q] = 1;
+  cache.SetSWThresh(def);
+
+  int last[32][kThreshStableChecks];
+  int nChecks[32] = {0};
+  int active[32], nActive = 0;
+  for (int q = 0; q < 32; q++) {
+    res.thresh[q] = FindThreshold(hLowQDC[q],threshVal,q,runNum);
+    res.used[q] = 0;
+    res.converged[q] = (runNum > 45000000 && q > 23);  // always 9999
+    if (!res.converged[q]) active[nActive++] = q;
+  }
+
+  // stride: about n/golden ratio, with no common factor with n, so every entry comes up once
+  long stride = 1;
+  if (cache.IsCached() && n > 2) {
+    stride = (long)(n*0.6180339887);
+    auto gcd = [](long a, long b) { while (b) { long t = a%b; a = b; b = t; } return a; };
+    while (gcd(stride, n) != 1) stride++;
+  }
+  else cache.Rewind();
+
+  VetoRecord veto, prev;
+  long good = 0, nextCheck = kThreshMinSamples;
+  long i = 0;
+  for (long k = 0; k < n && nActive > 0; k++)
+  {
+    if (stride > 1) {
+      if (i > 0) cache.Read(i-1, prev);
+      else prev = VetoRecord();
+      cache.Read(i, veto);
+      i = (i + stride) % n;
+    }
+    else {
+      prev = veto;
+      if (!cache.Next(veto)) break;
+    }
+    res.read++;
+    if (CheckErrors(veto,prev) & kSkipErrors) { res.skipped++; continue; }
+    for (int a = 0; a < nActive; a++) {
+      hLowQDC[active[a]]->Fill(veto.GetQDC(active[a]));
+      res.used[active[a]]++;
+    }
+    if (++good < nextCheck) continue;
+    nextCheck += kThreshCheckEvery;
+
+    // Check the panels still being filled
+    for (int a = 0; a < nActive; a++) {
+      int q = active[a];
+      int t = FindThreshold(hLowQDC[q],threshVal,q,runNum);
+      int bin = hLowQDC[q]->GetMaximumBin();
+      double peak = hLowQDC[q]->GetBinContent(bin);
+      double side = std::max(hLowQDC[q]->GetBinContent(bin-2), hLowQDC[q]->GetBinContent(bin+2));
+      hLowQDC[q]->GetXaxis()->SetRange();
+      last[q][nChecks[q]++ % kThreshStableChecks] = t;
+      res.thresh[q] = t;
+      if (t == 9999 || nChecks[q] < kThreshStableChecks) continue;
+      if (peak - side < kThreshPeakSigma*sqrt(peak + side)) continue;
+      bool stable = true;
+      for (int c = 0; c < kThreshStableChecks; c++) if (abs(last[q][c] - t) > kThreshTolerance) stable = false;
+      if (stable) {
+        res.converged[q] = true;
+        active[a--] = active[--nActive];
+      }
+    }
+  }
+  // The panels left used every entry: their thresholds are the full-scan ones.
+  for (int a = 0; a < nActive; a++) {
+    int q = active[a];
+    res.thresh[q] = FindThreshold(hLowQDC[q],threshVal,q,runNum);
+    res.nFullScan++;
+  }
+  return res;
+}
+
+#endif
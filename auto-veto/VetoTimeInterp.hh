@@ -0,0 +1,83 @@
+// VetoTimeInterp.hh
+// Reconstructed times for veto entries with a bad scaler.
+// The table is built once per run, and every lookup after that is an array read.
+// Entries with a good scaler aren't stored: IsBad() is false and GetTime() returns -1.
+// C. Wiseman, A. Lopez
+
+#ifndef VETOTIMEINTERP_HH_GUARD
+#define VETOTIMEINTERP_HH_GUARD
+
+#include <vector>
+#include <cstddef>
+
+class ScalerTimeInterp
+{
+  public:
+
+    ScalerTimeInterp() {}
+
+    // From a time for every entry (bad entries' times are ignored).
+    // A bad entry gets the midpoint of the nearest good times before and after it,
+    // and the uncertainty is half the gap.  A side with no good entry counts as 0.
+    // Two passes: the forward pass finds the good time before each bad entry,
+    // and the backward pass finds the one after.
+    // Returns false (and leaves the table empty) if the vectors have different sizes.
+    bool Build(const std::vector<double> &times, const std::vector<bool> &badScaler)
+    {
+      Clear();
+      if (times.size() != badScaler.size()) return false;
+      long n = (long)times.size();
+      fSlot.assign(n,-1);
+
+      double lower = 0;
+      for (long i = 0; i < n; i++) {
+        if (!badScaler[i]) { lower = times[i]; continue; }
+        fSlot[i] = (int)fTime.size();
+        fTime.push_back(lower);
+      }
+      fUnc.resize(fTime.size());
+
+      double upper = 0;
+      for (long i = n-1; i >= 0; i--) {
+        if (!badScaler[i]) { upper = times[i]; continue; }
+        int s = fSlot[i];
+        double lo = fTime[s];
+        fTime[s] = (upper + lo)/2.;
+        fUnc[s] = (upper - lo)/2.;
+      }
+      return true;
+    }
+
+    // From a sorted list of bad entries whose times were already reconstructed
+    // (e.g. from the Ge timestamps around each one).
+    bool Build(long nEntries, const std::vector<int> &badEntries,
+      const std::vector<double> &interpTimes, const std::vector<double> &interpUnc)
+    {
+      Clear();
+      if (badEntries.size() != interpTimes.size() || badEntries.size() != interpUnc.size()) return false;
+      fSlot.assign(nEntries,-1);
+      for (size_t s = 0; s < badEntries.size(); s++)
+        if (badEntries[s] >= 0 && badEntries[s] < nEntries) fSlot[badEntries[s]] = (int)s;
+      fTime = interpTimes;
+      fUnc = interpUnc;
+      return true;
+    }
+
+    void Clear() { fSlot.clear(); fTime.clear(); fUnc.clear(); }
+
+    long GetEntries() const { return (long)fSlot.size(); }
+    size_t GetNBad() const { return fTime.size(); }
+
+    bool IsBad(long entry) const { return entry >= 0 && entry < (long)fSlot.size() && fSlot[entry] >= 0; }
+
+    // Reconstructed time and uncertainty (seconds), or -1 for an entry that isn't in the table.
+    double GetTime(long entry) const { return IsBad(entry) ? fTime[fSlot[entry]] : -1; }
+    double GetUncert(long entry) const { return IsBad(entry) ? fUnc[fSlot[entry]] : -1; }
+
+  private:
+    std::vector<int> fSlot;      // entry -> index into fTime/fUnc, or -1 for a good entry
+    std::vector<double> fTime;   // one per bad entry, in entry order
+    std::vector<double> fUnc;
+};
+
+#endif
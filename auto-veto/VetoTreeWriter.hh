@@ -0,0 +1,208 @@
+// VetoTreeWriter.hh
+// Output stage for auto-veto's vetoTree and skipTree, in either layout:
+// VetoTreeWriter<VetoOutEntry> for v2, VetoTreeWriter<VetoOutEntryV1> for v1.
+//
+// In async mode, the muon scan pushes finished entries into a bounded
+// single-producer/single-consumer ring, and a dedicated I/O thread does the
+// TTree::Fill calls (and so the basket compression and flushing).  The scan
+// thread only waits if the ring is full, and the I/O thread if it's empty;
+// either one sleeps on a condition variable until the other makes room or
+// pushes, so neither spins.  In sync mode, Push() fills the trees directly,
+// like the old code did.
+// Only the I/O thread may touch the trees between Start() and Finish().
+// C. Wiseman, A. Lopez
+
+#ifndef VETOTREEWRITER_HH_GUARD
+#define VETOTREEWRITER_HH_GUARD
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <chrono>
+#include "TTree.h"
+#include "VetoOutput.hh"
+
+// Lock-free ring for one producer thread and one consumer thread.
+template <class T> class SPSCQueue
+{
+  public:
+    // capacity is rounded up to a power of 2
+    explicit SPSCQueue(size_t capacity=4096) : fHead(0), fTail(0)
+    {
+      size_t n = 2;
+      while (n < capacity) n <<= 1;
+      fBuf.resize(n);
+      fMask = n-1;
+    }
+
+    bool TryPush(const T &item)
+    {
+      size_t tail = fTail.load(std::memory_order_relaxed);
+      if (tail - fHead.load(std::memory_order_acquire) > fMask) return false;  // full
+      fBuf[tail & fMask] = item;
+      fTail.store(tail+1, std::memory_order_release);
+      return true;
+    }
+
+    bool TryPop(T &item)
+    {
+      size_t head = fHead.load(std::memory_order_relaxed);
+      if (head == fTail.load(std::memory_order_acquire)) return false;  // empty
+      item = fBuf[head & fMask];
+      fHead.store(head+1, std::memory_order_release);
+      return true;
+    }
+
+    bool IsEmpty() const { return fHead.load(std::memory_order_acquire) == fTail.load(std::memory_order_acquire); }
+    size_t GetCapacity() const { return fMask+1; }
+
+  private:
+    std::vector<T> fBuf;
+    size_t fMask;
+    alignas(64) std::atomic<size_t> fHead;  // next slot to pop (consumer)
+    alignas(64) std::atomic<size_t> fTail;  // next slot to push (producer)
+};
+
+// What the caller needs of a writer of either layout: start, finish, and the counters.
+class VetoTreeWriterBase
+{
+  public:
+    VetoTreeWriterBase(bool async) : fAsync(async), fNFull(0), fWaitSec(0), fBusySec(0), fNVeto(0), fNSkip(0) {}
+    virtual ~VetoTreeWriterBase() {}
+
+    virtual void Start() = 0;
+    virtual void Finish() = 0;
+
+    bool IsAsync() const { return fAsync; }
+    long GetNVeto() const { return fNVeto; }
+    long GetNSkip() const { return fNSkip; }
+    long GetNFull() const { return fNFull; }        // pushes that found the ring full
+    double GetWaitSec() const { return fWaitSec; }  // scan thread time spent waiting on a full ring
+    double GetBusySec() const { return fBusySec; }  // time spent in TTree::Fill
+
+  protected:
+    bool fAsync;
+    long fNFull;
+    double fWaitSec, fBusySec;
+    long fNVeto, fNSkip;
+};
+
+// Entry has BookVeto(TTree*) and BookSkip(TTree*), and is copied into the ring.
+template <class Entry> class VetoTreeWriter : public VetoTreeWriterBase
+{
+  public:
+
+    VetoTreeWriter(TTree *vetoTree, TTree *skipTree, bool async, size_t queueSize=4096) :
+      VetoTreeWriterBase(async), fVeto(vetoTree), fSkip(skipTree), fQueue(queueSize),
+      fDone(false), fRunning(false), fScanWaiting(false), fIOWaiting(false)
+    {
+      fOut.BookVeto(fVeto);
+      fOut.BookSkip(fSkip);
+    }
+
+    ~VetoTreeWriter() { Finish(); }
+
+    void Start()
+    {
+      if (!fAsync || fRunning) return;
+      fDone = false;
+      fRunning = true;
+      fThread = std::thread(&VetoTreeWriter<Entry>::Drain, this);
+    }
+
+    // Queue an entry for vetoTree (skipped=false) or skipTree (skipped=true).
+    void Push(const Entry &entry, bool skipped)
+    {
+      if (!fRunning) {
+        Write(Item(entry,skipped));
+        return;
+      }
+      Item item(entry,skipped);
+      if (!fQueue.TryPush(item)) {
+        fNFull++;
+        auto t0 = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(fMutex);
+        fScanWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        fNotFull.wait(lock, [&]{ return fQueue.TryPush(item); });
+        fScanWaiting.store(false, std::memory_order_relaxed);
+        fWaitSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      }
+      Wake(fIOWaiting, fNotEmpty);
+    }
+
+    // Wait for the I/O thread to write everything that was pushed.
+    // After this, the trees can be written and the file closed from the calling thread.
+    void Finish()
+    {
+      if (!fRunning) return;
+      {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fDone.store(true, std::memory_order_release);
+        fNotEmpty.notify_one();
+      }
+      fThread.join();
+      fRunning = false;
+    }
+
+  private:
+
+    struct Item {
+      Entry entry;
+      bool skipped;
+      Item() : skipped(false) {}
+      Item(const Entry &e, bool s) : entry(e), skipped(s) {}
+    };
+
+    void Write(const Item &item)
+    {
+      auto t0 = std::chrono::steady_clock::now();
+      fOut = item.entry;
+      if (item.skipped) { fSkip->Fill(); fNSkip++; }
+      else { fVeto->Fill(); fNVeto++; }
+      fBusySec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // Wake the other thread if it's asleep.  The fence pairs with the one a thread makes
+    // between raising its waiting flag and checking the ring, so a push or pop can't
+    // slip in between the check and the sleep unnoticed.
+    void Wake(std::atomic<bool> &waiting, std::condition_variable &cv)
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!waiting.load(std::memory_order_relaxed)) return;
+      std::lock_guard<std::mutex> lock(fMutex);
+      cv.notify_one();
+    }
+
+    void Drain()
+    {
+      Item item;
+      while (true) {
+        if (fQueue.TryPop(item)) {
+          Wake(fScanWaiting, fNotFull);
+          Write(item);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(fMutex);
+        fIOWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        fNotEmpty.wait(lock, [&]{ return !fQueue.IsEmpty() || fDone.load(std::memory_order_acquire); });
+        fIOWaiting.store(false, std::memory_order_relaxed);
+        if (fQueue.IsEmpty()) break;  // done, and everything is written
+      }
+    }
+
+    TTree *fVeto, *fSkip;
+    Entry fOut;          // the trees' branch addresses point here
+    SPSCQueue<Item> fQueue;
+    std::thread fThread;
+    std::atomic<bool> fDone;
+    bool fRunning;
+    std::mutex fMutex;                         // only for sleeping, not for the ring
+    std::condition_variable fNotFull, fNotEmpty;
+    std::atomic<bool> fScanWaiting, fIOWaiting;
+};
+
+#endif
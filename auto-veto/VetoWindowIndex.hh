@@ -0,0 +1,190 @@
+// VetoWindowIndex.hh
+// Veto windows around the muons in a VetoMuonList.  Each window definition gets
+// its own per-run set of sorted, merged intervals, so "is this hit inside any
+// veto window" is a binary search.  Nothing depends on the muons or the Ge hits
+// coming in time order, so clock resets and unsorted lists are fine.
+// Times are seconds on each run's veto clock, like VetoMuonList::times.
+// Used by skim-coins (Ge hit classification), skim-veto and vetoScan (dead time).
+// C. Wiseman, A. Lopez
+
+#ifndef VETOWINDOWINDEX_HH_GUARD
+#define VETOWINDOWINDEX_HH_GUARD
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include "VetoMuonList.hh"
+
+// A muon at t with time uncertainty unc vetoes [t - before - uncBefore*unc, t + after + uncAfter*unc].
+struct VetoWindowDef {
+  std::string name;
+  double before, uncBefore;
+  double after, uncAfter;
+};
+
+// skim-coins' windows: [t-unc, t+1+unc], and [t-3unc, t+4+unc] for DS4,
+// which requires a larger window due to synchronization issues.
+inline VetoWindowDef StandardVetoWindow() { return {"standard", 0, 1, 1, 1}; }
+inline VetoWindowDef WideVetoWindow() { return {"wide", 0, 3, 4, 1}; }
+inline VetoWindowDef VetoWindowForDS(int dsNumber) { return dsNumber==4 ? WideVetoWindow() : StandardVetoWindow(); }
+
+// Merged intervals, one sorted list per run.  Add() any number of intervals, then Build().
+class VetoWindowSet
+{
+  public:
+    void Add(int run, double lo, double hi) { fAdded[run].push_back(std::make_pair(lo,hi)); }
+
+    void Build()
+    {
+      fRuns.clear(); fLo.clear(); fHi.clear();
+      fNAdded = 0;
+      for (auto &r : fAdded) {
+        std::vector<std::pair<double,double> > &win = r.second;
+        std::sort(win.begin(), win.end());
+        size_t begin = fLo.size();
+        for (auto &w : win) {
+          if (fLo.size() > begin && w.first <= fHi.back()) fHi.back() = std::max(fHi.back(), w.second);
+          else { fLo.push_back(w.first); fHi.push_back(w.second); }
+        }
+        fRuns.push_back(RunSpan{r.first, begin, fLo.size()});
+        fNAdded += win.size();
+      }
+      fAdded.clear();
+    }
+
+    // The merged window holding t in run, or -1.
+    long Find(int run, double t) const
+    {
+      const RunSpan *span = Span(run);
+      if (!span) return -1;
+      std::vector<double>::const_iterator first = fLo.begin()+span->begin, last = fLo.begin()+span->end;
+      std::vector<double>::const_iterator it = std::upper_bound(first, last, t);
+      if (it == first) return -1;
+      long i = (it - fLo.begin()) - 1;
+      return t <= fHi[i] ? i : -1;
+    }
+
+    bool Contains(int run, double t) const { return Find(run,t) >= 0; }
+
+    double GetLo(long i) const { return fLo[i]; }
+    double GetHi(long i) const { return fHi[i]; }
+    size_t Size() const { return fLo.size(); }   // merged windows
+    size_t GetNAdded() const { return fNAdded; } // windows before merging
+
+    // Total length of the merged windows (no double counting of overlaps).
+    double DeadTime(int run) const
+    {
+      const RunSpan *span = Span(run);
+      double dead = 0;
+      if (span) for (size_t i = span->begin; i < span->end; i++) dead += fHi[i] - fLo[i];
+      return dead;
+    }
+    double DeadTime() const
+    {
+      double dead = 0;
+      for (size_t i = 0; i < fLo.size(); i++) dead += fHi[i] - fLo[i];
+      return dead;
+    }
+
+  private:
+    struct RunSpan { int run; size_t begin, end; };
+    std::map<int, std::vector<std::pair<double,double> > > fAdded;
+    std::vector<RunSpan> fRuns;  // sorted by run
+    std::vector<double> fLo, fHi;
+    size_t fNAdded = 0;
+
+    const RunSpan *Span(int run) const
+    {
+      std::vector<RunSpan>::const_iterator it = std::lower_bound(fRuns.begin(), fRuns.end(), run,
+        [](const RunSpan &s, int r) { return s.run < r; });
+      return (it != fRuns.end() && it->run == run) ? &*it : 0;
+    }
+};
+
+// The windows of a muon list for several definitions at once, and the most recent muon before a hit.
+class VetoWindowIndex
+{
+  public:
+    VetoWindowIndex(const VetoMuonList &mu, const std::vector<VetoWindowDef> &defs) : fDefs(defs), fSets(defs.size())
+    {
+      std::map<int, std::vector<std::pair<double,size_t> > > starts;
+      for (size_t i = 0; i < mu.Size(); i++) {
+        double t = mu.times[i], unc = mu.uncert[i];
+        for (size_t d = 0; d < fDefs.size(); d++)
+          fSets[d].Add(mu.runs[i], t - fDefs[d].before - fDefs[d].uncBefore*unc, t + fDefs[d].after + fDefs[d].uncAfter*unc);
+        // same rule as FindRecentMuon: a muon counts once the hit is past t - unc (10 ns at least)
+        starts[mu.runs[i]].push_back(std::make_pair(t - std::max(unc, 1.e-8), i));
+        if (fRunStart.find(mu.runs[i]) == fRunStart.end()) fRunStart[mu.runs[i]] = mu.runTStarts[i];
+      }
+      for (auto &s : fSets) s.Build();
+      for (auto &r : starts) {
+        std::sort(r.second.begin(), r.second.end());
+        RunMuons rm;
+        rm.run = r.first;
+        for (auto &s : r.second) {
+          rm.start.push_back(s.first);
+          size_t best = rm.latest.empty() ? s.second : rm.latest.back();
+          rm.latest.push_back(mu.times[s.second] >= mu.times[best] ? s.second : best);
+        }
+        fMuons.push_back(rm);
+      }
+    }
+
+    size_t GetNDefs() const { return fDefs.size(); }
+    const VetoWindowDef &GetDef(size_t d) const { return fDefs[d]; }
+    const VetoWindowSet &GetSet(size_t d) const { return fSets[d]; }
+
+    // Is t (seconds, veto clock of run) inside a window of definition d?
+    bool IsVetoed(int run, double t, size_t d=0) const { return fSets[d].Contains(run,t); }
+
+    // Bit d set: t is inside a window of definition d.
+    uint32_t VetoMask(int run, double t) const
+    {
+      uint32_t mask = 0;
+      for (size_t d = 0; d < fSets.size() && d < 32; d++)
+        if (fSets[d].Contains(run,t)) mask |= 1u << d;
+      return mask;
+    }
+
+    // Index (in the muon list) of the most recent muon before t in run: the latest one
+    // with t_mu - unc <= t.  If the run has none yet, the latest muon of an earlier run,
+    // and 0 if there's none of those either.  FindRecentMuon gives the same muon, unless
+    // a muon with a small uncertainty blocks its cursor from a later one with a large one.
+    size_t RecentMuon(int run, double t) const
+    {
+      std::vector<RunMuons>::const_iterator it = std::lower_bound(fMuons.begin(), fMuons.end(), run,
+        [](const RunMuons &m, int r) { return m.run < r; });
+      if (it != fMuons.end() && it->run == run) {
+        size_t n = std::upper_bound(it->start.begin(), it->start.end(), t) - it->start.begin();
+        if (n > 0) return it->latest[n-1];
+      }
+      if (it == fMuons.begin()) return 0;
+      --it;
+      return it->latest.back();
+    }
+
+    // A Ge hit's time on the veto clock of its run.  DS0 hit and veto times don't
+    // share an origin, so the hit is moved by the difference of the run start times.
+    double VetoClockTime(int run, double hitT_s, double startTime, int dsNumber) const
+    {
+      if (dsNumber != 0) return hitT_s;
+      std::map<int,double>::const_iterator it = fRunStart.find(run);
+      return it == fRunStart.end() ? hitT_s : (startTime - it->second) + hitT_s;
+    }
+
+  private:
+    struct RunMuons {
+      int run;
+      std::vector<double> start;   // t - unc, sorted
+      std::vector<size_t> latest;  // latest muon (by time) among the first i+1 starts
+    };
+    std::vector<VetoWindowDef> fDefs;
+    std::vector<VetoWindowSet> fSets;
+    std::vector<RunMuons> fMuons;  // sorted by run
+    std::map<int,double> fRunStart;
+};
+
+#endif
@@ -25,8 +25,13 @@ if [ ! "$opt" = "y" ]; then
 fi
 
 echo "Now processing run $run ..."
-# ./auto-veto $run -o avout/DS5/
-./auto-veto $run
+# With a daemon running (./auto-veto -D $AUTOVETO_SPOOL), hand it the run instead of starting a new process.
+if [ -n "$AUTOVETO_SPOOL" ]; then
+   ./veto-submit $AUTOVETO_SPOOL $run
+else
+   # ./auto-veto $run -o avout/DS5/
+   ./auto-veto $run
+fi
 
 echo "Job Complete:"
 date
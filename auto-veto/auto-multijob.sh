@@ -3,6 +3,7 @@
 #$ -j y
 #$ -o /global/homes/w/wisecg/auto-veto/logs/
 #$ -P majorana
+#$ -pe shared 4
 source /global/homes/w/wisecg/env/EnvBatch.sh
 cd /global/homes/w/wisecg/auto-veto
 
@@ -13,12 +14,21 @@ echo "Job ID:  "$JOB_ID
 echo " "
 echo "Auto-multijob got this many runs: "$#
 
-for var in "$@"
-do
-    echo "Now processing run $var ..."
-    # ./auto-veto $var -o avout/DS5/
-    ./auto-veto $var
-done
+# Process all the runs in one auto-veto process, in parallel (longest runs first),
+# on the slots the job was given (-pe above; NSLOTS is set by the scheduler).
+# Without -j, auto-veto would use every core of the node.
+runList=$(mktemp)
+printf "%s\n" "$@" > $runList
+# ./auto-veto -l $runList -j ${NSLOTS:-1} -o avout/DS5/
+./auto-veto -l $runList -j ${NSLOTS:-1}
+rm $runList
+
+# old way: one process per run
+# for var in "$@"
+# do
+#     echo "Now processing run $var ..."
+#     ./auto-veto $var
+# done
 
 echo "Job Complete:"
 date
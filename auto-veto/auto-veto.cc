@@ -4,13 +4,48 @@
 //
 // NOTE: The scans are split across a few different loops over the events in the run.
 // This is done to increase the flexibility of the code, since it checks many different
-// quantities.  The performance hit is minimal, since the size of the veto trees
-// is relatively small.
+// quantities.  Each entry is only decoded once: the loops iterate a VetoRunCache
+// (see VetoRunCache.hh), which falls back to re-reading the tree for oversized runs.
+//
+// Batch mode (-l run list, -r run range) processes many runs in one process,
+// on a pool of worker threads.  Each run gets its own chain, cache and output file.
+//
+// The output file layout (-f), compression (-z) and basket size (-b) are described
+// in VetoOutput.hh.  The default is the v1 (MJVetoEvent) layout; -f 2 writes the
+// split-column v2 layout.
+//
+// --profile [file.json] times each phase of each run (see VetoProfile.hh).
+// -g processes a synthetic run from veto-gen (see VetoSynth.hh) instead of built data:
+// a built file (OR_run%i.root) or a .vsyn record file, with its Ge index (.geidx).
+//
+// Each run's intermediate products (thresholds, LED and flush scan, Ge sync,
+// bad-scaler interpolation, error counts) are saved next to the output (see VetoProducts.hh).
+// Rerunning with new muon cuts only redoes the muon scan.  --rebuild ignores the saved products.
+//
+// -t follows a run while it's being written (a built file, a .vsyn file, or a directory
+// of OR_run*.root / synth_run*.vsyn files), checking each new entry as it lands and keeping a status file up to date
+// (see VetoLive.hh).  veto-replay makes a growing file out of a finished run, for testing.
+//
+// -D runs a daemon that takes runs from a spool directory (see VetoSpool.hh), submitted with
+//   ./veto-submit [spool dir] [run] ...
+// One process serves every job, so the ROOT/MGDO/GAT dictionaries are only loaded once,
+// and the run path lookups and the runs' saved products stay in memory between jobs.
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <tuple>
+#include <csignal>
+#include <sys/stat.h>
+#include <dirent.h>
 #include "TTreeReader.h"
 #include "TTreeReaderValue.h"
 #include "TTreeReaderArray.h"
@@ -19,100 +54,795 @@
 #include "TLine.h"
 #include "TStyle.h"
 #include "TFile.h"
+#include "TROOT.h"
 #include "MJVetoEvent.hh"
 #include "GATDataSet.hh"
 #include "MGTEvent.hh"
 #include "MGVDigitizerData.hh"
+#include "VetoRunCache.hh"
+#include "VetoSynthTree.hh"
+#include "VetoErrors.hh"
+#include "VetoGeometry.hh"
+#include "VetoCoincidence.hh"
+#include "VetoLog.hh"
+#include "GeTimeIndex.hh"
+#include "VetoTimeInterp.hh"
+#include "VetoLEDTimer.hh"
+#include "VetoOutput.hh"
+#include "VetoTreeWriter.hh"
+#include "VetoProfile.hh"
+#include "VetoThreshold.hh"
+#include "VetoProducts.hh"
+#include "VetoLive.hh"
+#include "VetoSpool.hh"
 
 using namespace std;
 
-const int nErrs = 31;
-vector<int> MeasurePanelThresholds(TChain *vetoChain, string outputDir, bool makePlots=false);
-void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir, bool errorCheckOnly=false, bool vetoOnly=false);
+// Muon ID cuts.  These only affect the muon scan, so changing them reuses the saved products.
+struct VetoMuonCuts {
+  int overQDC = 500;          // measured muon energy threshold
+  int minPanels = 2;          // energy cut: at least this many panels over overQDC
+  int LEDMultipThreshold = 5; // "multipThreshold" = "highestMultip" - "LEDMultipThreshold"
+};
 
-void SetCardNumbers(int runNum, int &card1, int &card2);
-int FindThreshold(TH1D *qdcHist, int threshVal, int panel, int runNum);
-int PlaneMap(int qdcChan, int runNum=0);
-bool CheckErrors(MJVetoEvent veto, MJVetoEvent prev, vector<int> &ErrorVec);
-bool CheckErrors(MJVetoEvent veto, MJVetoEvent prev);
-void FillInterpTimeVectors(int runNum, vector<int> &badEntries, vector<double> &interpTimes,
+struct RunOptions {
+  string outputDir = "./";
+  double maxCacheMB = 512;
+  bool makePlots = false, errorCheckOnly = false, vetoOnly = false;
+  bool syncOutput = false;
+  VetoOutConfig output;
+  string profileFile;  // empty: no profiling
+  bool synthInput = false;  // the run path is a synthetic run from veto-gen (built or .vsyn file)
+  VetoMuonCuts cuts;
+  bool rebuildProducts = false;  // recompute every stage, ignoring saved products
+  bool sampleThresh = false;     // thresholds from a converged sample, instead of every entry
+  bool checkThresh = false;      // sample, and also do the full scan to compare with
+  // follow mode (-t)
+  double pollSec = 1;    // time between checks for new entries
+  double idleSec = 0;    // stop when a file hasn't grown for this long.  0: never
+  string statusFile;     // default: [output dir]/veto_live.json
+  VetoProductsCache *products = 0;  // daemon mode: products kept in memory between jobs
+};
+int ProcessRun(int run, string runPath, const RunOptions &opts);
+int ProcessRunBatch(vector<int> runs, int nThreads, const RunOptions &opts);
+void ProcessCache(VetoRunCache &cache, string runPath, const RunOptions &opts);
+int WriteProfile(int status, const RunOptions &opts);
+void PrintUsage();
+bool ParseInt(string s, int &val);
+int FollowRun(string path, const RunOptions &opts);
+int RunDaemon(string spoolDir, int nThreads, RunOptions opts);
+
+vector<int> MeasurePanelThresholds(VetoRunCache &cache, string outputDir, VetoProducts &prod, bool makePlots=false,
+  bool sample=false, bool checkSample=false);
+void ProcessVetoData(VetoRunCache &cache, const VetoGeometry &geo, vector<int> thresholds, string outputDir,
+  const VetoOutConfig &outCfg, const VetoMuonCuts &cuts, VetoProducts &prod,
+  bool errorCheckOnly=false, bool vetoOnly=false, bool syncOutput=false);
+
+TChain *OpenBuiltChain(int runNum, TChain *synthVeto, GATDataSet *&ds);
+void CloseBuiltChain(TChain *builtChain, GATDataSet *ds);
+bool LoadGeTimeIndex(int runNum, TChain *synthVeto, string outputDir, GeTimeIndex &geIndex);
+long SyncBuiltChain(int runNum, TChain *synthVeto, long scalerIndex, double &first, double &before, double &after);
+void FillInterpTimeVectors(const GeTimeIndex &geIndex, vector<int> &badEntries, vector<double> &interpTimes,
   vector<double> &interpUnc, vector<long> &packetList);
-double PanelInfo(int run, int panel, string option);
+
+// GATDataSet and the ROOT graphics aren't thread-safe.  In batch mode,
+// only one worker at a time may use them.
+mutex gGATMutex, gPlotMutex;
 
 int main(int argc, char** argv)
 {
   // get command line args
   if (argc < 2) {
-    cout << "Usage: ./auto-veto [run number]\n"
-         << "                   [-d (optional: draws QDC & multiplicity plots)]\n"
-         << "                   [-e (optional: error check only)]\n"
-         << "                   [-v (optional: don't access Ge data)]\n"
-         << "                   [-o [directory] (options: specify output location)]\n";
+    PrintUsage();
     return 1;
   }
+  RunOptions opts;
+  int nThreads = thread::hardware_concurrency();
+  vector<string> opt(argc);
+  for (int i=0; i<argc-1; i++) opt[i]=argv[i+1];
+  if (find(opt.begin(), opt.end(), "-d") != opt.end()) opts.makePlots=true;
+  if (find(opt.begin(), opt.end(), "-e") != opt.end()) opts.errorCheckOnly=true;
+  if (find(opt.begin(), opt.end(), "-v") != opt.end()) opts.vetoOnly=true;
+  if (find(opt.begin(), opt.end(), "-s") != opt.end()) opts.syncOutput=true;
+  if (find(opt.begin(), opt.end(), "-o") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-o") - opt.begin();
+    opts.outputDir = opt[pos+1]+"/";
+  }
+  if (find(opt.begin(), opt.end(), "-m") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-m") - opt.begin();
+    opts.maxCacheMB = stod(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "-j") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-j") - opt.begin();
+    nThreads = stoi(opt[pos+1]);
+  }
+  if (nThreads < 1) nThreads = 1;
+  if (find(opt.begin(), opt.end(), "-f") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-f") - opt.begin();
+    if (!ParseInt(opt[pos+1], opts.output.schema) || (opts.output.schema != 1 && opts.output.schema != 2)) {
+      cout << "Unknown output layout " << opt[pos+1] << ".  Exiting ...\n";
+      PrintUsage();
+      return 1;
+    }
+  }
+  if (find(opt.begin(), opt.end(), "-z") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-z") - opt.begin();
+    if (!opts.output.SetCompression(opt[pos+1])) {
+      cout << "Unknown compression setting " << opt[pos+1] << ".  Exiting ...\n";
+      PrintUsage();
+      return 1;
+    }
+  }
+  if (find(opt.begin(), opt.end(), "-b") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "-b") - opt.begin();
+    if (!ParseInt(opt[pos+1], opts.output.basketSize) || opts.output.basketSize < 0) {
+      cout << "Bad basket size " << opt[pos+1] << ".  Exiting ...\n";
+      PrintUsage();
+      return 1;
+    }
+  }
+  if (find(opt.begin(), opt.end(), "--profile") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--profile") - opt.begin();
+    opts.profileFile = opt[pos+1];
+  }
+  if (find(opt.begin(), opt.end(), "--muon-qdc") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--muon-qdc") - opt.begin();
+    opts.cuts.overQDC = stoi(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "--muon-panels") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--muon-panels") - opt.begin();
+    opts.cuts.minPanels = stoi(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "--led-multip") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--led-multip") - opt.begin();
+    opts.cuts.LEDMultipThreshold = stoi(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "--rebuild") != opt.end()) opts.rebuildProducts=true;
+  if (find(opt.begin(), opt.end(), "--sample-thresh") != opt.end()) opts.sampleThresh=true;
+  if (find(opt.begin(), opt.end(), "--check-thresh") != opt.end()) opts.checkThresh=true;
+  if (find(opt.begin(), opt.end(), "--poll") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--poll") - opt.begin();
+    opts.pollSec = stod(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "--idle") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--idle") - opt.begin();
+    opts.idleSec = stod(opt[pos+1]);
+  }
+  if (find(opt.begin(), opt.end(), "--status") != opt.end()) {
+    int pos = find(opt.begin(), opt.end(), "--status") - opt.begin();
+    opts.statusFile = opt[pos+1];
+  }
+
+  // The writer fills the output trees on its own thread, unless -s.
+  if (!opts.syncOutput) ROOT::EnableThreadSafety();
+
+  // Synthetic run from veto-gen.  A .vsyn file has no MJVetoEvent to write, so it always uses the v2 layout.
+  if (opt[0] == "-g") {
+    if (IsVetoSynthRecordFile(opt[1])) {
+      if (opts.output.schema != 2) cout << ".vsyn runs are written with the v2 layout.\n";
+      opts.output.schema = 2;
+    }
+    opts.synthInput = true;
+    return WriteProfile(ProcessRun(0, opt[1], opts), opts);
+  }
+
+  // Follow mode: a run that's still being written
+  if (opt[0] == "-t") return WriteProfile(FollowRun(opt[1], opts), opts);
+
+  // Daemon mode: runs from a spool directory, until it's stopped
+  if (opt[0] == "-D") return WriteProfile(RunDaemon(opt[1], nThreads, opts), opts);
+
+  // Batch mode: a list of runs, one per line
+  if (opt[0] == "-l") {
+    ifstream runFile(opt[1]);
+    if (!runFile) {
+      cout << "Couldn't open run list " << opt[1] << ".  Exiting ...\n";
+      return 1;
+    }
+    vector<int> runs;
+    int run;
+    while (runFile >> run) runs.push_back(run);
+    return WriteProfile(ProcessRunBatch(runs, nThreads, opts), opts);
+  }
+  // Batch mode: a range of runs (inclusive)
+  if (opt[0] == "-r") {
+    vector<int> runs;
+    for (int run = stoi(opt[1]); run <= stoi(opt[2]); run++) runs.push_back(run);
+    return WriteProfile(ProcessRunBatch(runs, nThreads, opts), opts);
+  }
+
   int run = stoi(argv[1]);
   if (run > 60000000 && run < 70000000) {
     cout << "Veto data not present in Module 2 runs.  Exiting ...\n";
     return 1;
   }
-  string outputDir = "./";
-  bool makePlots = false, errorCheckOnly = false, vetoOnly = false;
-  vector<string> opt(argc);
-  for (int i=0; i<argc-2; i++) opt[i]=argv[i+2];
-  if (find(opt.begin(), opt.end(), "-d") != opt.end()) makePlots=true;
-  if (find(opt.begin(), opt.end(), "-e") != opt.end()) errorCheckOnly=true;
-  if (find(opt.begin(), opt.end(), "-v") != opt.end()) vetoOnly=true;
-  if (find(opt.begin(), opt.end(), "-o") != opt.end()) {
-    int pos = find(opt.begin(), opt.end(), "-o") - opt.begin();
-    outputDir = opt[pos+1]+"/";
-  }
 
   // Only get the run path (so we can use veto-only runs if necessary)
   GATDataSet ds;
   string runPath = ds.GetPathToRun(run,GATDataSet::kBuilt);
   // string runPath = "./stage/OR_run"+std::to_string(run)+".root"; // manually set path
 
+  return WriteProfile(ProcessRun(run, runPath, opts), opts);
+}
+
+void PrintUsage()
+{
+  cout << "Usage: ./auto-veto [run number]\n"
+       << "       ./auto-veto -l [run list file]\n"
+       << "       ./auto-veto -r [lower run] [upper run]\n"
+       << "       ./auto-veto -g [synthetic run file from veto-gen (OR_run*.root or .vsyn)]\n"
+       << "       ./auto-veto -t [growing built file, .vsyn file, or directory of OR_run*.root/synth_run*.vsyn files] (follow mode)\n"
+       << "       ./auto-veto -D [spool directory] (daemon: process the runs submitted with veto-submit)\n"
+       << "                   [-d (optional: draws QDC & multiplicity plots)]\n"
+       << "                   [-e (optional: error check only)]\n"
+       << "                   [-v (optional: don't access Ge data)]\n"
+       << "                   [-o [directory] (options: specify output location)]\n"
+       << "                   [-m [MB] (optional: memory cap for the run cache, default 512)]\n"
+       << "                   [-j [threads] (optional: batch and daemon mode worker threads, default: all cores)]\n"
+       << "                   [-f [1|2] (optional: output layout, default 1 (MJVetoEvent).  2 is the split-column layout)]\n"
+       << "                   [-z [alg:level] (optional: output compression, e.g. lz4:4, zstd:5, zlib:1, none)]\n"
+       << "                   [-b [bytes] (optional: output basket size)]\n"
+       << "                   [-s (optional: fill the output trees on the processing thread, no writer thread)]\n"
+       << "                   [--profile [file.json] (optional: write per-phase timing and I/O for each run.\n"
+       << "                                  follow mode: written when it stops, at --idle or on Ctrl-C)]\n"
+       << "                   [--muon-qdc [QDC] (optional: muon energy threshold, default 500)]\n"
+       << "                   [--muon-panels [n] (optional: panels over the muon energy threshold, default 2)]\n"
+       << "                   [--led-multip [n] (optional: LED multiplicity threshold below the highest, default 5)]\n"
+       << "                   [--rebuild (optional: recompute every stage instead of reusing saved products)]\n"
+       << "                   [--sample-thresh (optional: find the QDC thresholds from a sample of the run, not every entry.\n"
+       << "                                     faster, but a panel's threshold can differ from the full scan)]\n"
+       << "                   [--check-thresh (optional: sample, and also do the full scan and log the panels that differ)]\n"
+       << "                   [--poll [sec] (follow and daemon modes: time between checks, default 1)]\n"
+       << "                   [--idle [sec] (follow mode: stop after no new entries for this long, default never)]\n"
+       << "                   [--status [file] (follow mode: status file, default [output dir]/veto_live.json)]\n";
+}
+
+// The whole string must be an integer ("12abc" is rejected).
+bool ParseInt(string s, int &val)
+{
+  size_t end = 0;
+  try { val = stoi(s, &end); }
+  catch (...) { return false; }
+  return end == s.size();
+}
+
+int WriteProfile(int status, const RunOptions &opts)
+{
+  if (opts.profileFile.empty()) return status;
+  if (VetoProfileReport::Get().Write(opts.profileFile, "auto-veto"))
+    cout << "Wrote profile: " << opts.profileFile << endl;
+  else
+    cout << "Warning: couldn't write profile " << opts.profileFile << endl;
+  return status;
+}
+
+int ProcessRun(int run, string runPath, const RunOptions &opts)
+{
+  // Profile this run's phases if asked.  The profiler is handed to the report when the run is done.
+  unique_ptr<VetoProfiler> prof;
+  if (!opts.profileFile.empty()) prof.reset(new VetoProfiler("run", run));
+  VetoProfilerCurrent() = prof.get();
+  struct ProfileDone {
+    VetoProfiler *p;
+    ~ProfileDone() {
+      VetoProfilerCurrent() = 0;
+      if (p) { p->SetPeakRSS(); VetoProfileReport::Get().Add(*p); }
+    }
+  } profDone = {prof.get()};
+  VETO_SCOPE(pTotal, "total");
+
+  if (opts.synthInput && IsVetoSynthRecordFile(runPath)) {
+    VetoRunCache cache(runPath);
+    if (cache.GetEntries() < 1) {
+      vlog() << "Couldn't read synthetic run " << runPath << ".  Exiting ...\n";
+      return 1;
+    }
+    vlogf("\n========= Processing synthetic run %i ... %li entries. =========\n",cache.GetRunNumber(),cache.GetEntries());
+    vlog() << "Path: " << runPath << endl;
+    ProcessCache(cache, runPath, opts);
+    vlogf("=================== Done processing. ====================\n\n");
+    return 0;
+  }
+
   TChain *vetoChain = new TChain("VetoTree");
   if (!vetoChain->Add(runPath.c_str())){
-    cout << "File doesn't exist.  Exiting ...\n";
+    vlog() << "File doesn't exist.  Exiting ...\n";
+    delete vetoChain;
     return 1;
   }
 
-  printf("\n========= Processing run %i ... %lli entries. =========\n",run,vetoChain->GetEntries());
-  cout << "Path: " << runPath << endl;
-  if (vetoChain->GetEntries() < 1) { cout << "Warning: no veto data in run. Exiting...\n"; return 1; }
+  if (opts.synthInput) vlogf("\n========= Processing synthetic run ... %lli entries. =========\n",vetoChain->GetEntries());
+  else vlogf("\n========= Processing run %i ... %lli entries. =========\n",run,vetoChain->GetEntries());
+  vlog() << "Path: " << runPath << endl;
+  if (vetoChain->GetEntries() < 1) {
+    vlog() << "Warning: no veto data in run. Exiting...\n";
+    delete vetoChain;
+    return 1;
+  }
+  {
+    VetoRunCache cache(vetoChain);
+    if (opts.synthInput && VetoSynthTree::HasGeStream(runPath)) {
+      // A built file from veto-gen, with its Ge stream: read like the built data.
+      cache.SetSynthBuilt();
+    }
+    else if (opts.synthInput) {
+      // An older built file from veto-gen: the Ge timestamps are in the .geidx next to it.
+      long built = VetoSynthTree::BuiltEntries(runPath);
+      if (built < 0) vlog() << "Warning: " << runPath << " isn't from veto-gen (no synthBuiltEntries).\n";
+      cache.SetSynthGeIndex(runPath, built);
+    }
+    ProcessCache(cache, runPath, opts);
+  }
+  delete vetoChain;
+
+  vlogf("=================== Done processing. ====================\n\n");
+  return 0;
+}
+
+void ProcessCache(VetoRunCache &cache, string runPath, const RunOptions &opts)
+{
+  int runNum = cache.GetRunNumber();
+  VetoGeometry geo(runNum);
+
+  // Products of an earlier pass over the same input (see VetoProducts.hh).
+  // The Ge timestamps come from the same built file, except for synthetic runs.
+  VetoProducts prod;
+  string prodFile = TString::Format("%s/veto_run%i.products",opts.outputDir.c_str(),runNum).Data();
+  uint64_t inputKey = cache.GetChain() ? BuiltChainKey(cache.GetChain()) : VetoFileKey(runPath);
+  if (cache.HasSynthGeIndex() && inputKey)
+    inputKey = VetoKey().Add(inputKey).Add(VetoFileKey(cache.GetGeIndexFile())).Get();
+  prod.input = inputKey;
+  if (!opts.rebuildProducts && prod.input && !(opts.products && opts.products->Get(prodFile, prod)))
+    prod.Load(prodFile);
+
+  // The v1 output has a full MJVetoEvent per entry.  The cache keeps the events it
+  // decodes, with the thresholds the run is expected to get: the saved ones, or
+  // a guess from the start of the Load pass.  Entries they don't fit are read again.
+  VETO_SCOPE(pLoad, "cacheLoad");
+  if (opts.output.schema == 1 && !cache.IsSynthetic()) {
+    if (prod.key[kThreshStage] != 0) cache.KeepEvents(prod.swThresh);
+    else cache.KeepEventsGuessed(35);
+  }
+
+  // Decode every veto entry once, with run-based card numbers.
+  cache.Load(geo.GetCard1(),geo.GetCard2(),opts.maxCacheMB);
+  pLoad.Stop(cache.GetEntries());
+  if (VetoProfiler *prof = VetoProfilerCurrent()) {
+    // Uncompressed VetoTree bytes: all branches, and the pruned set read each pass (VetoBranches.hh)
+    prof->SetCounter("vetoTreeBytes", cache.GetTreeBytes().total);
+    prof->SetCounter("vetoTreeReadBytes", cache.GetTreeBytes().perEntry);
+  }
 
   // Find the QDC pedestal location in each channel.
   // Set a software threshold value above this location,
   // and optionally output plots that confirm this choice.
-  vector<int> thresholds = MeasurePanelThresholds(vetoChain, outputDir, makePlots);
+  vector<int> thresholds = MeasurePanelThresholds(cache, opts.outputDir, prod, opts.makePlots,
+    opts.sampleThresh, opts.checkThresh);
 
   // Check for data quality errors,
   // tag muon and LED events in veto data,
   // and output a ROOT file for further analysis.
-  ProcessVetoData(vetoChain, thresholds, outputDir, errorCheckOnly, vetoOnly);
+  ProcessVetoData(cache, geo, thresholds, opts.outputDir, opts.output, opts.cuts, prod,
+    opts.errorCheckOnly, opts.vetoOnly, opts.syncOutput);
+
+  if (prod.input && prod.nReused < kNStages && !prod.Save(prodFile))
+    vlog() << "Warning: couldn't write " << prodFile << endl;
+  if (opts.products && prod.input) opts.products->Put(prodFile, prod);
+  if (VetoProfiler *prof = VetoProfilerCurrent()) {
+    prof->SetCounter("stagesReused", prod.nReused);
+    prof->SetCounter("eventsRedecoded", cache.GetRedecoded());
+  }
+  if (cache.GetRedecoded() > 0)
+    vlogf("Read %li of %li entries again for the output.\n",cache.GetRedecoded(),cache.GetEntries());
+}
+
+int ProcessRunBatch(vector<int> runs, int nThreads, const RunOptions &opts)
+{
+  // Each worker has its own chain, cache, histograms and output file.
+  // Keep the histograms out of the shared gROOT directory.
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory(kFALSE);
+  gStyle->SetOptStat(0);
+
+  struct RunJob {
+    int run;
+    string path;
+    long entries;
+    int status;
+    double seconds;
+  };
+
+  // Look up every run first, so the longest runs can be started first.
+  vector<RunJob> jobs;
+  GATDataSet ds;
+  for (auto run : runs) {
+    if (run > 60000000 && run < 70000000) {
+      cout << "Run " << run << ": veto data not present in Module 2 runs.  Skipping ...\n";
+      continue;
+    }
+    string path = ds.GetPathToRun(run,GATDataSet::kBuilt);
+    TChain chain("VetoTree");
+    long entries = 0;
+    if (chain.Add(path.c_str())) entries = chain.GetEntries();
+    if (entries < 1) {
+      cout << "Run " << run << ": no veto data found at " << path << ".  Skipping ...\n";
+      continue;
+    }
+    jobs.push_back({run, path, entries, 1, 0});
+  }
+  sort(jobs.begin(), jobs.end(), [](const RunJob &a, const RunJob &b) { return a.entries > b.entries; });
+  if (nThreads > (int)jobs.size()) nThreads = (int)jobs.size();
+  printf("Batch mode: %i runs on %i threads.\n", (int)jobs.size(), nThreads);
+
+  // Workers take the next run from the (sorted) list until it's empty.
+  // Each run's output is buffered and printed in one piece when the run is done.
+  atomic<size_t> nextJob(0);
+  mutex printMutex;
+  auto worker = [&]() {
+    while (true) {
+      size_t j = nextJob++;
+      if (j >= jobs.size()) break;
+      RunJob &job = jobs[j];
+      ostringstream buf;
+      VetoLogBuffer() = &buf;
+      auto t0 = chrono::steady_clock::now();
+      try {
+        job.status = ProcessRun(job.run, job.path, opts);
+      }
+      catch (exception &e) {
+        vlog() << "Run " << job.run << " failed: " << e.what() << endl;
+        job.status = 1;
+      }
+      job.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+      VetoLogBuffer() = 0;
+      lock_guard<mutex> lock(printMutex);
+      cout << buf.str() << flush;
+    }
+  };
+  auto tStart = chrono::steady_clock::now();
+  vector<thread> pool;
+  for (int t = 0; t < nThreads; t++) pool.push_back(thread(worker));
+  for (auto &t : pool) t.join();
+  double wallTime = chrono::duration<double>(chrono::steady_clock::now() - tStart).count();
+
+  // Throughput summary
+  long totEntries = 0;
+  int nFailed = 0;
+  double runTime = 0;
+  printf("\n==================== Batch summary =====================\n");
+  printf("%-10s %10s %10s %12s %s\n","run","entries","sec","entries/sec","status");
+  for (auto &job : jobs) {
+    printf("%-10i %10li %10.1f %12.0f %s\n", job.run, job.entries, job.seconds,
+      job.seconds > 0 ? job.entries/job.seconds : 0, job.status==0 ? "ok" : "FAILED");
+    if (job.status==0) totEntries += job.entries;
+    else nFailed++;
+    runTime += job.seconds;
+  }
+  printf("%i runs (%i failed), %li entries in %.1f sec wall time (%.1f sec summed over runs).\n",
+    (int)jobs.size(), nFailed, totEntries, wallTime, runTime);
+  printf("Throughput: %.0f entries/sec, %.2f runs/min.  Parallel speedup %.1fx on %i threads.\n",
+    wallTime > 0 ? totEntries/wallTime : 0, wallTime > 0 ? 60.*jobs.size()/wallTime : 0,
+    wallTime > 0 ? runTime/wallTime : 0, nThreads);
+  printf("========================================================\n\n");
+  return nFailed > 0;
+}
 
-  printf("=================== Done processing. ====================\n\n");
+// Set by SIGINT or SIGTERM: the daemon finishes its running jobs and exits.
+atomic<bool> gDaemonStop(false);
+void DaemonSignal(int) { gDaemonStop = true; }
+
+int RunDaemon(string spoolDir, int nThreads, RunOptions opts)
+{
+  VetoSpool spool(spoolDir);
+  if (!spool.Init()) {
+    cout << "Couldn't make spool directory " << spoolDir << ".  Exiting ...\n";
+    return 1;
+  }
+  if (spool.DaemonRunning()) {
+    cout << "A daemon is already running on " << spoolDir << ".  Exiting ...\n";
+    return 1;
+  }
+  spool.ClearStop();
+  int nRequeued = spool.Requeue();
+  if (!spool.WritePid()) cout << "Warning: couldn't write the pid file in " << spoolDir << endl;
+  signal(SIGINT, DaemonSignal);
+  signal(SIGTERM, DaemonSignal);
+
+  // Same setup as batch mode, done once for every job.
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory(kFALSE);
+  gStyle->SetOptStat(0);
+
+  // Kept between jobs: the GATDataSet run lookups and each run's products.
+  VetoProductsCache products;
+  opts.products = &products;
+  GATDataSet ds;
+  map<int,string> runPaths;
+
+  printf("auto-veto daemon (pid %i): spool %s, %i workers.\n", (int)getpid(), spool.GetDir().c_str(), nThreads);
+  if (nRequeued > 0) printf("Requeued %i jobs left running by an earlier daemon.\n", nRequeued);
+  cout << flush;
+
+  mutex statMutex;
+  long nJobs = 0, nFailed = 0, nWarmPath = 0;
+  double sumLatency = 0, maxLatency = 0, sumProc = 0;
+  auto worker = [&]() {
+    VetoSpoolJob job;
+    while (!gDaemonStop && !spool.StopRequested())
+    {
+      if (!spool.Claim(job)) {
+        this_thread::sleep_for(chrono::duration<double>(opts.pollSec));
+        continue;
+      }
+      job.started = VetoSpool::Now();
+      RunOptions jobOpts = opts;
+      if (!job.outputDir.empty()) jobOpts.outputDir = job.outputDir + "/";
+      if (job.synth) {
+        jobOpts.synthInput = true;
+        if (IsVetoSynthRecordFile(job.path)) jobOpts.output.schema = 2;
+      }
+      ostringstream buf;
+      VetoLogBuffer() = &buf;
+      try {
+        string path = job.path;
+        if (job.run > 60000000 && job.run < 70000000) {
+          vlog() << "Run " << job.run << ": veto data not present in Module 2 runs.\n";
+          job.status = 1;
+        }
+        else if (path.empty()) {
+          lock_guard<mutex> lock(gGATMutex);
+          auto it = runPaths.find(job.run);
+          job.warmPath = (it != runPaths.end());
+          if (job.warmPath) path = it->second;
+          else path = runPaths[job.run] = ds.GetPathToRun(job.run,GATDataSet::kBuilt);
+        }
+        if (job.status < 0) job.status = ProcessRun(job.run, path, jobOpts);
+      }
+      catch (exception &e) {
+        vlog() << "Run " << job.run << " failed: " << e.what() << endl;
+        job.status = 1;
+      }
+      VetoLogBuffer() = 0;
+      job.finished = VetoSpool::Now();
+      bool recorded = spool.Finish(job, buf.str());
+
+      lock_guard<mutex> lock(statMutex);
+      nJobs++;
+      if (job.status != 0) nFailed++;
+      if (job.warmPath) nWarmPath++;
+      sumLatency += job.LatencySec();
+      sumProc += job.ProcSec();
+      if (job.LatencySec() > maxLatency) maxLatency = job.LatencySec();
+      cout << buf.str();
+      printf("Job %s: run %i %s.  Waited %.2f sec, processed in %.2f sec, latency %.2f sec%s.\n",
+        job.id.c_str(), job.run, job.status==0 ? "ok" : "FAILED", job.WaitSec(), job.ProcSec(),
+        job.LatencySec(), job.warmPath ? " (cached run path)" : "");
+      if (!recorded) printf("Warning: couldn't record job %s in %s\n", job.id.c_str(), spool.GetDir().c_str());
+      cout << flush;
+    }
+  };
+  vector<thread> pool;
+  for (int t = 0; t < nThreads; t++) pool.push_back(thread(worker));
+  for (auto &t : pool) t.join();
+
+  spool.RemovePid();
+  spool.ClearStop();
+  printf("\n==================== Daemon summary ====================\n");
+  printf("%li jobs (%li failed, %li with cached run paths), %i still queued.\n", nJobs, nFailed, nWarmPath, spool.Queued());
+  if (nJobs > 0)
+    printf("Latency: mean %.2f sec, max %.2f sec.  Processing: mean %.2f sec.\n",
+      sumLatency/nJobs, maxLatency, sumProc/nJobs);
+  printf("Products kept for %lu runs.\n", products.Size());
+  printf("========================================================\n\n");
+  return nFailed > 0;
+}
+
+// Run (and file part) of a run file name: a built file, OR_run%i.root or OR_run%i_%i.root,
+// or a veto-gen record file, synth_run%i.vsyn.  False for anything else, e.g. auto-veto's
+// own veto_run%i.root output.
+bool ParseRunFileName(const string &name, long &run, long &part)
+{
+  string prefix, suffix = ".root";
+  if (name.compare(0, 6, "OR_run") == 0) prefix = "OR_run";
+  else if (name.compare(0, 9, "synth_run") == 0) { prefix = "synth_run"; suffix = ".vsyn"; }
+  else return false;
+  if (name.size() <= prefix.size() + suffix.size()) return false;
+  if (name.compare(name.size()-suffix.size(), suffix.size(), suffix) != 0) return false;
+  string num = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+  size_t us = num.find('_');
+  string runStr = num.substr(0, us), partStr = (us == string::npos) ? "0" : num.substr(us+1);
+  if (runStr.empty() || partStr.empty() || (suffix == ".vsyn" && us != string::npos)) return false;
+  if (runStr.find_first_not_of("0123456789") != string::npos) return false;
+  if (partStr.find_first_not_of("0123456789") != string::npos) return false;
+  run = stol(runStr);
+  part = stol(partStr);
+  return true;
+}
+
+// Newest run file in a directory (see ParseRunFileName), or "" if there isn't one.
+// Files with the same mtime are ordered by run number, then file part, then name,
+// so the answer doesn't change from one call to the next.
+string NewestRunFile(string dir)
+{
+  string newest, newestName;
+  time_t newestTime = 0;
+  long newestRun = -1, newestPart = -1;
+  DIR *d = opendir(dir.c_str());
+  if (!d) return newest;
+  while (dirent *ent = readdir(d)) {
+    string name = ent->d_name;
+    long run = 0, part = 0;
+    if (!ParseRunFileName(name, run, part)) continue;
+    string path = dir + "/" + name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) continue;
+    if (!newest.empty() && make_tuple(st.st_mtime, run, part, name)
+        <= make_tuple(newestTime, newestRun, newestPart, newestName)) continue;
+    newest = path;
+    newestName = name;
+    newestTime = st.st_mtime;
+    newestRun = run;
+    newestPart = part;
+  }
+  closedir(d);
+  return newest;
+}
+
+// Follow mode stops on SIGINT/SIGTERM too, so the status and profile still get written.
+atomic<bool> gFollowStop(false);
+void FollowSignal(int) { gFollowStop = true; }
+
+// Follow one growing file until it's idle, or (in directory mode) a newer run shows up.
+// With --profile, each file is a "follow" job: its appends and monitor updates.
+int FollowFile(string file, string dir, const RunOptions &opts)
+{
+  string statusFile = opts.statusFile.empty() ? opts.outputDir + "veto_live.json" : opts.statusFile;
+  bool synth = IsVetoSynthRecordFile(file);
+  unique_ptr<VetoRunCache> cache;
+  unique_ptr<VetoLiveMonitor> mon;
+  TChain *vetoChain = 0;
+  uint32_t prevFlags = 0;
+  auto lastGrowth = chrono::steady_clock::now();
+  unique_ptr<VetoProfiler> prof;
+  vlog() << "Following " << file << " (status: " << statusFile << ")\n";
+
+  while (!gFollowStop)
+  {
+    auto tPoll = chrono::steady_clock::now();
+    long nNew = 0;
+    VETO_SCOPE(pAppend, "append");
+    if (synth) {
+      if (!cache) {
+        cache.reset(new VetoRunCache(file, true));
+        if (cache->GetRunNumber() == 0) cache.reset();  // no header yet
+      }
+      if (cache) nNew = cache->AppendSynth();
+    }
+    else {
+      // A fresh chain each poll, so it sees the entries written since the last one.
+      TChain *chain = new TChain("VetoTree");
+      long have = cache ? cache->GetEntries() : 0;
+      if (chain->Add(file.c_str()) && chain->GetEntries() > have) {
+        if (!cache) {
+          cache.reset(new VetoRunCache(chain));
+          VetoGeometry geo(cache->GetRunNumber());
+          cache->StartFollow(geo.GetCard1(),geo.GetCard2());
+        }
+        nNew = cache->Append(chain);
+        delete vetoChain;
+        vetoChain = chain;
+      }
+      else delete chain;
+    }
+    pAppend.Stop(nNew);
+    if (cache && !mon) {
+      mon.reset(new VetoLiveMonitor(*cache, opts.cuts.overQDC, opts.cuts.minPanels, opts.cuts.LEDMultipThreshold));
+      vlogf("Run %i: monitoring.\n",cache->GetRunNumber());
+      if (!opts.profileFile.empty()) {
+        // The first appends aren't in it: the run number isn't known until the cache exists.
+        prof.reset(new VetoProfiler("follow", cache->GetRunNumber()));
+        VetoProfilerCurrent() = prof.get();
+      }
+    }
+
+    if (nNew > 0) {
+      lastGrowth = chrono::steady_clock::now();
+      bool hadThresh = mon->HaveThresholds();
+      VETO_SCOPE(pMon, "monitor");
+      mon->Update();
+      pMon.Stop(nNew);
+      double pollSec = chrono::duration<double>(chrono::steady_clock::now() - tPoll).count();
+      if (!mon->WriteStatus(statusFile, pollSec)) vlog() << "Warning: couldn't write " << statusFile << endl;
+      if (!hadThresh && mon->HaveThresholds())
+        vlogf("Run %i: found QDC thresholds after %li entries.\n",cache->GetRunNumber(),mon->GetChecked());
+
+      // Report flags when they're raised or cleared
+      uint32_t flags = mon->Flags();
+      for (int i = 0; i < kNLiveFlags; i++) {
+        bool now = (flags >> i) & 1, before = (prevFlags >> i) & 1;
+        if (now == before) continue;
+        vlogf("Run %i entry %li (veto time %.1f s): %s %s\n", cache->GetRunNumber(), mon->GetChecked()-1,
+          mon->GetLatestTime(), kLiveFlagNames[i], now ? "RAISED" : "cleared");
+      }
+      prevFlags = flags;
+    }
+
+    double idle = chrono::duration<double>(chrono::steady_clock::now() - lastGrowth).count();
+    if (opts.idleSec > 0 && idle > opts.idleSec) break;
+    if (!dir.empty() && NewestRunFile(dir) != file) break;
+    this_thread::sleep_for(chrono::duration<double>(opts.pollSec));
+  }
+
+  if (mon) {
+    mon->WriteStatus(statusFile, 0, true);
+    vlogf("Run %i: %li entries, %li muons.  Stopped following %s\n",
+      cache->GetRunNumber(), mon->GetChecked(), mon->GetMuons(), file.c_str());
+  }
+  if (prof) {
+    VetoProfilerCurrent() = 0;
+    prof->SetCounter("entries", mon->GetChecked());
+    prof->SetCounter("muons", mon->GetMuons());
+    prof->SetPeakRSS();
+    VetoProfileReport::Get().Add(*prof);
+  }
+  mon.reset();
+  cache.reset();
+  delete vetoChain;
+  return 0;
+}
+
+int FollowRun(string path, const RunOptions &opts)
+{
+  signal(SIGINT, FollowSignal);
+  signal(SIGTERM, FollowSignal);
+
+  // A directory: follow its newest run, and move on to the next one when it shows up.
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return FollowFile(path, "", opts);
+  auto lastFile = chrono::steady_clock::now();
+  string done;
+  while (!gFollowStop) {
+    string file = NewestRunFile(path);
+    if (!file.empty() && file != done) {
+      FollowFile(file, path, opts);
+      done = file;
+      lastFile = chrono::steady_clock::now();
+    }
+    double idle = chrono::duration<double>(chrono::steady_clock::now() - lastFile).count();
+    if (opts.idleSec > 0 && idle > opts.idleSec) return 0;
+    this_thread::sleep_for(chrono::duration<double>(opts.pollSec));
+  }
   return 0;
 }
 
-vector<int> MeasurePanelThresholds(TChain *vetoChain, string outputDir, bool makePlots)
+vector<int> MeasurePanelThresholds(VetoRunCache &cache, string outputDir, VetoProducts &prod, bool makePlots,
+  bool sample, bool checkSample)
 {
   // format: (panel 1) (threshold 1) (panel 2) (threshold 2) ...
   vector<int> thresholds;
   int threshVal = 35;	// how many QDC above the pedestal we set the threshold at
 
-  long vEntries = vetoChain->GetEntries();
-  TTreeReader reader(vetoChain);
-  TTreeReaderValue<unsigned int> vMult(reader, "mVeto");
-  TTreeReaderValue<uint32_t> vBits(reader, "vetoBits");
-  TTreeReaderValue<MGTBasicEvent> vEvt(reader,"vetoEvent");
-  TTreeReaderValue<MJTRun> vRun(reader,"run");
-  reader.Next();
-  int runNum = vRun->GetRunNumber();
-  reader.SetTree(vetoChain);  // resets the reader
+  // The thresholds come from every entry, unless a sample of the run is asked for
+  // (SampleThresholds in VetoThreshold.hh).  The sample isn't guaranteed to give the
+  // same thresholds, so it's opt-in.  The plots need every entry.
+  bool sampled = (sample || checkSample) && !makePlots;
+
+  // Reuse the saved thresholds, unless we're making plots or checking the sample.
+  uint64_t key = prod.StageKey(kThreshStage, VetoKey().Add(threshVal).Add(sampled));
+  if (!makePlots && !checkSample && prod.Has(kThreshStage, key)) {
+    vlog() << "Reusing saved QDC thresholds.\n";
+    for (int i = 0; i < 32; i++) {
+      thresholds.push_back(i);
+      thresholds.push_back(prod.swThresh[i]);
+    }
+    prod.nReused++;
+    return thresholds;
+  }
+
+  VETO_SCOPE(pThresh, "MeasurePanelThresholds");
+  long vEntries = cache.GetEntries();
+  int runNum = cache.GetRunNumber();
 
-  gStyle->SetOptStat(0);
   int bins=500, lower=0, upper=500;
   TH1D *hLowQDC[32];
   TH1D *hFullQDC[32];
@@ -130,71 +860,110 @@ vector<int> MeasurePanelThresholds(TChain *vetoChain, string outputDir, bool mak
   int def[32] = {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
   long skippedEvents = 0;
 
-  // MJVetoEvent variables, with run-based card numbers
-  int card1=0, card2=0;
-  SetCardNumbers(runNum,card1,card2);
-  MJVetoEvent veto(card1,card2);
-  MJVetoEvent prev, first;
-  // printf("VME Slots: QDC1 %i  QDC2 %i\n",card1,card2);
-
-  while (reader.Next())
-  {
-    long i = reader.GetCurrentEntry();
-    int run = vRun->GetRunNumber();
-    veto.SetSWThresh(def);
-    veto.WriteEvent(i,&*vRun,&*vEvt,*vBits,run,true);
-    if (CheckErrors(veto,prev))
+  // Full scan: every entry into the low-QDC histograms (and the full-range ones, if given).
+  VetoRecord veto, prev;
+  auto scanAll = [&](TH1D **low, TH1D **full) {
+    cache.SetSWThresh(def);
+    cache.Rewind();
+    prev = VetoRecord();
+    while (cache.Next(veto))
     {
-      skippedEvents++;
-      // do the end of event resets before continuing
-      prev = veto;
-      veto.Clear();
+      if (CheckErrors(veto,prev) & kSkipErrors)
+      {
+        skippedEvents++;
+        // do the end of event resets before continuing
+        prev = veto;
         continue;
       }
       for (int q = 0; q < 32; q++) {
-        hLowQDC[q]->Fill(veto.GetQDC(q));
-        hFullQDC[q]->Fill(veto.GetQDC(q));
+        low[q]->Fill(veto.GetQDC(q));
+        if (full) full[q]->Fill(veto.GetQDC(q));
+      }
+      // save previous entries for the event error check
+      prev = veto;
     }
-    // save previous entries for the event error check
-    prev = veto;
-    veto.Clear();
-  }
-  if (skippedEvents > 0) printf("MeasurePanelThresholds skipped %li of %li entries.\n",skippedEvents,vEntries);
+    pThresh.AddEntries(vEntries);
+  };
 
   int thresh[32] = {9999};
+  if (sampled)
+  {
+    VetoThreshSample samp = SampleThresholds(cache, hLowQDC, threshVal);
+    pThresh.AddEntries(samp.read);
+    for (int i = 0; i < 32; i++) thresh[i] = samp.thresh[i];
+    vlogf("QDC thresholds from %li of %li entries (%.1f%%).  %i panels didn't converge and used the whole run.\n",
+      samp.read, vEntries, vEntries > 0 ? 100.*samp.read/vEntries : 0, samp.nFullScan);
+    vlog() << "Entries used per panel:";
+    for (int i = 0; i < 32; i++) vlog() << " " << samp.used[i] << (samp.converged[i] ? "" : "*");
+    vlog() << endl;
+    if (samp.skipped > 0) vlogf("MeasurePanelThresholds skipped %li of %li entries read.\n",samp.skipped,samp.read);
+    if (VetoProfiler *prof = VetoProfilerCurrent()) {
+      prof->SetCounter("threshEntriesRead", samp.read);
+      prof->SetCounter("threshFullScanPanels", samp.nFullScan);
+    }
+
+    // Validation: the full scan, panel by panel
+    if (checkSample) {
+      TH1D *hCheck[32];
+      for (int i = 0; i < 32; i++) {
+        sprintf(hname,"hCheckQDC%d",i);
+        hCheck[i] = new TH1D(hname,hname,bins,lower,upper);
+      }
+      scanAll(hCheck, 0);
+      int nDiff = 0, maxDiff = 0;
+      for (int i = 0; i < 32; i++) {
+        int full = FindThreshold(hCheck[i],threshVal,i,runNum);
+        if (full != thresh[i]) {
+          vlogf("Threshold check: panel %i sampled %i, full scan %i (%li of %li entries)\n",
+            i, thresh[i], full, samp.used[i], vEntries-skippedEvents);
+          nDiff++;
+          maxDiff = max(maxDiff, abs(full - thresh[i]));
+        }
+        delete hCheck[i];
+      }
+      vlogf("Threshold check: %i of 32 panels differ from the full scan (max %i QDC).\n",nDiff,maxDiff);
+      if (VetoProfiler *prof = VetoProfilerCurrent()) prof->SetCounter("threshMismatches", nDiff);
+    }
+  }
+  else
+  {
+    scanAll(hLowQDC, hFullQDC);
+    if (skippedEvents > 0) vlogf("MeasurePanelThresholds skipped %li of %li entries.\n",skippedEvents,vEntries);
+    for (int i = 0; i < 32; i++) thresh[i] = FindThreshold(hLowQDC[i],threshVal,i,runNum);
+  }
+
   for (int i = 0; i < 32; i++)
   {
-    thresh[i] = FindThreshold(hLowQDC[i],threshVal,i,runNum);
     thresholds.push_back(i);
     thresholds.push_back(thresh[i]);
+    prod.swThresh[i] = thresh[i];
   }
-  // cout << "Found thresholds: " << endl;
+  prod.key[kThreshStage] = key;
+  // vlog() << "Found thresholds: " << endl;
   // for (int i = 0; i < 32; i++)
-    // cout << i << " " << thresh[i] << endl;
+    // vlog() << i << " " << thresh[i] << endl;
 
   if (makePlots)
   {
     // re-scan with the found thresholds to make a multiplicity plot
-    reader.SetTree(vetoChain);  // resets the reader
-    while (reader.Next())
+    pThresh.AddEntries(vEntries);
+    cache.SetSWThresh(thresh);
+    cache.Rewind();
+    while (cache.Next(veto))
     {
-      long i = reader.GetCurrentEntry();
-      int run = vRun->GetRunNumber();
-      veto.SetSWThresh(thresh);
-      veto.WriteEvent(i,&*vRun,&*vEvt,*vBits,run,true);
-      if (CheckErrors(veto,prev))
+      if (CheckErrors(veto,prev) & kSkipErrors)
       {
         skippedEvents++;
         // do the end of event resets before continuing
         prev = veto;
-        veto.Clear();
-          continue;
-        }
+        continue;
+      }
       hMultip->Fill(veto.GetMultip());
       // save previous entries for the event error check
       prev = veto;
-      veto.Clear();
     }
+    lock_guard<mutex> lock(gPlotMutex);
+    gStyle->SetOptStat(0);
     TCanvas *c1 = new TCanvas("c1","full QDC",1600,1200);
     c1->Divide(8,4,0,0);
     for (int i=0; i<32; i++)
@@ -225,11 +994,21 @@ vector<int> MeasurePanelThresholds(TChain *vetoChain, string outputDir, bool mak
     c1->Print(TString::Format("%s/veto-%i-qdc.pdf",outputDir.c_str(),runNum));
     c2->Print(TString::Format("%s/veto-%i-qdcThresh.pdf",outputDir.c_str(),runNum));
     c3->Print(TString::Format("%s/veto-%i-multip.pdf",outputDir.c_str(),runNum));
+    delete c1;
+    delete c2;
+    delete c3;
   }
+  for (int i = 0; i < 32; i++) {
+    delete hLowQDC[i];
+    delete hFullQDC[i];
+  }
+  delete hMultip;
   return thresholds;
 }
 
-void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir, bool errorCheckOnly, bool vetoOnly)
+void ProcessVetoData(VetoRunCache &cache, const VetoGeometry &geo, vector<int> thresholds, string outputDir,
+  const VetoOutConfig &outCfg, const VetoMuonCuts &cuts, VetoProducts &prod,
+  bool errorCheckOnly, bool vetoOnly, bool syncOutput)
 {
   // QDC software threshold (obtained from MeasurePanelThresholds)
   int swThresh[32] = {0};
@@ -237,7 +1016,7 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
     swThresh[thresholds[i]] = thresholds[i+1];
 
   // LED variables
-  int LEDMultipThreshold=5;  // "multipThreshold" = "highestMultip" - "LEDMultipThreshold"
+  int LEDMultipThreshold=cuts.LEDMultipThreshold;  // "multipThreshold" = "highestMultip" - "LEDMultipThreshold"
   int LEDSimpleThreshold=10;  // used when LED frequency measurement is bad.
   int highestMultip=0, multipThreshold=0;
   double LEDfreq=0, LEDperiod=0;
@@ -248,12 +1027,12 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   double LEDQDCTotal[32] = {0};
   int nonLEDHitCount[32] = {0};
 
-  // Error check variables
-  vector<int> SeriousErrors = {1, 4, 13, 14, 18, 19, 20, 21, 22, 23, 24, 25, 26};
+  // Error check variables (see VetoErrors.hh)
   int SeriousErrorCount = 0;
   int TotalErrorCount = 0;
-  vector<int> Error(nErrs); // write this to ROOT tree
-  vector<int> ErrorCount(nErrs); // don't write this, but keep it for the error summary.
+  uint32_t ErrorBits = 0;   // event-level error mask, bit i = error i.  Write this to ROOT tree
+  vector<int> Error(nErrs); // unpacked copy of ErrorBits, kept for existing readers of "Errors"
+  int ErrorCount[nErrs] = {0}; // don't write this, but keep it for the error summary.
   long skippedEvents=0;
 
   // time variables
@@ -272,77 +1051,104 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   // muon ID variables
   bool LEDCut = true;
   bool EnergyCut = false;
-  vector<int> CoinType(32), Plane(32);
+  uint16_t PlaneMask = 0;  // bit p: plane p was hit
+  uint8_t CoinBits = 0;    // coincidence bits, see VetoCoincidence.hh
 
   // initialize input data
-  long vEntries = vetoChain->GetEntries();
-  TTreeReader reader(vetoChain);
-  TTreeReaderValue<unsigned int> vMult(reader, "mVeto");
-  TTreeReaderValue<uint32_t> vBits(reader, "vetoBits");
-  TTreeReaderValue<MGTBasicEvent> vEvt(reader,"vetoEvent");
-  TTreeReaderValue<MJTRun> vRun(reader,"run");
-  TTreeReaderValue<long> bTimeStart(reader,"fStartTime");
-  TTreeReaderValue<long> bTimeStop(reader,"fStopTime");
-  reader.SetEntry(0);
-  int runNum = vRun->GetRunNumber();
-  // start = vRun->GetStartTime(); // method 1
-  // stop = vRun->GetStopTime();
-  start = (*bTimeStart);  // method 2
-  stop = (*bTimeStop);
+  long vEntries = cache.GetEntries();
+  int runNum = cache.GetRunNumber();
+  start = cache.GetStartTime();  // from the fStartTime/fStopTime branches
+  stop = cache.GetStopTime();
   unixDuration = (double)(stop - start);
-  reader.SetTree(vetoChain);  // resets the reader
+  cache.SetSWThresh(swThresh);
+  cache.SetOverQDC(cuts.overQDC);  // measured muon energy threshold, for the energy cut
 
-  // MJVetoEvent variables, with run-based card numbers
-  int card1=0, card2=0;
-  SetCardNumbers(runNum,card1,card2);
-  MJVetoEvent veto(card1,card2);
-  MJVetoEvent sync, prev, prevLED, out;
+  // decoded entries (the full MJVetoEvent is only rebuilt for the output trees)
+  VetoRecord veto, sync, prev;
 
-  // initialize output file
+  // initialize output file (layouts are described in VetoOutput.hh)
   char outputFile[200];
   sprintf(outputFile,"%s/veto_run%i.root",outputDir.c_str(),runNum);
-  TFile *RootFile = new TFile(outputFile, "RECREATE");
+  // Declared before the writer, so an early return finishes the writer before the file closes.
+  unique_ptr<TFile> RootFile(new TFile(outputFile, "RECREATE"));
+  if (!outCfg.UseDefaultCompression()) RootFile->SetCompressionSettings(outCfg.GetCompression());
+  bool schemaV1 = (outCfg.schema == 1);
+  VetoOutEntry outEntry;   // v2 per-entry output, handed to the writer
+  VetoOutEntryV1 outV1;    // v1 per-entry output
+  VetoRunInfo runInfo;     // v2 run-level quantities
   TTree *vetoTree = new TTree("vetoTree","MJD Veto Events");
-  // event info
-  vetoTree->Branch("run",&runNum);
-  vetoTree->Branch("vetoEvent","MJVetoEvent",&out,32000,1);
-  // time variables
-  vetoTree->Branch("xTime",&xTime);
-  vetoTree->Branch("timeUncert",&timeUncert);
-  vetoTree->Branch("syncUncert",&syncUncert);
-  vetoTree->Branch("jumpCorrection",&jumpCorrection);
-  vetoTree->Branch("deltaScaler",&deltaScaler);
-  vetoTree->Branch("deltaSBC",&deltaSBC);
-  vetoTree->Branch("timePrevLED",&timePrevLED);
-  vetoTree->Branch("start",&start,"start/L");
-  vetoTree->Branch("stop",&stop,"stop/L");
-  vetoTree->Branch("unixDuration",&unixDuration);
-  vetoTree->Branch("scalerDuration",&scalerDuration);
-  vetoTree->Branch("scalerOffset",&scalerOffset);
-  vetoTree->Branch("sbcOffset",&sbcOffset);
-  vetoTree->Branch("sbcUnc",&sbcUnc);
-  vetoTree->Branch("entryAfterFlush",&entryAfterFlush);
-  vetoTree->Branch("applyOffset",&applyOffset);
-  // LED variables
-  vetoTree->Branch("LEDfreq",&LEDfreq);
-  vetoTree->Branch("multipThreshold",&multipThreshold);
-  vetoTree->Branch("highestMultip",&highestMultip);
-  vetoTree->Branch("LEDMultipThreshold",&LEDMultipThreshold);
-  vetoTree->Branch("LEDSimpleThreshold",&LEDSimpleThreshold);
-  vetoTree->Branch("useSimpleThreshold",&useSimpleThreshold);
-  // muon ID variables
-  vetoTree->Branch("CoinType",&CoinType);
-  vetoTree->Branch("Plane",&Plane);
-  // error variables
-  vetoTree->Branch("Errors",&Error);
-
-  // Error "garbage event" tree
   TTree *skipTree = new TTree("skipTree","skipped veto events");
-  skipTree->Branch("run",&runNum);
-  skipTree->Branch("vetoEvent","MJVetoEvent",&out,32000,1);
-  skipTree->Branch("Errors",&Error);
-  skipTree->Branch("start",&start,"start/L");
-  skipTree->Branch("stop",&stop,"stop/L");
+  TTree *runInfoTree = 0;
+  // The writer books vetoTree and skipTree (VetoOutEntryV1 or VetoOutEntry), and fills
+  // them on its own thread unless -s.
+  unique_ptr<VetoTreeWriterBase> writer;
+  VetoTreeWriter<VetoOutEntryV1> *writerV1 = 0;
+  VetoTreeWriter<VetoOutEntry> *writerV2 = 0;
+  if (schemaV1) {
+    writerV1 = new VetoTreeWriter<VetoOutEntryV1>(vetoTree, skipTree, !syncOutput);
+    writer.reset(writerV1);
+    outV1.Errors.resize(nErrs);
+  }
+  else {
+    writerV2 = new VetoTreeWriter<VetoOutEntry>(vetoTree, skipTree, !syncOutput);
+    writer.reset(writerV2);
+
+    // Run-level quantities (filled once, after the muon scan)
+    runInfoTree = new TTree("runInfo","veto run info");
+    runInfo.Book(runInfoTree);
+  }
+  if (outCfg.basketSize > 0) {
+    vetoTree->SetBasketSize("*",outCfg.basketSize);
+    skipTree->SetBasketSize("*",outCfg.basketSize);
+  }
+  // Writes entry i to vetoTree, or to skipTree if it was skipped
+  auto writeEntry = [&](long i, const VetoRecord &rec, bool skipped) {
+    if (schemaV1) {
+      cache.FillEvent(i,outV1.event);
+      outV1.run = runNum;
+      outV1.xTime = xTime;
+      outV1.timeUncert = timeUncert;
+      outV1.syncUncert = syncUncert;
+      outV1.jumpCorrection = jumpCorrection;
+      outV1.deltaScaler = deltaScaler;
+      outV1.deltaSBC = deltaSBC;
+      outV1.timePrevLED = timePrevLED;
+      outV1.start = start;
+      outV1.stop = stop;
+      outV1.unixDuration = unixDuration;
+      outV1.scalerDuration = scalerDuration;
+      outV1.scalerOffset = scalerOffset;
+      outV1.sbcOffset = sbcOffset;
+      outV1.sbcUnc = sbcUnc;
+      outV1.entryAfterFlush = entryAfterFlush;
+      outV1.applyOffset = applyOffset;
+      outV1.LEDfreq = LEDfreq;
+      outV1.multipThreshold = multipThreshold;
+      outV1.highestMultip = highestMultip;
+      outV1.LEDMultipThreshold = LEDMultipThreshold;
+      outV1.LEDSimpleThreshold = LEDSimpleThreshold;
+      outV1.useSimpleThreshold = useSimpleThreshold;
+      outV1.PlaneMask = PlaneMask;
+      outV1.CoinBits = CoinBits;
+      outV1.ErrorBits = ErrorBits;
+      for (int j=0; j<nErrs; j++) outV1.Errors[j] = Error[j];
+      writerV1->Push(outV1, skipped);
+      return;
+    }
+    outEntry.ev.Set(runNum,rec);
+    outEntry.xTime = xTime;
+    outEntry.timeUncert = timeUncert;
+    outEntry.jumpCorrection = jumpCorrection;
+    outEntry.deltaScaler = deltaScaler;
+    outEntry.deltaSBC = deltaSBC;
+    outEntry.timePrevLED = timePrevLED;
+    outEntry.PlaneMask = PlaneMask;
+    outEntry.CoinBits = CoinBits;
+    outEntry.ErrorBits = ErrorBits;
+    outEntry.start = start;
+    outEntry.stop = stop;
+    writerV2->Push(outEntry, skipped);
+  };
 
   // ==================== 1st loop over veto entries  =================
   // Measure the LED frequency, find the highest-multiplicity entry,
@@ -358,162 +1164,225 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   if (syncEvent > vEntries) syncEvent=1;
   bool foundSyncEvent = false;
   bool foundBufferFlush = false;
-  TH1D *LEDDeltaT = new TH1D("LEDDeltaT","LEDDeltaT",100000,0,100); // 0.001 sec/bin
-  while(reader.Next())
-  {
-    long i = reader.GetCurrentEntry();
-    veto.Clear();
-    veto.SetSWThresh(swThresh);
-    veto.WriteEvent(i,&*vRun,&*vEvt,*vBits,runNum,true);
-
-    if (veto.GetBadScaler() && (runNum < 6965 || runNum > 45000000)) {
-      badEntries.push_back(i);
-      packetList.push_back(veto.GetScalerIndex());
+  long dtEntries = 0;
+  double dtPeriod = 0;
+
+  // The scan only depends on the thresholds, so reuse it if they haven't changed.
+  uint64_t scanKey = prod.StageKey(kScanStage, VetoKey().Add(swThresh).Add(LEDSimpleThreshold));
+  if (prod.Has(kScanStage, scanKey)) {
+    vlog() << "Reusing saved LED and buffer flush scan.\n";
+    highestMultip = prod.highestMultip;
+    simpleLEDCount = prod.simpleLEDCount;
+    entryAfterFlush = prod.entryAfterFlush;
+    dtEntries = prod.LEDEntries;
+    dtPeriod = prod.LEDPeriod;
+    firstGoodScaler = prod.firstGoodScaler;
+    lastGoodScaler = prod.lastGoodScaler;
+    for (int j = 0; j < 32; j++) {
+      LEDQDCTotal[j] = prod.LEDQDCTotal[j];
+      nonLEDHitCount[j] = prod.nonLEDHitCount[j];
     }
+    badEntries = prod.badEntries;
+    packetList = prod.packetList;
+    foundSyncEvent = (prod.syncEntry >= 0);
+    if (foundSyncEvent) cache.Read(prod.syncEntry, sync);
+    cache.Read(vEntries-1, prev);  // as the scan leaves it
+    prod.nReused++;
+  }
+  else {
+    LEDTimer LEDDeltaT;
+    VETO_SCOPE(pLoop1, "loop1");
+    cache.Rewind();
+    while(cache.Next(veto))
+    {
+      long i = veto.GetEntry();
 
-    if (firstGoodScaler==0 && !veto.GetBadScaler())
-      firstGoodScaler = veto.GetTimeSec();
-    if (!veto.GetBadScaler()) lastGoodScaler = veto.GetTimeSec();
+      if (veto.GetBadScaler() && (runNum < 6965 || runNum > 45000000)) {
+        badEntries.push_back(i);
+        packetList.push_back(veto.GetScalerIndex());
+      }
 
-    if (CheckErrors(veto,prev,Error)){
-      skippedEvents++;
-      if (Error[25]) {
-        foundBufferFlush = true;
-        entryAfterFlush = i;
-        // cout << i << " Found buffer flush.  Index: " << veto.GetScalerIndex() << endl;
+      if (firstGoodScaler==0 && !veto.GetBadScaler())
+        firstGoodScaler = veto.GetTimeSec();
+      if (!veto.GetBadScaler()) lastGoodScaler = veto.GetTimeSec();
+
+      ErrorBits = CheckErrors(veto,prev);
+      if (ErrorBits & kSkipErrors){
+        skippedEvents++;
+        if (ErrorBits & ErrorBit(25)) {
+          foundBufferFlush = true;
+          entryAfterFlush = i;
+          // vlog() << i << " Found buffer flush.  Index: " << veto.GetScalerIndex() << endl;
+        }
+        // do end of loop reset
+        prev = veto;
+        continue;
       }
-      // do end of loop reset
-      prev = veto;
-      continue;
-    }
-    // Don't let the sync event be the first one, we need a Ge entry before and after it.
-    else if (!foundSyncEvent && i > syncEvent && !veto.GetBadScaler()) {
-      foundSyncEvent = true;
-      sync = veto;
-    }
-    if (veto.GetMultip() > highestMultip)
-      highestMultip = veto.GetMultip();
+      // Don't let the sync event be the first one, we need a Ge entry before and after it.
+      else if (!foundSyncEvent && i > syncEvent && !veto.GetBadScaler()) {
+        foundSyncEvent = true;
+        sync = veto;
+      }
+      if (veto.GetMultip() > highestMultip)
+        highestMultip = veto.GetMultip();
 
-    if (veto.GetMultip() > LEDSimpleThreshold) {
-      LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
-      simpleLEDCount++;
+      if (veto.GetMultip() > LEDSimpleThreshold) {
+        LEDDeltaT.Fill(veto.GetTimeSec()-prev.GetTimeSec());
+        simpleLEDCount++;
 
-      // Find total qdc for error 29
-      for (int j = 0; j < 32; j++) LEDQDCTotal[j] += veto.GetQDC(j);
-    }
+        // Find total qdc for error 29
+        for (int j = 0; j < 32; j++) LEDQDCTotal[j] += veto.GetQDC(j);
+      }
 
-    // Count number of non-LED panel hits
-    for (int j = 0; j < 32; j++)
-      if (veto.GetQDC(j) > veto.GetSWThresh(j) && veto.GetMultip() <= LEDSimpleThreshold)
-        nonLEDHitCount[j]++;
+      // Count number of non-LED panel hits
+      if (veto.GetMultip() <= LEDSimpleThreshold)
+        for (uint32_t m = veto.GetHitMask(); m; m &= m-1)
+          nonLEDHitCount[__builtin_ctz(m)]++;
 
-    // end of loop reset
-    prev = veto;
-  }
-  if (foundBufferFlush) {
-    entryAfterFlush += syncEvent;
-    while(1){
-      if (entryAfterFlush >= vEntries-1) break;
-      cout << "Warning: found buffer flush.  Syncing with entry : " << entryAfterFlush << endl;
-      reader.SetTree(vetoChain); // reset the reader
-      reader.SetEntry(entryAfterFlush);
-      sync.WriteEvent(entryAfterFlush,&*vRun,&*vEvt,*vBits,runNum,true);
-      if (!sync.GetBadScaler()) break; // don't sync off a bad scaler
-      else entryAfterFlush++;
+      // end of loop reset
+      prev = veto;
     }
+    pLoop1.Stop(vEntries);
+    if (foundBufferFlush) {
+      entryAfterFlush += syncEvent;
+      while(1){
+        if (entryAfterFlush >= vEntries-1) break;
+        vlog() << "Warning: found buffer flush.  Syncing with entry : " << entryAfterFlush << endl;
+        cache.Read(entryAfterFlush,sync);
+        if (!sync.GetBadScaler()) break; // don't sync off a bad scaler
+        else entryAfterFlush++;
+      }
+    }
+    dtEntries = LEDDeltaT.GetEntries();
+    if (dtEntries > 0) dtPeriod = LEDDeltaT.GetPeriod();
+
+    prod.highestMultip = highestMultip;
+    prod.simpleLEDCount = simpleLEDCount;
+    prod.entryAfterFlush = entryAfterFlush;
+    prod.LEDEntries = dtEntries;
+    prod.LEDPeriod = dtPeriod;
+    prod.firstGoodScaler = firstGoodScaler;
+    prod.lastGoodScaler = lastGoodScaler;
+    for (int j = 0; j < 32; j++) {
+      prod.LEDQDCTotal[j] = LEDQDCTotal[j];
+      prod.nonLEDHitCount[j] = nonLEDHitCount[j];
+    }
+    prod.badEntries = badEntries;
+    prod.packetList = packetList;
+    prod.syncEntry = foundSyncEvent ? sync.GetEntry() : -1;
+    prod.key[kScanStage] = scanKey;
   }
 
   // ============== Loop 1-a: Scan built data for rough sync ==============
   // Scan the built data for this run to determine if there is a scaler offset.
   // Find times of Ge events whose packets are immediately before and after the "sync" event.
+  // This only reads the start of the built chain (ScanGeSync, GeTimeIndex.hh).
   // NOTE: In the event that "sync" is still within a buffer flush, this may fail to
   //       find a "before" event.  (this is rare.)
 
-  if (foundSyncEvent && !vetoOnly)
-  {
-    GATDataSet *ds = new GATDataSet(runNum);
-    TChain *builtChain = ds->GetBuiltChain(false);
-    MGTEvent *evt=0;
-    MGVDigitizerData *dig=0;
-    builtChain->SetBranchAddress("event",&evt);
-    double bTimeFirst=0, bTimeBefore=0, bTimeAfter=0;
-    uint64_t bItr=0,bIndex=0;
-    int packetDiff = 99999999, minPacketDiff = 99999999;
-    int maxEntry = 200;
-    bool foundPacketAfter = false;
-    while (true)
+  // The full Ge packet/timestamp index is only loaded (or built) for the bad-scaler
+  // interpolation.  Synthetic runs with a .geidx bring their own, and have no built
+  // chain to scan.  Built files from veto-gen are their own built chain.
+  TChain *synthVeto = cache.IsSynthBuilt() ? cache.GetChain() : 0;
+  GeTimeIndex geIndex;
+  bool geIndexLoaded = false;
+  auto getGeIndex = [&]() -> const GeTimeIndex& {
+    if (!geIndexLoaded && cache.HasSynthGeIndex()) {
+      if (!geIndex.Load(cache.GetGeIndexFile(), cache.GetBuiltEntries(), 0))
+        vlog() << "Warning: couldn't read " << cache.GetGeIndexFile() << endl;
+    }
+    else if (!geIndexLoaded) LoadGeTimeIndex(runNum, synthVeto, outputDir, geIndex);
+    geIndexLoaded = true;
+    return geIndex;
+  };
+
+  VETO_SCOPE(pSync, "sync");
+  uint64_t syncKey = prod.StageKey(kSyncStage, VetoKey().Add(scanKey).Add(vetoOnly));
+  if (prod.Has(kSyncStage, syncKey)) {
+    vlog() << "Reusing saved veto/Ge clock sync.\n";
+    scalerOffset = prod.scalerOffset;
+    syncUncert = prod.syncUncert;
+    sbcOffset = prod.sbcOffset;
+    sbcUnc = prod.sbcUnc;
+    applyOffset = prod.applyOffset;
+    prod.nReused++;
+  }
+  else {
+    if (foundSyncEvent && !vetoOnly)
     {
-      builtChain->GetEntry(bItr);
-      if (evt->GetNDigitizerData() > 0)
+      double bTimeFirst=0, bTimeBefore=0, bTimeAfter=0;
+      long bEntries = 0;
+      if (cache.HasSynthGeIndex()) {
+        const GeTimeIndex &ge = getGeIndex();
+        bTimeFirst = ge.GetFirstTime();
+        ge.Around(sync.GetScalerIndex(), bTimeBefore, bTimeAfter);
+        bEntries = ge.GetBuiltEntries();
+      }
+      else bEntries = SyncBuiltChain(runNum, synthVeto, sync.GetScalerIndex(), bTimeFirst, bTimeBefore, bTimeAfter);
+      double bVetoTime = (bTimeAfter + bTimeBefore)/2.;
+      scalerOffset = bVetoTime-sync.GetTimeSec();
+      syncUncert = (bTimeAfter - bTimeBefore)/2.;
+      sbcOffset = bVetoTime - sync.GetTimeSBC();
+      sbcUnc = syncUncert;
+
+      vlogf("Syncing entry %i (packet %li) with Ge timestamps.\n",sync.GetEntry(),sync.GetScalerIndex());
+      if (fabs(sync.GetTimeSec() - bVetoTime) > syncUncert)
       {
-        dig = evt->GetDigitizerData(0);
-        bIndex = dig->GetIndex();
-        if (bTimeFirst == 0) bTimeFirst = ((double)dig->GetTimeStamp())*1.e-8;
-        if ((int)bIndex < sync.GetScalerIndex()) bTimeBefore = ((double)dig->GetTimeStamp())*1.e-8;
-
-        // Minimize the difference between packets to find the closest Ge event AFTER the veto sync event.
-        // (helps correct for irregular packet order from buffer flush)
-
-        packetDiff = abs((int)bIndex-sync.GetScalerIndex());
-        if ((int)bIndex > sync.GetScalerIndex() && packetDiff < minPacketDiff)
-          bTimeAfter = ((double)dig->GetTimeStamp())*1.e-8;
-
-        // printf("%li (max %i)  ind %lu  first %.3f  before %.3f  after %.3f  diff: %i  minDiff %i\n", bItr,maxEntry,bIndex,bTimeFirst,bTimeBefore,bTimeAfter,packetDiff,minPacketDiff);
-
-        if (packetDiff < minPacketDiff && (int)bIndex > sync.GetScalerIndex()) {
-          minPacketDiff = packetDiff;
-          foundPacketAfter = true;
-        }
+        vlogf("Sync results from built chain: first %.1fs  before %.1fs  after %.1fs  sync.Scaler %.1fs\n", bTimeFirst,bTimeBefore,bTimeAfter,sync.GetTimeSec());
+        vlogf("Built chain has %li entries.\n",bEntries);
+        vlogf("Scaler (%.2f) out of sync with trigger card (%.2f) by %.3f +/- %.3f sec.\n", sync.GetTimeSec(),bVetoTime,scalerOffset,syncUncert);
+        applyOffset = true;
+      }
+      if (syncUncert == bVetoTime) {
+        vlog() << "Warning: Sync failed, run " << runNum << "\n";
+        applyOffset = false;
       }
-      // if ((int)bIndex > sync.GetScalerIndex()) break;  // old version - no packetDiff.
-      if (!foundPacketAfter) maxEntry += 1;
-      if ((int)bItr > maxEntry) break;
-      if ((int)bItr > builtChain->GetEntries()-1) break;
-      bItr++;
-    }
-    int bEntries = builtChain->GetEntries();
-    double bVetoTime = (bTimeAfter + bTimeBefore)/2.;
-    scalerOffset = bVetoTime-sync.GetTimeSec();
-    syncUncert = (bTimeAfter - bTimeBefore)/2.;
-    sbcOffset = bVetoTime - sync.GetTimeSBC();
-    sbcUnc = syncUncert;
-    delete ds;
-
-    printf("Syncing entry %i (packet %li) with Ge timestamps.\n",sync.GetEntry(),sync.GetScalerIndex());
-    if (fabs(sync.GetTimeSec() - bVetoTime) > syncUncert)
-    {
-      printf("Sync results from built chain: first %.1fs  before %.1fs  after %.1fs  sync.Scaler %.1fs\n", bTimeFirst,bTimeBefore,bTimeAfter,sync.GetTimeSec());
-      printf("Built chain has %i entries.\n",bEntries);
-      printf("Scaler (%.2f) out of sync with trigger card (%.2f) by %.3f +/- %.3f sec.\n", sync.GetTimeSec(),bVetoTime,scalerOffset,syncUncert);
-      applyOffset = true;
     }
-    if (syncUncert == bVetoTime) {
-      cout << "Warning: Sync failed, run " << runNum << "\n";
-      applyOffset = false;
+    else vlog() << "Unable to sync veto and Ge clocks.\n";
+    if (!applyOffset){
+      scalerOffset=0;
+      syncUncert=0;
+      sbcOffset=0;
+      sbcUnc=0;
     }
+    prod.scalerOffset = scalerOffset;
+    prod.syncUncert = syncUncert;
+    prod.sbcOffset = sbcOffset;
+    prod.sbcUnc = sbcUnc;
+    prod.applyOffset = applyOffset;
+    prod.key[kSyncStage] = syncKey;
   }
-  else cout << "Unable to sync veto and Ge clocks.\n";
-  if (!applyOffset){
-    scalerOffset=0;
-    syncUncert=0;
-    sbcOffset=0;
-    sbcUnc=0;
-  }
+  pSync.Stop();
 
   // If we're in DS-0 or P3END, find interpolated times for bad scalers.
   vector<double> interpTimes(badEntries.size());
   vector<double> interpUnc(badEntries.size());
-  if (runNum <= 6965 || runNum > 45000000)
-    FillInterpTimeVectors(runNum, badEntries, interpTimes, interpUnc, packetList);
+  VETO_SCOPE(pInterp, "FillInterpTimeVectors");
+  uint64_t interpKey = prod.StageKey(kInterpStage, VetoKey().Add(scanKey));
+  if (prod.Has(kInterpStage, interpKey) && prod.interpTimes.size() == badEntries.size()) {
+    interpTimes = prod.interpTimes;
+    interpUnc = prod.interpUnc;
+    prod.nReused++;
+  }
+  else {
+    if ((runNum <= 6965 || runNum > 45000000) && !badEntries.empty())
+      FillInterpTimeVectors(getGeIndex(), badEntries, interpTimes, interpUnc, packetList);
+    prod.interpTimes = interpTimes;
+    prod.interpUnc = interpUnc;
+    prod.key[kInterpStage] = interpKey;
+  }
+  ScalerTimeInterp badScalerTimes;
+  badScalerTimes.Build(vEntries, badEntries, interpTimes, interpUnc);
+  pInterp.Stop(badEntries.size());
 
   // =======================================================================
-  cout << "===================== Veto Error Report =====================\n";
+  vlog() << "===================== Veto Error Report =====================\n";
 
   // Determine run duration from start and stop packets
   scalerDuration = lastGoodScaler - firstGoodScaler;
   if (start == 0 || stop == 0)
   {
-    cout << "Warning: Run " << runNum << " is missing start or stop packet.  Start: " << start << "  Stop: " << stop
+    vlog() << "Warning: Run " << runNum << " is missing start or stop packet.  Start: " << start << "  Stop: " << stop
          << "\n  Replacing unix duration with scaler duration.  First Scaler: " << firstGoodScaler << "  Last Scaler: " << lastGoodScaler
          << "\n  Setting unix duration to " << lastGoodScaler - firstGoodScaler
          << "\n  NOTE: scalerDuration - 3600 = " << scalerDuration - 3600 << "  (large excess indicates buffer flush problems)\n";
@@ -523,31 +1392,26 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   // Error 27: QDC threshold not found
   // Error 28: No events above QDC threshold
   for (int i=0; i < 32; i++) if (swThresh[i] == 9999) {
-    Error[27]=true;
     ErrorCount[27]++;
-    cout << "Warning: Couldn't find QDC threshold for panel " << i << ". Set to 9999\n";
+    vlog() << "Warning: Couldn't find QDC threshold for panel " << i << ". Set to 9999\n";
   }
 
   // Set LED multiplicity threshold, find LED frequency, and use alternate method if we have a short run.
   multipThreshold = highestMultip - LEDMultipThreshold;
   if (multipThreshold < 0) multipThreshold = 0;
-  int dtEntries = LEDDeltaT->GetEntries();
   if (dtEntries > 0) {
-    int maxbin = LEDDeltaT->GetMaximumBin();
-    LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-    LEDfreq = 1/LEDDeltaT->GetMean();
+    LEDfreq = 1/dtPeriod; // mean delta-t within ~0.1 seconds of the peak.
   }
   else {
-    cout << "Warning! No multiplicity > " << LEDSimpleThreshold << " events.  LED may be off.  (Run " << runNum << ")\n";
+    vlog() << "Warning! No multiplicity > " << LEDSimpleThreshold << " events.  LED may be off.  (Run " << runNum << ")\n";
     LEDfreq = 9999;
     badLEDFreq = true;
   }
   LEDperiod = 1/LEDfreq;
-  delete LEDDeltaT;
   if (LEDperiod > 9 || vEntries < 100) {
-    cout << "Warning: Short run.\n";
+    vlog() << "Warning: Short run.\n";
     if (simpleLEDCount > 3) {
-      cout << "  From delta-T histogram, LED frequency is " << LEDfreq << " Hz."
+      vlog() << "  From delta-T histogram, LED frequency is " << LEDfreq << " Hz."
           << "\n  Reverting to 'simple' rate: " <<  simpleLEDCount/unixDuration << " Hz.\n";
       LEDperiod = unixDuration/simpleLEDCount;
       useSimpleThreshold=true;
@@ -560,16 +1424,14 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   // Error 26: LED frequency very low/high, corrupted, or LED's off.
   if (LEDperiod > 20 || LEDperiod < 0 || badLEDFreq) {
     ErrorCount[26]++;
-    Error[26] = true;
   }
 
   // Error 29: LED-QDC mean deviates from expected value by > 3 sigma
   // Implemented for DS3 and onward.
   if (simpleLEDCount > 30 && runNum > 16797 && runNum < 4500000) {
     for (int j = 0; j < 32; j++){
-      if (fabs(PanelInfo(runNum,j,"qdcMean") - LEDQDCTotal[j]/simpleLEDCount) > 3.0*PanelInfo(runNum,j,"qdcSigma")){
+      if (fabs(geo.GetCheckQDCMean(j) - LEDQDCTotal[j]/simpleLEDCount) > 3.0*geo.GetCheckQDCSigma(j)){
         ErrorCount[29]++;
-        Error[29] = true;
       }
     }
   }
@@ -577,9 +1439,8 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   // Implemented for DS3 and onward.
   if (unixDuration > 300 && runNum > 16797 && runNum < 4500000) {
     for (int j = 0; j< 32; j++) {
-      if (fabs(PanelInfo(runNum,j,"hitRateMean") - nonLEDHitCount[j]/unixDuration) > 3.0*PanelInfo(runNum,j,"hitRateSigma")){
+      if (fabs(geo.GetHitRateMean(j) - nonLEDHitCount[j]/unixDuration) > 3.0*geo.GetHitRateSigma(j)){
         ErrorCount[30]++;
-        Error[30] = true;
       }
     }
   }
@@ -588,149 +1449,154 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
   // ================ 2nd loop over entries - Error checks ==================
   // We don't skip any events, and we count the number of each type of error.
 
-  reader.SetTree(vetoChain); // reset the reader
-  std::fill(Error.begin(), Error.end(), 0); // reset error bools
-  while(reader.Next())
-  {
-    long i = reader.GetCurrentEntry();
-    veto.Clear();
-    veto.SetSWThresh(swThresh);
-    veto.WriteEvent(i,&*vRun,&*vEvt,*vBits,runNum,true);
-    CheckErrors(veto,prev,Error);
-    for (int j=0; j<nErrs; j++) if (Error[j]==1) ErrorCount[j]++;
-
-    // Print errors to screen
-    bool PrintError = false;
-    for (auto i : SeriousErrors){
-      if (Error[i]) {
-        PrintError = true;
-        break;
-      }
-    }
-    if (PrintError)
+  // The error counts only depend on the input, so the loop is skipped when they're saved.
+  // (The per-entry error printout is then only in the log of the first pass.)
+  VETO_SCOPE(pLoop2, "errorLoop");
+  uint64_t errorKey = prod.StageKey(kErrorStage, VetoKey());
+  if (prod.Has(kErrorStage, errorKey)) {
+    vlog() << "Reusing saved error counts.\n";
+    prod.nReused++;
+  }
+  else {
+    for (int j = 0; j < nErrs; j++) prod.errorCount[j] = 0;
+    cache.Rewind();
+    while(cache.Next(veto))
     {
-      if (Error[1] && Error[25])  cout << i << ":[1] Missing Packet & [25] Buffer Flush.";
-      if (Error[1] && !Error[25]) cout << i << ":[1] Missing Packet.";
-      if (!Error[1] && Error[25]) cout << i << ":[25] Buffer Flush.";
-      if (Error[1] || Error[25])
-        printf("  Index %li  Scaler %-5.2f  d(sca) %-5.3f  d(sbc) %-5.3f\n", veto.GetScalerIndex(),veto.GetTimeSec(),veto.GetTimeSec()-prev.GetTimeSec(),veto.GetTimeSBC()-prev.GetTimeSBC());
-
-      if (Error[13])
-        cout << i << ":[13] Indexes of QDC1 and Scaler differ by more than 2."
-           << "\n    Scaler Index " << veto.GetScalerIndex()
-           << "  QDC1 Index " << veto.GetQDC1Index()
-           << "\n    Previous scaler Index " << prev.GetScalerIndex()
-           << "  Previous QDC1 Index " << prev.GetQDC1Index() << endl;
-
-      if (Error[14])
-        cout << i << ":[14] Indexes of QDC2 and Scaler differ by more than 2."
-           << "\n    Scaler Index " << veto.GetScalerIndex()
-           << "  QDC2 Index " << veto.GetQDC2Index()
-           << "\n    Previous scaler Index " << prev.GetScalerIndex()
-           << "  Previous QDC2 Index " << prev.GetQDC2Index() << endl;
-
-      if (Error[18])
-        cout << i << ":[18] Scaler/SBC Desynch."
-            << "\n    Scaler " << veto.GetTimeSec() << "  SBC " << (long)veto.GetTimeSBC()
-            << "\n    Delta(scaler) " << veto.GetTimeSec() - prev.GetTimeSec()
-            << "\n    Delta(sbc) " << veto.GetTimeSBC() - prev.GetTimeSBC()
-            << "\n    Scaler jump correction: " << (veto.GetTimeSBC()-prev.GetTimeSBC()) - (veto.GetTimeSec()-prev.GetTimeSec())
-            << "\n    Adjusted time: "
-            << veto.GetTimeSec() + (veto.GetTimeSBC()-prev.GetTimeSBC()) - (veto.GetTimeSec()-prev.GetTimeSec()) << endl;
-
-      if (Error[19])
-        cout << i << ":[19] Scaler Event Count Reset. "
-           << "\n    Scaler Index " << veto.GetScalerIndex()
-           << "  SEC " << veto.GetSEC()
-           << "  Previous SEC " << prev.GetSEC() << "\n";
-
-      if (Error[20])
-        cout << i << ":[20] Scaler Event Count Jump."
-           << "\n    Scaler Time " << veto.GetTimeSec()
-           << "  Scaler Index " << veto.GetScalerIndex()
-           << "  Prev scaler time " << prev.GetTimeSec()
-           << "\n    SEC " << veto.GetSEC()
-           << "  Previous SEC " << prev.GetSEC() << "\n";
-
-      if (Error[21])
-        cout << i << ":[21] QDC1 Event Count Reset."
-           << "\n    Scaler Index " << veto.GetScalerIndex()
-           << "  QEC1 " << veto.GetQEC()
-           << "  Previous QEC1 " << prev.GetQEC() << "\n";
-      if(Error[22])
-        cout << i << ":[22] QDC 1 Event Count Jump."
-           << "\n    Scaler time " << veto.GetTimeSec()
-           << "  QDC 1 Index " << veto.GetQDC1Index()
-           << "  QEC 1 " << veto.GetQEC()
-           << "  Previous QEC 1 " << prev.GetQEC() << "\n";
-
-      if (Error[23])
-        cout << i << ":[23] QDC2 Event Count Reset."
-           << "\n    Scaler Index " << veto.GetScalerIndex()
-           << "  QEC2 " << veto.GetQEC2()
-           << "  Previous QEC2 " << prev.GetQEC2() << "\n";
-
-      if(Error[24])
-        cout << i << ":[24] QDC 2 Event Count Jump."
-           << "\n    Scaler time " << veto.GetTimeSec()
-           << "  QDC 2 Index " << veto.GetQDC2Index()
-           << "  QEC 2 " << veto.GetQEC2()
-           << "  Previous QEC 2 " << prev.GetQEC2() << "\n";
+      long i = veto.GetEntry();
+      uint32_t err = CheckErrors(veto,prev);
+      CountErrors(err,prod.errorCount);
+
+      // Print errors to screen
+      if (err & kSeriousErrors)
+      {
+        bool Error[nErrs];
+        for (int j=0; j<nErrs; j++) Error[j] = (err >> j) & 1;
+
+        if (Error[1] && Error[25])  vlog() << i << ":[1] Missing Packet & [25] Buffer Flush.";
+        if (Error[1] && !Error[25]) vlog() << i << ":[1] Missing Packet.";
+        if (!Error[1] && Error[25]) vlog() << i << ":[25] Buffer Flush.";
+        if (Error[1] || Error[25])
+          vlogf("  Index %li  Scaler %-5.2f  d(sca) %-5.3f  d(sbc) %-5.3f\n", veto.GetScalerIndex(),veto.GetTimeSec(),veto.GetTimeSec()-prev.GetTimeSec(),veto.GetTimeSBC()-prev.GetTimeSBC());
+
+        if (Error[13])
+          vlog() << i << ":[13] Indexes of QDC1 and Scaler differ by more than 2."
+             << "\n    Scaler Index " << veto.GetScalerIndex()
+             << "  QDC1 Index " << veto.GetQDC1Index()
+             << "\n    Previous scaler Index " << prev.GetScalerIndex()
+             << "  Previous QDC1 Index " << prev.GetQDC1Index() << endl;
+
+        if (Error[14])
+          vlog() << i << ":[14] Indexes of QDC2 and Scaler differ by more than 2."
+             << "\n    Scaler Index " << veto.GetScalerIndex()
+             << "  QDC2 Index " << veto.GetQDC2Index()
+             << "\n    Previous scaler Index " << prev.GetScalerIndex()
+             << "  Previous QDC2 Index " << prev.GetQDC2Index() << endl;
+
+        if (Error[18])
+          vlog() << i << ":[18] Scaler/SBC Desynch."
+              << "\n    Scaler " << veto.GetTimeSec() << "  SBC " << (long)veto.GetTimeSBC()
+              << "\n    Delta(scaler) " << veto.GetTimeSec() - prev.GetTimeSec()
+              << "\n    Delta(sbc) " << veto.GetTimeSBC() - prev.GetTimeSBC()
+              << "\n    Scaler jump correction: " << (veto.GetTimeSBC()-prev.GetTimeSBC()) - (veto.GetTimeSec()-prev.GetTimeSec())
+              << "\n    Adjusted time: "
+              << veto.GetTimeSec() + (veto.GetTimeSBC()-prev.GetTimeSBC()) - (veto.GetTimeSec()-prev.GetTimeSec()) << endl;
+
+        if (Error[19])
+          vlog() << i << ":[19] Scaler Event Count Reset. "
+             << "\n    Scaler Index " << veto.GetScalerIndex()
+             << "  SEC " << veto.GetSEC()
+             << "  Previous SEC " << prev.GetSEC() << "\n";
+
+        if (Error[20])
+          vlog() << i << ":[20] Scaler Event Count Jump."
+             << "\n    Scaler Time " << veto.GetTimeSec()
+             << "  Scaler Index " << veto.GetScalerIndex()
+             << "  Prev scaler time " << prev.GetTimeSec()
+             << "\n    SEC " << veto.GetSEC()
+             << "  Previous SEC " << prev.GetSEC() << "\n";
+
+        if (Error[21])
+          vlog() << i << ":[21] QDC1 Event Count Reset."
+             << "\n    Scaler Index " << veto.GetScalerIndex()
+             << "  QEC1 " << veto.GetQEC()
+             << "  Previous QEC1 " << prev.GetQEC() << "\n";
+        if(Error[22])
+          vlog() << i << ":[22] QDC 1 Event Count Jump."
+             << "\n    Scaler time " << veto.GetTimeSec()
+             << "  QDC 1 Index " << veto.GetQDC1Index()
+             << "  QEC 1 " << veto.GetQEC()
+             << "  Previous QEC 1 " << prev.GetQEC() << "\n";
+
+        if (Error[23])
+          vlog() << i << ":[23] QDC2 Event Count Reset."
+             << "\n    Scaler Index " << veto.GetScalerIndex()
+             << "  QEC2 " << veto.GetQEC2()
+             << "  Previous QEC2 " << prev.GetQEC2() << "\n";
+
+        if(Error[24])
+          vlog() << i << ":[24] QDC 2 Event Count Jump."
+             << "\n    Scaler time " << veto.GetTimeSec()
+             << "  QDC 2 Index " << veto.GetQDC2Index()
+             << "  QEC 2 " << veto.GetQEC2()
+             << "  Previous QEC 2 " << prev.GetQEC2() << "\n";
+      }
+      // end of event resets
+      prev = veto;
     }
-    // end of event resets
-    prev = veto;
-    std::fill(Error.begin(), Error.end(), 0);
+    pLoop2.Stop(vEntries);
+    prod.key[kErrorStage] = errorKey;
   }
+  for (int j = 0; j < nErrs; j++) ErrorCount[j] += prod.errorCount[j];
   // Calculate total errors and total serious errors
   // Ignore Error 10 & 11 - the veto counters are not reset at the beginning of runs.
   for (int i = 1; i < nErrs; i++) {
       if (i != 10 && i != 11) TotalErrorCount += ErrorCount[i];
-      for (auto j : SeriousErrors) if (i == j) SeriousErrorCount += ErrorCount[i];
+      if (kSeriousErrors & ErrorBit(i)) SeriousErrorCount += ErrorCount[i];
   }
-  cout << "Serious errors found :: " << SeriousErrorCount << endl;
+  vlog() << "Serious errors found :: " << SeriousErrorCount << endl;
   if (SeriousErrorCount > 0)
   {
-    // cout << "Total Errors : " << TotalErrorCount << endl;
+    // vlog() << "Total Errors : " << TotalErrorCount << endl;
     for (int i = 1; i < nErrs; i++)
     {
       if (ErrorCount[i] > 0 && (i!=7 && i!=10 && i!=11))
       {
         if (i != 26)
-          cout << "  Run " << runNum << " Error[" << i <<"]: "
+          vlog() << "  Run " << runNum << " Error[" << i <<"]: "
                << ErrorCount[i] << " events ("<< 100*(double)ErrorCount[i]/vEntries << " %)\n";
 
         else if (i == 26) {
-          cout << "  Run " << runNum << " Error[26]: Bad LED rate: " << LEDfreq << "  Period: " << LEDperiod << endl;
+          vlog() << "  Run " << runNum << " Error[26]: Bad LED rate: " << LEDfreq << "  Period: " << LEDperiod << endl;
           if (LEDperiod > 0.1 && (abs(unixDuration/LEDperiod) - simpleLEDCount) > 5)
-            cout << "   Simple LED count: " << simpleLEDCount << "  Expected: " << (int)(unixDuration/LEDperiod) << endl;
+            vlog() << "   Simple LED count: " << simpleLEDCount << "  Expected: " << (int)(unixDuration/LEDperiod) << endl;
         }
         else if (i == 29 || i == 30)
-          cout << "  Error[" << i <<"]: " << ErrorCount[i] << " events ("<< 100*(double)ErrorCount[i]/(32*vEntries) << " %)\n";
+          vlog() << "  Error[" << i <<"]: " << ErrorCount[i] << " events ("<< 100*(double)ErrorCount[i]/(32*vEntries) << " %)\n";
       }
     }
-    // cout << "For reference, \"serious\" error types are: ";
-    // for (auto i : SeriousErrors) cout << i << " ";
-    // cout << "\nPlease report these to the veto group.\n";
+    // vlog() << "For reference, \"serious\" error types are: ";
+    // for (int i = 0; i < nErrs; i++) if (kSeriousErrors & ErrorBit(i)) vlog() << i << " ";
+    // vlog() << "\nPlease report these to the veto group.\n";
   }
   if (errorCheckOnly) return;
 
   // ================ 3nd loop over entries - Find muons! =================
   // Determine event time, skip bad entries, and apply all cuts for muon ID.
 
-  cout << "=================== Scanning for muons ... ==================\n";
+  vlog() << "=================== Scanning for muons ... ==================\n";
 
-  reader.SetTree(vetoChain); // reset the reader
+  cache.Rewind();
   prev.Clear();
   skippedEvents = 0;
-  printf("unixDuration %.0f sec  Highest mult. %i  LED threshold %i\n", unixDuration,highestMultip,multipThreshold);
-  while(reader.Next())
+  if (writer) writer->Start();
+  VETO_SCOPE(pLoop3, "muonLoop");
+  auto tScan = chrono::steady_clock::now();
+  vlogf("unixDuration %.0f sec  Highest mult. %i  LED threshold %i\n", unixDuration,highestMultip,multipThreshold);
+  while(cache.Next(veto))
   {
-    long i = reader.GetCurrentEntry();
-    veto.Clear();
-    veto.SetSWThresh(swThresh);
-    veto.WriteEvent(i,&*vRun,&*vEvt,*vBits,runNum,true);
-    CheckErrors(veto,prev,Error);
-    for (int j=0; j<nErrs; j++) if (Error[j]==1) ErrorCount[j]++;
+    long i = veto.GetEntry();
+    ErrorBits = CheckErrors(veto,prev);
+    CountErrors(ErrorBits,ErrorCount);
 
     deltaScaler = veto.GetTimeSec()-prev.GetTimeSec();
     deltaSBC = veto.GetTimeSBC()-prev.GetTimeSBC();
@@ -747,36 +1613,32 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
     }
     else if (veto.GetBadScaler() && (runNum <= 8557 || runNum > 45000000))
     {
-      auto it = find(badEntries.begin(), badEntries.end(), i);
-      if (it != badEntries.end()) {
-        auto idx = distance(badEntries.begin(), it);
-        xTime = interpTimes[idx];
-        timeUncert = interpUnc[idx];
-      }
-      else {
-        xTime=-1;
-        timeUncert=-1;
-      }
+      // -1 if this entry has no interpolated time
+      xTime = badScalerTimes.GetTime(i);
+      timeUncert = badScalerTimes.GetUncert(i);
     }
 
     // Scaler jump handling: Calculate the jumpCorrection and save it to the ROOT output.
     // Ignore any scaler jumps that happen during a buffer flush, because deltaSBC is not trustworthy.
-    if (i > entryAfterFlush && Error[18]) {
+    if (i > entryAfterFlush && (ErrorBits & ErrorBit(18))) {
       jumpCorrection += deltaSBC - deltaScaler;
-      printf("Scaler jump found.  Applying jump correction: %.2f  Before %.2f  After %.2f\n", jumpCorrection,xTime,xTime+jumpCorrection);
+      vlogf("Scaler jump found.  Applying jump correction: %.2f  Before %.2f  After %.2f\n", jumpCorrection,xTime,xTime+jumpCorrection);
     }
     xTime += jumpCorrection;
     // if (i > 715 && i < 720)  // debug block (don't delete!)
-    // printf("%li  ind %li  e1 %i  e18 %i  e19 %i  scaler %-5.2f  dScaler %-5.2f  dSBC %-5.2f  jumpCor %-5.2f\n" ,i,veto.GetScalerIndex(),Error[1],Error[18],Error[19],veto.GetTimeSec(),deltaScaler,deltaSBC,jumpCorrection);
+    // vlogf("%li  ind %li  e1 %i  e18 %i  e19 %i  scaler %-5.2f  dScaler %-5.2f  dSBC %-5.2f  jumpCor %-5.2f\n" ,i,veto.GetScalerIndex(),(ErrorBits>>1)&1,(ErrorBits>>18)&1,(ErrorBits>>19)&1,veto.GetTimeSec(),deltaScaler,deltaSBC,jumpCorrection);
+
+    // The "Errors" vector is only unpacked for entries we write out (v1 only).
+    if (schemaV1)
+      for (int j=0; j<nErrs; j++) Error[j] = (ErrorBits >> j) & 1;
 
     // Skip bad events and fill the skipTree.
-    if (CheckErrors(veto,prev,Error))
+    if (ErrorBits & kSkipErrors)
     {
       skippedEvents++;
       // do the end-of-event reset
       prev = veto;
-      skipTree->Fill();
-      veto.Clear();
+      writeEntry(i,veto,true);
       continue;
     }
 
@@ -787,96 +1649,52 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
     else if (LEDTurnedOff) LEDCut = true;
 
     // Energy (Gamma) Cut
-    // The measured muon energy threshold is QDC = 500.
-    // Set TRUE if at least TWO panels are over 500.
+    // The measured muon energy threshold is QDC = 500 (--muon-qdc).
+    // Set TRUE if at least TWO panels (--muon-panels) are over 500.
     EnergyCut = false;
-    int over500Count = 0;
-    for (int q = 0; q < 32; q++) {
-      if (veto.GetQDC(q) > 500)
-        over500Count++;
-    }
-    if (over500Count >= 2) EnergyCut = true;
+    int over500Count = veto.GetOverQDCCount();  // the cache counts panels over 500
+    if (over500Count >= cuts.minPanels) EnergyCut = true;
 
     // debug block (don't delete!)
     // if (veto.GetMultip() < 27 && veto.GetMultip() > 1)
-    // printf("Entry %li  Time %-6.2f  QDC %-5i  Mult %i  Ov500 %i  Loff? %i  LEDCut %i  ECut %i  \n",i,veto.GetTimeSec(),veto.GetTotE(),veto.GetMultip(),over500Count,LEDTurnedOff,LEDCut,EnergyCut);
+    // vlogf("Entry %li  Time %-6.2f  QDC %-5i  Mult %i  Ov500 %i  Loff? %i  LEDCut %i  ECut %i  \n",i,veto.GetTimeSec(),veto.GetTotE(),veto.GetMultip(),over500Count,LEDTurnedOff,LEDCut,EnergyCut);
 
     // Muon Identification:
     // Use EnergyCut, LEDCut, and the Hit Pattern to identify them sumbitches.
-    for (int k = 0; k < 12; k++) Plane[k] = 0;
-    for (int k = 0; k < 32; k++) {
-      if (veto.GetQDC(k) > veto.GetSWThresh(k)) {
-        if (PlaneMap(k,runNum)==0)       Plane[0]=1;  // 0: Lower Bottom
-        else if (PlaneMap(k,runNum)==1)  Plane[1]=1;  // 1: Upper Bottom
-        else if (PlaneMap(k,runNum)==2)  Plane[2]=1;  // 3: Top Inner
-        else if (PlaneMap(k,runNum)==3)  Plane[3]=1;  // 4: Top Outer
-        else if (PlaneMap(k,runNum)==4)  Plane[4]=1;  // 5: North Inner
-        else if (PlaneMap(k,runNum)==5)  Plane[5]=1;  // 6: North Outer
-        else if (PlaneMap(k,runNum)==6)  Plane[6]=1;  // 7: South Inner
-        else if (PlaneMap(k,runNum)==7)  Plane[7]=1;  // 8: South Outer
-        else if (PlaneMap(k,runNum)==8)  Plane[8]=1;  // 9: West Inner
-        else if (PlaneMap(k,runNum)==9)  Plane[9]=1;  // 10: West Outer
-        else if (PlaneMap(k,runNum)==10) Plane[10]=1; // 11: East Inner
-        else if (PlaneMap(k,runNum)==11) Plane[11]=1; // 12: East Outer
-        else if (PlaneMap(k,runNum)==-1)
-          cout << "Error: Panel " << k << " was not installed for this run and should not be giving counts above threshold.\n";
-      }
+    // Plane hit pattern (plane numbering is listed in VetoGeometry.hh)
+    uint32_t hitMask = veto.GetHitMask();
+    if (hitMask & ~geo.GetInstalledMask()) {
+      for (int k = 0; k < 32; k++)
+        if ((hitMask >> k) & 1 && !geo.IsInstalled(k))
+          vlog() << "Error: Panel " << k << " was not installed for this run and should not be giving counts above threshold.\n";
     }
-    std::fill(CoinType.begin(), CoinType.end(), 0);  // reset
+    PlaneMask = geo.GetPlaneMask(hitMask);
+    CoinBits = 0;  // reset
     if (LEDCut && EnergyCut)
     {
-      CoinType[0] = true;
-      int type = 0;
-      bool a=0,b=0,c=0;
+      // Types 1-3 (vertical, side+bottom, top+sides) and compound hits
+      // are looked up from the plane mask.
+      CoinBits = kCoinMuon | GetCoinClass(PlaneMask);
+      int type = GetHitType(PlaneMask);
 
       // debug block (don't delete!)
-      // cout << "\nQDC-panel-plane: ";
+      // vlog() << "\nQDC-panel-plane: ";
       // for (int i=0; i<32; i++) {
       // 	int qdc=0;
       // 	if (veto.GetQDC(i) > veto.GetSWThresh(i)) {
       // 		qdc = veto.GetQDC(i);
-      // 		cout << i << "-" << i+1 << "-p" << PlaneMap(i,run) << ":" << qdc << "  ";}
+      // 		vlog() << i << "-" << i+1 << "-p" << geo.GetPlane(i) << ":" << qdc << "  ";}
       // }
-      // cout << endl;
-      // cout << "Planes:\n";
-      // cout << "0: Lower Bottom  1: Upper Bottom\n"
+      // vlog() << endl;
+      // vlog() << "Planes:\n";
+      // vlog() << "0: Lower Bottom  1: Upper Bottom\n"
       // 	  << "2: Top Inner     3: Top Outer\n"
       // 	  << "4: North Inner   5: North Outer\n"
       // 	  << "6: South Inner   7: South Outer\n"
       // 	  << "8: West Inner    9: West Outer\n"
       // 	  << "10: East Inner   11: East Outer\n";
-      // for (int i=0; i<12; i++) cout << "p" << i << ":" << Plane[i] << "  ";
-      // cout << endl;
-
-      // Type 1: vertical muons
-      if (Plane[0] && Plane[1] && Plane[2] && Plane[3]) {
-        CoinType[1]=true;
-        a=true;
-        type=1;
-      }
-      // Type 2: (both planes of a side) + both bottom planes
-      if ((Plane[0] && Plane[1]) &&
-          ((Plane[4] && Plane[5])
-          || (Plane[6] && Plane[7])
-          || (Plane[8] && Plane[9])
-          || (Plane[10] && Plane[11])))
-      {
-        CoinType[2] = true;
-        b=true;
-        type = 2;
-      }
-      // Type 3: (both top planes) + (both planes of a side)
-      if ((Plane[2] && Plane[3]) &&
-          ((Plane[4] && Plane[5])
-          || (Plane[6] && Plane[7])
-          || (Plane[8] && Plane[9])
-          || (Plane[10] && Plane[11]))) {
-        CoinType[3] = true;
-        c=true;
-        type = 3;
-      }
-      // Type 4: compound hit (combination of types 1-3)
-      if ((a && b)||(a && c)||(b && c)) type = 4;
+      // for (int i=0; i<12; i++) vlog() << "p" << i << ":" << ((PlaneMask >> i) & 1) << "  ";
+      // vlog() << endl;
 
       char hitType[200];
       if (type==0) sprintf(hitType,"2+ panels");
@@ -886,11 +1704,10 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
       if (type==4) sprintf(hitType,"compound");
 
       // print the details of the hit
-      printf("Hit: %-12s Entry %-4li Time %-6.2f  QDC %-5i  Mult %i  Ov500 %i  LEDoff %i\n", hitType,i,xTime,veto.GetTotE(),veto.GetMultip(),over500Count,LEDTurnedOff);
+      vlogf("Hit: %-12s Entry %-4li Time %-6.2f  QDC %-5i  Mult %i  Ov500 %i  LEDoff %i\n", hitType,i,xTime,veto.GetTotE(),veto.GetMultip(),over500Count,LEDTurnedOff);
     }
 
-    out = veto;
-    vetoTree->Fill();
+    writeEntry(i,veto,false);
     // end of event resets
     prev = veto;
     if (veto.GetMultip() > multipThreshold) {
@@ -898,297 +1715,139 @@ void ProcessVetoData(TChain *vetoChain, vector<int> thresholds, string outputDir
       else timePrevLED = -1;
     }
   }
-  if (skippedEvents > 0) printf("ProcessVetoData skipped %li of %li entries.\n",skippedEvents,vEntries);
+  if (skippedEvents > 0) vlogf("ProcessVetoData skipped %li of %li entries.\n",skippedEvents,vEntries);
+  pLoop3.Stop(vEntries);
+  VETO_SCOPE(pWrite, "writeOutput");
+  double scanSec = chrono::duration<double>(chrono::steady_clock::now() - tScan).count();
+  if (writer) {
+    writer->Finish();
+    vlogf("Output (%s): muon scan %.2f sec, waited %.2f sec on a full queue (%li times), tree filling %.2f sec, total %.2f sec.\n",
+      writer->IsAsync() ? "writer thread" : "sync", scanSec, writer->GetWaitSec(), writer->GetNFull(), writer->GetBusySec(),
+      chrono::duration<double>(chrono::steady_clock::now() - tScan).count());
+  }
 
   vetoTree->Write("",TObject::kOverwrite);
   skipTree->Write("",TObject::kOverwrite);
-  cout << "Wrote ROOT file: " << outputFile << endl;
+  if (runInfoTree) {
+    runInfo.run = runNum;
+    runInfo.schema = 2;
+    runInfo.start = start;
+    runInfo.stop = stop;
+    runInfo.unixDuration = unixDuration;
+    runInfo.scalerDuration = scalerDuration;
+    runInfo.scalerOffset = scalerOffset;
+    runInfo.syncUncert = syncUncert;
+    runInfo.sbcOffset = sbcOffset;
+    runInfo.sbcUnc = sbcUnc;
+    runInfo.entryAfterFlush = entryAfterFlush;
+    runInfo.applyOffset = applyOffset;
+    runInfo.LEDfreq = LEDfreq;
+    runInfo.multipThreshold = multipThreshold;
+    runInfo.highestMultip = highestMultip;
+    runInfo.LEDMultipThreshold = LEDMultipThreshold;
+    runInfo.LEDSimpleThreshold = LEDSimpleThreshold;
+    runInfo.useSimpleThreshold = useSimpleThreshold;
+    for (int q = 0; q < 32; q++) runInfo.swThresh[q] = swThresh[q];
+    runInfoTree->Fill();
+    runInfoTree->Write("",TObject::kOverwrite);
+  }
+  vlog() << "Wrote ROOT file: " << outputFile << endl;
 
   RootFile->Close();
+  pWrite.Stop();
+  if (VetoProfiler *prof = VetoProfilerCurrent()) {
+    prof->SetCounter("entries", vEntries);
+    prof->SetCounter("skipped", skippedEvents);
+    prof->SetCounter("outputBytes", RootFile->GetBytesWritten());
+    if (writer) {
+      prof->SetCounter("writerWaitSec", writer->GetWaitSec());
+      prof->SetCounter("writerFillSec", writer->GetBusySec());
+    }
+  }
 }
 
 // ====================================================================================
 // =================================VETO TOOL KIT======================================
 // ====================================================================================
 
-void SetCardNumbers(int runNum, int &card1, int &card2)
+// The run's built chain, from GATDataSet.  For a built file from veto-gen (synthVeto,
+// its VetoTree chain), the MGTree of the same files.  Hand both to CloseBuiltChain.
+TChain *OpenBuiltChain(int runNum, TChain *synthVeto, GATDataSet *&ds)
 {
-  if (runNum > 45000000)
-    { card1 = 11;  card2 = 18; }
-  else
-    { card1 = 13;  card2 = 18; }
-}
-
-int FindThreshold(TH1D *qdcHist, int threshVal, int panel, int runNum)
-{
-  // Returns 9999 if a panels is deactivated or the threshold is not found.
-  // This (intentionally) causes that panel to not contribute to multiplicity or total QDC.
-  // This is the run-level error 27/28, and is checked between loop 1 and loop 2.
-
-  if (runNum > 45000000 && panel > 23)
-    return 9999;
-
-  int firstNonzeroBin = qdcHist->FindFirstBinAbove(1,1);
-  qdcHist->GetXaxis()->SetRange(firstNonzeroBin-10,firstNonzeroBin+50);
-  //qdcHist->GetXaxis()->SetRangeUser(0,500); //alternate method of finding pedestal
-  int bin = qdcHist->GetMaximumBin();
-  if (firstNonzeroBin == -1) return 9999;
-  double xval = qdcHist->GetXaxis()->GetBinCenter(bin);
-  return xval+threshVal;
+  ds = 0;
+  if (synthVeto) {
+    TChain *builtChain = new TChain("MGTree");
+    TObjArray *files = synthVeto->GetListOfFiles();
+    for (int i = 0; files && i < files->GetEntries(); i++)
+      builtChain->Add(((TChainElement*)files->At(i))->GetTitle());
+    return builtChain;
+  }
+  lock_guard<mutex> gatLock(gGATMutex);
+  ds = new GATDataSet(runNum);
+  return ds->GetBuiltChain(false);
 }
 
-int PlaneMap(int qdcChan, int runNum)
+void CloseBuiltChain(TChain *builtChain, GATDataSet *ds)
 {
-  // For tagging plane-based coincidences.
-  // This uses a zero-indexed map: {panel number, plane number}
-  map<int,int> planes;
-
-  // Geometric planes:
-  // 0: Lower Bottom 	1: Upper Bottom
-  // 2: Top Inner		3: Top Outer
-  // 4: North Inner		5: North Outer
-  // 6: South Inner 	7: South Outer
-  // 8: West Inner		9: West Outer
-  // 10: East Inner 	11: East Outer
-
-  // 32-panel config (default) - began 7/10/15
-  if (runNum < 45000000 && runNum >= 3057) {
-    map<int,int> tempMap =
-    {{0,0},  {1,0},  {2,0},  {3,0}, {4,0}, {5,0},
-     {6,1},  {7,1},  {8,1},  {9,1}, {10,1}, {11,1},
-     {12,8}, {13,8}, {14,9}, {15,5},
-     {16,5}, {17,3}, {18,3}, {19,4},
-     {20,2}, {21,2}, {22,9}, {23,4},
-     {24,6}, {25,7}, {26,6}, {27,7},
-     {28,10},{29,11},{30,10},{31,11}};
-    planes = tempMap;
-  }
-  // 1st prototype config (24 panels)
-   else if (runNum >= 45000509 && runNum <= 45004116) {
-    map<int,int> tempMap =
-    {{0,0},  {1,0},  {2,0},  {3,0}, {4,0}, {5,0},
-     {6,1},  {7,1},  {8,1},  {9,1}, {10,1}, {11,1},
-     {12,2}, {13,2}, {14,9}, {15,5},
-     {16,5}, {17,3}, {18,3}, {19,4},
-     {20,8}, {21,8}, {22,9}, {23,4},
-     {24,-1},{25,-1},{26,-1},{27,-1},
-     {28,-1},{29,-1},{30,-1},{31,-1}};
-    planes = tempMap;
-  }
-  // 2nd prototype config (24 panels)
-   else if (runNum >= 45004117 && runNum <= 45008659) {
-    map<int,int> tempMap =
-    {{0,0},  {1,0},  {2,0},  {3,0}, {4,0}, {5,0},
-     {6,1},  {7,1},  {8,1},  {9,1}, {10,1}, {11,1},
-     {12,8}, {13,8}, {14,9}, {15,5},
-     {16,5}, {17,3}, {18,3}, {19,4},
-     {20,2}, {21,2}, {22,9}, {23,4},
-     {24,-1},{25,-1},{26,-1},{27,-1},
-     {28,-1},{29,-1},{30,-1},{31,-1}};
-    planes = tempMap;
-  }
-  // 1st module 1 (P3JDY) config, 6/24/15 - 7/7/15
-  else if (runNum > 0 && runNum <=3056){
-    map<int,int> tempMap =
-    {{0,0},  {1,0},  {2,0},  {3,0}, {4,0}, {5,0},
-     {6,1},  {7,1},  {8,1},  {9,1}, {10,1}, {11,1},
-     {12,8}, {13,8}, {14,9}, {15,5},
-     {16,5}, {17,3}, {18,3}, {19,4},
-     {20,2}, {21,2}, {22,9}, {23,4},
-     {24,-1},{25,-1},{26,-1},{27,-1},
-     {28,-1},{29,-1},{30,-1},{31,-1}};
-    planes = tempMap;
-  }
-  // If the panel is not installed for this run, return -1.
-  else return -1;
-
-  // Otherwise, return the plane index for this panel.
-  int plane = -1;
-  auto search = planes.find(qdcChan);
-  if(search != planes.end()) plane=search->second;
-  return plane;
+  if (!ds) {
+    delete builtChain;
+    return;
+  }
+  lock_guard<mutex> gatLock(gGATMutex);
+  delete ds;
 }
 
-// This is overloaded so we don't have to use the error vector if we don't need it
-bool CheckErrors(MJVetoEvent veto, MJVetoEvent prev)
+bool LoadGeTimeIndex(int runNum, TChain *synthVeto, string outputDir, GeTimeIndex &geIndex)
 {
-  vector<int> ErrorVec(nErrs);
-  std::fill(ErrorVec.begin(), ErrorVec.end(), 0);
-  return CheckErrors(veto,prev,ErrorVec);
-}
-bool CheckErrors(MJVetoEvent veto, MJVetoEvent prev, vector<int> &ErrorVec)
-{
-  // Returns skip = false if the event is analyzable (either clean, or a workaround exists)
-  bool skip = false;
-
-  /*
-  Recoverable:
-  Actionable:
-    LED Off -> Output string Dave can grep for, send veto experts an email
-    No QDC events -> Need to have people check if a panel went down
-    High error rate (desynchs, bad scalers, etc) -> Need to try and restart data taking
-  Diagnostic:
-
-  // Event-level error checks ('s' denotes setting skip=true)
-  // s 1. Missing channels (< 32 veto datas in event)
-  // s 2. Extra Channels (> 32 veto datas in event)
-  // s 3. Scaler only (no QDC data)
-  //   4. Bad Timestamp: FFFF FFFF FFFF FFFF
-  // s 5. QDCIndex - ScalerIndex != 1 or 2
-  // s 6. Duplicate channels (channel shows up multiple times)
-  //   7. HW Count Mismatch (SEC - QEC != 1 or 2)
-  //   8. MJTRun run number doesn't match input file
-  // s 9. MJTVetoData cast failed (missing QDC data)
-  //   10. Scaler EventCount doesn't match ROOT entry
-  //   11. Scaler EventCount doesn't match QDC1 EventCount
-  //   12. QDC1 EventCount doesn't match QDC2 EventCount
-  // s 13. Indexes of QDC1 and Scaler differ by more than 2
-  // s 14. Indexes of QDC2 and Scaler differ by more than 2
-  //   15. Indexes of either QDC1 or QDC2 PRECEDE the scaler index
-  //   16. Indexes of either QDC1 or QDC2 EQUAL the scaler index
-  //   17. Unknown Card is present.
-  // s 18. Scaler & SBC Timestamp Desynch.
-  // s 19. Scaler Event Count reset.
-  // s 20. Scaler Event Count increment by > +1.
-  // s 21. QDC1 Event Count reset.
-  // s 22. QDC1 Event Count increment by > +1.
-  // s 23. QDC2 Event Count reset.
-  // s 24. QDC2 Event Count increment > +1.
-  // s 25. Buffer flush error.
-
-  // Run-level error checks (not checked in this function)
-  // 26. LED frequency very low/high, corrupted, or LED's off.
-  // 27. QDC threshold not found
-  // 28. No events above QDC threshold
-  // 29. Avg Panel LEDQDC deviates from expected mean by > 3 sigma.
-  // 30. nonLED Panel Hit Rate deviates from expected mean by 3 > sigma.
-  */
-
-  vector<int> Errors(nErrs);
-  std::fill(Errors.begin(), Errors.end(), 0);
-
-  // Errors 1-18 are checked automatically when we call MJVetoEvent::WriteEvent
-  for (int i=0; i < 18; i++) Errors[i] = veto.GetError(i);
-
-  for (int q=0; q<18; q++) {
-    if (Errors[q]==1 && (q==1||q==2||q==3||q==5||q==6||q==9||q==13||q==14))
-      skip = true;
-  }
-
-  bool foundBothQDC = (!veto.GetError(1) && !prev.GetError(1));
-
-  if (foundBothQDC && veto.GetEntry() > 1 && veto.GetTimeSec() > 0 && veto.GetTimeSBC() > 0
-      && fabs((veto.GetTimeSec() - prev.GetTimeSec())-(veto.GetTimeSBC() - prev.GetTimeSBC())) > 1
-      && !veto.GetBadScaler() && !prev.GetBadScaler()) {
-        Errors[18] = true;
-      }
-
-  if (!veto.GetError(1) && veto.GetSEC() == 0 && veto.GetEntry() > 1)
-    Errors[19] = true;
-
-  if (foundBothQDC && veto.GetEntry() > 1 && abs(veto.GetSEC() - prev.GetSEC()) > veto.GetEntry()-prev.GetEntry() && veto.GetSEC()!=0)
-    Errors[20] = true;
-
-  if (!veto.GetError(1) && veto.GetQEC() == 0 && veto.GetEntry() >1)
-    Errors[21] = true;
-
-  if (foundBothQDC && veto.GetEntry() > 1 && abs(veto.GetQEC() - prev.GetQEC()) > veto.GetEntry()-prev.GetEntry() && veto.GetQEC() != 0)
-    Errors[22] = true;
-
-  if (!veto.GetError(1) && veto.GetQEC2() == 0 && veto.GetEntry() > 1)
-    Errors[23] = true;
-
-  if (foundBothQDC && abs(veto.GetQEC2() - prev.GetQEC2()) > veto.GetEntry()-prev.GetEntry() && veto.GetEntry() > 1 && veto.GetQEC2() != 0)
-    Errors[24] = true;
-
-  if (abs(veto.GetScalerIndex() - prev.GetScalerIndex()) == 1)
-    Errors[25] = true;
-
-  // Check errors 18-25 (don't accidentally change the run-level errors 26-28)
-  for (int q=18; q<26; q++) {
-    if (Errors[q]==1 && (q==18||q==19||q==20||q==21||q==22||q==23||q==24||q==25))
-      skip = true;
+  // Use the sidecar index next to the veto output if it was made from these built
+  // files, otherwise build it (one pass over the built chain) and save it.
+  GATDataSet *ds = 0;
+  TChain *builtChain = OpenBuiltChain(runNum, synthVeto, ds);
+
+  VETO_SCOPE(pIndex, "LoadGeTimeIndex");
+  long bEntries = builtChain->GetEntries();
+  string indexFile = TString::Format("%s/veto_run%i.geidx",outputDir.c_str(),runNum).Data();
+  uint64_t key = BuiltChainKey(builtChain);
+  if (key && geIndex.Load(indexFile, bEntries, key))
+    vlogf("Loaded Ge timestamp index: %lu packets (%s)\n",geIndex.GetSize(),indexFile.c_str());
+  else {
+    geIndex.Build(builtChain);
+    pIndex.AddEntries(bEntries);
+    vlogf("Built Ge timestamp index: %lu packets from %li built entries.\n",geIndex.GetSize(),bEntries);
+    if (key && !geIndex.Save(indexFile)) vlog() << "Warning: couldn't write " << indexFile << endl;
   }
 
-  // assign Errors to the output vetor
-  ErrorVec = Errors;
-
-  // debug: print error vector
-  // for (int i=0; i < 28; i++) cout << i << ":" << Errors[i] << "  ";
-  // cout << endl;
+  pIndex.Stop();
+  CloseBuiltChain(builtChain, ds);
+  return geIndex.GetSize() > 0;
+}
 
-  return skip;
+// The Ge times around the sync packet (ScanGeSync).  Returns the built chain's entries.
+long SyncBuiltChain(int runNum, TChain *synthVeto, long scalerIndex, double &first, double &before, double &after)
+{
+  GATDataSet *ds = 0;
+  TChain *builtChain = OpenBuiltChain(runNum, synthVeto, ds);
+
+  VETO_SCOPE(pScan, "ScanGeSync");
+  long bEntries = builtChain->GetEntries();
+  pScan.AddEntries(ScanGeSync(builtChain, scalerIndex, first, before, after));
+  pScan.Stop();
+  CloseBuiltChain(builtChain, ds);
+  return bEntries;
 }
 
-void FillInterpTimeVectors(int runNum, vector<int> &badEntries, vector<double> &interpTimes,
+void FillInterpTimeVectors(const GeTimeIndex &geIndex, vector<int> &badEntries, vector<double> &interpTimes,
   vector<double> &interpUnc, vector<long> &packetList)
 {
   int nBS = (int)badEntries.size();
-  cout << "Found " << nBS << " bad scalers. Interpolating from Ge timestamps ...\n";
-  int iBS = 0;
-  GATDataSet *ds = new GATDataSet(runNum);
-  TChain *builtChain = ds->GetBuiltChain(false);
-  MGTEvent *evt=0;
-  MGVDigitizerData *dig=0;
-  builtChain->SetBranchAddress("event",&evt);
-  double bTimeBefore=0, bTimeAfter=0;
-  uint64_t bIndex=0;
-  int bItr = 0;
-  while (true)
+  vlog() << "Found " << nBS << " bad scalers. Interpolating from Ge timestamps ...\n";
+  for (int iBS = 0; iBS < nBS; iBS++)
   {
-    if (iBS > (int)packetList.size()-1) break;
-    if (bItr > builtChain->GetEntries()-1) break;
-
-    builtChain->GetEntry(bItr);
-    if (evt->GetNDigitizerData() > 0)
-    {
-      dig = evt->GetDigitizerData(0);
-      bIndex = dig->GetIndex();
-
-      if ((int)bIndex < packetList[iBS])
-        bTimeBefore = ((double)dig->GetTimeStamp())*1.e-8;
-
-      if ((int)bIndex > packetList[iBS])
-      {
-        bTimeAfter = ((double)dig->GetTimeStamp())*1.e-8;
-        interpTimes[iBS] = (bTimeAfter + bTimeBefore)/2.;
-        interpUnc[iBS] = (bTimeAfter - bTimeBefore)/2.;
-        // printf("g %i  v %i  ind %lu  before %-8.3f  after %-8.3f  interp %.3f +/- %.3f\n", bItr,badEntries[iBS],packetList[iBS],bTimeBefore,bTimeAfter,interpTimes[iBS],interpUnc[iBS]);
-        iBS++;
-      }
-    }
-    bItr++;
+    double bTimeBefore=0, bTimeAfter=0;
+    geIndex.Around(packetList[iBS], bTimeBefore, bTimeAfter);
+    if (bTimeAfter == 0) continue;  // no Ge packet after this one, leave it at 0.
+    interpTimes[iBS] = (bTimeAfter + bTimeBefore)/2.;
+    interpUnc[iBS] = (bTimeAfter - bTimeBefore)/2.;
+    // vlogf("v %i  ind %li  before %-8.3f  after %-8.3f  interp %.3f +/- %.3f\n", badEntries[iBS],packetList[iBS],bTimeBefore,bTimeAfter,interpTimes[iBS],interpUnc[iBS]);
   }
-  delete ds;
 }
-
-double PanelInfo(int run, int panel, string option)
-{
-  // Implemented for DS3 and onward.
-
-  // Each panel's mean hit rate:
-
-  vector<double> hitRateMean =  {0.007338, 0.007482, 0.007730, 0.009183, 0.005995, 0.005272, 0.005786, 0.013200, 0.007360, 0.008041, 0.006708, 0.004830, 0.006750, 0.010310, 0.011600, 0.020450, 0.006718, 0.028900, 0.008145, 0.025110, 0.002854, 0.003381, 0.006357, 0.002808, 0.0006327, 0.0010950, 0.0003902, 0.003375, 0.0022120, 0.005735, 0.0007639, 0.005983};
-
-  vector<double> hitRateSig = {0.001709, 0.001793, 0.001888, 0.002020, 0.001848, 0.00145 , 0.001414, 0.002276, 0.001566, 0.001775, 0.001587, 0.001344, 0.001948, 0.001995, 0.002273, 0.002962, 0.001635, 0.003787, 0.002711, 0.003167, 0.001129, 0.001145, 0.001727, 0.001200, 0.0004681, 0.0006459, 0.0003892, 0.001133, 0.0009158, 0.001850, 0.0005355, 0.001726};
-
-  // Each panel's mean qdc value:
-
-  vector<double> qdcMean = {925, 629.8, 1268, 993.4, 2151, 849.8, 720.2, 2997, 1585, 1185, 1495, 1207, 709.9, 1007, 1702, 2592, 643.2, 1040, 1115, 1307, 1917, 2027, 1214, 1069, 3783, 638.7, 1595, 1138, 1079, 1699, 2476, 3843};
-
-  vector<double> qdcSig = {220, 108.9, 175.6, 136.8, 309.9, 131.9, 115.1, 396.4, 228.5, 182.1, 230.5, 170.5, 93.33, 119.2, 207.9, 319.6, 155.6, 142,  217.2, 173.4, 272.5, 264.5, 145,  215.5, 269.2, 164.6, 263.8, 186.3, 204.9, 253.8, 282.3, 209.7};
-
-  // For runs > 19091:
-
-  vector<double> qdcMean2 = {3772, 520.1, 1491, 1110, 2306, 970.3, 2380, 3445, 1676, 1433, 1617, 1292, 857.2, 1124, 2104, 2576, 701.3, 1160, 1312, 1409, 2131, 2279, 1383, 1199, 1048, 743.7, 1688, 1220, 1343, 1760, 2212, 1828};
-
-  vector<double> qdcSig2 =  {297, 92.38, 199.9, 150.1, 321.5, 149.5, 299.3, 387.1, 239.2, 212.6, 244.3, 178.9, 113,  129.6, 245.3, 312.3, 162.3, 154.5, 255.4, 184.5, 292.5, 288.8, 161, 228.7, 210, 176,  270.8, 194.4, 230.4, 261.8, 316, 230.8};
-
-  if (option=="hitRateMean") return hitRateMean[panel];
-  if (option=="hitRateSigma") return hitRateSig[panel];
-  if (option=="qdcMean" && run > 19091 && run < 4500000) return qdcMean2[panel];
-  if (option=="qdcMean" && run < 19091 && run < 4500000) return qdcMean[panel];
-  if (option=="qdcSigma" && run > 19091 && run > 16797) return qdcSig2[panel];
-  if (option=="qdcSigma" && run > 19091 && run > 16797) return qdcSig[panel];
-  return 0;
-}
\ No newline at end of file
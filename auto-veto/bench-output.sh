@@ -0,0 +1,32 @@
+#!/bin/bash
+# Per-run wall time of auto-veto with each output layout, output mode (writer thread
+# or -s) and compression setting.
+# Usage: ./bench-output.sh [run number] [optional: output directory]
+# The "Output" line gives the muon scan time and how long it waited on the writer.
+
+if [ -z "$1" ]; then
+   echo "Usage: ./bench-output.sh [run number] [optional: output directory]"
+   exit
+fi
+run=$1
+out=${2:-./bench}
+mkdir -p $out
+
+make --quiet
+for layout in 1 2
+do
+  for comp in none lz4:4 zlib:1 zstd:5
+  do
+    for mode in async sync
+    do
+      flag=""
+      if [ "$mode" = "sync" ]; then flag="-s"; fi
+      start=$(date +%s.%N)
+      ./auto-veto $run -v -o $out -f $layout -z $comp $flag > $out/bench-$run.log
+      stop=$(date +%s.%N)
+      size=$(stat -c %s $out/veto_run$run.root)
+      printf "v%i %-8s %-6s wall %7.2f sec  file %10i bytes\n" $layout $comp $mode $(echo "$stop - $start" | bc) $size
+      grep "Output (" $out/bench-$run.log
+    done
+  done
+done
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Benchmark suite for the veto hot paths (run by "make bench").
+# Usage: ./bench.sh [optional: baseline results file]
+# Generates a synthetic run, processes its built file with auto-veto --profile, then runs
+# veto-bench on the same run as a .vsyn file (same seed, so the same entries).
+# The built file has the Ge stream too, so auto-veto builds its Ge index and does the
+# clock sync from the built chain, as for a production run.  Its output goes in
+# bench-out/av, so the Ge index it saves doesn't replace the one veto-bench reads.
+# Results go to bench-out/bench-results.json.  With a baseline, regressions are flagged
+# and the script exits nonzero.  BENCH_SCALE=10 makes the run 10x longer.
+
+dir=./bench-out
+scale=${BENCH_SCALE:-1}
+run=20000
+mkdir -p $dir/av
+
+gen="./veto-gen $run -o $dir -x $scale -bs 0.001 -flush 2 -jump 1 -reset 2 -seed 1"
+$gen > $dir/veto-gen.log || exit 1
+$gen -vsyn > $dir/veto-gen-vsyn.log || exit 1
+start=$(date +%s.%N)
+./auto-veto -g $dir/OR_run$run.root -o $dir/av --profile $dir/auto-veto-profile.json > $dir/auto-veto.log || exit 1
+stop=$(date +%s.%N)
+printf "auto-veto wall %.2f sec (%s)\n" $(echo "$stop - $start" | bc) "$(grep -m1 entries $dir/veto-gen.log)"
+
+./veto-bench -g $dir/synth_run$run.vsyn -a $dir/av/veto_run$run.root -p $dir/auto-veto-profile.json \
+  -o $dir/bench-results.json ${1:+-c $1}
@@ -1,6 +1,10 @@
 // A very, very stripped down version of
 // skim_mjd_data, for the purpose of checking
 // muon-ge coincidences.
+// Each gatified file is a shard, skimmed on a pool of threads into its own
+// partial skimTree (skim*.root.shards/), then the shards are merged in order.
+// Only the events passing the energy and pulser cuts are read in full (GeSelection.hh).
+// The hits are written as flat arrays, with a detector dictionary (SkimOutput.hh).
 // C. Wiseman, 2016/11/19
 
 #include "TFile.h"
@@ -18,8 +22,22 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "TEntryList.h"
 #include "TROOT.h"
+#include "TNamed.h"
+#include "TBranch.h"
 
 #include "GATDataSet.hh"
 #include "MJTChannelMap.hh"
@@ -29,24 +47,93 @@
 #include "MJVetoEvent.hh"
 
 #include "DataSetInfo.hh"
+#include "VetoCoincidence.hh"
+#include "VetoOutput.hh"
+#include "VetoProfile.hh"
+#include "VetoLog.hh"
+#include "VetoMuonList.hh"
+#include "VetoWindowIndex.hh"
+#include "VetoMuonCatalog.hh"
+#include "DS4MuonList.hh"
+#include "GeSelection.hh"
+#include "SkimOutput.hh"
+#include "GeDetStatus.hh"
 
 using namespace std;
 using namespace CLHEP;
 
+const char *kDS4MuonCatalog = "./avout/muons_DS4.vmc";
+const char *kDetStatusFile = "./detStatus.txt";
+
+// The dataset settings and muon data every shard uses.  Read-only once the shards start.
+struct SkimConfig {
+  int dsNumber = 0;
+  string gatTreeName;
+  GeSelectCuts cuts;
+  string selectDir;     // cached pre-selections
+  double runTime_s = 0, startTime0 = 0;
+  GeDetStatusTable detStatus;  // bad and veto-only detectors
+  const VetoMuonList *mu = 0;
+  const VetoWindowIndex *muWindows = 0;
+  SkimDetTable *detTable = 0;  // shared by the shards (thread safe)
+};
+
+// One gatified file, skimmed into its own partial skimTree.
+struct SkimShard {
+  size_t index = 0;
+  string inFile, outFile;
+  string input;  // the input file (path and VetoFileKey) and muons, saved as "skimInput"
+  long entries = 0, selected = 0, saved = 0;
+  bool selectReused = false;  // the pre-selection came from the cache
+  double seconds = 0;
+  int status = 1;
+  bool resumed = false;  // done by an earlier job
+};
+
 void LoadDataSet(GATDataSet& ds, int dsNumber, size_t iRunSeq);
 void LoadRun(GATDataSet& ds, size_t iRunSeq);
-void LoadDS4MuonList(vector<int> &muRuns, vector<double> &muRunTStarts, vector<double> &muTimes,
-  vector<int> &muTypes, vector<double> &muUncert);
+TTree *MakeSkimTree(SkimEvent &ev);
+string SkimSchema(TTree *skimTree);
+uint64_t SkimMuonKey(const VetoMuonList &mu, const vector<VetoWindowDef> &windowDefs);
+bool ShardDone(string file, string schema, string input, SkimDetTable &detTable);
+int SkimShardFile(SkimShard &shard, const SkimConfig &cfg, const string &schema);
+int MergeShards(const vector<SkimShard> &shards, string outFile, const vector<string> &detNames);
+bool ParseDouble(string s, double &val);
+bool ParseMask(string s, unsigned int &val);
 
 int main(int argc, const char** argv)
 {
-  if(argc < 3 || argc > 7) {
+  if(argc < 3 || argc > 9) {
     cout << "Usage for single file: " << argv[0] << " -f [runNum] (output path)" << endl;
     cout << "Usage for data sets: " << argv[0] << " [dataset number] [runseq] (output path)" << endl;
     cout << "Usage for run lists: " << argv[0] << " -l [dataset number] [path to txt list] (output path)" << endl;
+    cout << "Before the numbers: -e [keV] keeps hits over this in trapENFCal or trapECal (default 2630)." << endl;
+    cout << "                    -p [mask] skips events with any of these EventDC1Bits, e.g. 0x2 (pulsers, the default)." << endl;
+    cout << "Set VETO_PROFILE=[file.json] to write per-phase timing and I/O (see VetoProfile.hh)." << endl;
+    cout << "Set VETO_SKIM_THREADS=[n] to skim that many files at once (default: all cores)." << endl;
+    cout << "Set VETO_MUON_CATALOG=[file] to read the muons from a catalog (skim-veto -cat) instead of the veto files." << endl;
+    cout << "  DS4 always uses one, default " << kDS4MuonCatalog << " (skim-veto -ds4cat), or " << kDS4MuonFile << " if it doesn't exist." << endl;
+    cout << "Set VETO_DET_STATUS=[file] to read the detector status from another file (default " << kDetStatusFile << ")." << endl;
     return 1;
   }
 
+  // Optional phase profiling.  The report is written when the profiler goes out of scope.
+  struct SkimProfile {
+    VetoProfiler prof;
+    string file;
+    SkimProfile() : prof("skim-coins") {
+      if (getenv("VETO_PROFILE")) file = getenv("VETO_PROFILE");
+      if (!file.empty()) VetoProfilerCurrent() = &prof;
+    }
+    ~SkimProfile() {
+      if (file.empty()) return;
+      VetoProfilerCurrent() = 0;
+      prof.SetPeakRSS();
+      VetoProfileReport::Get().Add(prof);
+      if (VetoProfileReport::Get().Write(file,"skim-coins")) cout << "Wrote profile: " << file << endl;
+    }
+  } skimProfile;
+
   GATDataSet ds;
   TChain *vetoChain = new TChain("vetoTree");
   string outputPath = "";
@@ -55,9 +142,28 @@ int main(int argc, const char** argv)
   int runSeq=0;
   bool singleFile = false;
   bool runList = false;
+  string muCatalog = getenv("VETO_MUON_CATALOG") ? getenv("VETO_MUON_CATALOG") : "";
+  vector<int> catRuns;  // runs to take from the catalog.  empty: all of them
+  GeSelectCuts cuts;
   TString flags ="";
   int i = 1;
-  while(!TString(argv[i]).IsDigit()){
+  while(i < argc && !TString(argv[i]).IsDigit()){
+    if (string(argv[i]) == "-e" && i+1 < argc) {
+      if (!ParseDouble(argv[i+1], cuts.eThresh) || cuts.eThresh < 0) {
+        cout << "Bad energy threshold: -e " << argv[i+1] << endl;
+        return 1;
+      }
+      i += 2;
+      continue;
+    }
+    if (string(argv[i]) == "-p" && i+1 < argc) {
+      if (!ParseMask(argv[i+1], cuts.pulserMask)) {
+        cout << "Bad pulser mask: -p " << argv[i+1] << endl;
+        return 1;
+      }
+      i += 2;
+      continue;
+    }
     flags += TString(argv[i]);
     i++;
   }
@@ -76,7 +182,8 @@ int main(int argc, const char** argv)
     }
     cout << "Loading run " << runSeq << endl;
     ds.AddRunNumber(runSeq);
-    if (!vetoChain->Add(TString::Format("./avout/DS5/veto_run%i.root",runSeq))){
+    catRuns.push_back(runSeq);
+    if (muCatalog == "" && dsNumber != 4 && !vetoChain->Add(TString::Format("./avout/DS5/veto_run%i.root",runSeq))){
       cout << "Veto files not found.  Exiting ...\n";
       return 1;
     }
@@ -95,7 +202,8 @@ int main(int argc, const char** argv)
     for (auto i : runList)
     {
       ds.AddRunNumber(i);
-      if (dsNumber==4) continue;
+      catRuns.push_back(i);
+      if (dsNumber==4 || muCatalog != "") continue;
       if (!vetoChain->Add(TString::Format("./avout/DS5/veto_run%i.root",i))){
         cout << "Veto files not found.  Exiting ...\n";
         return 1;
@@ -117,69 +225,311 @@ int main(int argc, const char** argv)
 
   // Load muon data
   cout << "Loading muon data..." << endl;
-  vector<int> muRuns;
-  vector<int> muTypes;
-  vector<double> muRunTStarts;
-  vector<double> muTimes;
-  vector<double> muUncert;
-  if (dsNumber != 4)
+  VetoMuonList mu;
+  bool ds4List = false;
+  if (dsNumber == 4 && muCatalog == "") {
+    muCatalog = kDS4MuonCatalog;
+    // no catalog yet (skim-veto -ds4cat): read the list it's made from
+    if (access(muCatalog.c_str(), F_OK) != 0) {
+      cout << "No muon catalog " << muCatalog << ", reading " << kDS4MuonFile << " instead.\n";
+      muCatalog = "";
+      ds4List = true;
+    }
+  }
+  if (ds4List)
   {
-    TTreeReader vetoReader(vetoChain);
-    TTreeReaderValue<MJVetoEvent> vetoEventIn(vetoReader,"vetoEvent");
-    TTreeReaderValue<int> vetoRunIn(vetoReader,"run");
-  	TTreeReaderValue<Long64_t> vetoStart(vetoReader,"start");
-  	TTreeReaderValue<Long64_t> vetoStop(vetoReader,"stop");
-  	TTreeReaderValue<double> xTime(vetoReader,"xTime");
-    TTreeReaderValue<double> timeUncert(vetoReader,"timeUncert");
-  	TTreeReaderArray<int> CoinType(vetoReader,"CoinType");	//[32]
-    bool newRun=false;
-  	int prevRun=0;
-  	Long64_t prevStop=0;
-  	while(vetoReader.Next())
-  	{
-      MJVetoEvent veto = *vetoEventIn;
-      int run = *vetoRunIn;
-  		if (run != prevRun) newRun=true;
-  		else newRun = false;
-  		int type = 0;
-  		if (CoinType[0]) type=1;
-  		if (CoinType[1]) type=2;	// overrides type 1 if both are true
-  		if ((*vetoStart-prevStop) > 10 && newRun) type = 3;
-      if (type > 0){
-        muRuns.push_back(run);
-        muRunTStarts.push_back(*vetoStart);
-        muTypes.push_back(type);
-        if (type!=3) muTimes.push_back(*xTime);
-        else muTimes.push_back(*xTime); // time of the first veto entry in the run
-        if (!veto.GetBadScaler()) muUncert.push_back(*timeUncert);
-        else muUncert.push_back(8.0); // uncertainty for corrupted scalers
-      }
-  		prevStop = *vetoStop;  // end of entry, save the run and stop time
-  		prevRun = run;
-  	}
-    delete vetoChain;
-  }
-  else LoadDS4MuonList(muRuns,muRunTStarts,muTimes,muTypes,muUncert);
-  size_t iMu = 0;
-  size_t nMu = muTimes.size();
+    VETO_SCOPE(pMuons, "muonList");
+    string err;
+    if (!LoadDS4MuonList(kDS4MuonFile, mu, err, catRuns)) {
+      cout << err << ".  Exiting ...\n";
+      return 1;
+    }
+    pMuons.AddEntries(mu.Size());
+  }
+  else if (muCatalog != "")
+  {
+    VETO_SCOPE(pMuons, "muonCatalog");
+    VetoMuonCatalog cat;
+    if (!cat.Open(muCatalog)) {
+      cout << "Couldn't open muon catalog " << muCatalog << ".  Exiting ...\n";
+      return 1;
+    }
+    cat.Load(mu, catRuns);
+    pMuons.AddEntries(mu.Size());
+    cout << "Muon catalog " << muCatalog << " has " << cat.GetNMuons() << " entries in " << cat.GetNRuns() << " runs.\n";
+  }
+  else
+  {
+    VETO_SCOPE(pMuons, "muonList");
+    pMuons.AddEntries(vetoChain->GetEntries());
+    LoadMuonList(vetoChain, mu);
+  }
+  delete vetoChain;
+  size_t nMu = mu.Size();
   if(nMu == 0) {
     cout << "couldn't load mu data" << endl;
     return 0;
   }
-  cout << "Muon list has " << muRuns.size() << " entries.\n";
-  // for (int i = 0; i < (int)muRuns.size(); i++)
-    // printf("%i  %i  %i  %.0f  %.3f +/- %.3f\n",i,muRuns[i],muTypes[i],muRunTStarts[i],muTimes[i],muUncert[i]);
+  cout << "Muon list has " << nMu << " entries.\n";
+
+  // Veto windows: the dataset's (muVeto), and the wide DS4 one (muVetoWide)
+  vector<VetoWindowDef> muWindowDefs = {VetoWindowForDS(dsNumber), WideVetoWindow()};
+  VetoWindowIndex muWindows(mu, muWindowDefs);
+  for (size_t d = 0; d < muWindows.GetNDefs(); d++)
+    printf("Veto windows (%s): %lu muons, %lu merged windows, %.2f sec\n", muWindows.GetDef(d).name.c_str(),
+      muWindows.GetSet(d).GetNAdded(), muWindows.GetSet(d).Size(), muWindows.GetSet(d).DeadTime());
+  // for (int i = 0; i < (int)nMu; i++)
+    // printf("%i  %i  %i  %.0f  %.3f +/- %.3f\n",i,mu.runs[i],mu.types[i],mu.runTStarts[i],mu.times[i],mu.uncert[i]);
+
+  // Time and detector settings for the dataset, shared by the shards
+  SkimConfig cfg;
+  cfg.dsNumber = dsNumber;
+  cfg.cuts = cuts;
+  cfg.mu = &mu;
+  cfg.muWindows = &muWindows;
+  SkimDetTable detTable;
+  cfg.detTable = &detTable;
+  if(dsNumber == 0) {
+    cfg.runTime_s = 4121110;
+    cfg.startTime0 = 1435687000; // start time of run 2580
+  }
+  else if(dsNumber == 1) {
+    cfg.runTime_s = 5282280; //was 4728790; before blinding
+    cfg.startTime0 = 1452643100; // start time of run 9422
+  }
+  else if(dsNumber == 3) {
+    cfg.runTime_s = 2584470;//1549710;
+    cfg.startTime0 = 1472169600; // start time of run 16797
+  }
+  else if(dsNumber == 4) {
+    cfg.runTime_s = 2060020;//1460390;
+    cfg.startTime0 = 1472169600; // start time of run 60000802
+  }
+  // Bad and veto-only detectors for the dataset
+  string detStatusFile = getenv("VETO_DET_STATUS") ? getenv("VETO_DET_STATUS") : kDetStatusFile;
+  if (!cfg.detStatus.Load(detStatusFile, dsNumber)) {
+    cout << "Couldn't read detector status: " << cfg.detStatus.GetError() << ".  Exiting ...\n";
+    return 1;
+  }
+  printf("Detector status: %lu entries for DS%i from %s\n", cfg.detStatus.Size(), dsNumber, detStatusFile.c_str());
 
-  // set up dataset
+  // set up dataset: one shard per gatified file, in the chain's (run) order
   TChain* gatChain = ds.GetGatifiedChain(false);
+  cfg.gatTreeName = gatChain->GetName();
+  vector<SkimShard> shards;
+  TObjArray *gatFiles = gatChain->GetListOfFiles();
+  for (int f = 0; f < gatFiles->GetEntries(); f++) {
+    SkimShard shard;
+    shard.index = f;
+    shard.inFile = gatFiles->At(f)->GetTitle();
+    shards.push_back(shard);
+  }
+
+  // output file name
+  string filename = TString::Format("skimDS%d_", dsNumber).Data();
+  char runStr[10];
+  sprintf(runStr, "%d", runSeq);
+  if(singleFile) filename += "run";
+  if(runList) sprintf(runStr,"list");
+  filename += runStr;
+  filename += ".root";
+  if(outputPath != "") filename = outputPath + "/" + filename;
+
+  // Shards are written next to the output.  A shard that's already there with the
+  // same skimTree branches, cuts, detector status, input file and muons is done,
+  // so a job that died only redoes the missing ones.
+  string shardDir = filename + ".shards";
+  if (mkdir(shardDir.c_str(), 0775) != 0 && errno != EEXIST) {
+    cout << "Couldn't make shard directory " << shardDir << ".  Exiting ...\n";
+    return 1;
+  }
+  // The pre-selections are kept for the next job, with any threshold.
+  cfg.selectDir = (outputPath != "" ? outputPath : string(".")) + "/skimsel";
+  if (mkdir(cfg.selectDir.c_str(), 0775) != 0 && errno != EEXIST)
+    cout << "Warning: couldn't make " << cfg.selectDir << ", the pre-selections won't be saved.\n";
+  string schema;
+  {
+    SkimEvent ev;
+    TTree *t = MakeSkimTree(ev);
+    schema = SkimSchema(t) + TString::Format("eThresh:%g;pulserMask:%#x;", cuts.eThresh, cuts.pulserMask).Data();  // and the cuts
+    schema += TString::Format("detStatus:%016llx;", (unsigned long long)cfg.detStatus.GetKey()).Data();
+    delete t;
+  }
+  // A finished shard's detector indices are kept, so they have to agree with the
+  // ones already taken from the shards before it.  If they don't, it's redone.
+  // An input file that can't be keyed (VetoFileKey 0) is always redone.
+  uint64_t muKey = SkimMuonKey(mu, muWindowDefs);
+  vector<size_t> todo;
+  for (auto &shard : shards) {
+    shard.outFile = shardDir + TString::Format("/shard%04lu.root", shard.index).Data();
+    uint64_t inKey = VetoFileKey(shard.inFile);
+    shard.input = "inFile:" + shard.inFile + TString::Format(";inKey:%016llx;muons:%016llx;",
+      (unsigned long long)inKey, (unsigned long long)muKey).Data();
+    if (inKey != 0 && ShardDone(shard.outFile, schema, shard.input, detTable)) { shard.status = 0; shard.resumed = true; }
+    else todo.push_back(shard.index);
+  }
+
+  int nThreads = thread::hardware_concurrency();
+  if (getenv("VETO_SKIM_THREADS")) nThreads = atoi(getenv("VETO_SKIM_THREADS"));
+  if (nThreads > (int)todo.size()) nThreads = (int)todo.size();
+  if (nThreads < 1) nThreads = 1;
+  printf("Skimming %lu files: %lu to do (%lu done before), on %i threads.\n",
+    shards.size(), todo.size(), shards.size()-todo.size(), nThreads);
+
+  // Workers take the next shard until there are none left.
+  // Each shard's output is buffered and printed in one piece when it's done.
+  ROOT::EnableThreadSafety();
+  bool profile = !skimProfile.file.empty();
+  atomic<size_t> nextShard(0);
+  mutex printMutex;
+  auto worker = [&]() {
+    while (true) {
+      size_t j = nextShard++;
+      if (j >= todo.size()) break;
+      SkimShard &shard = shards[todo[j]];
+      ostringstream buf;
+      VetoLogBuffer() = &buf;
+      unique_ptr<VetoProfiler> prof;
+      if (profile) prof.reset(new VetoProfiler("shard", shard.index));
+      VetoProfilerCurrent() = prof.get();
+      auto t0 = chrono::steady_clock::now();
+      shard.status = SkimShardFile(shard, cfg, schema);
+      shard.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+      VetoProfilerCurrent() = 0;
+      if (prof) VetoProfileReport::Get().Add(*prof);
+      VetoLogBuffer() = 0;
+      lock_guard<mutex> lock(printMutex);
+      cout << buf.str();
+      printf("Shard %lu (%s): %li events, %li selected%s, %li saved, %.1f sec, %s\n", shard.index, shard.inFile.c_str(),
+        shard.entries, shard.selected, shard.selectReused ? " (cached)" : "", shard.saved, shard.seconds, shard.status==0 ? "ok" : "FAILED");
+      cout << flush;
+    }
+  };
+  VETO_SCOPE(pGe, "geLoop");
+  vector<thread> pool;
+  for (int t = 0; t < nThreads; t++) pool.push_back(thread(worker));
+  for (auto &t : pool) t.join();
+  long nEntries = 0;
+  int nFailed = 0;
+  for (auto &shard : shards) {
+    nEntries += shard.entries;
+    if (shard.status != 0) nFailed++;
+  }
+  pGe.Stop(nEntries);
+  if (nFailed > 0) {
+    printf("%i of %lu shards failed.  Run again to redo them.\n", nFailed, shards.size());
+    return 1;
+  }
+
+  // merge the shards into the output file
+  cout << "Closing out skim file..." << endl;
+  VETO_SCOPE(pWrite, "writeOutput");
+  if (MergeShards(shards, filename, detTable.Names()) != 0) return 1;
+  for (auto &shard : shards) remove(shard.outFile.c_str());
+  rmdir(shardDir.c_str());
+  pWrite.Stop();
+
+  return 0;
+}
+
+// The output branches (SkimOutput.hh).
+TTree *MakeSkimTree(SkimEvent &ev)
+{
+  TTree* skimTree = new TTree("skimTree", "skimTree");
+  ev.Book(skimTree);
+  return skimTree;
+}
+
+// Branch names and types, to tell whether a shard was written by this version.
+string SkimSchema(TTree *skimTree)
+{
+  string schema;
+  TObjArray *branches = skimTree->GetListOfBranches();
+  for (int b = 0; b < branches->GetEntries(); b++) {
+    TBranch *br = (TBranch*)branches->At(b);
+    schema += string(br->GetName()) + ":" + br->GetClassName() + ":" + br->GetTitle() + ";";
+  }
+  return schema;
+}
+
+// The whole string must be a number ("12abc" is rejected).
+bool ParseDouble(string s, double &val)
+{
+  size_t end = 0;
+  try { val = stod(s, &end); }
+  catch (...) { return false; }
+  return end == s.size() && isfinite(val);
+}
+
+// Decimal, or hex with 0x.  Has to fit in EventDC1Bits (32 bits).
+bool ParseMask(string s, unsigned int &val)
+{
+  size_t end = 0;
+  unsigned long v = 0;
+  if (s.empty() || s[0] == '-') return false;
+  try { v = stoul(s, &end, 0); }
+  catch (...) { return false; }
+  if (end != s.size() || v > UINT_MAX) return false;
+  val = v;
+  return true;
+}
+
+// The muon list and veto windows the shards are vetoed with.
+uint64_t SkimMuonKey(const VetoMuonList &mu, const vector<VetoWindowDef> &windowDefs)
+{
+  VetoKey key;
+  key.Add(mu.Size());
+  for (size_t i = 0; i < mu.Size(); i++) {
+    key.Add(mu.runs[i]).Add(mu.types[i]).Add(mu.runTStarts[i]).Add(mu.times[i]).Add(mu.uncert[i]);
+    key.Add((bool)(i < mu.badScalers.size() && mu.badScalers[i]));
+  }
+  for (auto &def : windowDefs) {
+    key.Add(def.name.data(), def.name.size());
+    key.Add(def.before).Add(def.uncBefore).Add(def.after).Add(def.uncAfter);
+  }
+  return key.Get();
+}
+
+// Is this shard's output complete, with the current branches, and made from the same input?
+// If it is, its detector table is merged into detTable (if they agree).
+bool ShardDone(string file, string schema, string input, SkimDetTable &detTable)
+{
+  if (access(file.c_str(), F_OK) != 0) return false;
+  TFile *f = TFile::Open(file.c_str());
+  if (!f || f->IsZombie()) { delete f; return false; }
+  TNamed *s = (TNamed*)f->Get("skimSchema");
+  TNamed *in = (TNamed*)f->Get("skimInput");
+  bool done = s && schema == s->GetTitle() && in && input == in->GetTitle() && f->Get("skimTree");
+  vector<string> detNames;
+  if (done) done = SkimDetTable::Read(f, detNames) && detTable.Merge(detNames);
+  f->Close();
+  delete f;
+  return done;
+}
+
+// Skim one gatified file.  Written to [shard].tmp, then renamed when it's complete.
+int SkimShardFile(SkimShard &shard, const SkimConfig &cfg, const string &schema)
+{
+  TChain *gatChain = new TChain(cfg.gatTreeName.c_str());
+  if (!gatChain->Add(shard.inFile.c_str())) {
+    vlog() << "Couldn't open " << shard.inFile << endl;
+    delete gatChain;
+    return 1;
+  }
   TTreeReader gatReader(gatChain);
+  const VetoMuonList &mu = *cfg.mu;
+  const VetoWindowIndex &muWindows = *cfg.muWindows;
+  int dsNumber = cfg.dsNumber;
+  GeDetStatusView detStatus;   // for statusRun
+  int statusRun = INT_MIN;
+  // detID -> (detIdx, enriched/natural bits).  detName is only read for a detector's first hit.
+  unordered_map<int, pair<UShort_t,UChar_t> > detInfo;
 
   // set up input chain value readers
 
   // run level variables and indices
   TTreeReaderValue<unsigned int> gatrevIn(gatReader, "gatrev");
   TTreeReaderValue<double> runIn(gatReader, "run");
-  double runSave = -1;
 
   // ID variables
   TTreeReaderValue< vector<double> > channelIn(gatReader, "channel");
@@ -188,8 +538,6 @@ int main(int argc, const char** argv)
   TTreeReaderValue< vector<int> > posIn(gatReader, "P");
   TTreeReaderValue< vector<int> > detIn(gatReader, "D");
   TTreeReaderValue< vector<int> > cryoIn(gatReader, "C");
-  TTreeReaderValue< vector<bool> > isEnrIn(gatReader, "isEnr");
-  TTreeReaderValue< vector<bool> > isNatIn(gatReader, "isNat");
 
   // time variables
   TTreeReaderValue<double> startTimeIn(gatReader, "startTime");
@@ -202,306 +550,176 @@ int main(int argc, const char** argv)
   TTreeReaderValue< vector<double> > trapENFCalIn(gatReader, "trapENFCal");
   TTreeReaderValue< vector<double> > trapECalIn(gatReader, "trapECal");
 
-  // data cleaning variables
-  const int kPinghanPulserMask = 0x1 << 1; // pinghan pulsers
-  TTreeReaderValue<unsigned int> eventDC1BitsIn(gatReader, "EventDC1Bits");
-
-  // set up output file and tree
-  cout << "creating output file ...\n";
-  string filename = TString::Format("skimDS%d_", dsNumber).Data();
-  char runStr[10];
-  sprintf(runStr, "%d", runSeq);
-  if(singleFile) filename += "run";
-  if(runList) sprintf(runStr,"list");
-  filename += runStr;
-  filename += ".root";
-  if(outputPath != "") filename = outputPath + "/" + filename;
-  TFile *fOut = TFile::Open(filename.c_str(), "recreate");
-  TTree* skimTree = new TTree("skimTree", "skimTree");
-
-  // set up output chain branches
-
-  // run level variables and indices
-  int run = 0;
-  skimTree->Branch("run", &run, "run/I");
-  int iEvent = 0;
-  skimTree->Branch("iEvent", &iEvent, "iEvent/I");
-  vector<int> iHit;
-  skimTree->Branch("iHit", &iHit);
-
-  // ID variables
-  vector<int> channel;
-  skimTree->Branch("channel", &channel);
-  vector<int> pos;
-  skimTree->Branch("P", &pos);
-  vector<int> det;
-  skimTree->Branch("D", &det);
-  vector<string> detName;
-  skimTree->Branch("detName", &detName);
-  vector<int> cryo;
-  skimTree->Branch("C", &cryo);
-  vector<int> gain;
-  skimTree->Branch("gain", &gain);
-  vector<int> detID;
-  skimTree->Branch("detID", &detID);
-  vector<bool> isEnr;
-  skimTree->Branch("isEnr", &isEnr);
-  vector<bool> isNat;
-  skimTree->Branch("isNat", &isNat);
-  vector<bool> isGood;
-  skimTree->Branch("isGood", &isGood);
-
-  // time variables
-  double runTime_s = 0;
-  double startTime = 0;
-  double startTime0 = 0;
-  double stopTime = 0;
-  if(dsNumber == 0) {
-    runTime_s = 4121110;
-    startTime0 = 1435687000; // start time of run 2580
-  }
-  else if(dsNumber == 1) {
-    runTime_s = 5282280; //was 4728790; before blinding
-    startTime0 = 1452643100; // start time of run 9422
+  // Events with a hit over threshold that aren't pulsers.  Only these are read in full.
+  GeSelection sel;
+  VETO_SCOPE(pSelect, "geSelect");
+  if (!GetGeSelection(shard.inFile, cfg.gatTreeName, cfg.cuts, cfg.selectDir, sel, shard.selectReused)) {
+    vlog() << "Couldn't scan " << shard.inFile << endl;
+    delete gatChain;
+    return 1;
   }
-  else if(dsNumber == 3) {
-    runTime_s = 2584470;//1549710;
-    startTime0 = 1472169600; // start time of run 16797
+  pSelect.Stop(shard.selectReused ? 0 : sel.entries);
+  shard.entries = sel.entries;
+  shard.selected = sel.selected.size();
+  if (VetoProfiler *prof = VetoProfilerCurrent()) {
+    prof->SetCounter("geEntries", sel.entries);
+    prof->SetCounter("geSelected", sel.selected.size());
+    prof->SetCounter("geSelectReused", shard.selectReused);
   }
-  else if(dsNumber == 4) {
-    runTime_s = 2060020;//1460390;
-    startTime0 = 1472169600; // start time of run 60000802
-  }
-  skimTree->Branch("startTime", &startTime, "startTime/D");
-  skimTree->Branch("startTime0", &startTime0, "startTime0/D");
-  skimTree->Branch("runTime_s", &runTime_s, "runTime_s/D");
-  skimTree->Branch("stopTime", &stopTime, "stopTime/D");
-  vector<double> tloc_s;
-  skimTree->Branch("tloc_s", &tloc_s);
-  vector<double> time_s;
-  skimTree->Branch("time_s", &time_s);
-  vector<double> timeMT;
-  skimTree->Branch("timeMT", &timeMT);
-  vector<int> dateMT;
-  skimTree->Branch("dateMT", &dateMT);
 
-  // energy variables
-  vector<double> trapENFCal;
-  skimTree->Branch("trapENFCal", &trapENFCal);
-  vector<double> trapECal;
-  skimTree->Branch("trapECal", &trapECal);
-
-  // analysis cut variables
-  int mH = 0;
-  skimTree->Branch("mH", &mH, "mH/I");
-  int mL = 0;
-  skimTree->Branch("mL", &mL, "mL/I");
-
-  // data cleaning variables
-  unsigned int eventDC1Bits = 0;
-  skimTree->Branch("EventDC1Bits", &eventDC1Bits, "eventDC1Bits/i");
-
-  // veto variables
-  vector<double> dtmu_s;
-  skimTree->Branch("dtmu_s", &dtmu_s);
-  vector<int> muType;
-  skimTree->Branch("muType", &muType);
-  vector<bool> muTUnc;
-  skimTree->Branch("muTUnc", &muTUnc);
-  vector<bool> muVeto;
-  skimTree->Branch("muVeto", &muVeto);
-  map<int,bool> detIDIsBad;
-  if(dsNumber == 0) {
-    detIDIsBad[28474] = true;
-    detIDIsBad[1426622] = true;
-    detIDIsBad[28480] = true;
-    detIDIsBad[1426980] = true;
-    detIDIsBad[1426620] = true;
-    detIDIsBad[1425370] = true;
-  }
-  if(dsNumber == 1) {
-    detIDIsBad[1426981] = true;
-    detIDIsBad[1426622] = true;
-    detIDIsBad[28455] = true;
-    detIDIsBad[28470] = true;
-    detIDIsBad[28463] = true;
-    detIDIsBad[28465] = true;
-    detIDIsBad[28469] = true;
-    detIDIsBad[28477] = true;
-    detIDIsBad[1425751] = true;
-    detIDIsBad[1425731] = true;
-    detIDIsBad[1426611] = true;
-  }
-  if(dsNumber == 3) {
-    detIDIsBad[1426981] = true;
-    detIDIsBad[1426622] = true;
-    detIDIsBad[28477] = true;
-    detIDIsBad[1425731] = true;
-    detIDIsBad[1426611] = true;
-  }
-  if(dsNumber == 4) {
-    detIDIsBad[28595] = true;
-    detIDIsBad[28461] = true;
-    detIDIsBad[1428530] = true;
-    detIDIsBad[28621] = true;
-    detIDIsBad[28473] = true;
-    detIDIsBad[1426651] = true;
-    detIDIsBad[1429092] = true;
-    detIDIsBad[1426652] = true;
-    detIDIsBad[28619] = true;
-  }
-  map<int,bool> detIDIsVetoOnly;
-  if(dsNumber == 0) {
-    detIDIsVetoOnly[1425381] = true;
-    detIDIsVetoOnly[1425742] = true;
-  }
-  if(dsNumber == 1) {
-    detIDIsVetoOnly[28480] = true;
-    detIDIsVetoOnly[1426621] = true;
-  }
-  if(dsNumber == 3) {
-    detIDIsVetoOnly[28480] = true;
-    detIDIsVetoOnly[28470] = true;
-    detIDIsVetoOnly[28463] = true;
-  }
-  if(dsNumber == 4) {
-    detIDIsVetoOnly[28459] = true;
-    detIDIsVetoOnly[1426641] = true;
-    detIDIsVetoOnly[1427481] = true;
-    detIDIsVetoOnly[28456] = true;
-    detIDIsVetoOnly[1427120] = true;
-    detIDIsVetoOnly[1427121] = true;
-  }
-
-  // start loop over all events
-  while(gatReader.Next()) {
-
-    // stuff to do on run boundaries
-    if(runSave != *runIn) {
-      runSave = *runIn;
-      // cout << "Processing run " << *runIn << "\n";
-          //  << skimTree->GetEntries() << " entries saved so far"
-          //  << endl;
-      skimTree->Write("", TObject::kOverwrite);
+  // set up output file and tree
+  string tmpFile = shard.outFile + ".tmp";
+  TFile *fOut = TFile::Open(tmpFile.c_str(), "recreate");
+  if (!fOut || fOut->IsZombie()) {
+    vlog() << "Couldn't write " << tmpFile << endl;
+    delete gatChain;
+    return 1;
+  }
+  SkimEvent ev;
+  ev.runTime_s = cfg.runTime_s;
+  ev.startTime0 = cfg.startTime0;
+  TTree *skimTree = MakeSkimTree(ev);
+
+  // start loop over the selected events
+  for (auto entry : sel.selected) {
+    if (gatReader.SetEntry(entry) != TTreeReader::kEntryValid) {
+      vlog() << "Couldn't read entry " << entry << " of " << shard.inFile << endl;
+      delete gatChain;
+      delete fOut;
+      return 1;
     }
-
-    // Skip this event if it is a pulser event as identified by Pinghan
-    if(*eventDC1BitsIn & kPinghanPulserMask) continue;
-    iEvent = gatChain->GetTree()->GetReadEntry();
+    ev.iEvent = gatChain->GetTree()->GetReadEntry();
 
     // copy the event-level info to the output fields
-    run = int(*runIn);
-    startTime = *startTimeIn;
-    stopTime = *stopTimeIn;
-    mH = 0;
-    mL = 0;
+    int run = int(*runIn);
+    ev.run = run;
+    if (run != statusRun) {
+      detStatus = cfg.detStatus.ForRun(run);
+      statusRun = run;
+    }
+    ev.startTime = *startTimeIn;
+    ev.stopTime = *stopTimeIn;
+    ev.mH = 0;
+    ev.mL = 0;
+    double startTime = ev.startTime;
 
     // clear all hit-level info fields
-    iHit.resize(0);
-    muType.resize(0);
-    muTUnc.resize(0);
-    dtmu_s.resize(0);
-    trapECal.resize(0);
-    trapENFCal.resize(0);
-    channel.resize(0);
-    tloc_s.resize(0);
-    time_s.resize(0);
-    timeMT.resize(0);
-    dateMT.resize(0);
-    pos.resize(0);
-    det.resize(0);
-    cryo.resize(0);
-    gain.resize(0);
-    detID.resize(0);
-    isEnr.resize(0);
-    isNat.resize(0);
-    isGood.resize(0);
-    muVeto.resize(0);
+    ev.ClearHits();
+    SkimHits &hits = ev.hits;
 
     // loop over hits
     bool skipMe = false;
     size_t nHits = trapENFCalIn->size();
+    hits.Reserve(nHits, skimTree);
     for(size_t i=0; i<nHits; i++)
     {
-      // skip all hits with E_H and E_L < 200 keV in trapENFCal and trapECal
+      // skip all hits under the threshold (-e) in both trapENFCal and trapECal
       double hitENFDBSGCal = (*trapENFCalIn)[i];
       double hitECal = (*trapECalIn)[i];
       int hitCh = (*channelIn)[i];
-      if(hitCh%2 == 0 && hitENFDBSGCal <  2630. && hitECal < 2630.) continue;
-      if(hitCh%2 == 1 && hitENFDBSGCal < 2630. && hitECal < 2630.) continue;
+      if(hitCh%2 == 0 && hitENFDBSGCal < cfg.cuts.eThresh && hitECal < cfg.cuts.eThresh) continue;
+      if(hitCh%2 == 1 && hitENFDBSGCal < cfg.cuts.eThresh && hitECal < cfg.cuts.eThresh) continue;
 
       // skip hits from totally "bad" detectors (not biased, etc), or from
       // use-for-veto-only detectors if E < 10 keV
       int hitDetID = (*detIDIn)[i];
-      if(detIDIsBad[hitDetID] || (detIDIsVetoOnly[hitDetID] && hitECal < 10.)) continue;
+      uint8_t status = detStatus.Get(hitDetID);
+      if((status & kDetBad) || ((status & kDetVetoOnly) && hitECal < 10.)) continue;
+      auto info = detInfo.find(hitDetID);
+      if (info == detInfo.end()) {
+        const string &name = (*detNameIn)[i];
+        info = detInfo.insert(make_pair(hitDetID, make_pair(cfg.detTable->Index(name), SkimDetFlags(name)))).first;
+      }
       // copy over hit info
-      iHit.push_back(i);
-      trapECal.push_back(hitECal);
-      trapENFCal.push_back(hitENFDBSGCal);
-      channel.push_back(hitCh);
-      cryo.push_back((*cryoIn)[i]);
-      pos.push_back((*posIn)[i]);
-      det.push_back((*detIn)[i]);
-      gain.push_back(hitCh % 2);
-      detID.push_back(hitDetID);
-      isEnr.push_back((*detNameIn)[i][0] == 'P');
-      isNat.push_back((*detNameIn)[i][0] == 'B');
-      isGood.push_back(!detIDIsVetoOnly[hitDetID]);
+      size_t h = hits.Add();
+      hits.iHit[h] = i;
+      hits.trapECal[h] = hitECal;
+      hits.trapENFCal[h] = hitENFDBSGCal;
+      hits.channel[h] = hitCh;
+      hits.cryo[h] = (*cryoIn)[i];
+      hits.pos[h] = (*posIn)[i];
+      hits.det[h] = (*detIn)[i];
+      hits.detID[h] = hitDetID;
+      hits.detIdx[h] = info->second.first;
+      hits.hitFlags[h] = info->second.second;
+      if (status & (kDetEnr | kDetNat))  // the status file overrides the name
+        hits.hitFlags[h] = (status & kDetEnr) ? kHitEnr : kHitNat;
+      if (!(status & kDetVetoOnly)) hits.hitFlags[h] |= kHitGood;
+      if (hitCh % 2) hits.hitFlags[h] |= kHitLowGain;
       // sum energies and multiplicities
-      if(hitCh%2 == 0) mH++;
-      else mL++;
+      if(hitCh%2 == 0) ev.mH++;
+      else ev.mL++;
 
       // copy over time info
       double hitT_s = (*timestampIn)[i]*1.e-8;
-      tloc_s.push_back(hitT_s);
-      time_s.push_back( (startTime - startTime0) + hitT_s ); //Need to figure out what to do with continuous running, Clara 10/10/16
-      timeMT.push_back((*timeMTIn)[i]);
-      dateMT.push_back((*dateMTIn)[i]);
-
-      // Find the most recent muon to this event
-      while(1)
-      {
-        if(iMu >= nMu-1) break;
-        double tmuUnc = 1.e-8; // normally 10ns uncertainty
-        if (muUncert[iMu+1] > tmuUnc) tmuUnc = muUncert[iMu+1];
-        if (muRuns[iMu+1] > run) break;
-        else if (muRuns[iMu+1]==run && (muTimes[iMu+1]-tmuUnc) > hitT_s) break;
-        // printf("Inc:iMu+1 %-4lu  gRun %-4i  mRun %-4i  tGe %-8.3f  tMu %-8.3f  dtRun %-8.0f  dtEvent %-8.0f\n" ,iMu+1, run, muRuns[iMu+1], hitT_s, muTimes[iMu], muRunTStarts[iMu+1]-startTime, (muTimes[iMu+1] - tmuUnc) - hitT_s);
-        iMu++;
-      }
-      // Calculate time since last muon.
-      // NOTE: If there has been a clock reset since the last muon hit, this will be incorrect.
-      double dtmu = 0;
-      if (dsNumber==0)
-        dtmu = (startTime - muRunTStarts[iMu]) + (hitT_s - muTimes[iMu]);
-      else
-        dtmu = (hitT_s - muTimes[iMu]);
-
-      bool vetoThisHit = (dtmu > -1.*(muUncert[iMu]) && dtmu < (1. + muUncert[iMu]));
-      // DS-4 requires a larger window due to synchronization issues.
-      if (dsNumber==4)
-        vetoThisHit = (dtmu > -3.*(muUncert[iMu]) && dtmu < (4. + muUncert[iMu]));
-
-      dtmu_s.push_back(dtmu);
-      muType.push_back(muTypes[iMu]);
-      muTUnc.push_back(muUncert[iMu]);
-      muVeto.push_back(vetoThisHit);
+      hits.tloc_s[h] = hitT_s;
+      hits.time_s[h] = (startTime - ev.startTime0) + hitT_s; //Need to figure out what to do with continuous running, Clara 10/10/16
+      hits.timeMT[h] = (*timeMTIn)[i];
+      hits.dateMT[h] = (*dateMTIn)[i];
+
+      // Find the most recent muon to this event, and the time since it.
+      // The hit is vetoed if it's inside any muon's window in its run.  The recent
+      // muon's own window still counts, since in DS0 it can be from the run before.
+      size_t iMu = muWindows.RecentMuon(run, hitT_s);
+      double dtmu = MuonDeltaT(mu, iMu, hitT_s, startTime, dsNumber);
+      uint32_t inWindow = muWindows.VetoMask(run, muWindows.VetoClockTime(run, hitT_s, startTime, dsNumber));
+      bool vetoThisHit = (inWindow & 1) || IsMuonVetoed(mu, iMu, dtmu, dsNumber);
+
+      hits.dtmu_s[h] = dtmu;
+      hits.muType[h] = mu.types[iMu];
+      hits.muTUnc[h] = mu.uncert[iMu];
+      if (vetoThisHit) hits.hitFlags[h] |= kHitMuVeto;
+      if ((inWindow & 2) || IsMuonVetoed(mu, iMu, dtmu, 4)) hits.hitFlags[h] |= kHitMuVetoWide;
 
       if (hitCh%2==0) continue;
-      printf("Coin: iMu %-4lu  det %i  gRun %-4i  mRun %-5i  tGe %-7.3f  tMu %-7.3f  ene %-6.0f  veto? %i  dtmu %.2f +/- %.2f\n", iMu,hitCh,run,muRuns[iMu],hitT_s,muTimes[iMu],hitENFDBSGCal,vetoThisHit,dtmu,muUncert[iMu]);
+      vlogf("Coin: iMu %-4lu  det %i  gRun %-4i  mRun %-5i  tGe %-7.3f  tMu %-7.3f  ene %-6.0f  veto? %i  dtmu %.2f +/- %.2f\n", iMu,hitCh,run,mu.runs[iMu],hitT_s,mu.times[iMu],hitENFDBSGCal,vetoThisHit,dtmu,mu.uncert[iMu]);
     }
     // If no good hits in the event or skipped for some other reason, don't
     // write this event to the output tree.
-    if(trapENFCal.size() == 0 || skipMe) continue;
+    if(hits.nHit == 0 || skipMe) continue;
 
     // finally, fill the tree for this event
     skimTree->Fill();
+    shard.saved++;
   }
+  delete gatChain;
 
-  // write output tree to output file
-  cout << "Closing out skim file..." << endl;
+  fOut->cd();
   skimTree->Write("", TObject::kOverwrite);
+  TNamed("skimSchema", schema.c_str()).Write();
+  TNamed("skimInput", shard.input.c_str()).Write();
+  SkimDetTable::Write(cfg.detTable->Names());  // includes every index this shard used
   fOut->Close();
+  delete fOut;
+  if (rename(tmpFile.c_str(), shard.outFile.c_str()) != 0) {
+    vlog() << "Couldn't rename " << tmpFile << endl;
+    return 1;
+  }
+  return 0;
+}
 
+// Concatenate the shards, in order, into the output file.  The baskets are
+// copied as they are ("fast" clone), without decompressing them.
+// The shards' detIdx all refer to detNames, which is written as the file's detTable.
+int MergeShards(const vector<SkimShard> &shards, string outFile, const vector<string> &detNames)
+{
+  TChain shardChain("skimTree");
+  for (auto &shard : shards) shardChain.Add(shard.outFile.c_str());
+  TFile *fOut = TFile::Open(outFile.c_str(), "recreate");
+  if (!fOut || fOut->IsZombie()) {
+    cout << "Couldn't write " << outFile << endl;
+    return 1;
+  }
+  TTree *skimTree = shardChain.GetEntries() > 0 ? shardChain.CloneTree(-1, "fast") : 0;
+  if (!skimTree) {  // no events: an empty tree with the same branches
+    SkimEvent ev;
+    skimTree = MakeSkimTree(ev);
+  }
+  skimTree->Write("", TObject::kOverwrite);
+  SkimDetTable::Write(detNames);
+  long nSaved = skimTree->GetEntries();
+  fOut->Close();
+  delete fOut;
+  printf("Wrote %li events from %lu shards to %s\n", nSaved, shards.size(), outFile.c_str());
   return 0;
-}
\ No newline at end of file
+}
@@ -16,7 +16,13 @@ echo "Node:  "$HOSTNAME
 echo "Job ID:  "$JOB_ID
 echo " "
 
-make -s && ./skim-coins -l 5 runs/ds5-complete.txt skimout/
+make -s || exit 1
+
+# DS4 skims read the muons from a catalog: make it from ds4Muons.txt the first time.
+# (If there isn't one, skim-coins reads ds4Muons.txt itself.)
+[ -f avout/muons_DS4.vmc ] || ./skim-veto -ds4cat avout/muons_DS4.vmc
+
+./skim-coins -l 5 runs/ds5-complete.txt skimout/
 
 echo "Job Complete:"
 date
@@ -7,6 +7,7 @@
 #include <fstream>
 #include <numeric>
 #include <cmath>
+#include <set>
 #include "TTreeReader.h"
 #include "TTreeReaderArray.h"
 #include "TChain.h"
@@ -20,6 +21,12 @@
 #include "MGTEvent.hh"
 #include "GATDataSet.hh"
 #include "DataSetInfo.hh"
+#include "VetoGeometry.hh"
+#include "VetoCoincidence.hh"
+#include "VetoOutput.hh"
+#include "VetoWindowIndex.hh"
+#include "VetoMuonCatalog.hh"
+#include "DS4MuonList.hh"
 
 using namespace std;
 
@@ -30,10 +37,8 @@ int PanelMap(int i, int runNum);
 void ListRunOffsets(TChain *vetoTree);
 void GetRunInfo();
 void GenerateDS4MuonList();
-void LoadDS4MuonList(vector<int> &muRuns, vector<double> &muRunTStarts, vector<double> &muTimes,
-  vector<int> &muTypes, vector<double> &muUncert);
-double PanelInfo(int run, int panel, string option);
 void CheckHitRate(TChain *vetoTree);
+int WriteCatalog(string catFile, const VetoMuonList &mu);
 
 int main(int argc, char** argv)
 {
@@ -41,6 +46,8 @@ int main(int argc, char** argv)
 		cout << "Usage: ./skim-veto [run list file]\n"
          << "                   -r [run number]\n"
          << "                   -ds4list (generate ds4 muon list)\n"
+         << "                   -cat [catalog file] [run list file] (veto file dir, default ./avout/DS5) (save a muon catalog)\n"
+         << "                   -ds4cat [catalog file] (list file, default ./ds4Muons.txt) (save the ds4 muon list as a catalog)\n"
          << "                   -h [lower run] [higher run]\n";
 		 //<< "                   -rate (generate panelhitrate)\n";
     return 0;
@@ -53,6 +60,29 @@ int main(int argc, char** argv)
   string opt1 = argv[1];
   TChain *vetoTree = new TChain("vetoTree");
   vector<int> runList;
+  if (opt1 == "-cat" && argc > 3){
+    string vetoDir = argc > 4 ? argv[4] : "./avout/DS5";
+    ifstream runFile(argv[3]);
+    set<int> uniqueRuns;
+    while (runFile >> run) uniqueRuns.insert(run);
+    for (auto i : uniqueRuns)
+      if (!vetoTree->Add(TString::Format("%s/veto_run%i.root",vetoDir.c_str(),i))) {
+        cout << "Veto file for run " << i << " not found.  Exiting ...\n";
+        return 1;
+      }
+    VetoMuonList mu;
+    LoadMuonList(vetoTree, mu);
+    return WriteCatalog(argv[2], mu);
+  }
+  if (opt1 == "-ds4cat" && argc > 2){
+    VetoMuonList mu;
+    string err, listFile = argc > 3 ? argv[3] : kDS4MuonFile;
+    if (!LoadDS4MuonList(listFile, mu, err)) {
+      cout << err << ".  Exiting ...\n";
+      return 1;
+    }
+    return WriteCatalog(argv[2], mu);
+  }
   if (opt1 == "-ds4list"){
     GetRunInfo();  // input to GenerateDS4MuonList
     GenerateDS4MuonList();
@@ -136,41 +166,49 @@ void GenerateVetoList(TChain *vetoTree)
   if (dsNumber != 4)
   {
     TTreeReader vetoReader(vetoTree);
-    TTreeReaderValue<MJVetoEvent> vetoEventIn(vetoReader,"vetoEvent");
-    TTreeReaderValue<int> vetoRunIn(vetoReader,"run");
-  	TTreeReaderValue<Long64_t> vetoStart(vetoReader,"start");
-  	TTreeReaderValue<Long64_t> vetoStop(vetoReader,"stop");
-  	TTreeReaderValue<double> xTime(vetoReader,"xTime");
-    TTreeReaderValue<double> timeUncert(vetoReader,"timeUncert");
-  	TTreeReaderArray<int> CoinType(vetoReader,"CoinType");	//[32]
+    VetoOutReader vetoIn(vetoReader,vetoTree);  // either output layout
+  	CoinBitsReader coinBits(vetoReader,vetoTree);
     bool newRun=false;
   	int prevRun=0;
   	Long64_t prevStop=0;
   	while(vetoReader.Next())
   	{
-      MJVetoEvent veto = *vetoEventIn;
-      int run = *vetoRunIn;
+      int run = vetoIn.GetRun();
+      Long64_t vetoStart = vetoIn.GetStart();
   		if (run != prevRun) newRun=true;
   		else newRun = false;
   		int type = 0;
-  		if (CoinType[0]) type=1;
-  		if (CoinType[1]) type=2;	// overrides type 1 if both are true
-  		if ((*vetoStart-prevStop) > 10 && newRun) type = 3;
+  		uint8_t coin = coinBits.Get();
+  		if (coin & kCoinMuon) type=1;
+  		if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
+  		if ((vetoStart-prevStop) > 10 && newRun) type = 3;
       if (type > 0){
         muRuns.push_back(run);
-        muRunTStarts.push_back(*vetoStart);
+        muRunTStarts.push_back(vetoStart);
         muTypes.push_back(type);
-        if (type!=3) muTimes.push_back(*xTime);
-        else muTimes.push_back(*xTime); // time of the first veto entry in the run
-        if (!veto.GetBadScaler()) muUncert.push_back(*timeUncert);
+        if (type!=3) muTimes.push_back(vetoIn.GetXTime());
+        else muTimes.push_back(vetoIn.GetXTime()); // time of the first veto entry in the run
+        if (!vetoIn.GetBadScaler()) muUncert.push_back(vetoIn.GetTimeUncert());
         else muUncert.push_back(8.0); // uncertainty for corrupted scalers
       }
-  		prevStop = *vetoStop;  // end of entry, save the run and stop time
+  		prevStop = vetoIn.GetStop();  // end of entry, save the run and stop time
   		prevRun = run;
   	}
     delete vetoTree;
   }
-  else LoadDS4MuonList(muRuns,muRunTStarts,muTimes,muTypes,muUncert);
+  else {
+    VetoMuonList mu;
+    string err;
+    if (!LoadDS4MuonList(kDS4MuonFile, mu, err)) {
+      cout << err << endl;
+      return;
+    }
+    muRuns = mu.runs;
+    muRunTStarts = mu.runTStarts;
+    muTimes = mu.times;
+    muTypes = mu.types;
+    muUncert = mu.uncert;
+  }
 
   cout << "Muon list has " << muRuns.size() << " entries.\n";
   for (int i = 0; i < (int)muRuns.size(); i++)
@@ -183,29 +221,27 @@ void GenerateDisplayList(TChain *vetoTree)
 	ofstream DisplayList("./output/MuonDisplay_test.txt");
 
 	TTreeReader reader(vetoTree);
-	TTreeReaderValue<MJVetoEvent> events(reader,"events");
-	TTreeReaderValue<Long64_t> start(reader,"start");
-	TTreeReaderValue<double> xTime(reader,"xTime");
-	TTreeReaderArray<int> CoinType(reader,"CoinType");	//[32]
+	VetoOutReader vetoIn(reader,vetoTree);  // either output layout
+	CoinBitsReader coinBits(reader,vetoTree);
 
 	while(reader.Next())
 	{
 		long i = reader.GetCurrentEntry();
-		MJVetoEvent veto = *events;
 
 		int type = 0;
-		if (CoinType[0]) type=1;
-		if (CoinType[1]) type=2;	// overrides type 1 if both are true
+		uint8_t coin = coinBits.Get();
+		if (coin & kCoinMuon) type=1;
+		if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
 
 		char display[200];
 		if (type>0) // all events passing TimeCut & EnergyCut
 		{
-			sprintf(display,"%i  %li  %lli  %.3f  ",events->GetRun(),i,*start,*xTime);
+			sprintf(display,"%i  %li  %lli  %.3f  ",vetoIn.GetRun(),i,vetoIn.GetStart(),vetoIn.GetXTime());
 			DisplayList << display;
 			for (int j=0; j<32; j++)
 			{
-				if (events->GetQDC(j) >= events->GetSWThresh(j))
-					DisplayList << events->GetQDC(j) << " ";
+				if (vetoIn.GetQDC(j) >= vetoIn.GetSWThresh(j))
+					DisplayList << vetoIn.GetQDC(j) << " ";
 				else
 					DisplayList << 0 << " ";
 			}
@@ -217,7 +253,7 @@ void GenerateDisplayList(TChain *vetoTree)
 void CalculateDeadTime(string MuonList, int dsNumber)
 {
   // OBSOLETE:  Need to use the auto-veto files.
-  // TO DO: Use the method employed by skim-coins.
+  // The windows are merged (VetoWindowIndex.hh), so overlapping ones aren't counted twice.
 
   ifstream InputList(MuonList.c_str());
   if(!InputList.good()) {
@@ -239,6 +275,7 @@ void CalculateDeadTime(string MuonList, int dsNumber)
 		timeAfter = 2;
 		badScalerWindow = 8;
 	}
+	VetoWindowSet windows;
 	while(true)
 	{
 		InputList >> run >> utc >> hitTime >> type >> badScaler;
@@ -248,110 +285,60 @@ void CalculateDeadTime(string MuonList, int dsNumber)
 			if (badScaler) {
 				deadTime += 2*badScalerWindow;
 				deadBadScalerTime += 2*badScalerWindow;
+				windows.Add(run, hitTime-badScalerWindow, hitTime+badScalerWindow);
+			}
+			else {
+				deadTime += timeBefore + timeAfter;
+				windows.Add(run, hitTime-timeBefore, hitTime+timeAfter);
 			}
-			else deadTime += timeBefore + timeAfter;
 		}
 		if (type == 3) {
 			if (badScaler) {
 				deadTime += badScalerWindow;
 				deadBadScalerTime += badScalerWindow;
+				windows.Add(run, hitTime, hitTime+badScalerWindow);
+			}
+			else {
+				deadTime += timeAfter;
+				windows.Add(run, hitTime, hitTime+timeAfter);
 			}
-			else deadTime += timeAfter;
 		}
 		if (badScaler) numBadScalers++;
 	}
-	printf("Dead time due to veto: %.2f seconds.\n",deadTime);
+	windows.Build();
+	printf("Dead time due to veto: %.2f seconds (%.2f before merging %lu overlapping windows).\n",
+		windows.DeadTime(),deadTime,windows.GetNAdded()-windows.Size());
 	if (numBadScalers > 0) printf("Bad scalers: %i, %.2f of %.2f sec (%.2f%%)\n", numBadScalers,deadBadScalerTime,deadTime,((double)deadBadScalerTime/deadTime)*100);
 }
 
 int PanelMap(int qdcChan, int runNum)
 {
 	// For Dave and Bradley.
-	// Using the 32-panel configuration as "standard", map the QDC index to a physical panel location for all of the run ranges.
-	// The figure "Veto Panels, View From The Top" in Veto System Change Log is the map I use for ALL configurations.
-	// key: "qdc channel"  value: "panel location"
-
-	map<int,int> panels;
-
-	// 32-panel config (default) - began 7/10/15
-	if (runNum < 45000000 && runNum >= 3057) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,25}, {25,26}, {26,27}, {27,28},
-		 {28,29}, {29,30}, {30,31}, {31,32}};
-		panels = tempMap;
-	}
-	// 1st prototype config (24 panels)
-	else if (runNum >= 45000509 && runNum <= 45004116) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,21}, {13,22}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,13}, {21,14}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	// 2nd prototype config (24 panels)
-	else if (runNum >= 45004117 && runNum <= 45008659) {
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	// 1st module 1 (P3JDY) config, 6/24/15 - 7/7/15
-	else if (runNum > 0 && runNum <=3056){
-		map<int,int> tempMap =
-		{{0,1},  {1,2},  {2,3},  {3,4}, {4,5}, {5,6},
-		 {6,7},  {7,8},  {8,9},  {9,10}, {10,11}, {11,12},
-		 {12,13}, {13,14}, {14,15}, {15,16},
-		 {16,17}, {17,18}, {18,19}, {19,20},
-		 {20,21}, {21,22}, {22,23}, {23,24},
-		 {24,-1}, {25,-1}, {26,-1}, {27,-1},
-		 {28,-1}, {29,-1}, {30,-1}, {31,-1}};
-		 panels = tempMap;
-	}
-	else {
+	// Map the QDC index to a physical panel location (see VetoGeometry.hh).
+	VetoGeometry geo(runNum);
+	if (!geo.IsKnown()) {
 		cout << "Panel map not known for this run number!\n";
 		return -1;
 	}
-	int panel = -1;
-	auto search = panels.find(qdcChan);
-	if(search != panels.end()) panel=search->second;
-	return panel;
+	return geo.GetLocation(qdcChan);
 }
 
 void ListRunOffsets(TChain *vetoTree)
 {
   TH1D *hUnc = new TH1D("hUnc","hUnc",100,0,0.2);
   TTreeReader reader(vetoTree);
-  TTreeReaderValue<int> runIn(reader,"run");
-  TTreeReaderValue<MJVetoEvent> vetoEventIn(reader,"vetoEvent");
-  TTreeReaderValue<double> xTimeIn(reader,"xTime");
-  TTreeReaderValue<double> scalerOffsetIn(reader,"scalerOffset");
-  TTreeReaderValue<double> scalerUncIn(reader,"scalerUnc");
+  VetoOutReader vetoIn(reader,vetoTree);  // either output layout
   int runSave = 0;
   double lastRunTS = 0;
   while(reader.Next())
   {
-    if(runSave != *runIn) // run boundary condition
+    if(runSave != vetoIn.GetRun()) // run boundary condition
     {
-      runSave = *runIn;
-      MJVetoEvent veto = *vetoEventIn;
-      printf("Run %i  Entry %i  xTime %-5.3f  Offset %-5.3f  Unc %-5.3f\n", veto.GetRun(),veto.GetEntry(),*xTimeIn,*scalerOffsetIn,*scalerUncIn);
-      hUnc->Fill(*scalerUncIn);
-      if (*xTimeIn < lastRunTS) cout << "Clock reset, run " << veto.GetRun() << endl;
-      lastRunTS = *xTimeIn;
+      runSave = vetoIn.GetRun();
+      printf("Run %i  Entry %li  xTime %-5.3f  Offset %-5.3f  Unc %-5.3f\n", runSave,vetoIn.GetEntry(),vetoIn.GetXTime(),vetoIn.GetScalerOffset(),vetoIn.GetSyncUncert());
+      hUnc->Fill(vetoIn.GetSyncUncert());
+      if (vetoIn.GetXTime() < lastRunTS) cout << "Clock reset, run " << runSave << endl;
+      lastRunTS = vetoIn.GetXTime();
     }
   }
   TCanvas *c1 = new TCanvas("c1","Bob Ross's Canvas",800,600);
@@ -441,36 +428,32 @@ void GenerateDS4MuonList()
   vector<int> muTypes;
   vector<double> muUncert;
   TTreeReader vetoReader(vetoTree);
-  TTreeReaderValue<MJVetoEvent> vetoEventIn(vetoReader,"vetoEvent");
-  TTreeReaderValue<int> vetoRunIn(vetoReader,"run");
-	TTreeReaderValue<Long64_t> vetoStart(vetoReader,"start");
-	TTreeReaderValue<Long64_t> vetoStop(vetoReader,"stop");
-	TTreeReaderValue<double> xTime(vetoReader,"xTime");
-  TTreeReaderValue<double> scalerUnc(vetoReader,"scalerUnc");
-	TTreeReaderArray<int> CoinType(vetoReader,"CoinType");	//[32]
+  VetoOutReader vetoIn(vetoReader,vetoTree);  // either output layout
+	CoinBitsReader coinBits(vetoReader,vetoTree);
   bool newRun=false;
 	int prevRun=0;
 	Long64_t prevStop=0;
 	while(vetoReader.Next())
 	{
-    MJVetoEvent veto = *vetoEventIn;
-    int run = *vetoRunIn;
+    int run = vetoIn.GetRun();
+    Long64_t vetoStart = vetoIn.GetStart();
 		if (run != prevRun) newRun=true;
 		else newRun = false;
 		int type = 0;
-		if (CoinType[0]) type=1;
-		if (CoinType[1]) type=2;	// overrides type 1 if both are true
-		if ((*vetoStart-prevStop) > 10 && newRun) type = 3;
+		uint8_t coin = coinBits.Get();
+		if (coin & kCoinMuon) type=1;
+		if (coin & kCoinVertical) type=2;	// overrides type 1 if both are true
+		if ((vetoStart-prevStop) > 10 && newRun) type = 3;
     if (type > 0){
       muRuns.push_back(run);
-      muRunTStarts_s.push_back(*vetoStart);
+      muRunTStarts_s.push_back(vetoStart);
       muTypes.push_back(type);
-      if (type!=3) muTimes.push_back(*xTime);
-      else muTimes.push_back(*xTime); // time of the first veto entry in the run
-      if (!veto.GetBadScaler()) muUncert.push_back(*scalerUnc);
+      if (type!=3) muTimes.push_back(vetoIn.GetXTime());
+      else muTimes.push_back(vetoIn.GetXTime()); // time of the first veto entry in the run
+      if (!vetoIn.GetBadScaler()) muUncert.push_back(vetoIn.GetSyncUncert());
       else muUncert.push_back(8.0); // uncertainty for corrupted scalers
     }
-		prevStop = *vetoStop;  // end of entry, save the run and stop time
+		prevStop = vetoIn.GetStop();  // end of entry, save the run and stop time
 		prevRun = run;
 	}
 
@@ -508,71 +491,22 @@ void GenerateDS4MuonList()
   }
   // check muon list
   cout << ds4muRuns.size() << " of " << muRuns.size() << " DS-3 muon candidates persisted in DS-4.\n";
-  // for (int i = 0; i < (int)ds4muRuns.size(); i++)
-    // printf("%i  %i  %.0f  %.3f  %.3f\n",ds4muRuns[i],ds4muTypes[i],ds4muRunTStarts[i],ds4muTimes[i],ds4muUncert[i]);
-
-
-  // Create the dictionaries for use in $GATDIR/Apps/DataSetInfo.hh
-
-  // cout << "vector<int> ds4muRuns = {";
-  // for (int i = 0; i < (int)ds4muRuns.size()-1; i++) cout << ds4muRuns[i] << ", ";
-  // cout << ds4muRuns[(int)ds4muRuns.size()-1] << "};\n\n";
-  //
-  // cout << "vector<int> ds4muTypes = {";
-  // for (int i = 0; i < (int)ds4muTypes.size()-1; i++) cout << ds4muTypes[i] << ", ";
-  // cout << ds4muTypes[(int)ds4muTypes.size()-1] << "};\n\n";
-  //
-  // cout << "vector<int> ds4muRunTStarts = {";
-  // for (int i = 0; i < (int)ds4muRunTStarts.size()-1; i++) cout << (long)ds4muRunTStarts[i] << ", ";
-  // cout << (long)ds4muRunTStarts[(int)ds4muRunTStarts.size()-1] << "};\n\n";
-  //
-  // cout << "vector<int> ds4muTimes = {";
-  // for (int i = 0; i < (int)ds4muTimes.size()-1; i++) cout << setprecision(9) << ds4muTimes[i] << ", ";
-  // cout << setprecision(9) << ds4muTimes[(int)ds4muTimes.size()-1] << "};\n\n";
-  //
-  // cout << "vector<int> ds4muUncert = {";
-  // for (int i = 0; i < (int)ds4muUncert.size()-1; i++) cout << setprecision(9) << ds4muUncert[i] << ", ";
-  // cout << setprecision(9) << ds4muUncert[(int)ds4muUncert.size()-1] << "};\n\n";
-}
-
-double PanelInfo(int run, int panel, string option)
-{
-  // Implemented for DS3 and onward.
-
-  // Each panel's mean hit rate:
-
-  vector<double> hitRateMean =  {0.007338, 0.007482, 0.007730, 0.009183, 0.005995, 0.005272, 0.005786, 0.013200, 0.007360, 0.008041, 0.006708, 0.004830, 0.006750, 0.010310, 0.011600, 0.020450, 0.006718, 0.028900, 0.008145, 0.025110, 0.002854, 0.003381, 0.006357, 0.002808, 0.0006327, 0.0010950, 0.0003902, 0.003375, 0.0022120, 0.005735, 0.0007639, 0.005983};
-
-  vector<double> hitRateSig = {0.001709, 0.001793, 0.001888, 0.002020, 0.001848, 0.00145 , 0.001414, 0.002276, 0.001566, 0.001775, 0.001587, 0.001344, 0.001948, 0.001995, 0.002273, 0.002962, 0.001635, 0.003787, 0.002711, 0.003167, 0.001129, 0.001145, 0.001727, 0.001200, 0.0004681, 0.0006459, 0.0003892, 0.001133, 0.0009158, 0.001850, 0.0005355, 0.001726};
-
-  // Each panel's mean qdc value:
-
-  vector<double> qdcMean = {925, 629.8, 1268, 993.4, 2151, 849.8, 720.2, 2997, 1585, 1185, 1495, 1207, 709.9, 1007, 1702, 2592, 643.2, 1040, 1115, 1307, 1917, 2027, 1214, 1069, 3783, 638.7, 1595, 1138, 1079, 1699, 2476, 3843};
-
-  vector<double> qdcSig = {220, 108.9, 175.6, 136.8, 309.9, 131.9, 115.1, 396.4, 228.5, 182.1, 230.5, 170.5, 93.33, 119.2, 207.9, 319.6, 155.6, 142,  217.2, 173.4, 272.5, 264.5, 145,  215.5, 269.2, 164.6, 263.8, 186.3, 204.9, 253.8, 282.3, 209.7};
-
-  // For runs > 19091:
-
-  vector<double> qdcMean2 = {3772, 520.1, 1491, 1110, 2306, 970.3, 2380, 3445, 1676, 1433, 1617, 1292, 857.2, 1124, 2104, 2576, 701.3, 1160, 1312, 1409, 2131, 2279, 1383, 1199, 1048, 743.7, 1688, 1220, 1343, 1760, 2212, 1828};
 
-  vector<double> qdcSig2 =  {297, 92.38, 199.9, 150.1, 321.5, 149.5, 299.3, 387.1, 239.2, 212.6, 244.3, 178.9, 113,  129.6, 245.3, 312.3, 162.3, 154.5, 255.4, 184.5, 292.5, 288.8, 161, 228.7, 210, 176,  270.8, 194.4, 230.4, 261.8, 316, 230.8};
-
-  if (option=="hitRateMean") return hitRateMean[panel];
-  if (option=="hitRateSig") return hitRateSig[panel];
-  if (option=="qdcMean" && run > 19091 && run < 4500000) return qdcMean2[panel];
-  if (option=="qdcMean" && run < 19091 && run < 4500000) return qdcMean[panel];
-  if (option=="qdcSig" && run > 19091 && run > 16797) return qdcSig2[panel];
-  if (option=="qdcSig" && run > 19091 && run > 16797) return qdcSig[panel];
-  return 0;
+  // Save it as a muon catalog, for skim-coins
+  VetoMuonList ds4mu;
+  for (int i = 0; i < (int)ds4muRuns.size(); i++)
+    ds4mu.Add(ds4muRuns[i],ds4muTypes[i],ds4muRunTStarts[i],ds4muTimes[i],ds4muUncert[i]);
+  WriteCatalog("./output/muons_DS4.vmc", ds4mu);
+  // and as a list, to replace ds4Muons.txt
+  if (WriteDS4MuonList("./output/ds4Muons.txt", ds4mu)) cout << "Wrote ./output/ds4Muons.txt\n";
+  else cout << "Couldn't write ./output/ds4Muons.txt\n";
 }
 
 void CheckHitRate(TChain *vetoTree)
 {
 
 	TTreeReader reader(vetoTree);
-	TTreeReaderValue<MJVetoEvent> events(reader,"vetoEvent");
-	TTreeReaderValue<double> durationIn(reader,"unixDuration");
-	TTreeReaderValue<int> runNum(reader,"run");
+	VetoOutReader vetoIn(reader,vetoTree);  // either output layout
 
 	//ready output file
 	TFile *rateFile = new TFile("./output/rateData.root","UPDATE");
@@ -609,9 +543,8 @@ void CheckHitRate(TChain *vetoTree)
 			//initialize data
 			//long Entry = reader.GetCurrentEntry();
 	
-			MJVetoEvent veto = *events;
-			double run = *runNum;
-			double unixDuration = *durationIn;			
+			double run = vetoIn.GetRun();
+			double unixDuration = vetoIn.GetUnixDuration();
 			
 			if (prevunixDuration != unixDuration){
 				//cout << "Unique Unixduration: " << unixDuration << endl; 
@@ -630,7 +563,7 @@ void CheckHitRate(TChain *vetoTree)
 					ghitrate[j]->Write("",TObject::kOverwrite);
 					nonLEDHitCount[j] = 0;
 				}
-				if (veto.GetQDC(j) > veto.GetSWThresh(j) && veto.GetMultip() <= LEDSimpleThreshold){
+				if (vetoIn.GetQDC(j) > vetoIn.GetSWThresh(j) && vetoIn.GetMultip() <= LEDSimpleThreshold){
 					nonLEDHitCount[j]++;
 					totnonLEDHitCount[j]++;
 				}
@@ -669,7 +602,7 @@ void CheckHitRate(TChain *vetoTree)
 		  // Implemented for DS3 and onward.
 		  if (unixDuration > 300 && runNum > 16797 && runNum < 4500000) {
 			for (int j = 0; j< 32; j++) {
-			  if (fabs(PanelInfo(runNum,j,"hitRateMean") - nonLEDHitCount[j]/unixDuration) > 3.0*PanelInfo(runNum,j,"hitRateSigma")){
+			  if (fabs(geo.GetHitRateMean(j) - nonLEDHitCount[j]/unixDuration) > 3.0*geo.GetHitRateSigma(j)){
 				ErrorCount[30]++;
 				Error[30] = true;
 			  }
@@ -678,7 +611,7 @@ void CheckHitRate(TChain *vetoTree)
 		  */
 		  
 		  // the goal is to evaluate this line::
-		  // PanelInfo(runNum,j,"hitRateMean") - nonLEDHitCount[j]/unixDuration)
+		  // geo.GetHitRateMean(j) - nonLEDHitCount[j]/unixDuration)
 
 		  // Open up an already existing file and add points to its graph.
 		  // If the file doesn't exist, create it.
@@ -689,4 +622,15 @@ void CheckHitRate(TChain *vetoTree)
 		  // g->Write("",TObject::kOverwrite);
 		  rateFile->Close();
 
-}
\ No newline at end of file
+}
+
+int WriteCatalog(string catFile, const VetoMuonList &mu)
+{
+  if (!WriteMuonCatalog(catFile, mu)) {
+    cout << "Couldn't write muon catalog " << catFile << endl;
+    return 1;
+  }
+  set<int> runs(mu.runs.begin(), mu.runs.end());
+  printf("Wrote muon catalog %s: %lu muons in %lu runs.\n", catFile.c_str(), mu.Size(), runs.size());
+  return 0;
+}
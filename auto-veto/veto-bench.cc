@@ -0,0 +1,371 @@
+// veto-bench.cc
+// Micro- and macro-benchmarks of the veto hot paths, on a synthetic run from veto-gen.
+// Each benchmark is run a few times and the fastest pass is kept, so results are
+// repeatable on a quiet machine.  Results are written as JSON (one benchmark per line),
+// and -c compares them with a stored baseline and flags regressions.
+// "make bench" runs the whole suite (see bench.sh).
+// vetoScan isn't built as a library, so the vetoScan tools benchmarked here
+// (code/vetoTools.cc) are compiled into veto-bench.
+// C. Wiseman, A. Lopez
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include "TH1.h"
+#include "TChain.h"
+#include "VetoRunCache.hh"
+#include "VetoErrors.hh"
+#include "VetoGeometry.hh"
+#include "VetoCoincidence.hh"
+#include "VetoLEDTimer.hh"
+#include "VetoTimeInterp.hh"
+#include "VetoThreshold.hh"
+#include "GeTimeIndex.hh"
+#include "VetoMuonList.hh"
+#include "VetoWindowIndex.hh"
+#include "VetoMuonCatalog.hh"
+#include "MJVetoEvent.hh"
+#include "../vetoScan/code/vetoTools.cc"
+
+using namespace std;
+
+struct BenchResult {
+  string name;
+  long ops;
+  double sec;       // fastest pass
+  double nsPerOp;
+};
+
+vector<BenchResult> gResults;
+double gSink = 0;   // results go here, so the compiler can't drop the work
+
+// Time func (which does ops operations) reps times, and keep the fastest pass.
+void Bench(string name, long ops, int reps, function<void()> func)
+{
+  double best = 1e300;
+  for (int r = 0; r < reps; r++) {
+    auto t0 = chrono::steady_clock::now();
+    func();
+    best = min(best, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+  }
+  BenchResult res = {name, ops, best, ops > 0 ? 1e9*best/ops : 0};
+  printf("%-34s %12li ops %10.4f sec %12.1f ns/op\n", name.c_str(), ops, best, res.nsPerOp);
+  gResults.push_back(res);
+}
+
+// "key": value from one line of our own JSON output
+bool GetJSON(const string &line, const string &key, string &val)
+{
+  size_t k = line.find("\"" + key + "\":");
+  if (k == string::npos) return false;
+  size_t v = line.find_first_not_of(" ", k + key.size() + 3);
+  if (v == string::npos) return false;
+  if (line[v] == '"') {
+    size_t e = line.find('"', v+1);
+    val = line.substr(v+1, e-v-1);
+  }
+  else val = line.substr(v, line.find_first_of(",}", v) - v);
+  return true;
+}
+
+// auto-veto --profile phases, as macro-benchmarks (ns per entry, or ns per run with no entries)
+void ImportProfile(string fileName)
+{
+  ifstream in(fileName.c_str());
+  string line;
+  while (getline(in, line)) {
+    string name, wall, entries;
+    if (!GetJSON(line,"name",name) || !GetJSON(line,"wall",wall) || !GetJSON(line,"entries",entries)) continue;
+    BenchResult res = {"auto-veto:" + name, stol(entries), stod(wall), 0};
+    long ops = res.ops > 0 ? res.ops : 1;
+    res.nsPerOp = 1e9*res.sec/ops;
+    printf("%-34s %12li ops %10.4f sec %12.1f ns/op\n", res.name.c_str(), res.ops, res.sec, res.nsPerOp);
+    gResults.push_back(res);
+  }
+}
+
+bool WriteResults(string fileName, int run, long entries)
+{
+  ofstream out(fileName.c_str());
+  if (!out) return false;
+  out << "{\"run\": " << run << ", \"entries\": " << entries << ", \"benchmarks\": [\n";
+  for (size_t i = 0; i < gResults.size(); i++) {
+    char line[300];
+    snprintf(line, sizeof(line), "  {\"name\": \"%s\", \"ops\": %li, \"sec\": %.6f, \"nsPerOp\": %.3f}%s\n",
+      gResults[i].name.c_str(), gResults[i].ops, gResults[i].sec, gResults[i].nsPerOp, i+1 < gResults.size() ? "," : "");
+    out << line;
+  }
+  out << "]}\n";
+  return out.good();
+}
+
+// Returns the number of benchmarks more than tol (fractional) slower than the baseline.
+int Compare(string fileName, double tol)
+{
+  ifstream in(fileName.c_str());
+  if (!in) {
+    cout << "Couldn't open baseline " << fileName << endl;
+    return 1;
+  }
+  map<string,double> base;
+  string line, name, ns;
+  while (getline(in, line))
+    if (GetJSON(line,"name",name) && GetJSON(line,"nsPerOp",ns)) base[name] = stod(ns);
+
+  int nSlow = 0;
+  printf("\n%-34s %12s %12s %8s\n","benchmark","baseline","now","ratio");
+  for (auto &r : gResults) {
+    if (base.find(r.name) == base.end() || base[r.name] <= 0) {
+      printf("%-34s %12s %12.1f %8s\n", r.name.c_str(), "-", r.nsPerOp, "new");
+      continue;
+    }
+    double ratio = r.nsPerOp / base[r.name];
+    bool slow = ratio > 1 + tol;
+    if (slow) nSlow++;
+    printf("%-34s %12.1f %12.1f %8.2f %s\n", r.name.c_str(), base[r.name], r.nsPerOp, ratio, slow ? "REGRESSION" : "");
+  }
+  printf("%i regressions (tolerance %.0f%%).\n", nSlow, 100*tol);
+  return nSlow;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    cout << "Usage: ./veto-bench -g [synthetic run (.vsyn)]\n"
+         << "                    [-a [auto-veto output of that run] (for the skim-coins proxy benchmarks)]\n"
+         << "                    [-p [auto-veto --profile output] (adds its phases as macro-benchmarks)]\n"
+         << "                    [-o [results file] (default bench-results.json)]\n"
+         << "                    [-c [baseline results file] (flag regressions)]  [-tol [fraction] (default 0.15)]\n"
+         << "                    [-n [passes] (default 5)]\n";
+    return 1;
+  }
+  vector<string> opt(argc);
+  for (int i=0; i<argc-1; i++) opt[i]=argv[i+1];
+  auto arg = [&](const char *flag) -> string {
+    vector<string>::iterator it = find(opt.begin(), opt.end(), flag);
+    if (it == opt.end() || it+1 == opt.end()) return "";
+    return *(it+1);
+  };
+  string synthFile = arg("-g"), vetoFile = arg("-a"), profFile = arg("-p"), baseFile = arg("-c");
+  string outFile = arg("-o") != "" ? arg("-o") : "bench-results.json";
+  double tol = arg("-tol") != "" ? stod(arg("-tol")) : 0.15;
+  int reps = arg("-n") != "" ? stoi(arg("-n")) : 5;
+  TH1::AddDirectory(kFALSE);
+
+  VetoRunCache cache(synthFile);
+  long n = cache.GetEntries();
+  if (n < 2) {
+    cout << "Couldn't read synthetic run " << synthFile << ".  Exiting ...\n";
+    return 1;
+  }
+  int run = cache.GetRunNumber();
+  VetoGeometry geo(run);
+  GeTimeIndex geIndex;
+  if (!geIndex.Load(cache.GetGeIndexFile(), cache.GetBuiltEntries(), 0))
+    cout << "Warning: couldn't read " << cache.GetGeIndexFile() << endl;
+  printf("Run %i: %li veto entries, %lu Ge packets.  Best of %i passes.\n\n", run, n, geIndex.GetSize(), reps);
+
+  // ======== Inputs (not timed) ========
+  // Thresholds from the low-QDC histograms, as in MeasurePanelThresholds
+  TH1D *hLowQDC[32];
+  for (int q = 0; q < 32; q++) hLowQDC[q] = new TH1D(TString::Format("hLowQDC%d",q),"",500,0,500);
+  VetoRecord veto, prev;
+  cache.Rewind();
+  while (cache.Next(veto)) for (int q = 0; q < 32; q++) hLowQDC[q]->Fill(veto.GetQDC(q));
+  int thresh[32];
+  for (int q = 0; q < 32; q++) thresh[q] = FindThreshold(hLowQDC[q],35,q,run);
+  cache.SetSWThresh(thresh);
+
+  vector<VetoRecord> recs(n);
+  cache.Rewind();
+  for (long i = 0; cache.Next(recs[i]) && i+1 < n; i++) {}
+  int highestMultip = 0;
+  for (auto &r : recs) highestMultip = max(highestMultip, r.GetMultip());
+
+  // Ge hits in time order, for the muon window search
+  vector<double> geTimes;
+  for (long i = 0; i < n; i++) {
+    double before=0, after=0;
+    if (i % 4 == 0 && geIndex.Around(recs[i].GetScalerIndex(), before, after)) {
+      geTimes.push_back(before);
+      geTimes.push_back(after);
+    }
+  }
+  sort(geTimes.begin(), geTimes.end());
+
+  // ======== Micro-benchmarks ========
+  Bench("VetoRunCache::Next", n, reps, [&]() {
+    cache.Rewind();
+    while (cache.Next(veto)) gSink += veto.GetMultip();
+  });
+
+  Bench("CheckErrors", n-1, reps, [&]() {
+    uint32_t bits = 0;
+    for (long i = 1; i < n; i++) bits ^= CheckErrors(recs[i],recs[i-1]);
+    gSink += bits;
+  });
+
+  const int nThresh = 100;
+  Bench("FindThreshold", 32*nThresh, reps, [&]() {
+    for (int k = 0; k < nThresh; k++)
+      for (int q = 0; q < 32; q++) {
+        hLowQDC[q]->GetXaxis()->SetRange();
+        gSink += FindThreshold(hLowQDC[q],35,q,run);
+      }
+  });
+
+  // vetoScan's versions of the two (vetoTools.cc), which its scans call for every entry.
+  // CheckForBadErrors takes the MJVetoEvent by value; an undecoded one is the same size.
+  // The packed hardware errors stand in for WriteEvent's return value (1: no errors).
+  MJVetoEvent scanVeto(geo.GetCard1(), geo.GetCard2());
+  vector<int> isGood(n);
+  for (long i = 0; i < n; i++) isGood[i] = recs[i].hwErrors ? (int)recs[i].hwErrors : 1;
+  Bench("vetoScan CheckForBadErrors", n, reps, [&]() {
+    long nBad = 0;
+    for (long i = 0; i < n; i++) nBad += CheckForBadErrors(scanVeto, (int)i, isGood[i], false);
+    gSink += nBad;
+  });
+
+  TH1F *hScanQDC[32];
+  for (int q = 0; q < 32; q++) {
+    hScanQDC[q] = new TH1F(TString::Format("hScanQDC%d",q),"",500,0,500);
+    for (auto &r : recs) hScanQDC[q]->Fill(r.GetQDC(q));
+  }
+  Bench("vetoScan FindQDCThreshold", 32*nThresh, reps, [&]() {
+    for (int k = 0; k < nThresh; k++)
+      for (int q = 0; q < 32; q++) gSink += FindQDCThreshold(hScanQDC[q],q,false);
+  });
+  for (int q = 0; q < 32; q++) delete hScanQDC[q];
+
+  // Fast-start thresholds, checked against the full-scan ones above
+  VetoThreshSample samp;
+  Bench("SampleThresholds", n, reps, [&]() {
+    TH1D *hSample[32];
+    for (int q = 0; q < 32; q++) hSample[q] = new TH1D(TString::Format("hSample%d",q),"",500,0,500);
+    samp = SampleThresholds(cache, hSample, 35);
+    for (int q = 0; q < 32; q++) delete hSample[q];
+  });
+  cache.SetSWThresh(thresh);
+  int nDiff = 0, maxDiff = 0;
+  for (int q = 0; q < 32; q++)
+    if (samp.thresh[q] != thresh[q]) { nDiff++; maxDiff = max(maxDiff, abs(samp.thresh[q] - thresh[q])); }
+  printf("  (sampled %li of %li entries: %i panels differ from the full scan, max %i QDC)\n", samp.read, n, nDiff, maxDiff);
+
+  Bench("GetPlaneMask+GetCoinClass", n, reps, [&]() {
+    long sum = 0;
+    for (auto &r : recs) {
+      uint16_t planes = geo.GetPlaneMask(r.GetHitMask());
+      sum += GetCoinClass(planes) + GetHitType(planes);
+    }
+    gSink += sum;
+  });
+
+  long nLED = 0;
+  for (long i = 1; i < n; i++) if (recs[i].GetMultip() > 10) nLED++;
+  Bench("LEDTimer Fill+Track", nLED, reps, [&]() {
+    LEDTimer timer;
+    for (long i = 1; i < n; i++) {
+      if (recs[i].GetMultip() <= 10) continue;
+      timer.Fill(recs[i].GetTimeSec() - recs[i-1].GetTimeSec());
+      timer.Track(recs[i].GetTimeSec());
+    }
+    gSink += timer.GetPeriod() + timer.GetJitter();
+  });
+
+  vector<double> times(n);
+  vector<bool> bad(n);
+  for (long i = 0; i < n; i++) { times[i] = recs[i].GetTimeSec(); bad[i] = recs[i].GetBadScaler(); }
+  Bench("ScalerTimeInterp Build+GetTime", n, reps, [&]() {
+    ScalerTimeInterp interp;
+    interp.Build(times, bad);
+    for (long i = 0; i < n; i++) gSink += interp.GetTime(i);
+  });
+
+  Bench("GeTimeIndex::Around", n, reps, [&]() {
+    double before=0, after=0;
+    for (auto &r : recs) { geIndex.Around(r.GetScalerIndex(), before, after); gSink += after - before; }
+  });
+
+  // Muon list from the records (2+ panels over 500, below the LED multiplicity)
+  VetoMuonList recMu;
+  for (auto &r : recs)
+    if (r.GetOverQDCCount() >= 2 && r.GetMultip() < highestMultip-5 && !r.GetBadScaler())
+      recMu.Add(run, 1, (double)cache.GetStartTime(), r.GetTimeSec(), 0);
+  Bench("FindRecentMuon", geTimes.size(), reps, [&]() {
+    size_t iMu = 0;
+    long nVeto = 0;
+    if (recMu.Size() == 0) return;
+    for (auto t : geTimes) {
+      iMu = FindRecentMuon(recMu, iMu, run, t);
+      nVeto += IsMuonVetoed(recMu, iMu, MuonDeltaT(recMu, iMu, t, 0, 5), 5);
+    }
+    gSink += nVeto;
+  });
+  Bench("VetoWindowIndex build+search", geTimes.size(), reps, [&]() {
+    if (recMu.Size() == 0) return;
+    VetoWindowIndex muWindows(recMu, {StandardVetoWindow(), WideVetoWindow()});
+    long nVeto = 0;
+    for (auto t : geTimes) nVeto += muWindows.VetoMask(run, t) + muWindows.RecentMuon(run, t);
+    gSink += nVeto;
+  });
+
+  // ======== Macro-benchmarks ========
+  // A proxy for skim-coins, NOT its event loop: veto-gen can't make the gatified Ge data
+  // skim-coins reads, so this is only its muon side.  The muon list from auto-veto's output,
+  // then the window search for every synthetic Ge packet.
+  if (vetoFile != "") {
+    printf("  (skim-coins proxy: muon list and window search only, not the skim-coins event loop)\n");
+    Bench("skim-coins proxy: muon list+search", geTimes.size(), max(1,reps/2), [&]() {
+      TChain *vetoChain = new TChain("vetoTree");
+      vetoChain->Add(vetoFile.c_str());
+      VetoMuonList mu;
+      LoadMuonList(vetoChain, mu);
+      delete vetoChain;
+      if (mu.Size() == 0) return;
+      size_t iMu = 0;
+      long nVeto = 0;
+      for (auto t : geTimes) {
+        iMu = FindRecentMuon(mu, iMu, run, t);
+        nVeto += IsMuonVetoed(mu, iMu, MuonDeltaT(mu, iMu, t, 0, 5), 5);
+      }
+      gSink += nVeto;
+    });
+    // the same, with the muons from a catalog (skim-veto -cat)
+    string catFile = outFile + ".vmc";
+    TChain *catChain = new TChain("vetoTree");
+    catChain->Add(vetoFile.c_str());
+    VetoMuonList catMu;
+    LoadMuonList(catChain, catMu);
+    delete catChain;
+    if (catMu.Size() > 0 && WriteMuonCatalog(catFile, catMu)) {
+      Bench("skim-coins proxy: muon catalog+search", geTimes.size(), reps, [&]() {
+        VetoMuonCatalog cat;
+        if (!cat.Open(catFile)) return;
+        VetoMuonList mu;
+        cat.Load(mu, {run});
+        VetoWindowIndex muWindows(mu, {StandardVetoWindow()});
+        long nVeto = 0;
+        for (auto t : geTimes) nVeto += muWindows.IsVetoed(run, t);
+        gSink += nVeto;
+      });
+      remove(catFile.c_str());
+    }
+  }
+  // auto-veto: the phases of ProcessVetoData, from its profile of the same run
+  if (profFile != "") ImportProfile(profFile);
+
+  for (int q = 0; q < 32; q++) delete hLowQDC[q];
+  if (gSink == 12345.678) cout << " ";  // keep gSink alive
+
+  if (!WriteResults(outFile, run, n)) cout << "Warning: couldn't write " << outFile << endl;
+  else cout << "\nWrote " << outFile << endl;
+  if (baseFile != "") return Compare(baseFile, tol) > 0;
+  return 0;
+}
@@ -0,0 +1,124 @@
+// veto-gen.cc
+// Writes synthetic veto runs (and their Ge packet/timestamp streams) for
+// load and scaling tests of auto-veto on any Linux box.  See VetoSynth.hh.
+// The runs are built files with their Ge stream (VetoSynthTree.hh), or .vsyn record
+// files with -vsyn.
+// The output of "./veto-gen 20000 -o synth" is processed with
+//   ./auto-veto -g synth/OR_run20000.root -o [output dir]
+// C. Wiseman, A. Lopez
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "VetoSynth.hh"
+#include "VetoSynthTree.hh"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    cout << "Usage: ./veto-gen [run number (sets the panel configuration)]\n"
+         << "                  [-o [directory] (output location, default ./)]\n"
+         << "                  [-t [sec] (run length, default 3600)]\n"
+         << "                  [-x [factor] (scale the run length, e.g. 10 or 100 x production)]\n"
+         << "                  [-n [runs] (consecutive runs to write, default 1)]\n"
+         << "                  [-led [Hz] (LED frequency, default 0.2)]  [-jit [sec] (LED jitter, default 0.002)]\n"
+         << "                  [-mu [Hz] (muon rate, default 0.01)]  [-pat [planes:weight,...] (muon plane patterns, e.g. 0+1+2+3:5,0+1+4+5:1)]\n"
+         << "                  [-bg [Hz] (background hit rate per panel, default: the run's reference rates)]\n"
+         << "                  [-ge [Hz] (Ge event rate, default 5)]  [-off [sec] (Ge minus scaler clock offset)]\n"
+         << "                  [-ped [file] (32 pedestals, one per line, default random 80-160)]\n"
+         << "                  [-bs [fraction] (bad scalers)]  [-miss [fraction] (missing QDC card)]\n"
+         << "                  [-flush [n] (buffer flushes)]  [-jump [n] (scaler jumps)]  [-reset [n] (SEC/QEC resets)]\n"
+         << "                  [-seed [n]]\n"
+         << "                  [-vsyn (write .vsyn record files instead of built files, for veto-bench and veto-replay -x)]\n";
+    return 1;
+  }
+  VetoSynthConfig cfg;
+  cfg.run = stoi(argv[1]);
+  string outputDir = "./";
+  double scale = 1;
+  int nRuns = 1;
+  bool records = false;
+  vector<string> opt(argc);
+  for (int i=0; i<argc-1; i++) opt[i]=argv[i+1];
+  auto arg = [&](const char *flag) -> string {
+    vector<string>::iterator it = find(opt.begin(), opt.end(), flag);
+    if (it == opt.end() || it+1 == opt.end()) return "";
+    return *(it+1);
+  };
+  if (find(opt.begin(), opt.end(), "-vsyn") != opt.end()) records = true;
+  if (arg("-o") != "") outputDir = arg("-o");
+  if (arg("-t") != "") cfg.duration = stod(arg("-t"));
+  if (arg("-x") != "") scale = stod(arg("-x"));
+  if (arg("-n") != "") nRuns = stoi(arg("-n"));
+  if (arg("-led") != "") cfg.LEDfreq = stod(arg("-led"));
+  if (arg("-jit") != "") cfg.LEDjitter = stod(arg("-jit"));
+  if (arg("-mu") != "") cfg.muRate = stod(arg("-mu"));
+  if (arg("-bg") != "") cfg.bgRate = stod(arg("-bg"));
+  if (arg("-ge") != "") cfg.geRate = stod(arg("-ge"));
+  if (arg("-off") != "") cfg.geOffset = stod(arg("-off"));
+  if (arg("-bs") != "") cfg.badScalerFrac = stod(arg("-bs"));
+  if (arg("-miss") != "") cfg.missingCardFrac = stod(arg("-miss"));
+  if (arg("-flush") != "") cfg.nFlush = stoi(arg("-flush"));
+  if (arg("-jump") != "") cfg.nJump = stoi(arg("-jump"));
+  if (arg("-reset") != "") cfg.nReset = stoi(arg("-reset"));
+  if (arg("-seed") != "") cfg.seed = stoul(arg("-seed"));
+  if (arg("-pat") != "" && !cfg.SetPatterns(arg("-pat"))) {
+    cout << "Couldn't parse muon patterns " << arg("-pat") << ".  Exiting ...\n";
+    return 1;
+  }
+  if (arg("-ped") != "") {
+    ifstream pedFile(arg("-ped"));
+    for (int q = 0; q < 32; q++)
+      if (!(pedFile >> cfg.pedestal[q])) {
+        cout << "Couldn't read 32 pedestals from " << arg("-ped") << ".  Exiting ...\n";
+        return 1;
+      }
+  }
+  cfg.duration *= scale;
+
+  long totEntries = 0;
+  auto tStart = chrono::steady_clock::now();
+  for (int r = 0; r < nRuns; r++)
+  {
+    VetoSynthConfig runCfg = cfg;
+    runCfg.run = cfg.run + r;
+    runCfg.startUnix = cfg.startUnix + (long)(r*(cfg.duration + 60));
+    runCfg.seed = cfg.seed + r;
+    VetoSynth gen(runCfg);
+    if (!gen.IsKnownRun()) {
+      cout << "Run " << runCfg.run << " has no known panel configuration.  Exiting ...\n";
+      return 1;
+    }
+    VetoSynthRecordWriter recOut;
+    VetoSynthTree treeOut;
+    bool ok = records ? gen.Generate(outputDir, recOut) : gen.Generate(outputDir, treeOut);
+    string outFile = records ? recOut.GetFileName() : treeOut.GetFileName();
+    if (!ok) {
+      cout << "Couldn't write run " << runCfg.run << " to " << outputDir << ".  Exiting ...\n";
+      return 1;
+    }
+    string err;
+    long bad = records ? -1 : treeOut.Check(err);
+    if (bad >= 0) {
+      cout << "Entry " << bad << " of " << outFile << " doesn't decode to what was generated (" << err << ").  Exiting ...\n";
+      return 1;
+    }
+    const VetoSynthCounts &n = gen.GetCounts();
+    printf("Run %i: %.0f sec, %li entries (%li LED, %li muon, %li background), %li Ge events.\n",
+      runCfg.run, runCfg.duration, n.entries, n.LED, n.muon, n.bg, n.ge);
+    printf("  Faults: %li bad scalers, %li missing cards, %li flushed entries, %i jumps, %i resets.\n",
+      n.badScaler, n.missingCard, n.flushed, runCfg.nJump, runCfg.nReset);
+    ifstream written(outFile, ios::binary | ios::ate);
+    printf("  Wrote %s (%.1f MB) and %s\n", outFile.c_str(), written.tellg()/(1024.*1024.),
+      gen.GetGeIndexFile(outputDir).c_str());
+    totEntries += n.entries;
+  }
+  double sec = chrono::duration<double>(chrono::steady_clock::now() - tStart).count();
+  printf("Generated %li entries in %.1f sec (%.0f entries/sec).\n", totEntries, sec, sec > 0 ? totEntries/sec : 0);
+  return 0;
+}
@@ -0,0 +1,150 @@
+// veto-replay.cc
+// Copies the veto entries of a finished run into a new file a few at a time,
+// so the new file grows like a run being taken.  For testing auto-veto's follow mode
+// (with a .vsyn run from veto-gen -vsyn):
+//   ./veto-replay synth/synth_run20000.vsyn live/synth_run20000.vsyn -x 60 &
+//   ./auto-veto -t live/synth_run20000.vsyn -o live --idle 10
+// Built files are copied VetoTree entry by entry (CloneTree), with an AutoSave
+// after each batch, so readers see the new entries.
+// C. Wiseman, A. Lopez
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include "TFile.h"
+#include "TTree.h"
+#include "VetoSynth.hh"
+
+using namespace std;
+
+struct ReplayOptions {
+  double rate = 50;      // entries/sec
+  double speedup = 0;    // >0: follow the veto clock, this many times faster (synthetic runs)
+  long batch = 0;        // entries per write.  0: one poll's worth (rate/4, at least 1)
+};
+
+int ReplaySynth(string inFile, string outFile, const ReplayOptions &ro);
+int ReplayBuilt(string inFile, string outFile, const ReplayOptions &ro);
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    cout << "Usage: ./veto-replay [finished run: built file (.root) or synthetic run (.vsyn)] [growing output file]\n"
+         << "                     [-r [entries/sec] (default 50)]\n"
+         << "                     [-x [speedup] (synthetic runs: follow the veto clock at this many times real time)]\n"
+         << "                     [-n [entries per write]]\n";
+    return 1;
+  }
+  ReplayOptions ro;
+  vector<string> opt(argc);
+  for (int i=0; i<argc-1; i++) opt[i]=argv[i+1];
+  auto arg = [&](const char *flag) -> string {
+    vector<string>::iterator it = find(opt.begin(), opt.end(), flag);
+    if (it == opt.end() || it+1 == opt.end()) return "";
+    return *(it+1);
+  };
+  if (arg("-r") != "") ro.rate = stod(arg("-r"));
+  if (arg("-x") != "") ro.speedup = stod(arg("-x"));
+  if (arg("-n") != "") ro.batch = stol(arg("-n"));
+  if (ro.batch <= 0) ro.batch = max(1L, (long)(ro.rate/4));
+
+  string inFile = opt[0], outFile = opt[1];
+  bool synth = inFile.size() > 5 && inFile.compare(inFile.size()-5, 5, ".vsyn") == 0;
+  if (synth) return ReplaySynth(inFile, outFile, ro);
+  return ReplayBuilt(inFile, outFile, ro);
+}
+
+int ReplaySynth(string inFile, string outFile, const ReplayOptions &ro)
+{
+  VetoSynthFile in;
+  if (!in.Open(inFile)) {
+    cout << "Couldn't read synthetic run " << inFile << ".  Exiting ...\n";
+    return 1;
+  }
+  VetoSynthHeader hdr = in.GetHeader();
+  long nEntries = hdr.entries;
+  ofstream out(outFile.c_str(), ios::binary);
+  if (!out) {
+    cout << "Couldn't write " << outFile << ".  Exiting ...\n";
+    return 1;
+  }
+  // The entry count is filled in at the end, like veto-gen does.
+  hdr.entries = 0;
+  out.write((const char*)&hdr, sizeof(hdr));
+  out.flush();
+
+  auto tStart = chrono::steady_clock::now();
+  VetoSynthRow row;
+  bool pending = false;   // row is read, but not written yet
+  double t0 = -1;
+  long i = 0;
+  while (true)
+  {
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - tStart).count();
+    long n = 0;
+    while (true) {
+      if (!pending && (i >= nEntries || !in.Next(row))) break;
+      pending = true;
+      if (t0 < 0 && row.timeSec > 0) t0 = row.timeSec;
+      // Stop when the batch is full, or the entry is still in the future.
+      if (ro.speedup > 0 ? (t0 >= 0 && row.timeSec - t0 > elapsed*ro.speedup) : n >= ro.batch) break;
+      out.write((const char*)&row, sizeof(row));
+      pending = false;
+      i++;
+      n++;
+    }
+    if (!pending) { out.flush(); break; }  // end of the input
+    out.flush();
+    if (ro.speedup > 0) this_thread::sleep_for(chrono::milliseconds(250));
+    else this_thread::sleep_for(chrono::duration<double>(n/ro.rate));
+  }
+  hdr.entries = i;
+  out.seekp(0);
+  out.write((const char*)&hdr, sizeof(hdr));
+  out.close();
+  printf("Replayed %li entries of run %i in %.1f sec.\n", i, hdr.run,
+    chrono::duration<double>(chrono::steady_clock::now() - tStart).count());
+  return 0;
+}
+
+int ReplayBuilt(string inFile, string outFile, const ReplayOptions &ro)
+{
+  TFile *fin = TFile::Open(inFile.c_str());
+  if (!fin || fin->IsZombie()) {
+    cout << "Couldn't open " << inFile << ".  Exiting ...\n";
+    return 1;
+  }
+  TTree *vetoIn = (TTree*)fin->Get("VetoTree");
+  if (!vetoIn) {
+    cout << "No VetoTree in " << inFile << ".  Exiting ...\n";
+    return 1;
+  }
+  long nEntries = vetoIn->GetEntries();
+  TFile *fout = new TFile(outFile.c_str(), "RECREATE");
+  TTree *vetoOut = vetoIn->CloneTree(0);
+
+  auto tStart = chrono::steady_clock::now();
+  long i = 0;
+  while (i < nEntries)
+  {
+    long n = min(ro.batch, nEntries - i);
+    for (long j = 0; j < n; j++, i++) {
+      vetoIn->GetEntry(i);
+      vetoOut->Fill();
+    }
+    vetoOut->AutoSave("SaveSelf");
+    this_thread::sleep_for(chrono::duration<double>(n/ro.rate));
+  }
+  fout->cd();
+  vetoOut->Write("",TObject::kOverwrite);
+  fout->Close();
+  fin->Close();
+  printf("Replayed %li VetoTree entries in %.1f sec.\n", i,
+    chrono::duration<double>(chrono::steady_clock::now() - tStart).count());
+  return 0;
+}
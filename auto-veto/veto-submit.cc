@@ -0,0 +1,122 @@
+// veto-submit.cc
+// Submits runs to an auto-veto daemon (./auto-veto -D [spool dir]) and waits
+// for them to finish.  See VetoSpool.hh.
+//   ./veto-submit spool 20000 20001 -o avout/DS5
+//   ./veto-submit spool -g synth/OR_run20000.root
+// Returns 0 if every run was processed, 1 if any failed, and 2 on a timeout.
+// C. Wiseman, A. Lopez
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+#include "VetoSpool.hh"
+
+using namespace std;
+
+// Paths are used by the daemon, which has its own working directory.
+string AbsPath(string path)
+{
+  if (path.empty() || path[0] == '/') return path;
+  char buf[PATH_MAX];
+  if (realpath(path.c_str(), buf)) return buf;
+  if (!getcwd(buf, sizeof(buf))) return path;
+  return string(buf) + "/" + path;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    cout << "Usage: ./veto-submit [spool dir] [run number(s)]\n"
+         << "                     [-g [synthetic run file from veto-gen (OR_run*.root or .vsyn)] (submit a synthetic run, can be repeated)]\n"
+         << "                     [-o [directory] (output location, default: the daemon's)]\n"
+         << "                     [-n (don't wait for the runs to finish)]\n"
+         << "                     [-t [sec] (give up waiting after this long)]\n"
+         << "                     [-q (don't print the runs' output)]\n";
+    return 1;
+  }
+  VetoSpool spool(argv[1]);
+  vector<VetoSpoolJob> jobs;
+  string outputDir;
+  bool wait = true, printLogs = true;
+  double timeout = 0;
+  for (int i = 2; i < argc; i++) {
+    string a = argv[i];
+    bool hasVal = (i+1 < argc);
+    if (a == "-n") wait = false;
+    else if (a == "-q") printLogs = false;
+    else if (a == "-o" && hasVal) outputDir = AbsPath(argv[++i]);
+    else if (a == "-t" && hasVal) timeout = stod(argv[++i]);
+    else if (a == "-g" && hasVal) {
+      VetoSpoolJob job;
+      job.path = AbsPath(argv[++i]);
+      job.synth = true;
+      jobs.push_back(job);
+    }
+    else if (a.find_first_not_of("0123456789") == string::npos) {
+      VetoSpoolJob job;
+      job.run = stoi(a);
+      jobs.push_back(job);
+    }
+    else {
+      cout << "Unknown option " << a << ".  Exiting ...\n";
+      return 1;
+    }
+  }
+  if (jobs.empty()) {
+    cout << "No runs to submit.  Exiting ...\n";
+    return 1;
+  }
+  if (!spool.Init()) {
+    cout << "Couldn't make spool directory " << spool.GetDir() << ".  Exiting ...\n";
+    return 1;
+  }
+  if (!spool.DaemonRunning())
+    cout << "Warning: no daemon is running on " << spool.GetDir() << ".  The runs will wait for one.\n";
+
+  for (auto &job : jobs) {
+    job.outputDir = outputDir;
+    if (!spool.Submit(job)) {
+      cout << "Couldn't submit " << (job.synth ? job.path : to_string(job.run)) << ".  Exiting ...\n";
+      return 1;
+    }
+    printf("Submitted %s as job %s.\n", job.synth ? job.path.c_str() : to_string(job.run).c_str(), job.id.c_str());
+  }
+  if (!wait) return 0;
+
+  // Report each job as it finishes.
+  auto tStart = chrono::steady_clock::now();
+  vector<bool> done(jobs.size(), false);
+  size_t nDone = 0;
+  int nFailed = 0;
+  while (nDone < jobs.size())
+  {
+    for (size_t j = 0; j < jobs.size(); j++) {
+      VetoSpoolJob res;
+      if (done[j] || !spool.Done(jobs[j].id, res)) continue;
+      done[j] = true;
+      nDone++;
+      if (res.status != 0) nFailed++;
+      if (printLogs) {
+        ifstream log(spool.LogFile(res.id).c_str());
+        if (log.peek() != EOF) cout << log.rdbuf();
+      }
+      printf("Job %s: run %i %s.  Waited %.2f sec, processed in %.2f sec, latency %.2f sec.\n",
+        res.id.c_str(), res.run, res.status==0 ? "ok" : "FAILED", res.WaitSec(), res.ProcSec(), res.LatencySec());
+      cout << flush;
+    }
+    if (nDone == jobs.size()) break;
+    double waited = chrono::duration<double>(chrono::steady_clock::now() - tStart).count();
+    if (timeout > 0 && waited > timeout) {
+      printf("Timed out after %.0f sec, %i of %i runs done.\n", waited, (int)nDone, (int)jobs.size());
+      return 2;
+    }
+    this_thread::sleep_for(chrono::milliseconds(200));
+  }
+  return nFailed > 0;
+}
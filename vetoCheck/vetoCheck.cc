@@ -45,11 +45,12 @@
 #include "TLine.h"
 #include "MJVetoEvent.hh"
 #include "GATDataSet.hh"
+#include "../auto-veto/VetoTimeInterp.hh"
+#include "../auto-veto/VetoLEDTimer.hh"
 
 using namespace std;
 
 bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool verbose);
-double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler);
 int FindQDCThreshold(TH1F *qdcHist);
 void vetoCheck(int run, bool draw);
 
@@ -105,12 +106,10 @@ void vetoCheck(int run, bool draw)
 
 	int ErrorCount[nErrs] = {0};
 	vector<double> EntryTime;
-	vector<double> EntryNum;
 	vector<bool> BadScalers;
 
 	char hname[50];
-	sprintf(hname,"%d_LEDDeltaT",run);
-	TH1D *LEDDeltaT = new TH1D(hname,hname,100000,0,100); // 0.001 sec/bin
+	LEDTimer LEDDeltaT;
 	TH1F *hRunQDC[32];
 	for (int i = 0; i < 32; i++) {
 		sprintf(hname,"hRunQDC%d",i);
@@ -155,7 +154,6 @@ void vetoCheck(int run, bool draw)
 		}
 
     	// fill vectors (the time vectors are revised in the second loop)
-		EntryNum.push_back(i);
 		EntryTime.push_back(xTime);
 
 		// check if first good entry isn't acutally first good entry
@@ -180,7 +178,7 @@ void vetoCheck(int run, bool draw)
 
     	// very simple LED tag (fMultip is number of channels above QDC threshold)
 		if (veto.GetMultip() > 15) {
-			LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+			LEDDeltaT.Fill(veto.GetTimeSec()-prev.GetTimeSec());
 			pureLEDcount++;
 		}
 
@@ -202,12 +200,10 @@ void vetoCheck(int run, bool draw)
 	// find the LED frequency
 	double LEDrms = 0;
 	double LEDfreq = 0;
-	int dtEntries = LEDDeltaT->GetEntries();
+	int dtEntries = LEDDeltaT.GetEntries();
 	if (dtEntries > 0) {
-		int maxbin = LEDDeltaT->GetMaximumBin();
-		LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-		LEDrms = LEDDeltaT->GetRMS();
-		LEDfreq = 1/LEDDeltaT->GetMean();
+		LEDrms = LEDDeltaT.GetRMS();
+		LEDfreq = 1/LEDDeltaT.GetPeriod(); // mean delta-t within ~0.1 seconds of the peak.
 	}
 	else {
 		cout << "Warning! No multiplicity > 15 events.  LED may be off.\n";
@@ -216,7 +212,6 @@ void vetoCheck(int run, bool draw)
 		badLEDFreq = true;
 	}
 	double LEDperiod = 1/LEDfreq;
-	delete LEDDeltaT;
 	if (LEDperiod > 9 || vEntries < 100)
 	{
 		cout << "Warning: Short run.\n";
@@ -235,6 +230,11 @@ void vetoCheck(int run, bool draw)
 		Error[25] = true;
 	}
 
+	// bad scaler times, from the nearest good scalers
+	ScalerTimeInterp badScalerTimes;
+	if (!badScalerTimes.Build(EntryTime,BadScalers))
+		cout << "Vectors are different sizes!\n";
+
 	// ====================== Second loop over entries =========================
 	double STime = 0;
 	double STimePrev = 0;
@@ -271,7 +271,7 @@ void vetoCheck(int run, bool draw)
 			xTime = veto.GetTimeSBC() - SBCOffset;
 		else
 		{
-			xTime = InterpTime(i,EntryTime,EntryNum,BadScalers);
+			xTime = badScalerTimes.GetTime(i);
 		 	Error[28] = true;
  			ErrorCount[28]++;
 		}
@@ -536,28 +536,3 @@ int FindQDCThreshold(TH1F *qdcHist)
 	double xval = qdcHist->GetXaxis()->GetBinCenter(bin);
 	return xval+35;
 }
-
-double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler)
-{
-	if ((times.size() != entries.size()) || times.size() != badScaler.size())
-	{
-		cout << "Vectors are different sizes!\n";
-		if (entry >= (int)times.size())
-			cout << "Entry is larger than number of entries in vector!\n";
-		return -1;
-	}
-
-	double iTime = 0;
-	double lower = 0;
-	double upper = 0;
-	if (!badScaler[entry]) iTime = times[entry];
-	else
-	{
-		for (int i = entry; i < (int)entries.size(); i++)
-			if (badScaler[i] == 0) { upper = times[i]; break; }
-		for (int j = entry; j > 0; j--)
-			if (badScaler[j] == 0) { lower = times[j]; break; }
-		iTime = (upper + lower)/2.0;
-	}
-	return iTime;
-}
\ No newline at end of file
@@ -18,7 +18,6 @@ void muDisplayList(string file)
 
 	// Initialize output from muFinder
 	MJVetoEvent *event = NULL;
-	int CoinType[32] = {0};
 	int CutType[32] = {0};
 	double LEDfreq = 0;
 	double LEDrms = 0;
@@ -28,7 +27,6 @@ void muDisplayList(string file)
 	double xTime = 0;
 	double x_deltaT = 0;
 	v->SetBranchAddress("events",&event);
-	v->SetBranchAddress("CoinType[32]",CoinType);
 	v->SetBranchAddress("CutType[32]",CutType);
 	v->SetBranchAddress("LEDfreq",&LEDfreq);
 	v->SetBranchAddress("LEDrms",&LEDrms);
@@ -37,6 +35,7 @@ void muDisplayList(string file)
 	v->SetBranchAddress("stop",&stop);
 	v->SetBranchAddress("xTime",&xTime);
 	v->SetBranchAddress("x_deltaT",&x_deltaT);
+	CoinBitsReader coinBits(v);	// CoinBits, or CoinType in older files
 	int vEntries = v->GetEntries();
 	cout << "Found " << vEntries << " entries.\n";
 	// v->GetEntry(0);
@@ -51,7 +50,7 @@ void muDisplayList(string file)
 		// hit list format:
 		// run entry QEC time qdc1 ... qdc32
 
-		if (CoinType[0]==1) 
+		if (coinBits.Get() & kCoinMuon) 
 		{
 			hitList << event->GetRun() << " " << i << " " << event->GetSEC() << " " << xTime << " ";
 			for (int j=0;j<numPanels;j++)  
@@ -51,10 +51,11 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	long stop;
 	long prevStopTime = 0;
 	double duration;
-	int CoinType[32];
+	uint8_t CoinBits = 0;	// coincidence bits, see VetoCoincidence.hh
 	int CutType[32];
 	int PlaneHits[12];
 	int PlaneTrue[12];
+	uint16_t PlaneMask = 0;	// bit p: plane p was hit
 	int PlaneHitCount = 0;
 	int highestMultip = 0;
 	int multipThreshold = 0;
@@ -87,10 +88,10 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		vetoEvent->Branch("xTime",&xTime);
 		vetoEvent->Branch("x_deltaT",&x_deltaT);
 		vetoEvent->Branch("x_LEDDeltaT",&x_LEDDeltaT);
-		vetoEvent->Branch("CoinType[32]",CoinType,"CoinType[32]/I");
+		vetoEvent->Branch("CoinBits",&CoinBits,"CoinBits/b");
 		vetoEvent->Branch("CutType[32]",CutType,"CutType[32]/I");
 		vetoEvent->Branch("PlaneHits[12]",PlaneHits,"PlaneHits[12]/I");
-		vetoEvent->Branch("PlaneTrue[12]",PlaneTrue,"PlaneTrue[12]/I");
+		vetoEvent->Branch("PlaneMask",&PlaneMask,"PlaneMask/s");
 		vetoEvent->Branch("PlaneHitCount",&PlaneHitCount);
 	}
 
@@ -100,18 +101,14 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 
 		// initialize
 		InputList >> run;
+		VetoGeometry geo(run);
 		GATDataSet *ds = new GATDataSet(run);
 		TChain *v = ds->GetVetoChain();
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent();
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
-		v->GetEntry(0);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 		start = (long)vRun->GetStartTime();
 		stop = (long)vRun->GetStopTime();
 		duration = ds->GetRunTime()/CLHEP::second;
@@ -129,9 +126,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		//
 		bool badLEDFreq = false;
 		MJVetoEvent prev;
-		char hname[200];
-		sprintf(hname,"LEDDeltaT_run%i",run);
-		TH1F *LEDDeltaT = new TH1F(hname,hname,100000,0,100); // 0.001 sec/bin
+		LEDTimer LEDDeltaT;
 		highestMultip = 0;	// try to predict how many panels there are for this run.
 		long skippedEvents = 0;
 		long corruptScaler = 0;
@@ -139,6 +134,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		int firstGoodEntry = 0;
 		MJVetoEvent first;
 		highestMultip=0;
+		VETO_SCOPE(pLED, "muFinder LED loop");
 		for (long i = 0; i < vEntries; i++)
 		{
 			v->GetEntry(i);
@@ -170,7 +166,8 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 
 	    	// Very simple LED tag.
 			if (veto.GetMultip() >= 20) {
-				LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT.Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT.Track(veto.GetTimeSec());
 			}
 			prev = veto;
 		}
@@ -191,13 +188,11 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		}
 		LEDrms = 0;
 		LEDfreq = 0;
-		int dtEntries = LEDDeltaT->GetEntries();
+		int dtEntries = LEDDeltaT.GetEntries();
 		if (dtEntries > 0) {
-			int maxbin = LEDDeltaT->GetMaximumBin();
-			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-			LEDrms = LEDDeltaT->GetRMS();
+			LEDrms = LEDDeltaT.GetRMS();
 			if (LEDrms==0) LEDrms = 0.1;
-			LEDfreq = 1/LEDDeltaT->GetMean();
+			LEDfreq = 1/LEDDeltaT.GetPeriod(); // mean delta-t within ~0.1 seconds of the peak.
 		}
 		else {
 			printf("Warning! No multiplicity > 20 events!!\n");
@@ -206,19 +201,25 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			LEDTurnedOff = true;
 		}
 		double LEDperiod = 1/LEDfreq;
+		pLED.Stop(vEntries);
 
 		// Display LED Cut parameters
 		multipThreshold = highestMultip - LEDMultipThreshold;
 		printf("HM: %i LED_f: %.8f LED_t: %.8f RMS: %8f\n",highestMultip,LEDfreq,1/LEDfreq,LEDrms);
+		printf("Tracked LED_t: %.8f  jitter: %.6f  (%li pulses locked)\n",LEDDeltaT.GetTrackedPeriod(),LEDDeltaT.GetJitter(),LEDDeltaT.GetLocks());
 		printf("LED window: %.2f  Multip Threshold: %i\n",LEDWindow,multipThreshold);
 		if (LEDperiod > 9 || vEntries < 100) {
 			badLEDFreq = true;
 			printf("Warning: LED period is %.2f, total entries: %li.  Can't use it in the time cut!\n",LEDperiod,vEntries);
 		}
-		delete LEDDeltaT;
 
 		// ========= 2nd loop over veto entries - Find muons! =========
 		//
+		// The time cut compares each entry to the tracker's next expected LED.
+		// It starts again from the histogram period (the old fixed-period cut),
+		// and follows the LED period as this loop's tagged LEDs lock in.
+		LEDDeltaT.ResetTracker();
+		VETO_SCOPE(pScan, "muFinder scan loop");
 		prev.Clear();
 		MJVetoEvent prevLED;
 		double xTimePrev = 0;
@@ -321,7 +322,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 
 			// Set Cut
 			x_deltaT = xTime - xTimePrevLED;
-			if (!LEDTurnedOff && !badLEDFreq && fabs(LEDperiod - x_deltaT) < LEDWindow && veto.GetMultip() > multipThreshold)
+			if (!LEDTurnedOff && !badLEDFreq && fabs(LEDDeltaT.ExpectedNext() - xTime) < LEDWindow && veto.GetMultip() > multipThreshold)
 			{
 				TimeCut = false;
 				IsLED = true;
@@ -382,11 +383,9 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	    	//
 	    	bool EnergyCut = false;
 
-	    	int over500Count = 0;
-	    	for (int q = 0; q < 32; q++) {
-	    		if (veto.GetQDC(q) > 500)
-	    			over500Count++;
-	    	}
+	    	PanelSummary panels;
+	    	SummarizePanels(veto,500,panels);
+	    	int over500Count = panels.overN;
 	    	if (over500Count >= 2) EnergyCut = true;
 
 			//----------------------------------------------------------
@@ -400,26 +399,14 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 				PlaneTrue[k] = 0;
 				PlaneHits[k]=0;
 			}
-			for (int k = 0; k < 32; k++)
+			for (uint32_t m = panels.hitMask; m; m &= m-1)
 			{
-				if (veto.GetQDC(k) > veto.GetSWThresh(k))
-				{
-					if (PanelMap(k)==0) { PlaneTrue[0]=1; PlaneHits[0]++; }			// 0: Lower Bottom
-					else if (PanelMap(k)==1) { PlaneTrue[1]=1; PlaneHits[1]++; }		// 1: Upper Bottom
-					else if (PanelMap(k)==2) { PlaneTrue[2]=1; PlaneHits[2]++; }		// 3: Inner Top
-					else if (PanelMap(k)==3) { PlaneTrue[3]=1; PlaneHits[3]++; }		// 4: Outer Top
-					else if (PanelMap(k)==4) { PlaneTrue[4]=1; PlaneHits[4]++; }		// 5: Inner North
-					else if (PanelMap(k)==5) { PlaneTrue[5]=1; PlaneHits[5]++; }		// 6: Outer North
-					else if (PanelMap(k)==6) { PlaneTrue[6]=1; PlaneHits[6]++; }		// 7: Inner South
-					else if (PanelMap(k)==7) { PlaneTrue[7]=1; PlaneHits[7]++; }		// 8: Outer South
-					else if (PanelMap(k)==8) { PlaneTrue[8]=1; PlaneHits[8]++; }		// 9: Inner West
-					else if (PanelMap(k)==9) { PlaneTrue[9]=1; PlaneHits[9]++; }		// 10: Outer West
-					else if (PanelMap(k)==10) { PlaneTrue[10]=1; PlaneHits[10]++; }	// 11: Inner East
-					else if (PanelMap(k)==11) { PlaneTrue[11]=1; PlaneHits[11]++; }	// 12: Outer East
-				}
+				int plane = geo.GetPlane(__builtin_ctz(m));	// see VetoGeometry.hh
+				if (plane >= 0) { PlaneTrue[plane]=1; PlaneHits[plane]++; }
 			}
+			PlaneMask = 0;
 			for (int k = 0; k < 12; k++) {
-				if (PlaneTrue[k]) PlaneHitCount++;
+				if (PlaneTrue[k]) { PlaneHitCount++; PlaneMask |= (1 << k); }
 			}
 
 			//----------------------------------------------------------
@@ -427,7 +414,8 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			// Use EnergyCut, TimeCut, and the Hit Pattern to identify them sumbitches.
 
 			// reset
-			for (int r = 0; r < 32; r++) {CoinType[r]=0; CutType[r]=0;}
+			CoinBits = 0;
+			for (int r = 0; r < 32; r++) CutType[r]=0;
 
 			// Check output
 			// printf("%-3li  m %-3i  t %-6.2f  XDT %-6.2f  LED? %i  TC %i  EC %i  QTot %i\n"
@@ -437,36 +425,31 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			{
 				// 0. Everything that passes TimeCut and EnergyCut.
 				// This is what goes into the DEMONSTRATOR veto cut.
-				CoinType[0] = true;
+				CoinBits = kCoinMuon | GetCoinClass(PlaneMask);	// bits 1-4: see VetoCoincidence.hh
 				printf("Entry: %li  2+Panel Muon.  QDC: %i  Mult: %i  LED? %i  T: %-6.2f  XDT %-6.2f  LEDP-XDT %-6.2f\n",
 					i,veto.GetTotE(),veto.GetMultip(),IsLED,xTime,x_deltaT,LEDperiod-x_deltaT);
 
 				// 1. Definite Vertical Muons
-				if (PlaneTrue[0] && PlaneTrue[1] && PlaneTrue[2] && PlaneTrue[3]) {
-					CoinType[1] = true;
+				if (CoinBits & kCoinVertical) {
 					printf("Entry: %li  Vertical Muon.  QDC: %i  Mult: %i  LED? %i  T: %-6.2f  XDT %-6.2f  LEDP-XDT %-6.2f\n",
 						i,veto.GetTotE(),veto.GetMultip(),IsLED,xTime,x_deltaT,LEDperiod-x_deltaT);
 				}
 
 				// 2. Both top or side layers + both bottom layers.
-				if ((PlaneTrue[0] && PlaneTrue[1]) && ((PlaneTrue[2] && PlaneTrue[3]) || (PlaneTrue[4] && PlaneTrue[5])
-					|| (PlaneTrue[6] && PlaneTrue[7]) || (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[2] = true;
+				if (CoinBits & kCoinSideBottom) {
 
 					// show output if we haven't seen it from CT1 already
-					if (!CoinType[1]) {
+					if (!(CoinBits & kCoinVertical)) {
 						printf("Entry: %li  Side+Bottom Muon.  QDC: %i  Mult: %i  LED? %i  T: %-6.2f  XDT %-6.2f  LEDP-XDT %-6.2f\n",
 							i,veto.GetTotE(),veto.GetMultip(),IsLED,xTime,x_deltaT,LEDperiod-x_deltaT);
 					}
 				}
 
 				// 3. Both Top + Both Sides
-				if ((PlaneTrue[2] && PlaneTrue[3]) && ((PlaneTrue[4] && PlaneTrue[5]) || (PlaneTrue[6] && PlaneTrue[7])
-					|| (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[3] = true;
+				if (CoinBits & kCoinTopSide) {
 
 					// show output if we haven't seen it from CT1 or CT2 already
-					if (!CoinType[1] && !CoinType[2]) {
+					if (!(CoinBits & (kCoinVertical | kCoinSideBottom))) {
 						printf("Entry: %li  Top+Sides Muon.  QDC: %i  Mult: %i  LED? %i  T: %-6.2f  XDT %-6.2f  LEDP-XDT %-6.2f\n",
 							i,veto.GetTotE(),veto.GetMultip(),IsLED,xTime,x_deltaT,LEDperiod-x_deltaT);
 					}
@@ -484,10 +467,10 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			// Write a text file
 			if (list) {
 				char buffer[200];
-				if (CoinType[1] || CoinType[0]) {
+				if (CoinBits & (kCoinMuon | kCoinVertical)) {
 					int type;
-					if (CoinType[0]) type = 1;
-					if (CoinType[1]) type = 2;
+					if (CoinBits & kCoinMuon) type = 1;
+					if (CoinBits & kCoinVertical) type = 2;
 					sprintf(buffer,"%i %li %.8f %i %i\n",run,start,xTime,type,veto.GetBadScaler());
 					MuonList << buffer;
 				}
@@ -518,6 +501,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			if (IsLED) {
 				prevLED = veto;
 				xTimePrevLED = xTime;
+				LEDDeltaT.Track(xTime);
 			}
 			if (veto.GetMultip() > multipThreshold) {
 				xTimePrevLEDSimple = xTime;
@@ -528,6 +512,8 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			x_deltaTPrev = x_deltaT;
 	    }
 
+		pScan.Stop(vEntries);
+
 	    // End of run summaries.
 		if (almostMissedLED > 0) cout << "\nWarning, almost missed " << almostMissedLED << " LED events.\n";
 
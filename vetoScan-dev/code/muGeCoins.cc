@@ -28,7 +28,6 @@ void muGeCoins(string Input)
     MJVetoEvent *veto;
 	Long64_t start;
 	Long64_t stop;
-	int CoinType[32];
 	int CutType[32];
 	int highestMultip = 0;
 	double LEDfreq = 0;
@@ -36,7 +35,6 @@ void muGeCoins(string Input)
 	double xTime = 0;
 	double x_deltaT = 0;
     vEvent->SetBranchAddress("events",&veto);
-	vEvent->SetBranchAddress("CoinType[32]",&CoinType);
 	vEvent->SetBranchAddress("CutType[32]",&CutType);
 	vEvent->SetBranchAddress("LEDfreq",&LEDfreq);
 	vEvent->SetBranchAddress("LEDrms",&LEDrms);
@@ -50,7 +48,9 @@ void muGeCoins(string Input)
 	cout << "Veto File has " << vEntries << " entries.\n";
 
   	// Create TEntryList with a particular coincidence type, possibly from command line.
-  	vEvent->Draw(">>elist", "CoinType[0]==1", "entrylist");
+  	// Muon candidates: CoinBits bit 0 (see VetoCoincidence.hh), or CoinType[0] in older files.
+  	const char *muonCut = vEvent->GetBranch("CoinBits") ? "(CoinBits & 1) != 0" : "CoinType[0]==1";
+  	vEvent->Draw(">>elist", muonCut, "entrylist");
     TEntryList *elist = (TEntryList*)gDirectory->Get("elist");
     elist->Print("");	// "": print the name of the tree and file, "all": print all the entry numbers
 	long listEntries = elist->GetN();  
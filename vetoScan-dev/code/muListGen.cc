@@ -29,10 +29,8 @@ void muListGen(string arg)
 	double LEDfreq=0,LEDrms=0,LEDWindow=0,xTime=0,x_deltaT=0,x_LEDDeltaT=0;
 	int multipThreshold=0,highestMultip=0,LEDMultipThreshold=0,LEDSimpleThreshold=0,PlaneHitCount=0;
 	Long64_t start=0,stop=0;
-	int CoinType[32] = {0};
 	int CutType[32] = {0};
 	int PlaneHits[12] = {0};
-	int PlaneTrue[12] = {0};
 	v->SetBranchAddress("events",&event);
 	// v->SetBranchAddress("rEntry",&rEntry);	// not implemented for DS1 yet.
 	v->SetBranchAddress("LEDfreq",&LEDfreq);
@@ -47,11 +45,10 @@ void muListGen(string arg)
 	v->SetBranchAddress("xTime",&xTime);
 	v->SetBranchAddress("x_deltaT",&x_deltaT);
 	v->SetBranchAddress("x_LEDDeltaT",&x_LEDDeltaT);
-	v->SetBranchAddress("CoinType[32]",CoinType);
 	v->SetBranchAddress("CutType[32]",CutType);
 	v->SetBranchAddress("PlaneHits[12]",PlaneHits);
-	v->SetBranchAddress("PlaneTrue[12]",PlaneTrue);
 	v->SetBranchAddress("PlaneHitCount",&PlaneHitCount);
+	CoinBitsReader coinBits(v);	// CoinBits, or CoinType in older files
 	int vEntries = v->GetEntries();
 	cout << "Found " << vEntries << " entries.\n";
 	
@@ -63,12 +60,13 @@ void muListGen(string arg)
 
 		// Write a text file
 		char buffer[200];
-		if (CoinType[1] || CoinType[0]) 
+		uint8_t coin = coinBits.Get();
+		if (coin & (kCoinMuon | kCoinVertical)) 
 		{
 			counter++;
 			int type;
-			if (CoinType[0]) type = 1;
-			if (CoinType[1]) type = 2;
+			if (coin & kCoinMuon) type = 1;
+			if (coin & kCoinVertical) type = 2;
 			sprintf(buffer,"%i %lli %.8f %i %i\n",event->GetRun(),start,xTime,type,event->GetBadScaler());
 			MuonList << buffer;
 			// cout << buffer;
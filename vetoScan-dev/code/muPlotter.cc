@@ -17,7 +17,8 @@ void muPlotter(string arg)
 	TH2D *hqm = new TH2D("hqm","qdctotal vs multip.",100,0,55000,32,0,32);
 
 	char cut1[500];
-	sprintf(cut1,"CoinType[1]==1");
+	// vertical muons: CoinBits bit 1 (see VetoCoincidence.hh), or CoinType[1] in older files
+	sprintf(cut1,"%s", t->GetBranch("CoinBits") ? "(CoinBits & 2) != 0" : "CoinType[1]==1");
 	TCut tcut1 = cut1;
 
 	// t->Project("hqt","events.totE");
@@ -49,10 +49,11 @@ void muSimple(string Input, int *thresh)
 	long stop;
 	long prevStopTime = 0;
 	double duration;
-	int CoinType[32];
+	uint8_t CoinBits = 0;	// coincidence bits, see VetoCoincidence.hh
 	int CutType[32];
 	int PlaneHits[12];
 	int PlaneTrue[12];
+	uint16_t PlaneMask = 0;	// bit p: plane p was hit
 	int PlaneHitCount = 0;
 	int highestMultip = 0;
 	int multipThreshold = 0;
@@ -81,10 +82,10 @@ void muSimple(string Input, int *thresh)
 	vetoEvent->Branch("xTime",&xTime);
 	vetoEvent->Branch("x_deltaT",&x_deltaT); 
 	vetoEvent->Branch("x_LEDDeltaT",&x_LEDDeltaT);
-	vetoEvent->Branch("CoinType[32]",CoinType,"CoinType[32]/I");
+	vetoEvent->Branch("CoinBits",&CoinBits,"CoinBits/b");
 	vetoEvent->Branch("CutType[32]",CutType,"CutType[32]/I");
 	vetoEvent->Branch("PlaneHits[12]",PlaneHits,"PlaneHits[12]/I");
-	vetoEvent->Branch("PlaneTrue[12]",PlaneTrue,"PlaneTrue[12]/I");
+	vetoEvent->Branch("PlaneMask",&PlaneMask,"PlaneMask/s");
 	vetoEvent->Branch("PlaneHitCount",&PlaneHitCount);
 
 	// Loop over files.
@@ -92,18 +93,14 @@ void muSimple(string Input, int *thresh)
 
 		// initialize
 		InputList >> run;
+		VetoGeometry geo(run);
 		GATDataSet *ds = new GATDataSet(run);
 		TChain *v = ds->GetVetoChain();
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
-		v->GetEntry(0);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 		start = (long)vRun->GetStartTime();
 		stop = (long)vRun->GetStopTime();
 		duration = ds->GetRunTime()/CLHEP::second;
@@ -298,24 +295,12 @@ void muSimple(string Input, int *thresh)
 			}
 			for (int k = 0; k < 32; k++) 
 			{
-				if (veto.GetQDC(k) > veto.GetSWThresh(k))
-				{
-					if (PanelMap(k)==0) { PlaneTrue[0]=1; PlaneHits[0]++; }			// 0: Lower Bottom
-					else if (PanelMap(k)==1) { PlaneTrue[1]=1; PlaneHits[1]++; }		// 1: Upper Bottom
-					else if (PanelMap(k)==2) { PlaneTrue[2]=1; PlaneHits[2]++; }		// 3: Inner Top
-					else if (PanelMap(k)==3) { PlaneTrue[3]=1; PlaneHits[3]++; }		// 4: Outer Top
-					else if (PanelMap(k)==4) { PlaneTrue[4]=1; PlaneHits[4]++; }		// 5: Inner North
-					else if (PanelMap(k)==5) { PlaneTrue[5]=1; PlaneHits[5]++; }		// 6: Outer North
-					else if (PanelMap(k)==6) { PlaneTrue[6]=1; PlaneHits[6]++; }		// 7: Inner South
-					else if (PanelMap(k)==7) { PlaneTrue[7]=1; PlaneHits[7]++; }		// 8: Outer South
-					else if (PanelMap(k)==8) { PlaneTrue[8]=1; PlaneHits[8]++; }		// 9: Inner West
-					else if (PanelMap(k)==9) { PlaneTrue[9]=1; PlaneHits[9]++; }		// 10: Outer West
-					else if (PanelMap(k)==10) { PlaneTrue[10]=1; PlaneHits[10]++; }	// 11: Inner East
-					else if (PanelMap(k)==11) { PlaneTrue[11]=1; PlaneHits[11]++; }	// 12: Outer East
-				}
+				int plane = geo.GetPlane(k);	// see VetoGeometry.hh
+				if (plane >= 0 && veto.GetQDC(k) > veto.GetSWThresh(k)) { PlaneTrue[plane]=1; PlaneHits[plane]++; }
 			}
+			PlaneMask = 0;
 			for (int k = 0; k < 12; k++) {
-				if (PlaneTrue[k]) PlaneHitCount++;
+				if (PlaneTrue[k]) { PlaneHitCount++; PlaneMask |= (1 << k); }
 			}
 
 			//----------------------------------------------------------
@@ -323,7 +308,8 @@ void muSimple(string Input, int *thresh)
 			// Use EnergyCut, TimeCut, and the Hit Pattern to identify them sumbitches.
 
 			// reset
-			for (int r = 0; r < 32; r++) {CoinType[r]=0; CutType[r]=0;}
+			CoinBits = 0;
+			for (int r = 0; r < 32; r++) CutType[r]=0;
 
 			// Check output
 			// printf("i %-3li  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
@@ -333,36 +319,31 @@ void muSimple(string Input, int *thresh)
 			{
 				// 0. Everything that energy cut that is not an LED.
 				// This is what goes into the DEMONSTRATOR veto cut.
-				CoinType[0] = true;
+				CoinBits = kCoinMuon | GetCoinClass(PlaneMask);	// bits 1-4: see VetoCoincidence.hh
 				printf("Entry: %li  2+Panel Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 					,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 
 				// 1. Definite Vertical Muons
-				if (PlaneTrue[0] && PlaneTrue[1] && PlaneTrue[2] && PlaneTrue[3]) {
-					CoinType[1] = true;
+				if (CoinBits & kCoinVertical) {
 					printf("Entry: %li  Vertical Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 						,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 				}
 
 				// 2. Both top or side layers + both bottom layers.
-				if ((PlaneTrue[0] && PlaneTrue[1]) && ((PlaneTrue[2] && PlaneTrue[3]) || (PlaneTrue[4] && PlaneTrue[5])
-					|| (PlaneTrue[6] && PlaneTrue[7]) || (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[2] = true;
+				if (CoinBits & kCoinSideBottom) {
 					
 					// show output if we haven't seen it from CT1 already
-					if (!CoinType[1]) { 
+					if (!(CoinBits & kCoinVertical)) { 
 						printf("Entry: %li  Side+Bottom Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 							,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 					}
 				}
 
 				// 3. Both Top + Both Sides
-				if ((PlaneTrue[2] && PlaneTrue[3]) && ((PlaneTrue[4] && PlaneTrue[5]) || (PlaneTrue[6] && PlaneTrue[7])
-					|| (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[3] = true;
+				if (CoinBits & kCoinTopSide) {
 
 					// show output if we haven't seen it from CT1 or CT2 already
-					if (!CoinType[1] && !CoinType[2]) { 
+					if (!(CoinBits & (kCoinVertical | kCoinSideBottom))) { 
 						printf("Entry: %li  Top+Sides Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 							,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 					}
@@ -378,10 +359,10 @@ void muSimple(string Input, int *thresh)
 			// 
 
 			char buffer[200];
-			if (CoinType[1] || CoinType[0]) {
+			if (CoinBits & (kCoinMuon | kCoinVertical)) {
 				int type;
-				if (CoinType[0]) type = 1;
-				if (CoinType[1]) type = 2;
+				if (CoinBits & kCoinMuon) type = 1;
+				if (CoinBits & kCoinVertical) type = 2;
 				sprintf(buffer,"%i %li %.8f %i %i\n",run,start,xTime,type,veto.GetBadScaler());
 				MuonList << buffer;
 			}
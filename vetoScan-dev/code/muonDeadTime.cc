@@ -5,6 +5,7 @@
 // Calculate the Ge dead time from a muon list.
 
 #include "vetoScan.hh"
+#include "VetoWindowIndex.hh"
 
 void durationChecker(string file)
 {
@@ -70,6 +71,9 @@ void muonDeadTime(string file)
 	int numGoodScalers = 0;
 	double deadGoodScalerTime = 0;
 
+	// The same windows, merged per run, to find the overlaps
+	VetoWindowSet windows;
+
 	// double duration = 0;
 
 	cout << "Scanning list ..." << endl;
@@ -81,28 +85,32 @@ void muonDeadTime(string file)
 			if (badScaler) {
 				deadTime += 2*badScalerWindow;
 				deadBadScalerTime += 2*badScalerWindow;
+				windows.Add(run,hitTime-badScalerWindow,hitTime+badScalerWindow);
 			}
 			else {
 				deadTime += timeBefore + timeAfter;
 				deadGoodScalerTime += timeBefore + timeAfter;
+				windows.Add(run,hitTime-timeBefore,hitTime+timeAfter);
 			}
 		}
 		if (type == 3) {
 			if (badScaler) {
 				deadTime += badScalerWindow;
 				deadBadScalerTime += badScalerWindow;
+				windows.Add(run,hitTime,hitTime+badScalerWindow);
 			}
 			else {
 				deadTime += timeAfter;
 				deadGoodScalerTime += timeAfter;
+				windows.Add(run,hitTime,hitTime+timeAfter);
 			}
 		}
 
 		if (badScaler) numBadScalers++;
 		else numGoodScalers++;
 
-		// Attempt to find the possible overlapping events.
-		// These are usually at the end of a run.
+		// Overlaps between windows in the same run are found by merging them (below).
+		// This was an attempt to find the windows that run past the ends of a run.
 		// But since "duration" is only accurate to an integer,
 		// they may not be true overlaps.
 		// We don't know exactly when runs end, which makes
@@ -142,6 +150,9 @@ void muonDeadTime(string file)
 		*/
 
 	}
+	windows.Build();
+	windowOverlaps = deadTime - windows.DeadTime();
+	woCount = windows.GetNAdded() - windows.Size();
 	cout << "Dead time due to veto: " << deadTime << " seconds." << endl;
 
 	printf("Bad scalers: %i, %.2f of %.2f sec (%.2f%%)\n",numBadScalers,deadBadScalerTime,deadTime,((double)deadBadScalerTime/deadTime)*100);
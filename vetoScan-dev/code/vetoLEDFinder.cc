@@ -29,14 +29,8 @@ void vetoLEDFinder(string file)
 		TChain *v = ds.GetVetoChain();
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
-		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
 		unsigned int mVeto = 0;
-		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
-		v->GetEntry(0);
+		SetVetoBranches(v,&vRun,NULL,NULL,&mVeto);	// only mVeto is needed here
 
 		// Do a very rough estimate of the number of LED events 
 		// and output the frequency.
@@ -118,12 +118,8 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 		
 		long start = (long)vRun->GetStartTime();
 		long stop = (long)vRun->GetStopTime();
@@ -139,8 +135,7 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		vector<bool> LocalBadScalers;	
 
 		// run-by-run histos and graphs
-		sprintf(hname,"%d_LEDDeltaT",run);
-		TH1D *LEDDeltaT = new TH1D(hname,hname,100000,0,100); // 0.001 sec/bin
+		LEDTimer LEDDeltaT;
 		TH1D *deltaTRun = NULL;
 		TGraph *gMultipVsTimeRun = NULL;
 		TGraph *gSTimeVsfIndex = NULL;	
@@ -260,7 +255,7 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 			
 	    	// very simple LED tag 
 			if (veto.GetMultip() > 20) {
-				LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT.Fill(veto.GetTimeSec()-prev.GetTimeSec());
 				pureLEDcount++;
 				isLED = true;
 				totLED++;
@@ -285,6 +280,11 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		if ((LocalEntryNum.size() != LocalEntryTime.size()) || (LocalEntryNum.size() != LocalErrCountEntry.size()))
 		printf("Warning! Local vectors are not the same size!\n");
 
+		// bad scaler times, from the nearest good scalers
+		ScalerTimeInterp badScalerTimes;
+		if (!badScalerTimes.Build(LocalEntryTime,LocalBadScalers))
+			printf("Warning! Local time and bad scaler vectors are not the same size!\n");
+
 		// if duration is corrupted, use the last good timestamp as the duration.
 		if (duration == 0) {
 			printf("Corrupted duration. Using last good timestamp: %.2f\n",lastGoodTime-first.GetTimeSec());
@@ -301,12 +301,10 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		printf("\"Simple\" LED count: %i.  Approx rate: %.3f\n",pureLEDcount,pureLEDcount/duration);
 		double LEDrms = 0;
 		double LEDfreq = 0;
-		int dtEntries = LEDDeltaT->GetEntries();
+		int dtEntries = LEDDeltaT.GetEntries();
 		if (dtEntries > 0) {
-			int maxbin = LEDDeltaT->GetMaximumBin();
-			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-			LEDrms = LEDDeltaT->GetRMS();
-			LEDfreq = 1/LEDDeltaT->GetMean();
+			LEDrms = LEDDeltaT.GetRMS();
+			LEDfreq = 1/LEDDeltaT.GetPeriod(); // mean delta-t within ~0.1 seconds of the peak.
 		}
 		else {
 			printf("Warning! No multiplicity > 20 events!!\n");
@@ -315,7 +313,6 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		}
 		double LEDperiod = 1/LEDfreq;
 		printf("Histo method: LED_f: %.8f LED_t: %.8f RMS: %8f\n",LEDfreq,LEDperiod,LEDrms);
-		delete LEDDeltaT;
 		if (LEDfreq != 9999 && vEntries > 100) {
 			runs.push_back(run);
 			freqs.push_back(LEDfreq);
@@ -384,13 +381,13 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 			}
 			else if (run > 8557 && veto.GetTimeSBC() < 2000000000) {
 				xTime = veto.GetTimeSBC() - SBCOffset;
-				double interpTime = InterpTime(i,LocalEntryTime,LocalEntryNum,LocalBadScalers);
+				double interpTime = badScalerTimes.GetTime(i);
 				printf("Entry %i : SBC method: %.2f  Interp method: %.2f  sbc-interp: %.2f\n",i,xTime,interpTime,xTime-interpTime);
 				TimeMethod = 2;
 			}
 			else {
 				double eTime = ((double)i / vEntries) * duration;
-				xTime = InterpTime(i,LocalEntryTime,LocalEntryNum,LocalBadScalers);
+				xTime = badScalerTimes.GetTime(i);
 				printf("Entry %i : Entry method: %.2f  Interp method: %.2f  eTime-interp: %.2f\n",i,eTime,xTime,eTime-xTime);
 				TimeMethod = 3;
 			}
@@ -61,12 +61,8 @@ void vetoThreshFinder(string Input, bool runHistos)
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 
 		printf("\n========= Scanning Run %i: %li entries. =========\n",run,vEntries);
 
@@ -29,12 +29,8 @@ void vetoTimeFinder(string file)
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 
 		printf("\n=========== Scanning Run %i: %li entries. ===========\n",run,vEntries);
 
@@ -55,9 +51,7 @@ void vetoTimeFinder(string file)
 		bool foundFirst = false;
 		int firstGoodEntry = 0;
 		MJVetoEvent prev;
-		char hname[200];
-		sprintf(hname,"LEDDeltaT_run%i",run);
-		TH1F *LEDDeltaT = new TH1F(hname,hname,100000,0,100); // 0.001 sec/bin
+		LEDTimer LEDDeltaT;
 		int isGood = 0;
 		int highestMultip = 0;	// try to predict how many panels there are for this run.
 		int pureLEDcount = 0;
@@ -82,7 +76,7 @@ void vetoTimeFinder(string file)
 	    	// Super simple LED tag
 	    	if (veto.GetMultip() > highestMultip && veto.GetMultip() < 33) highestMultip = veto.GetMultip();
 			if (veto.GetMultip() >= 20) { 				
-				LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT.Fill(veto.GetTimeSec()-prev.GetTimeSec());
 				pureLEDcount++;
 			}
 			prev = veto;
@@ -96,12 +90,10 @@ void vetoTimeFinder(string file)
 		printf("\"Pure\" LED count: %i.  Approx rate: %.3f\n",pureLEDcount,pureLEDcount/duration);
 		double LEDrms = 0;
 		double LEDfreq = 0;
-		int dtEntries = LEDDeltaT->GetEntries();
+		int dtEntries = LEDDeltaT.GetEntries();
 		if (dtEntries > 0) {
-			int maxbin = LEDDeltaT->GetMaximumBin();
-			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-			LEDrms = LEDDeltaT->GetRMS();
-			LEDfreq = 1/LEDDeltaT->GetMean();
+			LEDrms = LEDDeltaT.GetRMS();
+			LEDfreq = 1/LEDDeltaT.GetPeriod(); // mean delta-t within ~0.1 seconds of the peak.
 		}
 		else {
 			printf("Warning! No multiplicity > 20 events!!\n");
@@ -110,7 +102,6 @@ void vetoTimeFinder(string file)
 		}
 		double LEDperiod = 1/LEDfreq;
 		printf("LED_f: %.8f LED_t: %.8f RMS: %8f\n",LEDfreq,LEDperiod,LEDrms);
-		delete LEDDeltaT;
 
 
 		// ===================== SECOND LOOP OVER ENTRIES =========================
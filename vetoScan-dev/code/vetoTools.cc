@@ -56,6 +56,28 @@ int GetNumFiles(string arg)
   	return filesToScan;
 }
 
+// Pruned VetoTree reading.  Only the branches passed in are read with each GetEntry
+// (pass NULL to skip one), through a TTreeCache holding just those branches, set up
+// front (no learning phase).  The run object is the same for the whole file, so it's
+// read here with entry 0 and then switched off.
+void SetVetoBranches(TChain *v, MJTRun **vRun, MGTBasicEvent **vEvent, uint32_t *vBits, unsigned int *mVeto)
+{
+	v->SetBranchStatus("*",0);
+	v->SetBranchStatus("run",1);
+	v->SetBranchAddress("run",vRun);
+	if (vEvent) { v->SetBranchStatus("vetoEvent",1); v->SetBranchAddress("vetoEvent",vEvent); }
+	if (vBits) { v->SetBranchStatus("vetoBits",1); v->SetBranchAddress("vetoBits",vBits); }
+	if (mVeto) { v->SetBranchStatus("mVeto",1); v->SetBranchAddress("mVeto",mVeto); }
+	v->GetEntry(0);
+	v->SetBranchStatus("run",0);
+
+	v->SetCacheSize(8*1024*1024);
+	if (vEvent) v->AddBranchToCache("vetoEvent",kTRUE);
+	if (vBits) v->AddBranchToCache("vetoBits",kTRUE);
+	if (mVeto) v->AddBranchToCache("mVeto",kTRUE);
+	v->StopCacheLearningPhase();
+}
+
 // ROOT color wheel: https://root.cern.ch/root/html/TColor.html
 int color(int i)
 {
@@ -70,61 +92,12 @@ int color(int i)
 }
 
 // For tagging plane-based coincidences.
-// This uses a zero-indexed map.
-int PanelMap(int i){
-	// 0: Lower Bottom
-	// 1: Upper Bottom
-	// 2: Inner Top
-	// 3: Outer Top
-	// 4: Inner North
-	// 5: Outer North
-	// 6: Inner South
-	// 7: Outer South
-	// 8: Inner West
-	// 9: Outer West
-	// 10: Inner East
-	// 11: Outer East 
-			
-	if 		(i == 0) return 0;  // L-bot 1
-	else if (i == 1) return 0;  
-	else if (i == 2) return 0;
-	else if (i == 3) return 0;
-	else if (i == 4) return 0;
-	else if (i == 5) return 0;  // L-bot 6
-
-	else if (i == 6) return 1;  // U-bot 1
-	else if (i == 7) return 1;
-	else if (i == 8) return 1;
-	else if (i == 9) return 1;
-	else if (i == 10) return 1;
-	else if (i == 11) return 1; // U-bot 6
-
-	else if (i == 17) return 3; // Top outer
-	else if (i == 18) return 3; // Top outer
-	else if (i == 20) return 2; // Top inner
-	else if (i == 21) return 2; // Top inner
-
-	else if (i == 15) return 5; // North outer
-	else if (i == 16) return 5; // North outer
-	else if (i == 19) return 4; // North inner
-	else if (i == 23) return 4; // North inner
-
-	else if (i == 24) return 6; // South inner
-	else if (i == 25) return 7; // South outer
-	else if (i == 26) return 6; // South inner
-	else if (i == 27) return 7; // South outer
-	
-	else if (i == 12) return 8; // West inner
-	else if (i == 13) return 8; // West inner
-	else if (i == 14) return 9; // West outer
-	else if (i == 22) return 9; // West outer
-	
-	else if (i == 28) return 10; // East inner
-	else if (i == 29) return 11; // East outer
-	else if (i == 30) return 10; // East inner
-	else if (i == 31) return 11; // East outer
-
-	else return -1;
+// This uses a zero-indexed map, resolved by run (see auto-veto/VetoGeometry.hh).
+// Event loops should keep their own VetoGeometry for the run instead.
+int PanelMap(int i, int runNum)
+{
+	VetoGeometry geo(runNum);
+	return geo.GetPlane(i);
 }
 
 // MJVetoEvent "error filter" - analysis codes skip events which fail
@@ -244,35 +217,3 @@ int* GetQDCThreshold(string file, int *arr, string name)
 
 	return arr;
 }
-
-double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler)
-{
-	if ((times.size() != entries.size()) || times.size() != badScaler.size()) 
-	{
-		cout << "Vectors are different sizes!\n";  
-		if (entry >= (int)times.size()) 
-			cout << "Entry is larger than number of entries in vector!\n";
-		return -1; 
-	}
-	
-	double iTime = 0;
-
-	double lower = 0;
-	double upper = 0;
-	if (!badScaler[entry]) iTime = times[entry];
-	else 
-	{
-		for (int i = entry; i < (int)entries.size(); i++) 
-		{
-			if (badScaler[i] == 0) { upper = times[i]; break; }
-		}
-		for (int j = entry; j > 0; j--)
-		{
-			if (badScaler[j] == 0) { lower = times[j]; break; }
-		}
-
-		iTime = (upper + lower)/2.0;
-	}
-
-	return iTime;
-}
\ No newline at end of file
@@ -38,6 +38,7 @@ static const char Usage[] =
 "     -D (--dispList) : Create veto hit list for vetoDisplay code\n"
 "     -L (--vetoList) : Create veto hit list for DEMONSTRATOR Veto Cut\n"
 "     -s (--muSimple) : Run a simplified version of muFinder\n"
+"     -P (--profile) : Write per-phase timing and I/O to this JSON file (see VetoProfile.hh)\n"
 "\n";
 
 int main(int argc, char** argv) 
@@ -50,7 +51,7 @@ int main(int argc, char** argv)
 	// Parse command line arguments with getopt_long:
 	// http://www.gnu.org/software/libc/manual/html_node/Getopt-Long-Option-Example.html
 	//
-	string file = "", partNum = "", threshName = "";
+	string file = "", partNum = "", threshName = "", profileFile = "";
 	bool findMuons=0, perfCheck=0, fileCheck=0, findTime=0,findLED=0,findThresh=0,deadTime=0,durationCheck=0;
 	bool muPlot=0, muParse=0,checkBuilt=0,checkGAT=0,checkGDS=0,root=0,list=0;
 	bool runBreakdowns=0,geCoins=0,muList=0,vetoCutList=0;
@@ -78,11 +79,12 @@ int main(int argc, char** argv)
 			{"geCoins", required_argument, 0, 'G'},
 			{"dispList", no_argument,0,'D'},
 			{"vetoList", no_argument, 0, 'L'},
-			{"muSimple", no_argument, 0, 's'}
+			{"muSimple", no_argument, 0, 's'},
+			{"profile", required_argument, 0, 'P'}
 		};
 
 		// don't forget to add a new option here too!
-		c = getopt_long (argc, argv, "hF:S:f:H:T:m:p:tldorGDLsu",long_options,&option_index);
+		c = getopt_long (argc, argv, "hF:S:f:H:T:m:p:tldorGDLsuP:",long_options,&option_index);
 		if (c == -1) break;
 
 		switch (c)
@@ -137,6 +139,7 @@ int main(int argc, char** argv)
 		case 'D': muList=1; break;
 		case 'L': vetoCutList=1; break;
 		case 's': muSimp=1; break;
+		case 'P': profileFile = string(optarg); break;
 		case '?':
 		    if (isprint (optopt))  fprintf (stderr, "Unknown option `-%c'.\n", optopt);
 		    else fprintf (stderr,"Unknown option character `\\x%x'.\n",optopt);
@@ -151,6 +154,8 @@ int main(int argc, char** argv)
 	// Run selected routines
 	//
 	int thresh[32] = {0};
+	VetoProfiler prof("vetoScan");
+	if (profileFile != "") VetoProfilerCurrent() = &prof;
 
 	if (fileCheck) 	vetoFileCheck(file,partNum,checkBuilt,checkGAT,checkGDS);
 	if (findTime)	vetoTimeFinder(file);
@@ -182,6 +187,13 @@ int main(int argc, char** argv)
 	if (muList)		muDisplayList(file);
 	if (vetoCutList) muListGen(file);
 
+	if (profileFile != "") {
+		VetoProfilerCurrent() = 0;
+		prof.SetPeakRSS();
+		VetoProfileReport::Get().Add(prof);
+		if (VetoProfileReport::Get().Write(profileFile,"vetoScan")) cout << "Wrote profile: " << profileFile << endl;
+	}
+
 	// =======================================================
 
 	cout << "\nCletus codes good." << endl;
@@ -32,6 +32,12 @@
 #include "MJVetoEvent.hh"
 #include "GATDataSet.hh"
 #include "GATMultiplicityProcessor.hh"
+#include "VetoGeometry.hh"
+#include "VetoCoincidence.hh"
+#include "VetoPanelSummary.hh"
+#include "VetoTimeInterp.hh"
+#include "VetoLEDTimer.hh"
+#include "VetoProfile.hh"
 
 
 using namespace std;
@@ -41,12 +47,12 @@ void Test();
 long GetStartUnixTime(GATDataSet ds);
 long GetStopUnixTime(GATDataSet ds);
 int GetNumFiles(string arg);
+void SetVetoBranches(TChain *v, MJTRun **vRun, MGTBasicEvent **vEvent, uint32_t *vBits, unsigned int *mVeto = NULL);
 int color(int i);
-int PanelMap(int i);
+int PanelMap(int i, int runNum);
 int* GetQDCThreshold(string file, int *arr, string name = "");
 bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool deactivate);
 int FindQDCThreshold(TH1F *qdcHist, int panel, bool verbose);
-double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler);
 
 // Analysis
 void vetoFileCheck(string file = "", string partNum = "", bool checkBuilt = true, bool checkGat = true, bool checkGDS = false);
@@ -105,13 +105,8 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent();
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
-		v->GetEntry(0);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 		start = (long)vRun->GetStartTime();
 		stop = (long)vRun->GetStopTime();
 		duration = ds->GetRunTime()/CLHEP::second;
@@ -117,12 +117,8 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
-		unsigned int mVeto = 0;
 		uint32_t vBits = 0;
-		v->SetBranchAddress("run",&vRun);
-		v->SetBranchAddress("mVeto",&mVeto);
-		v->SetBranchAddress("vetoEvent",&vEvent);
-		v->SetBranchAddress("vetoBits",&vBits);
+		SetVetoBranches(v,&vRun,&vEvent,&vBits);	// also reads vRun
 		
 		long start = (long)vRun->GetStartTime();
 		long stop = (long)vRun->GetStopTime();
@@ -56,6 +56,28 @@ int GetNumFiles(string arg)
   	return filesToScan;
 }
 
+// Pruned VetoTree reading.  Only the branches passed in are read with each GetEntry
+// (pass NULL to skip one), through a TTreeCache holding just those branches, set up
+// front (no learning phase).  The run object is the same for the whole file, so it's
+// read here with entry 0 and then switched off.
+void SetVetoBranches(TChain *v, MJTRun **vRun, MGTBasicEvent **vEvent, uint32_t *vBits, unsigned int *mVeto)
+{
+	v->SetBranchStatus("*",0);
+	v->SetBranchStatus("run",1);
+	v->SetBranchAddress("run",vRun);
+	if (vEvent) { v->SetBranchStatus("vetoEvent",1); v->SetBranchAddress("vetoEvent",vEvent); }
+	if (vBits) { v->SetBranchStatus("vetoBits",1); v->SetBranchAddress("vetoBits",vBits); }
+	if (mVeto) { v->SetBranchStatus("mVeto",1); v->SetBranchAddress("mVeto",mVeto); }
+	v->GetEntry(0);
+	v->SetBranchStatus("run",0);
+
+	v->SetCacheSize(8*1024*1024);
+	if (vEvent) v->AddBranchToCache("vetoEvent",kTRUE);
+	if (vBits) v->AddBranchToCache("vetoBits",kTRUE);
+	if (mVeto) v->AddBranchToCache("mVeto",kTRUE);
+	v->StopCacheLearningPhase();
+}
+
 // ROOT color wheel: https://root.cern.ch/root/html/TColor.html
 int color(int i)
 {
@@ -36,6 +36,7 @@ void Test();
 long GetStartUnixTime(GATDataSet ds);
 long GetStopUnixTime(GATDataSet ds);
 int GetNumFiles(string arg);
+void SetVetoBranches(TChain *v, MJTRun **vRun, MGTBasicEvent **vEvent, uint32_t *vBits, unsigned int *mVeto = NULL);
 int color(int i);
 int PanelMap(int i);
 int* GetQDCThreshold(string file, int *arr, string name = "");